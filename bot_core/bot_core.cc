@@ -14,10 +14,13 @@
 #include "utility/msg_checker.h"
 #include "utility/log.h"
 #include "game_framework/game_main.h"
+#include "bot_core/cached_db_manager.h"
 #include "bot_core/db_manager.h"
+#include "bot_core/image.h"
 #include "bot_core/match.h"
 #include "bot_core/message_handlers.h"
 #include "bot_core/msg_sender.h"
+#include "bot_core/user_identity_cache.h"
 
 #include "sqlite_modern_cpp.h"
 
@@ -28,12 +31,47 @@ const int32_t LGT_AC = -1;
 BotCtx::BotCtx(const BotOption& option, std::unique_ptr<DBManagerBase> db_manager)
     : this_uid_(option.this_uid_)
     , game_path_(std::filesystem::absolute(option.game_path_).string())
-    , match_manager_(*this)
     , db_manager_(std::move(db_manager))
+    , match_manager_(*this)
 {
+    if (db_manager_) {
+        std::filesystem::path journal_path;
+        if (option.db_path_ && std::filesystem::path(option.db_path_) != ":memory:") {
+            journal_path = std::filesystem::path(option.db_path_) += ".journal";
+        }
+        match_recorder_ = std::make_unique<MatchRecorder>(*db_manager_, std::move(journal_path));
+    }
+    ImageStore::Get().Clear(); // the images saved by the last process will never be sent
     LoadGameModules_(option.game_path_);
     LoadAdmins_(option.admins_);
     HandleConfig_(option.conf_path_);
+    RegisterGauges_();
+#ifndef TEST_BOT
+    metrics_snapshotter_ = std::make_unique<MetricsSnapshotter>(std::filesystem::current_path() / "metrics.txt",
+            [this] { return std::chrono::seconds(GET_OPTION_VALUE(this->option(), 性能快照间隔)); });
+    checkpoint_path_ = std::filesystem::current_path() / "matches.checkpoint";
+    match_manager_.Restore(checkpoint_path_);
+#endif
+}
+
+void BotCtx::RegisterGauges_()
+{
+    gauges_.emplace_back(Metrics::Get().RegisterGauge("queue.timer_wheel.pending",
+                [] { return TimerWheel::Get().PendingNum(); }));
+    if (match_recorder_) {
+        gauges_.emplace_back(Metrics::Get().RegisterGauge("queue.match_recorder.pending",
+                    [this] { return match_recorder_->PendingNum(); }));
+    }
+    gauges_.emplace_back(Metrics::Get().RegisterGauge("match.num",
+                [this] { return match_manager_.Matches().size(); }));
+}
+
+void BotCtx::RegisterRequestDispatcherGauges_()
+{
+    gauges_.emplace_back(Metrics::Get().RegisterGauge("queue.request_dispatcher.pending",
+                [this] { return request_dispatcher_->GetStat().pending_num_; }));
+    gauges_.emplace_back(Metrics::Get().RegisterGauge("queue.request_dispatcher.running",
+                [this] { return request_dispatcher_->GetStat().running_num_; }));
 }
 
 void BotCtx::LoadAdmins_(const std::string_view& admins_str)
@@ -72,7 +110,8 @@ void BotCtx::HandleConfig_(const std::filesystem::path::value_type* const conf_p
     }
     InfoLog() << "Handle config file: " << conf_path;
     for (std::string s; std::getline(f, s); ) {
-        if (const ErrCode rc = HandleAdminRequest(*this, "", std::nullopt, s, EmptyMsgSender::Get()); rc != EC_OK) {
+        MsgReader reader(s);
+        if (const ErrCode rc = HandleAdminRequest(*this, "", std::nullopt, reader, EmptyMsgSender::Get()); rc != EC_OK) {
             ErrorLog() << "Handle initial admin request \"" << s << "\" failed, rc=" << errcode2str(rc);
         } else {
             InfoLog() << "Handle initial admin request \"" << s << "\" succeed";
@@ -80,26 +119,31 @@ void BotCtx::HandleConfig_(const std::filesystem::path::value_type* const conf_p
     }
 }
 
-static ErrCode HandleRequest(BotCtx& bot, const std::optional<GroupID> gid, const UserID uid, const std::string& msg,
-                             MsgSender& reply)
+static ErrCode HandleRequestImpl(BotCtx& bot, const std::optional<GroupID> gid, const UserID uid,
+                                 const std::string& msg, MsgReader& reader, MsgSender& reply)
 {
+    const UserIdentityCache::RequestStatScope identity_cache_stat_scope;
     if (uid == bot.this_uid()) {
         ErrorLog() << "receive self request: " << msg;
         return EC_UNEXPECTED_ERROR;
     }
-    if (std::string first_arg; !(std::stringstream(msg) >> first_arg) || first_arg.empty()) {
+    if (!reader.HasNext()) {
         reply() << "[错误] 我不理解，所以你是想表达什么？";
         return EC_REQUEST_EMPTY;
     } else {
-        switch (first_arg[0]) {
-        case '#':
-            return HandleMetaRequest(bot, uid, gid, msg, reply);
-        case '%':
+        switch (reader.NextArg().front()) {
+        case '#': {
+            METRICS_LATENCY_SCOPE("request.meta");
+            return HandleMetaRequest(bot, uid, gid, reader, reply);
+        }
+        case '%': {
             if (!bot.HasAdmin(uid)) {
                 reply() << "[错误] 您未持有管理员权限";
                 return EC_REQUEST_NOT_ADMIN;
             }
-            return HandleAdminRequest(bot, uid, gid, msg, reply);
+            METRICS_LATENCY_SCOPE("request.admin");
+            return HandleAdminRequest(bot, uid, gid, reader, reply);
+        }
         default:
             std::shared_ptr<Match> match = bot.match_manager().GetMatch(uid);
             if (!match) {
@@ -117,6 +161,20 @@ static ErrCode HandleRequest(BotCtx& bot, const std::optional<GroupID> gid, cons
     }
 }
 
+// |reader| is split from |msg|, and it is not read before.
+static ErrCode HandleRequest(BotCtx& bot, const std::optional<GroupID> gid, const UserID uid, const std::string& msg,
+                             MsgReader& reader, MsgSender& reply)
+{
+    static Counter& request_counter = Metrics::Get().GetCounter("request.num");
+    static Counter& failed_request_counter = Metrics::Get().GetCounter("request.failed_num");
+    request_counter.Add();
+    const ErrCode rc = HandleRequestImpl(bot, gid, uid, msg, reader, reply);
+    if (rc != EC_OK) {
+        failed_request_counter.Add();
+    }
+    return rc;
+}
+
 void* /*__cdecl*/ BOT_API::Init(const BotOption* option)
 {
 #ifdef WITH_GLOG
@@ -127,7 +185,7 @@ void* /*__cdecl*/ BOT_API::Init(const BotOption* option)
         return nullptr;
     }
     InfoLog() << "Init the bot succeed";
-    return new BotCtx(*option, SQLiteDBManager::UseDB(option->db_path_));
+    return new BotCtx(*option, CachedDBManager::Wrap(SQLiteDBManager::UseDB(option->db_path_)));
 }
 
 void /*__cdelcl*/ BOT_API::Release(void* const bot_p)
@@ -143,13 +201,28 @@ bool /*__cdelcl*/ BOT_API::ReleaseIfNoProcessingGames(void* const bot_p)
         return false;
     }
     BotCtx& bot = *static_cast<BotCtx*>(bot_p);
-    const auto matches = bot.match_manager().Matches();
-    if (std::ranges::any_of(matches, [](const auto& match) { return match->state() == Match::State::IS_STARTED; })) {
-        InfoLog() << "ReleaseIfNoProcessingGames failed because there are processing games";
-        return false;
+    const auto is_started = [](const auto& match) { return match->state() == Match::State::IS_STARTED; };
+    // the processing games can be resumed after the bot restarts if they are checkpointed
+    std::vector<std::shared_ptr<Match>> checkpointed_matches;
+    if (std::ranges::any_of(bot.match_manager().Matches(), is_started)) {
+        auto matches = bot.checkpoint_path().empty() ? std::nullopt
+                                                     : bot.match_manager().Checkpoint(bot.checkpoint_path());
+        if (!matches.has_value()) {
+            InfoLog() << "ReleaseIfNoProcessingGames failed because there are processing games which cannot be checkpointed";
+            return false;
+        }
+        checkpointed_matches = std::move(*matches);
     }
     InfoLog() << "Releasing the bot in ReleaseIfNoProcessingGames";
-    std::ranges::for_each(matches, [](const auto& match) { match->Terminate(true); });
+    // Only the checkpointed matches are suspended, the matches started after the checkpoint cannot be resumed.
+    std::ranges::for_each(bot.match_manager().Matches(), [&](const auto& match)
+            {
+                if (std::ranges::find(checkpointed_matches, match) != checkpointed_matches.end()) {
+                    match->Suspend();
+                } else {
+                    match->Terminate(true);
+                }
+            });
     delete &bot;
     return true;
 }
@@ -163,7 +236,9 @@ ErrCode /*__cdecl*/ BOT_API::HandlePrivateRequest(void* const bot_p, const char*
     DebugLog() << "Handle private request uid=" << uid << " msg=\"" << msg << "\"";
     BotCtx& bot = *static_cast<BotCtx*>(bot_p);
     MsgSender sender(UserID{uid});
-    return HandleRequest(bot, std::nullopt, uid, msg, sender);
+    const std::string msg_str(msg);
+    MsgReader reader(msg_str);
+    return HandleRequest(bot, std::nullopt, uid, msg_str, reader, sender);
 }
 
 class PublicReplyMsgSender : public MsgSender
@@ -190,6 +265,67 @@ ErrCode /*__cdecl*/ BOT_API::HandlePublicRequest(void* const bot_p, const char*
     DebugLog() << "Handle public request uid=" << uid << " gid=" << gid << " msg=" << msg;
     BotCtx& bot = *static_cast<BotCtx*>(bot_p);
     PublicReplyMsgSender sender(GroupID{gid}, UserID{uid});
-    return HandleRequest(bot, gid, uid, msg, sender);
+    const std::string msg_str(msg);
+    MsgReader reader(msg_str);
+    return HandleRequest(bot, gid, uid, msg_str, reader, sender);
+}
+
+// The requests of a user in a match are handled in the lane of the match, including the meta requests, so that they are
+// handled in the order they are received.
+// The message is split once when it is dispatched, and the arguments are read again by the task.
+struct DispatchedRequest
+{
+    explicit DispatchedRequest(std::string msg) : msg_(std::move(msg)), reader_(msg_) {}
+
+    const std::string msg_;
+    MsgReader reader_;
+};
+
+static void DispatchRequest(BotCtx& bot, const UserID& uid, DispatchedRequest& request, RequestDispatcher::Task task)
+{
+    const bool is_admin_request = request.reader_.HasNext() && request.reader_.NextArg().front() == '%';
+    request.reader_.Reset();
+    if (is_admin_request) {
+        bot.request_dispatcher().Dispatch(RequestDispatcher::Lane::ADMIN, MatchID(), std::move(task));
+    } else if (const auto match = bot.match_manager().GetMatch(uid)) {
+        bot.request_dispatcher().Dispatch(RequestDispatcher::Lane::MATCH, match->MatchId(), std::move(task));
+    } else {
+        bot.request_dispatcher().Dispatch(RequestDispatcher::Lane::META, MatchID(), std::move(task));
+    }
+}
+
+ErrCode /*__cdecl*/ BOT_API::HandlePrivateRequestAsync(void* const bot_p, const char* const uid, const char* const msg)
+{
+    if (!bot_p) {
+        ErrorLog() << "Dispatch private request not init failed uid=" << uid << " msg=\"" << msg << "\"";
+        return EC_NOT_INIT;
+    }
+    DebugLog() << "Dispatch private request uid=" << uid << " msg=\"" << msg << "\"";
+    BotCtx& bot = *static_cast<BotCtx*>(bot_p);
+    const auto request = std::make_shared<DispatchedRequest>(msg);
+    DispatchRequest(bot, uid, *request, [&bot, uid = UserID(uid), request]
+            {
+                MsgSender sender(uid);
+                HandleRequest(bot, std::nullopt, uid, request->msg_, request->reader_, sender);
+            });
+    return EC_OK;
+}
+
+ErrCode /*__cdecl*/ BOT_API::HandlePublicRequestAsync(void* const bot_p, const char* const gid, const char* const uid,
+                                                      const char* const msg)
+{
+    if (!bot_p) {
+        ErrorLog() << "Dispatch public request not init failed uid=" << uid << " gid=" << gid << " msg=" << msg;
+        return EC_NOT_INIT;
+    }
+    DebugLog() << "Dispatch public request uid=" << uid << " gid=" << gid << " msg=" << msg;
+    BotCtx& bot = *static_cast<BotCtx*>(bot_p);
+    const auto request = std::make_shared<DispatchedRequest>(msg);
+    DispatchRequest(bot, uid, *request, [&bot, gid = GroupID(gid), uid = UserID(uid), request]
+            {
+                PublicReplyMsgSender sender(gid, uid);
+                HandleRequest(bot, gid, uid, request->msg_, request->reader_, sender);
+            });
+    return EC_OK;
 }
 
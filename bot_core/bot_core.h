@@ -45,6 +45,7 @@ ERRCODE_DEF_V(EC_REQUEST_EMPTY, 301)
 ERRCODE_DEF(EC_REQUEST_NOT_ADMIN)
 ERRCODE_DEF(EC_REQUEST_NOT_FOUND)
 ERRCODE_DEF(EC_REQUEST_UNKNOWN_GAME)
+ERRCODE_DEF(EC_REQUEST_GAME_LOAD_FAILED)
 
 ERRCODE_DEF_V(EC_GAME_ALREADY_RELEASE, 401)
 ERRCODE_DEF(EC_USER_SUICIDE_FAILED)
@@ -124,6 +125,10 @@ class BOT_API
     static DLLEXPORT(bool) ReleaseIfNoProcessingGames(void* bot);
     static DLLEXPORT(ErrCode) HandlePrivateRequest(void* bot, const char* uid, const char* msg);
     static DLLEXPORT(ErrCode) HandlePublicRequest(void* bot, const char* gid, const char* uid, const char* msg);
+    // Queue the request and return immediately, and the request is handled by a worker thread. EC_OK is returned if the
+    // request is queued.
+    static DLLEXPORT(ErrCode) HandlePrivateRequestAsync(void* bot, const char* uid, const char* msg);
+    static DLLEXPORT(ErrCode) HandlePublicRequestAsync(void* bot, const char* gid, const char* uid, const char* msg);
 };
 
 #undef DLLEXPORT
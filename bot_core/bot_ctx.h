@@ -12,6 +12,10 @@
 #include "bot_core/match_manager.h"
 #include "bot_core/id.h"
 #include "bot_core/db_manager.h"
+#include "bot_core/match_recorder.h"
+#include "bot_core/metrics.h"
+#include "bot_core/metrics_snapshotter.h"
+#include "bot_core/request_dispatcher.h"
 #include "bot_core/options.h"
 
 #include <dirent.h>
@@ -38,8 +42,29 @@ class BotCtx
 
     DBManagerBase* db_manager() const { return db_manager_.get(); }
 
+    MatchRecorder* match_recorder() const { return match_recorder_.get(); }
+
+    // The dispatcher is created when it is used for the first time.
+    RequestDispatcher& request_dispatcher()
+    {
+        std::call_once(request_dispatcher_once_, [this]
+                {
+                    request_dispatcher_ = std::make_unique<RequestDispatcher>(RequestDispatcher::DefaultThreadNum());
+                    RegisterRequestDispatcherGauges_();
+                });
+        return *request_dispatcher_;
+    }
+
     const UserID this_uid() const { return this_uid_; }
 
+    // The started matches are checkpointed into this file when the bot is released, and restored when it restarts.
+    // Empty if the matches should not be checkpointed.
+#ifdef TEST_BOT
+    auto& checkpoint_path() { return checkpoint_path_; }
+#else
+    const auto& checkpoint_path() const { return checkpoint_path_; }
+#endif
+
     auto& option() { return mutable_bot_options_; }
     const auto& options() const { return mutable_bot_options_; }
 
@@ -47,15 +72,23 @@ class BotCtx
     void LoadGameModules_(const char* const games_path);
     void LoadAdmins_(const std::string_view& admins);
     void HandleConfig_(const std::filesystem::path::value_type* const conf_path);
+    void RegisterGauges_();
+    void RegisterRequestDispatcherGauges_();
 
     const UserID this_uid_;
     const std::string game_path_;
+    std::filesystem::path checkpoint_path_;
     std::mutex mutex_;
     GameHandleMap game_handles_;
     std::set<UserID> admins_;
-    MatchManager match_manager_;
 #ifdef WITH_SQLITE
     std::unique_ptr<DBManagerBase> db_manager_;
 #endif
+    std::unique_ptr<MatchRecorder> match_recorder_; /* make sure match_recorder_ is destructed after the matches */
     MutableBotOption mutable_bot_options_;
+    MatchManager match_manager_;
+    std::once_flag request_dispatcher_once_;
+    std::unique_ptr<RequestDispatcher> request_dispatcher_; /* make sure request_dispatcher_ is destructed first */
+    std::vector<Metrics::GaugeGuard> gauges_; /* except the gauges observing the members above */
+    std::unique_ptr<MetricsSnapshotter> metrics_snapshotter_;
 };
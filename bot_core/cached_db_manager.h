@@ -0,0 +1,293 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+#include "bot_core/db_manager.h"
+#include "bot_core/metrics.h"
+
+// Wraps a DBManagerBase and caches the results of the rank and profile queries, which are made for every rank image or
+// profile request but change only when matches are recorded or users clear their profiles. The writes through this
+// manager invalidate only the affected results, and the results are queried again when they are requested next time.
+//
+// The results are keyed by the time range, so the results of a finished season are no longer hit after the season
+// changes. The markdown of the same results is the same, so the rendered image is reused by MarkdownImageCache.
+//
+// The writes bypassing this manager (e.g. rebuilding the scores by tools) are not noticed, so Clear should be called
+// after them.
+class CachedDBManager : public DBManagerBase
+{
+  public:
+    static constexpr uint64_t k_default_user_capacity = 1024;
+    static constexpr uint64_t k_default_rank_capacity = 256;
+
+    struct Stat
+    {
+        uint64_t hit_num_ = 0;
+        uint64_t miss_num_ = 0;
+        uint64_t user_num_ = 0; // the users whose profiles are cached
+        uint64_t rank_num_ = 0;
+    };
+
+    // Returns null if |db| is null.
+    static std::unique_ptr<DBManagerBase> Wrap(std::unique_ptr<DBManagerBase> db)
+    {
+        return db ? std::make_unique<CachedDBManager>(std::move(db)) : nullptr;
+    }
+
+    explicit CachedDBManager(std::unique_ptr<DBManagerBase> db, const uint64_t user_capacity = k_default_user_capacity,
+            const uint64_t rank_capacity = k_default_rank_capacity)
+        : db_(std::move(db))
+        , user_capacity_(user_capacity)
+        , rank_capacity_(rank_capacity)
+        , generation_(0)
+        , hit_num_(0)
+        , miss_num_(0)
+        , hit_counter_(Metrics::Get().GetCounter("db_cache.hit"))
+        , miss_counter_(Metrics::Get().GetCounter("db_cache.miss"))
+    {
+    }
+
+    virtual ~CachedDBManager() {}
+
+    virtual std::vector<ScoreInfo> RecordMatch(const std::string& game_name, const std::optional<GroupID> gid,
+            const UserID& host_uid, const uint64_t multiple,
+            const std::vector<std::pair<UserID, int64_t>>& game_score_infos,
+            const std::vector<std::pair<UserID, std::string>>& achievements) override
+    {
+        auto score_infos = db_->RecordMatch(game_name, gid, host_uid, multiple, game_score_infos, achievements);
+        std::lock_guard<std::mutex> l(mutex_);
+        InvalidateMatch_(game_name, game_score_infos);
+        return score_infos;
+    }
+
+    virtual std::vector<std::vector<ScoreInfo>> RecordMatches(const std::vector<MatchRecord>& records) override
+    {
+        auto score_infos = db_->RecordMatches(records);
+        std::lock_guard<std::mutex> l(mutex_);
+        for (const auto& record : records) {
+            InvalidateMatch_(record.game_name_, record.game_score_infos_);
+        }
+        return score_infos;
+    }
+
+    virtual UserProfile GetUserProfile(const UserID& uid, const std::string_view& time_range_begin,
+            const std::string_view& time_range_end) override
+    {
+        const auto find = [&]() -> const UserProfile*
+            {
+                const auto user_it = users_.find(uid.GetStr());
+                if (user_it == users_.end()) {
+                    return nullptr;
+                }
+                lru_.splice(lru_.begin(), lru_, user_it->second.lru_it_);
+                const auto it = user_it->second.profiles_.find(TimeRangeKey_(time_range_begin, time_range_end));
+                return it == user_it->second.profiles_.end() ? nullptr : &it->second;
+            };
+        const auto insert = [&](UserProfile profile)
+            {
+                auto user_it = users_.find(uid.GetStr());
+                if (user_it == users_.end()) {
+                    if (users_.size() >= user_capacity_) {
+                        users_.erase(lru_.back());
+                        lru_.pop_back();
+                    }
+                    lru_.emplace_front(uid.GetStr());
+                    user_it = users_.emplace(uid.GetStr(), UserEntry{.lru_it_ = lru_.begin()}).first;
+                }
+                user_it->second.profiles_.emplace(TimeRangeKey_(time_range_begin, time_range_end), std::move(profile));
+            };
+        return Lookup_(find, insert, [&] { return db_->GetUserProfile(uid, time_range_begin, time_range_end); });
+    }
+
+    virtual bool Suicide(const UserID& uid, const uint32_t required_match_num) override
+    {
+        if (!db_->Suicide(uid, required_match_num)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> l(mutex_);
+        ++generation_;
+        ranks_.clear();
+        game_ranks_.clear();
+        EraseUser_(uid);
+        return true;
+    }
+
+    virtual RankInfo GetRank(const std::string_view& time_range_begin, const std::string_view& time_range_end) override
+    {
+        auto key = TimeRangeKey_(time_range_begin, time_range_end);
+        return Lookup_(
+                [&]() -> const RankInfo*
+                {
+                    const auto it = ranks_.find(key);
+                    return it == ranks_.end() ? nullptr : &it->second;
+                },
+                [&](RankInfo info)
+                {
+                    if (ranks_.size() >= rank_capacity_) {
+                        ranks_.clear();
+                    }
+                    ranks_.emplace(std::move(key), std::move(info));
+                },
+                [&] { return db_->GetRank(time_range_begin, time_range_end); });
+    }
+
+    virtual GameRankInfo GetLevelScoreRank(const std::string& game_name, const std::string_view& time_range_begin,
+            const std::string_view& time_range_end) override
+    {
+        auto key = std::make_tuple(game_name, std::string(time_range_begin), std::string(time_range_end));
+        return Lookup_(
+                [&]() -> const GameRankInfo*
+                {
+                    const auto it = game_ranks_.find(key);
+                    return it == game_ranks_.end() ? nullptr : &it->second;
+                },
+                [&](GameRankInfo info)
+                {
+                    if (game_ranks_.size() >= rank_capacity_) {
+                        game_ranks_.clear();
+                    }
+                    game_ranks_.emplace(std::move(key), std::move(info));
+                },
+                [&] { return db_->GetLevelScoreRank(game_name, time_range_begin, time_range_end); });
+    }
+
+    virtual AchievementStatisticInfo GetAchievementStatistic(const UserID& uid, const std::string& game_name,
+            const std::string& achievement_name) override
+    {
+        return db_->GetAchievementStatistic(uid, game_name, achievement_name);
+    }
+
+    virtual std::vector<HonorInfo> GetHonors() override { return db_->GetHonors(); }
+
+    virtual bool AddHonor(const UserID& uid, const std::string_view& description) override
+    {
+        if (!db_->AddHonor(uid, description)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> l(mutex_);
+        ++generation_;
+        EraseUser_(uid); // the profile shows the recent honors
+        return true;
+    }
+
+    virtual bool DeleteHonor(const int32_t id) override
+    {
+        if (!db_->DeleteHonor(id)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> l(mutex_);
+        ++generation_;
+        // we do not know whose honor it is
+        users_.clear();
+        lru_.clear();
+        return true;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        ++generation_;
+        users_.clear();
+        lru_.clear();
+        ranks_.clear();
+        game_ranks_.clear();
+    }
+
+    Stat GetStat() const
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        return Stat{.hit_num_ = hit_num_, .miss_num_ = miss_num_, .user_num_ = users_.size(),
+                    .rank_num_ = ranks_.size() + game_ranks_.size()};
+    }
+
+  private:
+    using TimeRangeKey = std::pair<std::string, std::string>;
+
+    struct UserEntry
+    {
+        std::list<std::string>::iterator lru_it_;
+        std::map<TimeRangeKey, UserProfile> profiles_;
+    };
+
+    static TimeRangeKey TimeRangeKey_(const std::string_view begin, const std::string_view end)
+    {
+        return {std::string(begin), std::string(end)};
+    }
+
+    // Query without the lock because the database may be slow. The result is not cached if any write finishes during
+    // the query, because the result may be read before the write and the invalidation has been done.
+    template <typename Find, typename Insert, typename Query>
+    std::invoke_result_t<Query> Lookup_(Find&& find, Insert&& insert, Query&& query)
+    {
+        uint64_t generation = 0;
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            if (const auto* const result = find()) {
+                ++hit_num_;
+                hit_counter_.Add();
+                return *result;
+            }
+            ++miss_num_;
+            miss_counter_.Add();
+            generation = generation_;
+        }
+        auto result = query();
+        std::lock_guard<std::mutex> l(mutex_);
+        if (generation == generation_) {
+            insert(result);
+        }
+        return result;
+    }
+
+    // REQUIRE: should be protected by mutex_
+    void InvalidateMatch_(const std::string& game_name, const std::vector<std::pair<UserID, int64_t>>& game_score_infos)
+    {
+        ++generation_;
+        ranks_.clear();
+        const auto begin = game_ranks_.lower_bound(std::make_tuple(game_name, std::string(), std::string()));
+        auto end = begin;
+        while (end != game_ranks_.end() && std::get<0>(end->first) == game_name) {
+            ++end;
+        }
+        game_ranks_.erase(begin, end);
+        for (const auto& [uid, _] : game_score_infos) {
+            EraseUser_(uid);
+        }
+    }
+
+    // REQUIRE: should be protected by mutex_
+    void EraseUser_(const UserID& uid)
+    {
+        if (const auto it = users_.find(uid.GetStr()); it != users_.end()) {
+            lru_.erase(it->second.lru_it_);
+            users_.erase(it);
+        }
+    }
+
+    const std::unique_ptr<DBManagerBase> db_;
+    const uint64_t user_capacity_;
+    const uint64_t rank_capacity_;
+
+    mutable std::mutex mutex_;
+    uint64_t generation_; // increased by each write
+    std::list<std::string> lru_; // the most recently used user is at the front
+    std::unordered_map<std::string, UserEntry> users_;
+    std::map<TimeRangeKey, RankInfo> ranks_;
+    std::map<std::tuple<std::string, std::string, std::string>, GameRankInfo> game_ranks_;
+
+    uint64_t hit_num_;
+    uint64_t miss_num_;
+    Counter& hit_counter_;
+    Counter& miss_counter_;
+};
@@ -9,9 +9,14 @@
 #include <sstream>
 #include <type_traits>
 #include <cmath>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <unordered_map>
 
 #include "utility/log.h"
 #include "bot_core/match.h"
+#include "bot_core/metrics.h"
 #include "bot_core/score_calculation.h"
 
 #include "sqlite_modern_cpp.h"
@@ -26,49 +31,165 @@ static void HandleError(const std::exception& e)
     ErrorLog() << "DB error " << e.what();
 }
 
+// A connection with its prepared statements. Each statement is prepared when it is used for the first time and reused
+// later, so the SQL text is parsed only once per connection.
+class SQLiteConnection
+{
+  public:
+    SQLiteConnection(const DBName& db_name, const sqlite::OpenFlags flags)
+        : db_(db_name, sqlite::sqlite_config{.flags = flags})
+    {
+        db_ << "PRAGMA busy_timeout = 5000;";
+    }
+
+    SQLiteConnection(sqlite::database db) : db_(std::move(db)) {}
+
+    sqlite::database_binder& operator<<(const std::string& sql)
+    {
+        auto it = statements_.find(sql);
+        if (it == statements_.end()) {
+            it = statements_.emplace(sql, db_ << sql).first;
+            it->second.used(true); // do not execute when the connection is released
+        }
+        return it->second;
+    }
+
+    // Reset the statements so that they do not hold the snapshot of a finished transaction.
+    void ResetStatements()
+    {
+        for (auto& [_, statement] : statements_) {
+            statement.reset();
+            statement.used(true); // reset marks it unused, which makes it executed again when the connection is released
+        }
+    }
+
+    int64_t last_insert_rowid() const { return db_.last_insert_rowid(); }
+
+    sqlite::database& db() { return db_; }
+
+  private:
+    sqlite::database db_;
+    std::unordered_map<std::string, sqlite::database_binder> statements_;
+};
+
+static void Rollback(SQLiteConnection& db)
+{
+    try {
+        // the transaction is left open by the exception, and the connection will be reused
+        (db << "ROLLBACK;").execute();
+    } catch (const std::exception& e) {
+        HandleError(e);
+    }
+}
+
 template <typename Fn>
-static bool ExecuteTransaction(const DBName& db_name, const Fn& fn)
+static bool ExecuteTransaction(SQLiteConnection& db, const bool readonly, const Fn& fn)
 {
+    bool ret = false;
     try {
-        sqlite::database db(db_name);
-        db << "BEGIN;";
+        (db << (readonly ? "BEGIN;" : "BEGIN IMMEDIATE;")).execute();
         if (fn(db)) {
-            db << "COMMIT;";
-            return true;
+            (db << "COMMIT;").execute();
+            ret = true;
         } else {
-            db << "ROLLBACK";
-            return false;
+            (db << "ROLLBACK;").execute();
         }
     } catch (const sqlite::sqlite_exception& e) {
         HandleError(e);
+        Rollback(db);
     } catch (const std::exception& e) {
         HandleError(e);
+        Rollback(db);
     }
-    return false;
+    db.ResetStatements();
+    return ret;
 }
 
-uint64_t InsertMatch(sqlite::database& db, const std::string& game_name, const std::optional<GroupID> gid, const UserID host_uid,
+// A writer connection and several reader connections. The database is in WAL mode, so readers do not block the writer
+// and each other.
+class SQLiteConnectionPool
+{
+  public:
+    static constexpr uint32_t k_default_reader_num = 4;
+
+    SQLiteConnectionPool(const DBName& db_name, uint32_t reader_num)
+        : writer_(db_name, sqlite::OpenFlags::READWRITE | sqlite::OpenFlags::CREATE)
+    {
+        std::string journal_mode;
+        writer_.db() << "PRAGMA journal_mode = WAL;" >> journal_mode;
+        writer_.db() << "PRAGMA synchronous = NORMAL;";
+        if (journal_mode != "wal") {
+            // in-memory database cannot be shared by connections, and other journal modes block readers when writing
+            reader_num = 0;
+        }
+        for (uint32_t i = 0; i < reader_num; ++i) {
+            readers_.emplace_back(std::make_unique<SQLiteConnection>(db_name, sqlite::OpenFlags::READONLY));
+            idle_readers_.emplace_back(readers_.back().get());
+        }
+    }
+
+    template <typename Fn>
+    bool ExecuteTransaction(const bool readonly, const Fn& fn)
+    {
+        if (!readonly || readers_.empty()) {
+            std::lock_guard<std::mutex> l(writer_mutex_);
+            return ::ExecuteTransaction(writer_, readonly, fn);
+        }
+        SQLiteConnection* const reader = AcquireReader_();
+        const bool ret = ::ExecuteTransaction(*reader, readonly, fn);
+        ReleaseReader_(reader);
+        return ret;
+    }
+
+  private:
+    SQLiteConnection* AcquireReader_()
+    {
+        std::unique_lock<std::mutex> l(reader_mutex_);
+        reader_cv_.wait(l, [this] { return !idle_readers_.empty(); });
+        SQLiteConnection* const reader = idle_readers_.back();
+        idle_readers_.pop_back();
+        return reader;
+    }
+
+    void ReleaseReader_(SQLiteConnection* const reader)
+    {
+        {
+            std::lock_guard<std::mutex> l(reader_mutex_);
+            idle_readers_.emplace_back(reader);
+        }
+        reader_cv_.notify_one();
+    }
+
+    std::mutex writer_mutex_;
+    SQLiteConnection writer_;
+    std::mutex reader_mutex_;
+    std::condition_variable reader_cv_;
+    std::vector<std::unique_ptr<SQLiteConnection>> readers_;
+    std::vector<SQLiteConnection*> idle_readers_;
+};
+
+uint64_t InsertMatch(SQLiteConnection& db, const std::string& game_name, const std::optional<GroupID> gid, const UserID host_uid,
         const uint64_t user_count, const uint64_t multiple)
 {
-    db << "INSERT INTO match (game_name, finish_time, group_id, host_user_id, user_count, multiple) VALUES (?,datetime(CURRENT_TIMESTAMP, \'localtime\'),?,?,?,?);"
+    (db << "INSERT INTO match (game_name, finish_time, group_id, host_user_id, user_count, multiple) VALUES (?,datetime(CURRENT_TIMESTAMP, \'localtime\'),?,?,?,?);"
        << game_name
        << gid
        << host_uid.GetStr()
        << user_count
-       << multiple;
+       << multiple).execute();
     return db.last_insert_rowid();
 }
 
-void InsertUserIfNotExist(sqlite::database& db, const UserID& uid)
+void InsertUserIfNotExist(SQLiteConnection& db, const UserID& uid)
 {
-    db << "INSERT INTO user (user_id, birth_time) SELECT ?, datetime(CURRENT_TIMESTAMP, \'localtime\') WHERE NOT EXISTS (SELECT user_id FROM user WHERE user_id = ?);"
-       << uid.GetStr() << uid.GetStr();
+    (db << "INSERT INTO user (user_id, birth_time) SELECT ?, datetime(CURRENT_TIMESTAMP, \'localtime\') WHERE NOT EXISTS (SELECT user_id FROM user WHERE user_id = ?);"
+       << uid.GetStr() << uid.GetStr()).execute();
 }
 
-void InsertUserWithMatch(sqlite::database& db, const uint64_t match_id, const UserID& uid, const uint32_t birth_count,
+void InsertUserWithMatch(SQLiteConnection& db, const uint64_t match_id, const UserID& uid, const uint32_t birth_count,
         const int64_t game_score, const int64_t zero_sum_score, const int64_t top_score, const double level_score, const int64_t rank_score)
 {
-    db << "INSERT INTO user_with_match (match_id, user_id, birth_count, game_score, zero_sum_score, top_score, level_score, rank_score) VALUES (?,?,?,?,?,?,?,?);"
+    (db << "INSERT INTO user_with_match (match_id, user_id, birth_count, game_score, zero_sum_score, top_score, level_score, rank_score) VALUES (?,?,?,?,?,?,?,?);"
        << match_id
        << uid.GetStr()
        << birth_count
@@ -76,46 +197,149 @@ void InsertUserWithMatch(sqlite::database& db, const uint64_t match_id, const Us
        << zero_sum_score
        << top_score
        << level_score
-       << rank_score;
+       << rank_score).execute();
 }
 
-void InsertUserWithAchievement(sqlite::database& db, const uint64_t match_id, const UserID& uid, const uint32_t birth_count,
+void InsertUserWithAchievement(SQLiteConnection& db, const uint64_t match_id, const UserID& uid, const uint32_t birth_count,
         const std::string& achievement_name)
 {
-    db << "INSERT INTO user_with_achievement (user_id, birth_count, match_id, achievement_name) VALUES (?,?,?,?);"
+    (db << "INSERT INTO user_with_achievement (user_id, birth_count, match_id, achievement_name) VALUES (?,?,?,?);"
        << uid.GetStr()
        << birth_count
        << match_id
-       << achievement_name;
+       << achievement_name).execute();
 }
 
-void UpdateBirthOfUser(sqlite::database& db, const UserID& uid)
+void UpdateBirthOfUser(SQLiteConnection& db, const UserID& uid)
 {
-    db << "UPDATE user SET birth_time = datetime(CURRENT_TIMESTAMP, \'localtime\'), birth_count = birth_count + 1 "
+    (db << "UPDATE user SET birth_time = datetime(CURRENT_TIMESTAMP, \'localtime\'), birth_count = birth_count + 1 "
             "WHERE user_id = ?;"
-        << uid.GetStr();
+        << uid.GetStr()).execute();
+}
+
+std::string GetFinishTimeOfMatch(SQLiteConnection& db, const uint64_t match_id)
+{
+    std::string finish_time;
+    db << "SELECT finish_time FROM match WHERE match_id = ?;" << match_id >> finish_time;
+    return finish_time;
+}
+
+// The scores in user_with_match are also summed up in user_score_summary, so that the ranks can be read from the summary
+// instead of aggregating all the matches. The scores are summed by time buckets: "YYYY-MM" for a month, "YYYY" for a
+// year and "" for all the time, and by games: the game name for a game and "" for all the games.
+void UpdateScoreSummary(SQLiteConnection& db, const std::string& finish_time, const std::string& game_name,
+        const UserID& uid, const uint32_t birth_count, const ScoreInfo& score_info)
+{
+    for (const auto& bucket : {finish_time.substr(0, 7), finish_time.substr(0, 4), std::string()}) {
+        for (const auto& summary_game_name : {game_name, std::string()}) {
+            (db << "INSERT INTO user_score_summary (bucket, game_name, user_id, birth_count, match_count, zero_sum_score, top_score, level_score) VALUES (?,?,?,?,1,?,?,?) "
+                    "ON CONFLICT (bucket, game_name, user_id, birth_count) DO UPDATE SET "
+                        "match_count = match_count + 1, "
+                        "zero_sum_score = zero_sum_score + excluded.zero_sum_score, "
+                        "top_score = top_score + excluded.top_score, "
+                        "level_score = level_score + excluded.level_score;"
+                << bucket
+                << summary_game_name
+                << uid.GetStr()
+                << birth_count
+                << score_info.zero_sum_score_
+                << score_info.top_score_
+                << score_info.level_score_).execute();
+        }
+    }
 }
 
-static std::string ComparationCondition(const std::string_view& column_name, const std::string_view& op,
-        const std::string_view& value)
+void RebuildScoreSummary(sqlite::database& db)
 {
-    if (value.empty()) {
-        return "TRUE";
+    db << "DROP TABLE IF EXISTS user_score_summary;";
+    db << "CREATE TABLE user_score_summary("
+            "bucket VARCHAR(10) NOT NULL, "
+            "game_name VARCHAR(100) NOT NULL, "
+            "user_id VARCHAR(100) NOT NULL, "
+            "birth_count INT UNSIGNED NOT NULL, "
+            "match_count BIGINT UNSIGNED NOT NULL, "
+            "zero_sum_score BIGINT NOT NULL, "
+            "top_score BIGINT NOT NULL, "
+            "level_score DOUBLE NOT NULL, "
+            "PRIMARY KEY (bucket, game_name, user_id, birth_count));";
+    // to read the top users of a bucket without sorting
+    for (const char* const score_name : {"match_count", "zero_sum_score", "top_score", "level_score"}) {
+        db << std::string("CREATE INDEX ") + score_name + "_summary_index ON user_score_summary(bucket, game_name, " +
+            score_name + ");";
+    }
+    for (const char* const bucket : {"substr(match.finish_time, 1, 7)", "substr(match.finish_time, 1, 4)", "''"}) {
+        for (const char* const game_name : {"match.game_name", "''"}) {
+            db << std::string("INSERT INTO user_score_summary (bucket, game_name, user_id, birth_count, match_count, zero_sum_score, top_score, level_score) ") +
+                    "SELECT " + bucket + ", " + game_name + ", user_with_match.user_id, user_with_match.birth_count, "
+                        "COUNT(*), SUM(user_with_match.zero_sum_score), SUM(user_with_match.top_score), SUM(user_with_match.level_score) "
+                    "FROM user_with_match, match "
+                    "WHERE user_with_match.match_id = match.match_id AND match.finish_time IS NOT NULL "
+                    "GROUP BY 1, 2, 3, 4;";
+        }
     }
-    return std::string() + column_name.data() + " " + op.data() + " " + value.data();
 }
 
-static std::string TimeRangeLeftCondition(const std::string_view& column_name, const std::string_view& time_range_begin)
+// Returns the bucket in user_score_summary which covers exactly the time range, or std::nullopt if there is no such
+// bucket.
+static std::optional<std::string> ScoreSummaryBucket(const std::string_view& time_range_begin,
+        const std::string_view& time_range_end)
 {
-    return ComparationCondition(column_name, ">=", time_range_begin);
+    if (time_range_begin.empty() && time_range_end.empty()) {
+        return std::string();
+    }
+    int year = 0;
+    unsigned month = 0;
+    if (sscanf(std::string(time_range_begin).c_str(), "%d-%u", &year, &month) != 2) {
+        return std::nullopt;
+    }
+    const auto begin_month = std::chrono::year(year) / std::chrono::month(month);
+    if (!begin_month.ok() || DatetimeOfDay(begin_month / 1) != time_range_begin) {
+        return std::nullopt;
+    }
+    if (DatetimeOfDay((begin_month + std::chrono::months(1)) / 1) == time_range_end) {
+        return std::string(time_range_begin.substr(0, 7));
+    }
+    if (month == 1 && DatetimeOfDay((begin_month + std::chrono::years(1)) / 1) == time_range_end) {
+        return std::string(time_range_begin.substr(0, 4));
+    }
+    return std::nullopt;
+}
+
+// The history level scores are summed up before the end of the time range, which are the same as the all-time bucket if
+// no match finishes after that.
+static bool AllMatchesFinishedBefore(SQLiteConnection& db, const std::string_view& time_range_end)
+{
+    if (time_range_end.empty()) {
+        return true;
+    }
+    std::optional<std::string> last_finish_time;
+    db << "SELECT MAX(finish_time) FROM match;" >> last_finish_time;
+    return !last_finish_time.has_value() || *last_finish_time < time_range_end;
 }
 
-static std::string TimeRangeRightCondition(const std::string_view& column_name, const std::string_view& time_range_end)
+// The datetime is bound to the placeholder as a parameter. If it is NULL, the comparation results in NULL and the
+// condition is always true.
+static std::string ComparationCondition(const std::string_view& column_name, const std::string_view& op)
 {
-    return ComparationCondition(column_name, "<", time_range_end);
+    return std::string("COALESCE(") + column_name.data() + " " + op.data() + " ?, TRUE)";
 }
 
-auto GetTotalScoreOfUser(sqlite::database& db, const UserID& uid, const std::string_view& time_range_begin,
+static std::string TimeRangeLeftCondition(const std::string_view& column_name)
+{
+    return ComparationCondition(column_name, ">=");
+}
+
+static std::string TimeRangeRightCondition(const std::string_view& column_name)
+{
+    return ComparationCondition(column_name, "<");
+}
+
+static std::optional<std::string> TimeRangeParam(const std::string_view& datetime)
+{
+    return datetime.empty() ? std::nullopt : std::optional<std::string>(datetime);
+}
+
+auto GetTotalScoreOfUser(SQLiteConnection& db, const UserID& uid, const std::string_view& time_range_begin,
         const std::string_view& time_range_end)
 {
     struct
@@ -130,14 +354,14 @@ auto GetTotalScoreOfUser(sqlite::database& db, const UserID& uid, const std::str
                 "user_with_match.user_id = user.user_id AND "
                 "user_with_match.birth_count = user.birth_count AND "
                 "user_with_match.match_id = match.match_id AND "
-                + TimeRangeLeftCondition("match.finish_time", time_range_begin) + " AND "
-                + TimeRangeRightCondition("match.finish_time", time_range_end) + " "
-        << uid.GetStr()
+                + TimeRangeLeftCondition("match.finish_time") + " AND "
+                + TimeRangeRightCondition("match.finish_time") + " "
+        << uid.GetStr() << TimeRangeParam(time_range_begin) << TimeRangeParam(time_range_end)
         >> std::tie(result.match_count_, result.total_zero_sum_score_, result.total_top_score_, result.birth_time_);
     return result;
 }
 
-uint32_t GetMatchCountOfUser(sqlite::database& db, const UserID& uid)
+uint32_t GetMatchCountOfUser(SQLiteConnection& db, const UserID& uid)
 {
     uint32_t count = 0;
     db << "SELECT COUNT(*) FROM user_with_match "
@@ -147,7 +371,7 @@ uint32_t GetMatchCountOfUser(sqlite::database& db, const UserID& uid)
     return count;
 }
 
-uint32_t GetBirthCountOfUser(sqlite::database& db, const UserID& uid)
+uint32_t GetBirthCountOfUser(SQLiteConnection& db, const UserID& uid)
 {
     InsertUserIfNotExist(db, uid);
     uint32_t birth_count = -1;
@@ -155,7 +379,7 @@ uint32_t GetBirthCountOfUser(sqlite::database& db, const UserID& uid)
     return birth_count;
 }
 
-auto GetGameHistoryOfUser(sqlite::database& db, const UserID& uid, const std::string& game_name)
+auto GetGameHistoryOfUser(SQLiteConnection& db, const UserID& uid, const std::string& game_name)
 {
     struct
     {
@@ -175,7 +399,7 @@ auto GetGameHistoryOfUser(sqlite::database& db, const UserID& uid, const std::st
 }
 
 template <typename Fn>
-void ForeachTotalLevelScoreOfUser(sqlite::database& db, const UserID& uid, const std::string_view& time_range_begin,
+void ForeachTotalLevelScoreOfUser(SQLiteConnection& db, const UserID& uid, const std::string_view& time_range_begin,
         const std::string_view& time_range_end, const Fn& fn)
 {
     db << "WITH game_match AS ( "
@@ -191,23 +415,23 @@ void ForeachTotalLevelScoreOfUser(sqlite::database& db, const UserID& uid, const
             "( "
                 "SELECT game_name, SUM(level_score) AS history_total_level_score "
                 "FROM game_match "
-                "WHERE " + TimeRangeRightCondition("finish_time", time_range_end) + " "
+                "WHERE " + TimeRangeRightCondition("finish_time") + " "
                 "GROUP BY game_name "
             ") AS game_history_total_level_score, "
             "( "
                 "SELECT game_name, COUNT(*) AS time_range_match_count "
                 "FROM game_match "
-                "WHERE " + TimeRangeLeftCondition("finish_time", time_range_begin) + " AND "
-                + TimeRangeRightCondition("finish_time", time_range_end) + " "
+                "WHERE " + TimeRangeLeftCondition("finish_time") + " AND "
+                + TimeRangeRightCondition("finish_time") + " "
                 "GROUP BY game_name "
             ") AS game_time_range_match_count "
         "WHERE game_history_total_level_score.game_name = game_time_range_match_count.game_name; "
-        << uid.GetStr()
+        << uid.GetStr() << TimeRangeParam(time_range_end) << TimeRangeParam(time_range_begin) << TimeRangeParam(time_range_end)
         >> fn;
 }
 
 template <typename Fn>
-void ForeachRecentMatchOfUser(sqlite::database& db, const UserID& uid, const uint32_t limit, const Fn& fn)
+void ForeachRecentMatchOfUser(SQLiteConnection& db, const UserID& uid, const uint32_t limit, const Fn& fn)
 {
     db << "SELECT match.game_name, match.finish_time, match.user_count, match.multiple, user_with_match.game_score, "
                 "user_with_match.zero_sum_score, user_with_match.top_score, user_with_match.level_score, user_with_match.rank_score "
@@ -222,7 +446,7 @@ void ForeachRecentMatchOfUser(sqlite::database& db, const UserID& uid, const uin
 }
 
 template <typename Fn>
-void ForeachUserInRank(sqlite::database& db, const std::string& score_name, const std::string_view& time_range_begin,
+void ForeachUserInRank(SQLiteConnection& db, const std::string& score_name, const std::string_view& time_range_begin,
         const std::string_view& time_range_end, const Fn& fn)
 {
     db << "SELECT user.user_id, SUM(" + score_name + ") AS sum_score "
@@ -230,14 +454,15 @@ void ForeachUserInRank(sqlite::database& db, const std::string& score_name, cons
             "WHERE user_with_match.user_id = user.user_id AND "
                 "user_with_match.birth_count = user.birth_count AND "
                 "match.match_id = user_with_match.match_id AND "
-                + TimeRangeLeftCondition("match.finish_time", time_range_begin) + " AND "
-                + TimeRangeRightCondition("match.finish_time", time_range_end) + " "
+                + TimeRangeLeftCondition("match.finish_time") + " AND "
+                + TimeRangeRightCondition("match.finish_time") + " "
             "GROUP BY user.user_id ORDER BY sum_score DESC LIMIT 10;"
+       << TimeRangeParam(time_range_begin) << TimeRangeParam(time_range_end)
        >> fn;
 }
 
 template <typename Fn>
-void ForeachUserInGameLevelScoreRank(sqlite::database& db, const std::string_view& game_name, const std::string_view& time_range_begin,
+void ForeachUserInGameLevelScoreRank(SQLiteConnection& db, const std::string_view& game_name, const std::string_view& time_range_begin,
         const std::string_view& time_range_end, const Fn& fn)
 {
     db << "SELECT user.user_id AS user_id, "
@@ -247,14 +472,14 @@ void ForeachUserInGameLevelScoreRank(sqlite::database& db, const std::string_vie
                 "user_with_match.match_id = match.match_id AND "
                 "user_with_match.birth_count = user.birth_count AND "
                 "match.game_name = ? AND "
-                + TimeRangeRightCondition("match.finish_time", time_range_end) + " "
+                + TimeRangeRightCondition("match.finish_time") + " "
             "GROUP BY user.user_id ORDER BY total_level_score DESC LIMIT 10"
-    << game_name.data()
+    << game_name.data() << TimeRangeParam(time_range_end)
     >> fn;
 }
 
 template <typename Fn>
-void ForeachUserInGameWeightLevelScoreRank(sqlite::database& db, const std::string_view& game_name,
+void ForeachUserInGameWeightLevelScoreRank(SQLiteConnection& db, const std::string_view& game_name,
         const std::string_view& time_range_begin, const std::string_view& time_range_end, const Fn& fn)
 {
     db << "WITH game_user_match AS ( "
@@ -273,24 +498,24 @@ void ForeachUserInGameWeightLevelScoreRank(sqlite::database& db, const std::stri
                 "( "
                     "SELECT game_user_match.user_id, SUM(game_user_match.level_score) AS history_total_level_score "
                     "FROM game_user_match "
-                    "WHERE " + TimeRangeRightCondition("game_user_match.finish_time", time_range_end) + " "
+                    "WHERE " + TimeRangeRightCondition("game_user_match.finish_time") + " "
                     "GROUP BY game_user_match.user_id "
                 ") AS user_history_total_level_score, "
                 "( "
                     "SELECT game_user_match.user_id, COUNT(*) AS time_range_match_count "
                     "FROM game_user_match "
-                    "WHERE " + TimeRangeLeftCondition("game_user_match.finish_time", time_range_begin) + " AND "
-                        + TimeRangeRightCondition("game_user_match.finish_time", time_range_end) + " "
+                    "WHERE " + TimeRangeLeftCondition("game_user_match.finish_time") + " AND "
+                        + TimeRangeRightCondition("game_user_match.finish_time") + " "
                     "GROUP BY game_user_match.user_id "
                 ") AS user_time_range_match_count "
             "WHERE user_history_total_level_score.user_id = user_time_range_match_count.user_id "
             "ORDER BY weight_level_score DESC LIMIT 10"
-       << game_name.data()
+       << game_name.data() << TimeRangeParam(time_range_end) << TimeRangeParam(time_range_begin) << TimeRangeParam(time_range_end)
        >> fn;
 }
 
 template <typename Fn>
-void ForeachUserInGameMatchCountRank(sqlite::database& db, const std::string_view& game_name, const std::string_view& time_range_begin,
+void ForeachUserInGameMatchCountRank(SQLiteConnection& db, const std::string_view& game_name, const std::string_view& time_range_begin,
         const std::string_view& time_range_end, const Fn& fn)
 {
     db << "SELECT user.user_id AS user_id, "
@@ -300,32 +525,67 @@ void ForeachUserInGameMatchCountRank(sqlite::database& db, const std::string_vie
                 "user_with_match.match_id = match.match_id AND "
                 "user_with_match.birth_count = user.birth_count AND "
                 "match.game_name = ? AND "
-                + TimeRangeLeftCondition("match.finish_time", time_range_begin) + " AND "
-                + TimeRangeRightCondition("match.finish_time", time_range_end) + " "
+                + TimeRangeLeftCondition("match.finish_time") + " AND "
+                + TimeRangeRightCondition("match.finish_time") + " "
             "GROUP BY user.user_id ORDER BY match_count DESC LIMIT 10"
-    << game_name.data()
+    << game_name.data() << TimeRangeParam(time_range_begin) << TimeRangeParam(time_range_end)
     >> fn;
 }
 
-void AddHonor(sqlite::database& db, const std::string_view& description, const UserID& uid, const uint32_t birth_count)
+template <typename Fn>
+void ForeachUserInScoreSummaryRank(SQLiteConnection& db, const std::string& score_name, const std::string& bucket,
+        const std::string_view& game_name, const Fn& fn)
+{
+    db << "SELECT user.user_id, user_score_summary." + score_name + " "
+            "FROM user_score_summary, user "
+            "WHERE user_score_summary.bucket = ? AND "
+                "user_score_summary.game_name = ? AND "
+                "user_score_summary.user_id = user.user_id AND "
+                "user_score_summary.birth_count = user.birth_count "
+            "ORDER BY user_score_summary." + score_name + " DESC LIMIT 10;"
+       << bucket << game_name.data()
+       >> fn;
+}
+
+template <typename Fn>
+void ForeachUserInScoreSummaryWeightLevelScoreRank(SQLiteConnection& db, const std::string& bucket,
+        const std::string_view& game_name, const Fn& fn)
+{
+    db << "SELECT user.user_id AS user_id, "
+                "history.level_score * ABS(history.level_score) * time_range.match_count AS weight_level_score "
+            "FROM user_score_summary AS time_range, user_score_summary AS history, user "
+            "WHERE time_range.bucket = ? AND "
+                "time_range.game_name = ? AND "
+                "time_range.user_id = user.user_id AND "
+                "time_range.birth_count = user.birth_count AND "
+                "history.bucket = '' AND "
+                "history.game_name = time_range.game_name AND "
+                "history.user_id = time_range.user_id AND "
+                "history.birth_count = time_range.birth_count "
+            "ORDER BY weight_level_score DESC LIMIT 10;"
+       << bucket << game_name.data()
+       >> fn;
+}
+
+void AddHonor(SQLiteConnection& db, const std::string_view& description, const UserID& uid, const uint32_t birth_count)
 {
-    db << "INSERT INTO honor (description, user_id, birth_count, time) VALUES (?, ?, ?, datetime(CURRENT_TIMESTAMP, \'localtime\'))"
-       << description.data() << uid.GetStr() << birth_count;
+    (db << "INSERT INTO honor (description, user_id, birth_count, time) VALUES (?, ?, ?, datetime(CURRENT_TIMESTAMP, \'localtime\'))"
+       << description.data() << uid.GetStr() << birth_count).execute();
 }
 
-void DeleteHonor(sqlite::database& db, const int32_t id)
+void DeleteHonor(SQLiteConnection& db, const int32_t id)
 {
-    db << "DELETE FROM honor WHERE id = ?" << id;
+    (db << "DELETE FROM honor WHERE id = ?" << id).execute();
 }
 
 template <typename Fn>
-void ForeachHonor(sqlite::database& db, const Fn& fn)
+void ForeachHonor(SQLiteConnection& db, const Fn& fn)
 {
     db << "SELECT id, description, user_id, time FROM honor" >> fn;
 }
 
 template <typename Fn>
-void ForeachRecentHonorOfUser(sqlite::database& db, const UserID& uid, const uint32_t limit, const Fn& fn)
+void ForeachRecentHonorOfUser(SQLiteConnection& db, const UserID& uid, const uint32_t limit, const Fn& fn)
 {
     db << "SELECT honor.id, honor.description, honor.user_id, honor.time FROM honor, user "
           "WHERE honor.user_id = ? AND honor.user_id = user.user_id AND honor.birth_count = user.birth_count "
@@ -335,7 +595,7 @@ void ForeachRecentHonorOfUser(sqlite::database& db, const UserID& uid, const uin
 }
 
 template <typename Fn>
-void ForeachRecentAchievementOfUser(sqlite::database& db, const UserID& uid, const uint32_t limit, const Fn& fn)
+void ForeachRecentAchievementOfUser(SQLiteConnection& db, const UserID& uid, const uint32_t limit, const Fn& fn)
 {
     db << "SELECT user_with_achievement.achievement_name, match.game_name, match.finish_time "
           "FROM user_with_achievement, user, match "
@@ -348,7 +608,7 @@ void ForeachRecentAchievementOfUser(sqlite::database& db, const UserID& uid, con
        >> fn;
 }
 
-auto GetAchievementStatistic(sqlite::database& db, const UserID& uid, const std::string& game_name,
+auto GetAchievementStatistic(SQLiteConnection& db, const UserID& uid, const std::string& game_name,
         const std::string& achievement_name)
 {
     struct
@@ -367,7 +627,7 @@ auto GetAchievementStatistic(sqlite::database& db, const UserID& uid, const std:
     return result;
 }
 
-int64_t GetAchievedUserNumber(sqlite::database& db, const std::string& game_name, const std::string& achievement_name)
+int64_t GetAchievedUserNumber(SQLiteConnection& db, const std::string& game_name, const std::string& achievement_name)
 {
     int64_t count = 0;
     db << "SELECT count(*) FROM "
@@ -383,29 +643,41 @@ int64_t GetAchievedUserNumber(sqlite::database& db, const std::string& game_name
     return count;
 }
 
-SQLiteDBManager::SQLiteDBManager(const DBName& db_name) : db_name_(db_name)
+SQLiteDBManager::SQLiteDBManager(const DBName& db_name)
+    : pool_(std::make_unique<SQLiteConnectionPool>(db_name, SQLiteConnectionPool::k_default_reader_num))
 {
 }
 
 SQLiteDBManager::~SQLiteDBManager() {}
 
-void RecordMatch(sqlite::database& db, const std::string& game_name, const std::optional<GroupID> gid,
+uint64_t RecordMatch(SQLiteConnection& db, const std::string& game_name, const std::optional<GroupID> gid,
         const UserID host_uid, const uint64_t multiple, const std::vector<ScoreInfo>& score_infos,
         const std::vector<std::pair<UserID, std::string>>& achievements)
 {
     const auto match_id = InsertMatch(db, game_name, gid, host_uid, score_infos.size(), multiple);
+    const auto finish_time = GetFinishTimeOfMatch(db, match_id);
     for (const ScoreInfo& score_info : score_infos) {
         const auto birth_count = GetBirthCountOfUser(db, score_info.uid_);
         InsertUserWithMatch(db, match_id, score_info.uid_, birth_count, score_info.game_score_,
                 score_info.zero_sum_score_, score_info.top_score_, score_info.level_score_, score_info.rank_score_);
+        UpdateScoreSummary(db, finish_time, game_name, score_info.uid_, birth_count, score_info);
     }
     for (const auto& [user_id, achievement_name] : achievements) {
         const auto birth_count = GetBirthCountOfUser(db, user_id);
         InsertUserWithAchievement(db, match_id, user_id, birth_count, achievement_name);
     }
+    return match_id;
 }
 
-std::vector<UserInfoForCalScore> GetUserInfoForCalScore(sqlite::database& db, const std::string& game_name,
+void RecordMatch(sqlite::database& db, const std::string& game_name, const std::optional<GroupID> gid,
+        const UserID host_uid, const uint64_t multiple, const std::vector<ScoreInfo>& score_infos,
+        const std::vector<std::pair<UserID, std::string>>& achievements)
+{
+    SQLiteConnection conn(db);
+    RecordMatch(conn, game_name, gid, host_uid, multiple, score_infos, achievements);
+}
+
+std::vector<UserInfoForCalScore> GetUserInfoForCalScore(SQLiteConnection& db, const std::string& game_name,
         const std::vector<std::pair<UserID, int64_t>>& game_score_infos)
 {
     std::vector<UserInfoForCalScore> user_infos;
@@ -416,25 +688,111 @@ std::vector<UserInfoForCalScore> GetUserInfoForCalScore(sqlite::database& db, co
     return user_infos;
 }
 
+static std::vector<ScoreInfo> CalScoresAndRecordMatch(SQLiteConnection& db, const std::string& game_name,
+        const std::optional<GroupID> gid, const UserID& host_uid, const uint64_t multiple,
+        const std::vector<std::pair<UserID, int64_t>>& game_score_infos,
+        const std::vector<std::pair<UserID, std::string>>& achievements, const std::string& record_id = "")
+{
+    auto user_infos = GetUserInfoForCalScore(db, game_name, game_score_infos);
+    auto score_infos = CalScores(user_infos, multiple);
+    const auto match_id = ::RecordMatch(db, game_name, gid, host_uid, multiple, score_infos, achievements);
+    if (!record_id.empty()) {
+        (db << "INSERT INTO recorded_match (record_id, match_id) VALUES (?,?);" << record_id << match_id).execute();
+    }
+    return score_infos;
+}
+
+std::optional<uint64_t> GetMatchIdOfRecord(SQLiteConnection& db, const std::string& record_id)
+{
+    std::optional<uint64_t> match_id;
+    db << "SELECT match_id FROM recorded_match WHERE record_id = ?;" << record_id
+       >> [&](const uint64_t id) { match_id = id; };
+    return match_id;
+}
+
+// The score infos are in the same order as |game_score_infos|.
+std::vector<ScoreInfo> GetScoreInfosOfMatch(SQLiteConnection& db, const uint64_t match_id,
+        const std::vector<std::pair<UserID, int64_t>>& game_score_infos)
+{
+    std::map<std::string, ScoreInfo> score_info_map;
+    db << "SELECT user_id, game_score, zero_sum_score, top_score, level_score, rank_score FROM user_with_match "
+          "WHERE match_id = ?;"
+       << match_id
+       >> [&](std::string uid, const int64_t game_score, const int64_t zero_sum_score, const int64_t top_score,
+               const double level_score, const int64_t rank_score)
+          {
+              score_info_map.emplace(uid, ScoreInfo{.uid_ = uid, .game_score_ = game_score,
+                      .zero_sum_score_ = zero_sum_score, .top_score_ = top_score, .level_score_ = level_score,
+                      .rank_score_ = rank_score});
+          };
+    std::vector<ScoreInfo> score_infos;
+    for (const auto& [uid, _] : game_score_infos) {
+        if (const auto it = score_info_map.find(uid.GetStr()); it != score_info_map.end()) {
+            score_infos.emplace_back(it->second);
+        }
+    }
+    return score_infos;
+}
+
+// The records with the same non-empty id are written only once, so a record replayed after a crash is not duplicated.
+static std::vector<ScoreInfo> RecordMatchOnce(SQLiteConnection& db, const MatchRecord& record)
+{
+    if (const auto match_id = record.record_id_.empty() ? std::nullopt : GetMatchIdOfRecord(db, record.record_id_);
+            match_id.has_value()) {
+        InfoLog() << "Skip the match which has been recorded record_id=" << record.record_id_;
+        return GetScoreInfosOfMatch(db, *match_id, record.game_score_infos_);
+    }
+    return CalScoresAndRecordMatch(db, record.game_name_, record.gid_, record.host_uid_, record.multiple_,
+            record.game_score_infos_, record.achievements_, record.record_id_);
+}
+
 std::vector<ScoreInfo> SQLiteDBManager::RecordMatch(const std::string& game_name, const std::optional<GroupID> gid,
         const UserID& host_uid, const uint64_t multiple, const std::vector<std::pair<UserID, int64_t>>& game_score_infos,
         const std::vector<std::pair<UserID, std::string>>& achievements)
 {
+    METRICS_LATENCY_SCOPE("db.record_match");
     std::vector<ScoreInfo> score_infos; // TODO: get from game_score_infos
-    return ExecuteTransaction(db_name_, [&](sqlite::database& db)
+    return pool_->ExecuteTransaction(false, [&](SQLiteConnection& db)
         {
-            auto user_infos = GetUserInfoForCalScore(db, game_name, game_score_infos);
-            score_infos = CalScores(user_infos, multiple);
-            ::RecordMatch(db, game_name, gid, host_uid, multiple, score_infos, achievements);
+            score_infos = CalScoresAndRecordMatch(db, game_name, gid, host_uid, multiple, game_score_infos, achievements);
             return true;
         }) ? score_infos : std::vector<ScoreInfo>();
 }
 
+std::vector<std::vector<ScoreInfo>> SQLiteDBManager::RecordMatches(const std::vector<MatchRecord>& records)
+{
+    METRICS_LATENCY_SCOPE("db.record_matches");
+    std::vector<std::vector<ScoreInfo>> score_infos;
+    if (pool_->ExecuteTransaction(false, [&](SQLiteConnection& db)
+            {
+                for (const auto& record : records) {
+                    score_infos.emplace_back(RecordMatchOnce(db, record));
+                }
+                return true;
+            })) {
+        return score_infos;
+    }
+    // one bad record fails the whole transaction, so record them one by one to save the others
+    ErrorLog() << "Record matches in one transaction failed, record them one by one, size=" << records.size();
+    score_infos.clear();
+    for (const auto& record : records) {
+        std::vector<ScoreInfo> record_score_infos;
+        pool_->ExecuteTransaction(false, [&](SQLiteConnection& db)
+            {
+                record_score_infos = RecordMatchOnce(db, record);
+                return true;
+            });
+        score_infos.emplace_back(std::move(record_score_infos));
+    }
+    return score_infos;
+}
+
 UserProfile SQLiteDBManager::GetUserProfile(const UserID& uid, const std::string_view& time_range_begin,
         const std::string_view& time_range_end)
 {
+    METRICS_LATENCY_SCOPE("db.get_user_profile");
     UserProfile profile;
-    ExecuteTransaction(db_name_, [&](sqlite::database& db)
+    pool_->ExecuteTransaction(true, [&](SQLiteConnection& db)
         {
             // get user total_score
             {
@@ -487,7 +845,8 @@ UserProfile SQLiteDBManager::GetUserProfile(const UserID& uid, const std::string
 
 bool SQLiteDBManager::Suicide(const UserID& uid, const uint32_t required_match_num)
 {
-    return ExecuteTransaction(db_name_, [&](sqlite::database& db)
+    METRICS_LATENCY_SCOPE("db.suicide");
+    return pool_->ExecuteTransaction(false, [&](SQLiteConnection& db)
         {
             uint32_t posi_score_count = 0;
             ForeachRecentMatchOfUser(db, uid, required_match_num,
@@ -507,20 +866,31 @@ bool SQLiteDBManager::Suicide(const UserID& uid, const uint32_t required_match_n
 
 RankInfo SQLiteDBManager::GetRank(const std::string_view& time_range_begin, const std::string_view& time_range_end)
 {
+    METRICS_LATENCY_SCOPE("db.get_rank");
     RankInfo info;
-    ExecuteTransaction(db_name_, [&](sqlite::database& db)
+    const auto bucket = ScoreSummaryBucket(time_range_begin, time_range_end);
+    pool_->ExecuteTransaction(true, [&](SQLiteConnection& db)
         {
-            ForeachUserInRank(db, "user_with_match.zero_sum_score", time_range_begin, time_range_end,
+            const auto foreach_user_in_rank = [&](const std::string& score_name, auto&& fn)
+                {
+                    if (bucket.has_value()) {
+                        ForeachUserInScoreSummaryRank(db, score_name, *bucket, "", fn);
+                    } else {
+                        ForeachUserInRank(db, score_name == "match_count" ? "1" : "user_with_match." + score_name,
+                                time_range_begin, time_range_end, fn);
+                    }
+                };
+            foreach_user_in_rank("zero_sum_score",
                     [&](std::string uid, const int64_t score_sum)
                     {
                         info.zero_sum_score_rank_.emplace_back(std::move(uid), score_sum);
                     });
-            ForeachUserInRank(db, "user_with_match.top_score", time_range_begin, time_range_end,
+            foreach_user_in_rank("top_score",
                     [&](std::string uid, const int64_t score_sum)
                     {
                         info.top_score_rank_.emplace_back(std::move(uid), score_sum);
                     });
-            ForeachUserInRank(db, "1", time_range_begin, time_range_end,
+            foreach_user_in_rank("match_count",
                     [&](std::string uid, const int64_t score_sum)
                     {
                         info.match_count_rank_.emplace_back(std::move(uid), score_sum);
@@ -533,26 +903,35 @@ RankInfo SQLiteDBManager::GetRank(const std::string_view& time_range_begin, cons
 GameRankInfo SQLiteDBManager::GetLevelScoreRank(const std::string& game_name, const std::string_view& time_range_begin,
         const std::string_view& time_range_end)
 {
+    METRICS_LATENCY_SCOPE("db.get_level_score_rank");
     GameRankInfo info;
-    ExecuteTransaction(db_name_, [&](sqlite::database& db)
+    const auto bucket = ScoreSummaryBucket(time_range_begin, time_range_end);
+    pool_->ExecuteTransaction(true, [&](SQLiteConnection& db)
         {
-            ForeachUserInGameLevelScoreRank(db, game_name, time_range_begin, time_range_end,
-                    [&](std::string uid, const double total_level_score)
-                    {
-                        info.level_score_rank_.emplace_back(std::move(uid), total_level_score);
-                    });
-            ForeachUserInGameWeightLevelScoreRank(db, game_name, time_range_begin, time_range_end,
-                    [&](std::string uid, double weight_level_score)
-                    {
-                        weight_level_score =
-                            (1 - 2 * std::signbit(weight_level_score)) * std::sqrt(std::abs(weight_level_score));
-                        info.weight_level_score_rank_.emplace_back(std::move(uid), weight_level_score);
-                    });
-            ForeachUserInGameMatchCountRank(db, game_name, time_range_begin, time_range_end,
-                    [&](std::string uid, const int64_t match_count)
-                    {
-                        info.match_count_rank_.emplace_back(std::move(uid), match_count);
-                    });
+            const auto on_level_score = [&](std::string uid, const double total_level_score)
+                {
+                    info.level_score_rank_.emplace_back(std::move(uid), total_level_score);
+                };
+            const auto on_weight_level_score = [&](std::string uid, double weight_level_score)
+                {
+                    weight_level_score =
+                        (1 - 2 * std::signbit(weight_level_score)) * std::sqrt(std::abs(weight_level_score));
+                    info.weight_level_score_rank_.emplace_back(std::move(uid), weight_level_score);
+                };
+            const auto on_match_count = [&](std::string uid, const int64_t match_count)
+                {
+                    info.match_count_rank_.emplace_back(std::move(uid), match_count);
+                };
+            if (bucket.has_value() && AllMatchesFinishedBefore(db, time_range_end)) {
+                ForeachUserInScoreSummaryRank(db, "level_score", "", game_name, on_level_score);
+                ForeachUserInScoreSummaryWeightLevelScoreRank(db, *bucket, game_name, on_weight_level_score);
+                ForeachUserInScoreSummaryRank(db, "match_count", *bucket, game_name, on_match_count);
+            } else {
+                ForeachUserInGameLevelScoreRank(db, game_name, time_range_begin, time_range_end, on_level_score);
+                ForeachUserInGameWeightLevelScoreRank(db, game_name, time_range_begin, time_range_end,
+                        on_weight_level_score);
+                ForeachUserInGameMatchCountRank(db, game_name, time_range_begin, time_range_end, on_match_count);
+            }
             return true;
         });
     return info;
@@ -561,8 +940,9 @@ GameRankInfo SQLiteDBManager::GetLevelScoreRank(const std::string& game_name, co
 AchievementStatisticInfo SQLiteDBManager::GetAchievementStatistic(const UserID& uid, const std::string& game_name,
             const std::string& achievement_name)
 {
+    METRICS_LATENCY_SCOPE("db.get_achievement_statistic");
     AchievementStatisticInfo info;
-    ExecuteTransaction(db_name_, [&](sqlite::database& db)
+    pool_->ExecuteTransaction(true, [&](SQLiteConnection& db)
         {
             auto result = ::GetAchievementStatistic(db, uid, game_name, std::string(achievement_name));
             info.first_achieve_time_ = std::move(result.first_achieve_time_);
@@ -575,7 +955,8 @@ AchievementStatisticInfo SQLiteDBManager::GetAchievementStatistic(const UserID&
 
 bool SQLiteDBManager::AddHonor(const UserID& uid, const std::string_view& description)
 {
-    return ExecuteTransaction(db_name_, [&](sqlite::database& db)
+    METRICS_LATENCY_SCOPE("db.add_honor");
+    return pool_->ExecuteTransaction(false, [&](SQLiteConnection& db)
         {
             const auto birth_count = GetBirthCountOfUser(db, uid);
             ::AddHonor(db, description, uid, birth_count);
@@ -585,7 +966,8 @@ bool SQLiteDBManager::AddHonor(const UserID& uid, const std::string_view& descri
 
 bool SQLiteDBManager::DeleteHonor(const int32_t id)
 {
-    return ExecuteTransaction(db_name_, [&](sqlite::database& db)
+    METRICS_LATENCY_SCOPE("db.delete_honor");
+    return pool_->ExecuteTransaction(false, [&](SQLiteConnection& db)
         {
             ::DeleteHonor(db, id);
             return true;
@@ -594,8 +976,9 @@ bool SQLiteDBManager::DeleteHonor(const int32_t id)
 
 std::vector<HonorInfo> SQLiteDBManager::GetHonors()
 {
+    METRICS_LATENCY_SCOPE("db.get_honors");
     std::vector<HonorInfo> info;
-    ExecuteTransaction(db_name_, [&](sqlite::database& db)
+    pool_->ExecuteTransaction(true, [&](SQLiteConnection& db)
         {
             ForeachHonor(db,
                 [&](const int32_t id, std::string description, std::string uid, std::string time)
@@ -654,6 +1037,19 @@ std::unique_ptr<DBManagerBase> SQLiteDBManager::UseDB(const std::filesystem::pat
                 "match_id BIGINT UNSIGNED NOT NULL, "
                 "achievement_name VARCHAR(100) NOT NULL);";
         db << "CREATE INDEX IF NOT EXISTS user_id_index ON user_with_achievement(user_id);";
+        db << "CREATE INDEX IF NOT EXISTS finish_time_index ON match(finish_time);";
+        db << "CREATE TABLE IF NOT EXISTS recorded_match("
+                "record_id VARCHAR(100) PRIMARY KEY, "
+                "match_id BIGINT UNSIGNED NOT NULL);";
+        bool has_score_summary = false;
+        db << "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = 'user_score_summary';"
+            >> has_score_summary;
+        if (!has_score_summary) {
+            InfoLog() << "Build the score summary from the existing matches";
+            db << "BEGIN;";
+            RebuildScoreSummary(db);
+            db << "COMMIT;";
+        }
         return std::unique_ptr<DBManagerBase>(new SQLiteDBManager(db_name_str));
     } catch (const sqlite::sqlite_exception& e) {
         HandleError(e);
@@ -20,6 +20,8 @@ ENUM_END(TimeRange)
 #define DB_MANAGER_H
 
 #include <sstream>
+#include <chrono>
+#include <cstdio>
 #include <type_traits>
 #include <optional>
 #include <memory>
@@ -39,17 +41,39 @@ using DBName = std::string;
 #define ENUM_FILE "../bot_core/db_manager.h"
 #include "../utility/extend_enum.h"
 
-inline const char* const k_time_range_begin_datetimes[] = {
-    [TimeRange(TimeRange::月).ToUInt()] = "datetime('now','start of month')",
-    [TimeRange(TimeRange::年).ToUInt()] = "datetime('now','start of year')",
-    [TimeRange(TimeRange::总).ToUInt()] = "",
-};
-
-inline const char* const k_time_range_end_datetimes[] = {
-    [TimeRange(TimeRange::月).ToUInt()] = "datetime('now','start of month', '+1 month')",
-    [TimeRange(TimeRange::年).ToUInt()] = "datetime('now','start of year', '+1 year')",
-    [TimeRange(TimeRange::总).ToUInt()] = "",
-};
+// The datetimes are in the same format as the sqlite function datetime(), so they can be bound as parameters and compared
+// with the finish time of matches. An empty string means the time range is unbounded on that side.
+inline std::string DatetimeOfDay(const std::chrono::year_month_day& ymd)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%04d-%02u-%02u 00:00:00", static_cast<int>(ymd.year()),
+            static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()));
+    return buf;
+}
+
+// Same as datetime('now','start of month') or datetime('now','start of year').
+inline std::string TimeRangeBeginDatetime(const TimeRange time_range)
+{
+    const std::chrono::year_month_day today{std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now())};
+    if (time_range == TimeRange::月) {
+        return DatetimeOfDay(today.year() / today.month() / 1);
+    } else if (time_range == TimeRange::年) {
+        return DatetimeOfDay(today.year() / std::chrono::January / 1);
+    }
+    return "";
+}
+
+// Same as datetime('now','start of month','+1 month') or datetime('now','start of year','+1 year').
+inline std::string TimeRangeEndDatetime(const TimeRange time_range)
+{
+    const std::chrono::year_month_day today{std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now())};
+    if (time_range == TimeRange::月) {
+        return DatetimeOfDay((today.year() / today.month() + std::chrono::months(1)) / 1);
+    } else if (time_range == TimeRange::年) {
+        return DatetimeOfDay((today.year() + std::chrono::years(1)) / std::chrono::January / 1);
+    }
+    return "";
+}
 
 struct MatchProfile
 {
@@ -81,6 +105,18 @@ struct ScoreInfo
     int64_t rank_score_ = 0;
 };
 
+struct MatchRecord
+{
+    std::string game_name_;
+    std::optional<GroupID> gid_;
+    UserID host_uid_;
+    uint64_t multiple_ = 0;
+    std::vector<std::pair<UserID, int64_t>> game_score_infos_;
+    std::vector<std::pair<UserID, std::string>> achievements_;
+    // The record is skipped if a record with the same id has been written. Empty if it should never be skipped.
+    std::string record_id_ = {};
+};
+
 struct RankInfo
 {
     std::vector<std::pair<UserID, int64_t>> zero_sum_score_rank_;
@@ -138,6 +174,16 @@ class DBManagerBase
             const UserID& host_uid, const uint64_t multiple,
             const std::vector<std::pair<UserID, int64_t>>& game_score_infos,
             const std::vector<std::pair<UserID, std::string>>& achievements) = 0;
+    // Returns the score infos of each record, which is empty if the record failed.
+    virtual std::vector<std::vector<ScoreInfo>> RecordMatches(const std::vector<MatchRecord>& records)
+    {
+        std::vector<std::vector<ScoreInfo>> score_infos;
+        for (const auto& record : records) {
+            score_infos.emplace_back(RecordMatch(record.game_name_, record.gid_, record.host_uid_, record.multiple_,
+                        record.game_score_infos_, record.achievements_));
+        }
+        return score_infos;
+    }
     virtual UserProfile GetUserProfile(const UserID& uid, const std::string_view& time_range_begin,
             const std::string_view& time_range_end) = 0;
     virtual bool Suicide(const UserID& uid, const uint32_t required_match_num) = 0;
@@ -153,6 +199,15 @@ class DBManagerBase
 
 #ifdef WITH_SQLITE
 
+namespace sqlite { class database; }
+
+class SQLiteConnectionPool;
+
+// Drop the summary of scores used by the ranks and rebuild it from all the recorded matches. It is built when the
+// database is opened for the first time, and should be rebuilt after the scores of matches are updated by tools.
+// REQUIRE: should be called in a transaction
+void RebuildScoreSummary(sqlite::database& db);
+
 class SQLiteDBManager : public DBManagerBase
 {
   public:
@@ -162,6 +217,7 @@ class SQLiteDBManager : public DBManagerBase
             const UserID& host_uid, const uint64_t multiple,
             const std::vector<std::pair<UserID, int64_t>>& game_score_infos,
             const std::vector<std::pair<UserID, std::string>>& achievements) override;
+    virtual std::vector<std::vector<ScoreInfo>> RecordMatches(const std::vector<MatchRecord>& records) override;
     virtual UserProfile GetUserProfile(const UserID& uid, const std::string_view& time_range_begin,
             const std::string_view& time_range_end) override;
     virtual bool Suicide(const UserID& uid, const uint32_t required_match_num) override;
@@ -177,7 +233,7 @@ class SQLiteDBManager : public DBManagerBase
   private:
     SQLiteDBManager(const DBName& db_name);
 
-    DBName db_name_;
+    std::unique_ptr<SQLiteConnectionPool> pool_;
 };
 
 #endif // WITH_SQLITE
@@ -6,27 +6,33 @@
 
 #include <cassert>
 
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <memory>
 #include <filesystem>
 
 #include "image.h"
+#include "bot_core/timer.h"
+#include "utility/log.h"
 
 class MainStageBase;
 class GameOptionBase;
 class MatchBase;
+class MsgSenderBase;
 
 struct GameHandle
 {
     using ModGuard = std::function<void()>;
     using game_options_allocator = GameOptionBase*(*)();
     using game_options_deleter = void(*)(const GameOptionBase*);
-    using game_options_ptr = std::unique_ptr<GameOptionBase, game_options_deleter>;
     using main_stage_allocator = MainStageBase*(*)(MsgSenderBase&, const GameOptionBase&, MatchBase& match);
     using main_stage_deleter = void(*)(const MainStageBase*);
-    using main_stage_ptr = std::unique_ptr<MainStageBase, main_stage_deleter>;
+
+    static constexpr std::chrono::minutes k_default_idle_timeout{30};
 
     struct Achievement
     {
@@ -34,6 +40,182 @@ struct GameHandle
         std::string description_;
     };
 
+    // The functions exported by a loaded game module. The module is unloaded by |mod_guard_| when the object is
+    // destructed.
+    struct Module
+    {
+        Module(game_options_allocator game_options_allocator_fn, game_options_deleter game_options_deleter_fn,
+               main_stage_allocator main_stage_allocator_fn, main_stage_deleter main_stage_deleter_fn,
+               ModGuard mod_guard)
+            : game_options_allocator_(game_options_allocator_fn)
+            , game_options_deleter_(game_options_deleter_fn)
+            , main_stage_allocator_(main_stage_allocator_fn)
+            , main_stage_deleter_(main_stage_deleter_fn)
+            , mod_guard_(std::move(mod_guard))
+        {}
+
+        Module(const Module&) = delete;
+
+        ~Module()
+        {
+            if (mod_guard_) {
+                mod_guard_();
+            }
+        }
+
+        const game_options_allocator game_options_allocator_;
+        const game_options_deleter game_options_deleter_;
+        const main_stage_allocator main_stage_allocator_;
+        const main_stage_deleter main_stage_deleter_;
+        const ModGuard mod_guard_;
+    };
+
+    // Return: the loaded module, or nullptr if failed
+    using ModuleLoader = std::function<std::unique_ptr<Module>()>;
+
+  private:
+    // The shared state of the module, which may be accessed by the objects made by the module and the unloading timer
+    // after the game handle is destructed.
+    class ModuleSlot_
+    {
+      public:
+        ModuleSlot_(std::shared_ptr<const Module> module, ModuleLoader module_loader)
+            : module_(std::move(module)), module_loader_(std::move(module_loader)), idle_timeout_(k_default_idle_timeout)
+        {}
+
+        std::shared_ptr<const Module> Load(const std::string& game_name, std::weak_ptr<ModuleSlot_> self)
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            if (!module_ && module_loader_) {
+                InfoLog() << "Load game module lazily, game_name=" << game_name;
+                module_ = module_loader_();
+                ++load_count_;
+                // the module may not be used by any match, e.g., failed to create the match
+                ScheduleUnload_(std::move(self));
+            }
+            return module_;
+        }
+
+        // Called when the module may become idle, i.e., the game handle is created or an object made by the module is
+        // deleted.
+        void ScheduleUnloadIfIdle(std::weak_ptr<ModuleSlot_> self)
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            if (module_.use_count() == 1) {
+                ScheduleUnload_(std::move(self));
+            }
+        }
+
+        // Unload the module if no objects made by it are alive and it has been idle for |idle_timeout_|. The module
+        // which cannot be loaded again is never unloaded.
+        bool UnloadIfIdle()
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            if (!module_ || !module_loader_ || module_.use_count() > 1 ||
+                    std::chrono::steady_clock::now() - idle_since_ < idle_timeout_) {
+                return false;
+            }
+            module_ = nullptr;
+            return true;
+        }
+
+        bool IsLoaded() const
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            return module_ != nullptr;
+        }
+
+        uint64_t LoadCount() const
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            return load_count_;
+        }
+
+        void SetIdleTimeout(const std::chrono::steady_clock::duration idle_timeout)
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            idle_timeout_ = idle_timeout;
+        }
+
+      private:
+        // REQUIRE: should be protected by mutex_
+        void ScheduleUnload_(std::weak_ptr<ModuleSlot_> self)
+        {
+            if (!module_ || !module_loader_) {
+                return;
+            }
+            idle_since_ = std::chrono::steady_clock::now();
+            ScheduleUnloadTimer_(std::move(self), idle_timeout_);
+        }
+
+        // REQUIRE: should be protected by mutex_
+        void ScheduleUnloadTimer_(std::weak_ptr<ModuleSlot_> self, const std::chrono::steady_clock::duration delay)
+        {
+            auto& timer_wheel = TimerWheel::Get();
+            if (timer_id_.has_value()) {
+                timer_wheel.Cancel(*timer_id_); // only the last idle period matters
+            }
+            timer_id_ = timer_wheel.Schedule(std::chrono::ceil<TimerWheel::Duration>(delay),
+                    [self = std::move(self)]
+                    {
+                        if (const auto slot = self.lock()) {
+                            slot->OnUnloadTimer_(slot);
+                        }
+                    });
+        }
+
+        void OnUnloadTimer_(std::weak_ptr<ModuleSlot_> self)
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            timer_id_ = std::nullopt;
+            if (!module_ || module_.use_count() > 1) {
+                return;
+            }
+            // the timer wheel may fire up to one tick earlier than expected
+            if (const auto idle_time = std::chrono::steady_clock::now() - idle_since_; idle_time < idle_timeout_) {
+                ScheduleUnloadTimer_(std::move(self), idle_timeout_ - idle_time);
+                return;
+            }
+            module_ = nullptr;
+        }
+
+        mutable std::mutex mutex_;
+        std::shared_ptr<const Module> module_; // nullptr if the module is not loaded
+        const ModuleLoader module_loader_; // empty if the module cannot be loaded again after unloaded
+        std::chrono::steady_clock::duration idle_timeout_;
+        std::chrono::steady_clock::time_point idle_since_;
+        std::optional<uint64_t> timer_id_;
+        uint64_t load_count_ = 0;
+    };
+
+    // Holds the module so that it is not unloaded until the object made by it is deleted.
+    template <typename T, auto DeleterPtr>
+    class Deleter_
+    {
+      public:
+        Deleter_() = default;
+        Deleter_(std::shared_ptr<const Module> module, std::weak_ptr<ModuleSlot_> slot)
+            : module_(std::move(module)), slot_(std::move(slot))
+        {}
+
+        void operator()(const T* const p)
+        {
+            (module_.get()->*DeleterPtr)(p);
+            module_ = nullptr;
+            if (const auto slot = slot_.lock()) {
+                slot->ScheduleUnloadIfIdle(slot_);
+            }
+        }
+
+      private:
+        std::shared_ptr<const Module> module_;
+        std::weak_ptr<ModuleSlot_> slot_;
+    };
+
+  public:
+    using game_options_ptr = std::unique_ptr<GameOptionBase, Deleter_<GameOptionBase, &Module::game_options_deleter_>>;
+    using main_stage_ptr = std::unique_ptr<MainStageBase, Deleter_<MainStageBase, &Module::main_stage_deleter_>>;
+
     GameHandle(std::string name, std::string module_name,
                const uint64_t max_player, std::string rule,
                std::vector<Achievement> achievements, const uint32_t multiple,
@@ -43,6 +225,20 @@ struct GameHandle
                main_stage_allocator main_stage_allocator_fn,
                main_stage_deleter main_stage_deleter_fn,
                ModGuard mod_guard)
+        : GameHandle(std::move(name), std::move(module_name), max_player, std::move(rule), std::move(achievements),
+                multiple, std::move(developer), std::move(description),
+                std::make_shared<const Module>(game_options_allocator_fn, game_options_deleter_fn,
+                    main_stage_allocator_fn, main_stage_deleter_fn, std::move(mod_guard)),
+                nullptr)
+    {}
+
+    // |module| can be nullptr, in which case the module is loaded by |module_loader| when the first match of the game
+    // is created. If |module_loader| is set, the module is unloaded after it has been idle for a while.
+    GameHandle(std::string name, std::string module_name,
+               const uint64_t max_player, std::string rule,
+               std::vector<Achievement> achievements, const uint32_t multiple,
+               std::string developer, std::string description,
+               std::shared_ptr<const Module> module, ModuleLoader module_loader)
         : name_(std::move(name))
         , module_name_(std::move(module_name))
         , max_player_(max_player)
@@ -51,24 +247,45 @@ struct GameHandle
         , multiple_(multiple)
         , developer_(std::move(developer))
         , description_(std::move(description))
-        , game_options_allocator_(std::move(game_options_allocator_fn))
-        , game_options_deleter_(std::move(game_options_deleter_fn))
-        , main_stage_allocator_(std::move(main_stage_allocator_fn))
-        , main_stage_deleter_(std::move(main_stage_deleter_fn))
-        , mod_guard_(std::move(mod_guard))
         , activity_(0)
-    {}
+        , module_slot_(std::make_shared<ModuleSlot_>(std::move(module), std::move(module_loader)))
+    {
+        module_slot_->ScheduleUnloadIfIdle(module_slot_);
+    }
 
     GameHandle(GameHandle&&) = delete;
 
+    // Return: the loaded module, or nullptr if failed to load. The module will not be unloaded while the returned
+    // pointer is held.
+    std::shared_ptr<const Module> LoadModule() const { return module_slot_->Load(name_, module_slot_); }
+
+    bool IsModuleLoaded() const { return module_slot_->IsLoaded(); }
+
+    uint64_t ModuleLoadCount() const { return module_slot_->LoadCount(); }
+
+    bool UnloadModuleIfIdle() const { return module_slot_->UnloadIfIdle(); }
+
+    void SetModuleIdleTimeout(const std::chrono::steady_clock::duration idle_timeout) const
+    {
+        module_slot_->SetIdleTimeout(idle_timeout);
+    }
+
+    // REQUIRE: the module can be loaded
     game_options_ptr make_game_options() const
     {
-        return game_options_ptr(game_options_allocator_(), game_options_deleter_);
+        auto module = LoadModule();
+        assert(module);
+        GameOptionBase* const game_options = module->game_options_allocator_();
+        return game_options_ptr(game_options, {std::move(module), module_slot_});
     }
 
+    // REQUIRE: the module can be loaded
     main_stage_ptr make_main_stage(MsgSenderBase& reply, const GameOptionBase& game_options, MatchBase& match) const
     {
-        return main_stage_ptr(main_stage_allocator_(reply, game_options, match), main_stage_deleter_);
+        auto module = LoadModule();
+        assert(module);
+        MainStageBase* const main_stage = module->main_stage_allocator_(reply, game_options, match);
+        return main_stage_ptr(main_stage, {std::move(module), module_slot_});
     }
 
     const std::string name_;
@@ -79,11 +296,8 @@ struct GameHandle
     uint32_t multiple_;
     const std::string developer_;
     const std::string description_;
-    const game_options_allocator game_options_allocator_;
-    const game_options_deleter game_options_deleter_;
-    const main_stage_allocator main_stage_allocator_;
-    const main_stage_deleter main_stage_deleter_;
-    const ModGuard mod_guard_;
     std::atomic<uint64_t> activity_;
-};
 
+  private:
+    const std::shared_ptr<ModuleSlot_> module_slot_;
+};
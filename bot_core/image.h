@@ -5,12 +5,26 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <fstream>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iterator>
 
 #include <sys/stat.h>
 #include <dirent.h>
 
 #include "utility/log.h"
+#include "bot_core/metrics.h"
 
 #ifdef TEST_BOT
 inline bool enable_markdown_to_image = false;
@@ -25,17 +39,9 @@ inline std::filesystem::path ImageAbsPath(const std::filesystem::path& rel_path)
     return (std::filesystem::current_path() / ".image" / "gen" / rel_path) += ".png";
 }
 
-inline int MarkdownToImage(const std::string& markdown, const std::filesystem::path& rel_path, const uint32_t width)
+inline int RenderMarkdown(const std::string& markdown, const std::filesystem::path& abs_path, const uint32_t width)
 {
-    if (!enable_markdown_to_image) {
-        return false;
-    }
-    const auto abs_path = ImageAbsPath(rel_path);
-    if (std::filesystem::exists(abs_path)) {
-        // TODO: print debug msg
-        // return 0;
-    }
-    std::filesystem::create_directories(abs_path.parent_path());
+    METRICS_LATENCY_SCOPE("markdown.render");
     const std::string cmd = k_markdown2image_path.string() + " --output " + abs_path.string() + " --width " + std::to_string(width) + " --nowith_css --noprint_info";
     FILE* fp = popen(cmd.c_str(), "w");
     if (fp == nullptr) {
@@ -48,6 +54,350 @@ inline int MarkdownToImage(const std::string& markdown, const std::filesystem::p
     return 0;
 }
 
+// The rendered images are stored on disk and named by the hash of the markdown and the width, so that the same board or
+// help page is rendered only once. The least recently used images are removed when the total size exceeds the capacity.
+// The images already on disk are loaded when the cache is constructed, so the cache survives restarts.
+//
+// Each image has a sidecar file holding its markdown, which is compared on hit, so a hash collision is rendered again
+// rather than returning the image of another message.
+//
+// The returned paths may be sent by the adapters later, so the evicted files are removed after a grace period rather
+// than at once.
+class MarkdownImageCache
+{
+  public:
+    using Renderer = std::function<int(const std::string&, const std::filesystem::path&, uint32_t)>;
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint64_t k_default_capacity_bytes = 256 * 1024 * 1024;
+    static constexpr std::chrono::seconds k_default_removal_grace_period{300};
+
+    struct Stat
+    {
+        uint64_t hit_num_;
+        uint64_t miss_num_;
+        uint64_t image_num_;
+        uint64_t total_bytes_;
+    };
+
+    static MarkdownImageCache& Get()
+    {
+        static MarkdownImageCache cache(std::filesystem::current_path() / ".image" / "cache", k_default_capacity_bytes,
+                RenderMarkdown);
+        return cache;
+    }
+
+    MarkdownImageCache(std::filesystem::path dir, const uint64_t capacity_bytes, Renderer renderer,
+            const Clock::duration removal_grace_period = k_default_removal_grace_period)
+        : dir_(std::move(dir)), capacity_bytes_(capacity_bytes), renderer_(std::move(renderer))
+        , removal_grace_period_(removal_grace_period), total_bytes_(0), hit_num_(0), miss_num_(0)
+    {
+        std::error_code ec;
+        std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> images;
+        for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            if (entry.path().extension() == ".png" && std::filesystem::exists(SourcePath_(entry.path()))) {
+                images.emplace_back(entry.last_write_time(), entry.path());
+            } else if (entry.path().extension() != ".md" ||
+                    !std::filesystem::exists(std::filesystem::path(entry.path()).replace_extension(".png"))) {
+                std::filesystem::remove(entry.path(), ec); // unfinished renders
+            }
+        }
+        std::ranges::sort(images);
+        for (const auto& [_, path] : images) {
+            Insert_(path.filename().string(),
+                    std::filesystem::file_size(path, ec) + std::filesystem::file_size(SourcePath_(path), ec));
+        }
+        Evict_("");
+    }
+
+    MarkdownImageCache(const MarkdownImageCache&) = delete;
+    MarkdownImageCache(MarkdownImageCache&&) = delete;
+
+    // Returns the absolute path of the rendered image. The image is not rendered if |enable_markdown_to_image| is
+    // false.
+    std::filesystem::path Render(const std::string& markdown, const uint32_t width)
+    {
+        const std::string filename = Filename_(markdown, width);
+        const auto path = dir_ / filename;
+        if (!enable_markdown_to_image) {
+            return path;
+        }
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            RemoveExpired_();
+            if (const auto it = index_.find(filename); it != index_.end()) {
+                // the markdown is small, so it is cheap to be read on hit comparing to sending the image
+                if (std::filesystem::exists(path) && ReadSource_(path) == markdown) {
+                    Touch_(it);
+                    ++hit_num_;
+                    return path;
+                }
+                Erase_(it); // removed by others or hash collided
+            }
+            ++miss_num_;
+        }
+        // Render to temporary files and rename them, so that a concurrent hit never sees a partial image.
+        std::stringstream tmp_filename;
+        tmp_filename << filename << "." << std::this_thread::get_id() << ".tmp";
+        const auto tmp_path = dir_ / tmp_filename.str();
+        const auto tmp_source_path = std::filesystem::path(tmp_path).replace_extension(".md.tmp");
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+        std::ofstream(tmp_source_path, std::ios::binary | std::ios::trunc) << markdown;
+        if (renderer_(markdown, tmp_path, width) != 0 || !std::filesystem::exists(tmp_path)) {
+            ErrorLog() << "Render markdown to cache failed path=" << tmp_path;
+            std::filesystem::remove(tmp_source_path, ec);
+            return path;
+        }
+        const uint64_t size = std::filesystem::file_size(tmp_path, ec) + markdown.size();
+        std::filesystem::rename(tmp_source_path, SourcePath_(path), ec);
+        if (!ec) {
+            std::filesystem::rename(tmp_path, path, ec);
+        }
+        if (ec) {
+            ErrorLog() << "Rename cached image failed path=" << path << " error=" << ec.message();
+            return path;
+        }
+        std::lock_guard<std::mutex> l(mutex_);
+        if (const auto it = index_.find(filename); it != index_.end()) {
+            Erase_(it, false); // rendered by another thread concurrently
+        }
+        Insert_(filename, size);
+        Evict_(filename);
+        return path;
+    }
+
+    Stat GetStat() const
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        return Stat{.hit_num_ = hit_num_, .miss_num_ = miss_num_, .image_num_ = index_.size(),
+                    .total_bytes_ = total_bytes_};
+    }
+
+  private:
+    struct Entry
+    {
+        std::list<std::string>::iterator lru_it_;
+        uint64_t size_;
+        Clock::time_point last_used_time_;
+    };
+
+    using Index = std::unordered_map<std::string, Entry>;
+
+    static std::string Filename_(const std::string& markdown, const uint32_t width)
+    {
+        // FNV-1a, which is stable across processes unlike std::hash
+        uint64_t hash = 14695981039346656037ULL;
+        const auto update = [&hash](const char* const data, const size_t size)
+            {
+                for (size_t i = 0; i < size; ++i) {
+                    hash = (hash ^ static_cast<uint8_t>(data[i])) * 1099511628211ULL;
+                }
+            };
+        update(markdown.data(), markdown.size());
+        update(reinterpret_cast<const char*>(&width), sizeof(width));
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%016llx_%u.png", static_cast<unsigned long long>(hash), width);
+        return buf;
+    }
+
+    static std::filesystem::path SourcePath_(std::filesystem::path path) { return path.replace_extension(".md"); }
+
+    static std::string ReadSource_(const std::filesystem::path& path)
+    {
+        std::ifstream f(SourcePath_(path), std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(f), {});
+    }
+
+    // REQUIRE: should be protected by mutex_
+    void Insert_(const std::string& filename, const uint64_t size)
+    {
+        lru_.emplace_front(filename);
+        index_.emplace(filename, Entry{.lru_it_ = lru_.begin(), .size_ = size, .last_used_time_ = Clock::now()});
+        total_bytes_ += size;
+        removal_times_.erase(filename); // rendered again after eviction
+    }
+
+    // REQUIRE: should be protected by mutex_
+    void Touch_(const Index::iterator it)
+    {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_it_);
+        it->second.last_used_time_ = Clock::now();
+    }
+
+    // REQUIRE: should be protected by mutex_
+    void Erase_(const Index::iterator it, const bool remove_file = true)
+    {
+        if (remove_file) {
+            const auto removal_time = it->second.last_used_time_ + removal_grace_period_;
+            auto& pending_removal_time = removal_times_[it->first];
+            pending_removal_time = std::max(pending_removal_time, removal_time);
+            removing_files_.emplace_back(removal_time, it->first);
+        }
+        total_bytes_ -= it->second.size_;
+        lru_.erase(it->second.lru_it_);
+        index_.erase(it);
+        RemoveExpired_();
+    }
+
+    // REQUIRE: should be protected by mutex_
+    void RemoveExpired_()
+    {
+        const auto now = Clock::now();
+        // The files are appended in the order of eviction rather than expiration, which are nearly the same because
+        // the least recently used image is evicted first.
+        while (!removing_files_.empty() && removing_files_.front().first <= now) {
+            const auto& filename = removing_files_.front().second;
+            // skip if the image is rendered again, or it is evicted again with a later removal time
+            if (const auto it = removal_times_.find(filename); it != removal_times_.end() && it->second <= now) {
+                std::error_code ec;
+                std::filesystem::remove(dir_ / filename, ec);
+                std::filesystem::remove(SourcePath_(dir_ / filename), ec);
+                removal_times_.erase(it);
+            }
+            removing_files_.pop_front();
+        }
+    }
+
+    // REQUIRE: should be protected by mutex_
+    void Evict_(const std::string& keep_filename)
+    {
+        while (total_bytes_ > capacity_bytes_ && !lru_.empty() && lru_.back() != keep_filename) {
+            Erase_(index_.find(lru_.back()));
+        }
+    }
+
+    const std::filesystem::path dir_;
+    const uint64_t capacity_bytes_;
+    const Renderer renderer_;
+    const Clock::duration removal_grace_period_;
+    mutable std::mutex mutex_;
+    std::list<std::string> lru_; // the most recently used image is at the front
+    Index index_;
+    std::deque<std::pair<Clock::time_point, std::string>> removing_files_; // the evicted files and their removal time
+    std::unordered_map<std::string, Clock::time_point> removal_times_; // the latest removal time of each evicted file
+    uint64_t total_bytes_;
+    uint64_t hit_num_;
+    uint64_t miss_num_;
+};
+
+// The images encoded by the games (e.g., the boards composited from tiles) are saved under a directory and named by the
+// hash of the PNG bytes, so that an unchanged board is written only once and a path is never overwritten by another
+// board before it is sent. The least recently saved images are removed when there are more than |capacity| images.
+//
+// There is only one store in the bot, which is used by the message senders of the bot, so the capacity is shared by all
+// the games, and the directory is cleared only once when the bot starts.
+class ImageStore
+{
+  public:
+    static constexpr const uint32_t k_default_capacity_ = 1024;
+
+    static ImageStore& Get()
+    {
+        static ImageStore store(std::filesystem::current_path() / ".image" / "board", k_default_capacity_);
+        return store;
+    }
+
+    ImageStore(std::filesystem::path dir, const uint32_t capacity) : dir_(std::move(dir)), capacity_(capacity) {}
+
+    ImageStore(const ImageStore&) = delete;
+    ImageStore(ImageStore&&) = delete;
+
+    // Remove the images left by the last process.
+    void Clear()
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        std::error_code ec;
+        std::filesystem::remove_all(dir_, ec);
+        lru_.clear();
+        index_.clear();
+    }
+
+    // Returns the absolute path of the saved image, or an empty path if the image cannot be saved.
+    std::filesystem::path Save(const std::string_view png)
+    {
+        if (png.empty()) {
+            return {};
+        }
+        const std::string filename = Filename_(png);
+        const auto path = dir_ / filename;
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            if (const auto it = index_.find(filename); it != index_.end()) {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                if (std::filesystem::exists(path)) {
+                    return path;
+                }
+            }
+        }
+        // Write to a temporary file and rename it, so that a concurrent sender never sees a partial image.
+        std::stringstream tmp_filename;
+        tmp_filename << filename << "." << std::this_thread::get_id() << ".tmp";
+        const auto tmp_path = dir_ / tmp_filename.str();
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+        if (!(std::ofstream(tmp_path, std::ios::binary) << png)) {
+            return {};
+        }
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec) {
+            std::filesystem::remove(tmp_path, ec);
+            return {};
+        }
+        std::lock_guard<std::mutex> l(mutex_);
+        if (index_.find(filename) == index_.end()) {
+            lru_.emplace_front(filename);
+            index_.emplace(filename, lru_.begin());
+        }
+        while (lru_.size() > capacity_) {
+            std::filesystem::remove(dir_ / lru_.back(), ec);
+            index_.erase(lru_.back());
+            lru_.pop_back();
+        }
+        return path;
+    }
+
+  private:
+    static std::string Filename_(const std::string_view png)
+    {
+        // FNV-1a, which is stable across processes unlike std::hash
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char c : png) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+        }
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%016llx.png", static_cast<unsigned long long>(hash));
+        return buf;
+    }
+
+    const std::filesystem::path dir_;
+    const uint32_t capacity_;
+    std::mutex mutex_;
+    std::list<std::string> lru_; // the most recently saved image is at the front
+    std::unordered_map<std::string, std::list<std::string>::iterator> index_;
+};
+
+inline int MarkdownToImage(const std::string& markdown, const std::filesystem::path& rel_path, const uint32_t width)
+{
+    if (!enable_markdown_to_image) {
+        return false;
+    }
+    METRICS_LATENCY_SCOPE("markdown.to_image"); // including the images hitting the cache
+    const auto abs_path = ImageAbsPath(rel_path);
+    std::filesystem::create_directories(abs_path.parent_path());
+    std::error_code ec;
+    std::filesystem::copy_file(MarkdownImageCache::Get().Render(markdown, width), abs_path,
+            std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec) {
+        ErrorLog() << "Copy cached image failed path=" << abs_path << " error=" << ec.message();
+        return -1;
+    }
+    return 0;
+}
+
 inline int CharToImage(const char ch, const std::filesystem::path& rel_path)
 {
     return MarkdownToImage(std::string("<style>html,body{color:#fdf3dd; background:#783623;}</style> <p align=\"middle\"><font size=\"6\"><b>") + ch + "</b></font></p>", rel_path, 85);
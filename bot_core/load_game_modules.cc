@@ -2,15 +2,14 @@
 //
 // This source code is licensed under LGPLv2 (found in the LICENSE file).
 
-#include <regex>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
 
 #ifdef _WIN32
 #include <windows.h>
 #elif __linux__
-#include <dirent.h>
 #include <dlfcn.h>
-#include <sys/stat.h>
-#include <sys/types.h>
 #define HINSTANCE void*
 #define GetProcAddress dlsym
 #define FreeLibrary dlclose
@@ -24,15 +23,60 @@ static_assert(false, "Not support OS");
 #include "bot_core/msg_sender.h"
 #include "game_framework/game_main.h"
 
-static void LoadGame(HINSTANCE mod, GameHandleMap& game_handles)
+#ifdef _WIN32
+static constexpr const char* const k_module_extension = ".dll";
+#else
+static constexpr const char* const k_module_extension = ".so";
+#endif
+
+// The games listed in the manifest are not loaded when the bot starts, so the manifest should be updated when the
+// module file is changed, which is checked by the modification time and the size of the file.
+static constexpr const char* const k_manifest_filename = "game_manifest.txt";
+static constexpr const char* const k_manifest_header = "lgtbot_game_manifest 1";
+
+namespace {
+
+struct GameManifestEntry
+{
+    std::string filename_ = {};
+    int64_t mtime_ = 0;
+    uint64_t size_ = 0;
+    std::string name_;
+    std::string module_name_;
+    uint64_t max_player_ = 0;
+    uint32_t multiple_ = 0;
+    std::string rule_;
+    std::string developer_;
+    std::string description_;
+    std::vector<GameHandle::Achievement> achievements_ = {};
+};
+
+}
+
+using GameManifest = std::map<std::string, GameManifestEntry>; // the key is the filename
+
+static HINSTANCE OpenLibrary(const std::filesystem::path& path)
 {
+#ifdef _WIN32
+    HINSTANCE const mod = LoadLibrary(path.string().c_str());
+#else
+    HINSTANCE const mod = dlopen(path.c_str(), RTLD_LAZY);
+#endif
     if (!mod) {
 #ifdef __linux__
         ErrorLog() << "Load mod failed: " << dlerror();
 #else
         ErrorLog() << "Load mod failed";
 #endif
-        return;
+    }
+    return mod;
+}
+
+// Return: the module and its manifest entry without the file information, or nullptr if failed
+static std::pair<std::unique_ptr<GameHandle::Module>, GameManifestEntry> LoadGame(HINSTANCE mod)
+{
+    if (!mod) {
+        return {};
     }
 
     typedef bool(*GetGameInfo)(GameInfo* game_info);
@@ -56,28 +100,192 @@ static void LoadGame(HINSTANCE mod, GameHandleMap& game_handles)
     const auto main_stage_deleter_fn = (GameHandle::main_stage_deleter)load_proc("DeleteMainStage");
 
     if (!game_info_fn || !game_options_allocator_fn || !game_options_deleter_fn || !main_stage_allocator_fn || !main_stage_deleter_fn) {
-        return;
+        FreeLibrary(mod);
+        return {};
     }
 
-    const char* rule = nullptr;
-    const char* module_name = nullptr;
-    uint64_t max_player = 0;
     GameInfo game_info;
     if (!game_info_fn(&game_info)) {
         ErrorLog() << "Load failed: Cannot get game game";
-        return;
+        FreeLibrary(mod);
+        return {};
     }
-    std::vector<GameHandle::Achievement> achievements;
+    GameManifestEntry entry{
+        .name_ = game_info.game_name_,
+        .module_name_ = game_info.module_name_,
+        .max_player_ = game_info.max_player_,
+        .multiple_ = game_info.multiple_,
+        .rule_ = game_info.rule_,
+        .developer_ = game_info.developer_,
+        .description_ = game_info.description_,
+    };
     for (const GameAchievement* achievement = game_info.achievements_; achievement->name_; ++achievement) {
-        achievements.emplace_back(achievement->name_, achievement->description_);
+        entry.achievements_.emplace_back(achievement->name_, achievement->description_);
+    }
+    return {std::make_unique<GameHandle::Module>(game_options_allocator_fn, game_options_deleter_fn,
+                    main_stage_allocator_fn, main_stage_deleter_fn, [mod] { FreeLibrary(mod); }),
+            std::move(entry)};
+}
+
+static std::string EscapeManifestValue(const std::string_view str)
+{
+    std::string result;
+    for (const char c : str) {
+        switch (c) {
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n"; break;
+        case '\r': result += "\\r"; break;
+        case '\t': result += "\\t"; break;
+        default: result += c;
+        }
+    }
+    return result;
+}
+
+static std::string UnescapeManifestValue(const std::string_view str)
+{
+    std::string result;
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] != '\\' || i + 1 == str.size()) {
+            result += str[i];
+            continue;
+        }
+        switch (str[++i]) {
+        case 'n': result += '\n'; break;
+        case 'r': result += '\r'; break;
+        case 't': result += '\t'; break;
+        default: result += str[i];
+        }
     }
-    game_handles.emplace(
-            game_info.game_name_,
-            std::make_unique<GameHandle>(game_info.game_name_, game_info.module_name_, game_info.max_player_,
-                game_info.rule_, std::move(achievements), game_info.multiple_, game_info.developer_, game_info.description_,
-                game_options_allocator_fn, game_options_deleter_fn, main_stage_allocator_fn, main_stage_deleter_fn,
-                [mod] { FreeLibrary(mod); }));
-    InfoLog() << "Loaded successfully!";
+    return result;
+}
+
+template <typename T>
+static bool ParseManifestNumber(const std::string& value, T& number)
+{
+    const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+    return ec == std::errc() && ptr == value.data() + value.size();
+}
+
+// Each entry is a block of "<key>\t<value>" lines, and the blocks are separated by empty lines. A broken entry is dropped,
+// so the module is loaded again as if it is not in the manifest.
+static GameManifest ReadManifest(const std::filesystem::path& path)
+{
+    GameManifest manifest;
+    std::ifstream f(path);
+    if (std::string header; !f || !std::getline(f, header) || header != k_manifest_header) {
+        InfoLog() << "No valid game manifest: " << path;
+        return manifest;
+    }
+    GameManifestEntry entry;
+    bool is_broken = false;
+    const auto finish_entry = [&]
+        {
+            if (entry.filename_.empty() && !is_broken) {
+                // no entry
+            } else if (is_broken || entry.filename_.empty() || entry.name_.empty()) {
+                WarnLog() << "Drop broken entry in game manifest: " << entry.filename_;
+            } else {
+                manifest.emplace(entry.filename_, std::move(entry));
+            }
+            entry = GameManifestEntry();
+            is_broken = false;
+        };
+    for (std::string line; std::getline(f, line); ) {
+        if (line.empty()) {
+            finish_entry();
+            continue;
+        }
+        const auto pos = line.find('\t');
+        if (pos == std::string::npos) {
+            WarnLog() << "Invalid line in game manifest: " << line;
+            is_broken = true;
+            continue;
+        }
+        const std::string_view key = std::string_view(line).substr(0, pos);
+        const std::string value = UnescapeManifestValue(std::string_view(line).substr(pos + 1));
+        if (key == "file") {
+            entry.filename_ = value;
+        } else if (key == "mtime") {
+            is_broken |= !ParseManifestNumber(value, entry.mtime_);
+        } else if (key == "size") {
+            is_broken |= !ParseManifestNumber(value, entry.size_);
+        } else if (key == "name") {
+            entry.name_ = value;
+        } else if (key == "module_name") {
+            entry.module_name_ = value;
+        } else if (key == "max_player") {
+            is_broken |= !ParseManifestNumber(value, entry.max_player_);
+        } else if (key == "multiple") {
+            is_broken |= !ParseManifestNumber(value, entry.multiple_);
+        } else if (key == "rule") {
+            entry.rule_ = value;
+        } else if (key == "developer") {
+            entry.developer_ = value;
+        } else if (key == "description") {
+            entry.description_ = value;
+        } else if (key == "achievement") {
+            const auto name_end = value.find('\t');
+            entry.achievements_.emplace_back(value.substr(0, name_end),
+                    name_end == std::string::npos ? "" : value.substr(name_end + 1));
+        }
+    }
+    finish_entry();
+    return manifest;
+}
+
+static void WriteManifest(const std::filesystem::path& path, const GameManifest& manifest)
+{
+    const auto tmp_path = std::filesystem::path(path).concat(".tmp");
+    {
+        std::ofstream f(tmp_path);
+        if (!f) {
+            WarnLog() << "Cannot write game manifest: " << tmp_path;
+            return;
+        }
+        f << k_manifest_header << "\n";
+        for (const auto& [_, entry] : manifest) {
+            f << "\n";
+            f << "file\t" << EscapeManifestValue(entry.filename_) << "\n";
+            f << "mtime\t" << entry.mtime_ << "\n";
+            f << "size\t" << entry.size_ << "\n";
+            f << "name\t" << EscapeManifestValue(entry.name_) << "\n";
+            f << "module_name\t" << EscapeManifestValue(entry.module_name_) << "\n";
+            f << "max_player\t" << entry.max_player_ << "\n";
+            f << "multiple\t" << entry.multiple_ << "\n";
+            f << "rule\t" << EscapeManifestValue(entry.rule_) << "\n";
+            f << "developer\t" << EscapeManifestValue(entry.developer_) << "\n";
+            f << "description\t" << EscapeManifestValue(entry.description_) << "\n";
+            for (const auto& achievement : entry.achievements_) {
+                f << "achievement\t" << EscapeManifestValue(achievement.name_ + "\t" + achievement.description_) << "\n";
+            }
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        WarnLog() << "Cannot rename game manifest: " << ec.message();
+    } else {
+        InfoLog() << "Game manifest updated: " << path;
+    }
+}
+
+static void AddGameHandle(GameHandleMap& game_handles, const std::filesystem::path& path, const GameManifestEntry& entry,
+        std::shared_ptr<const GameHandle::Module> module)
+{
+    const auto loader = [path, name = entry.name_]() -> std::unique_ptr<GameHandle::Module>
+        {
+            auto [module, entry] = LoadGame(OpenLibrary(path));
+            if (module && entry.name_ != name) {
+                ErrorLog() << "The game name of the module is changed from " << name << " to " << entry.name_
+                           << ", restart the bot to reload the manifest";
+                return nullptr;
+            }
+            return std::move(module);
+        };
+    game_handles.emplace(entry.name_, std::make_unique<GameHandle>(entry.name_, entry.module_name_, entry.max_player_,
+                entry.rule_, entry.achievements_, entry.multiple_, entry.developer_, entry.description_,
+                std::move(module), loader));
 }
 
 void BotCtx::LoadGameModules_(const char* const games_path)
@@ -85,38 +293,48 @@ void BotCtx::LoadGameModules_(const char* const games_path)
     if (games_path == nullptr) {
         return;
     }
-#ifdef _WIN32
-    WIN32_FIND_DATA file_data;
-    HANDLE file_handle = FindFirstFile((std::string(games_path) + "\\*.dll").c_str(), &file_data);
-    if (file_handle == INVALID_HANDLE_VALUE) {
+    std::error_code ec;
+    std::filesystem::directory_iterator dir_it(games_path, ec);
+    if (ec) {
+        ErrorLog() << "Open games directory failed: " << ec.message();
         return;
     }
-    do {
-        const auto dll_path = std::string(games_path) + "\\" + file_data.cFileName;
-        LoadGame(LoadLibrary(dll_path.c_str()), game_handles_);
-    } while (FindNextFile(file_handle, &file_data));
-    FindClose(file_handle);
-    InfoLog() << "Load module count: " << game_handles_.size();
-#elif __linux__
-    DIR* d = opendir(games_path);
-    if (!d) {
-        ErrorLog() << "opendir failed";
-        return;
-    }
-    const std::regex base_regex(".*so");
-    std::smatch base_match;
-    struct stat st;
-    for (dirent* dp = nullptr; (dp = readdir(d)) != NULL;) {
-        std::string name(dp->d_name);
-        if (std::regex_match(name, base_match, base_regex); base_match.empty()) {
-            DebugLog() << "Find irrelevant file " << name << ", skip";
+    const auto manifest_path = std::filesystem::path(games_path) / k_manifest_filename;
+    const GameManifest old_manifest = ReadManifest(manifest_path);
+    GameManifest manifest;
+    bool manifest_changed = false;
+    for (const auto& dir_entry : dir_it) {
+        const auto& path = dir_entry.path();
+        const std::string filename = path.filename().string();
+        if (!dir_entry.is_regular_file(ec) || path.extension() != k_module_extension) {
+            DebugLog() << "Find irrelevant file " << filename << ", skip";
+            continue;
+        }
+        const int64_t mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        const uint64_t size = std::filesystem::file_size(path, ec);
+        if (const auto it = old_manifest.find(filename);
+                it != old_manifest.end() && it->second.mtime_ == mtime && it->second.size_ == size) {
+            InfoLog() << "Find game " << it->second.name_ << " in manifest, library " << filename << " is not loaded";
+            AddGameHandle(game_handles_, path, it->second, nullptr);
+            manifest.emplace(filename, it->second);
+            continue;
+        }
+        InfoLog() << "Loading library " << filename;
+        auto [module, entry] = LoadGame(OpenLibrary(path));
+        if (!module) {
             continue;
         }
-        InfoLog() << "Loading library " << name;
-        LoadGame(dlopen((std::string(games_path) + "/" + name).c_str(), RTLD_LAZY), game_handles_);
+        entry.filename_ = filename;
+        entry.mtime_ = mtime;
+        entry.size_ = size;
+        // the module has been loaded, so keep it until it is idle
+        AddGameHandle(game_handles_, path, entry, std::move(module));
+        manifest.emplace(filename, std::move(entry));
+        manifest_changed = true;
+        InfoLog() << "Loaded successfully!";
     }
-    InfoLog() << "Loading finished.";
-    closedir(d);
-#endif
+    if (manifest_changed || manifest.size() != old_manifest.size()) {
+        WriteManifest(manifest_path, manifest);
+    }
+    InfoLog() << "Loading finished, game count: " << game_handles_.size();
 }
-
@@ -9,6 +9,7 @@
 #include <filesystem>
 #include <numeric>
 #include <algorithm>
+#include <thread>
 #include <utility> // g++12 has a bug which will cause 'exchange' is not a member of 'std'
 
 #include "utility/msg_checker.h"
@@ -19,6 +20,7 @@
 #include "bot_core/match_manager.h"
 #include "bot_core/score_calculation.h"
 #include "bot_core/options.h"
+#include "bot_core/user_identity_cache.h"
 
 Match::Match(BotCtx& bot, const MatchID mid, GameHandle& game_handle, const UserID host_uid,
              const std::optional<GroupID> gid)
@@ -29,7 +31,7 @@ Match::Match(BotCtx& bot, const MatchID mid, GameHandle& game_handle, const User
         , gid_(gid)
         , state_(State::NOT_STARTED)
         , options_(game_handle.make_game_options())
-        , main_stage_(nullptr, [](const MainStageBase*) {}) // make when game starts
+        , main_stage_(nullptr) // make when game starts
         , player_num_each_user_(1)
         , users_()
         , boardcast_private_sender_([this](const std::function<void(MsgSender&)>& fn)
@@ -44,6 +46,8 @@ Match::Match(BotCtx& bot, const MatchID mid, GameHandle& game_handle, const User
         , bench_to_player_num_(0)
         , multiple_(game_handle.multiple_)
         , help_cmd_(Command<void(MsgSenderBase&)>("查看游戏帮助", std::bind_front(&Match::Help_, this), VoidChecker("帮助"), OptionalDefaultChecker<BoolChecker>(false, "文字", "图片")))
+        , request_histogram_(Metrics::Get().GetHistogram("request.game." + game_handle.name_))
+        , computer_act_histogram_(Metrics::Get().GetHistogram("computer_act." + game_handle.name_))
 #ifdef TEST_BOT
         , before_handle_timeout_(false)
 #endif
@@ -52,13 +56,18 @@ Match::Match(BotCtx& bot, const MatchID mid, GameHandle& game_handle, const User
     users_.emplace(host_uid, ParticipantUser(host_uid));
 }
 
-Match::~Match() {}
+Match::~Match()
+{
+    std::unique_lock<std::mutex> l(computer_task_mutex_);
+    computer_task_cv_.wait(l, [this] { return computer_task_num_ == 0; });
+}
 
 bool Match::Has_(const UserID uid) const { return users_.find(uid) != users_.end(); }
 
 const char* Match::HostUserName_() const
 {
-    return GetUserName(host_uid_.GetCStr(), gid_.has_value() ? gid_->GetCStr() : nullptr);
+    thread_local static std::string str;
+    return (str = UserIdentityCache::Get().UserName(host_uid_, gid_)).c_str();
 }
 
 uint64_t Match::ComputerNum_() const
@@ -162,6 +171,7 @@ static ErrCode ConverErrCode(const StageErrCode& stage_errcode)
 ErrCode Match::Request(const UserID uid, const std::optional<GroupID> gid, const std::string& msg,
                        MsgSender& reply)
 {
+    const LatencyScope latency_scope(request_histogram_);
     std::lock_guard<std::mutex> l(mutex_);
     const auto it = users_.find(uid);
     if (it == users_.end() && it->second.state_ == ParticipantUser::State::LEFT) {
@@ -219,17 +229,23 @@ ErrCode Match::GameStart(const UserID uid, const bool is_public, MsgSenderBase&
         return EC_MATCH_NOT_HOST;
     }
     const uint64_t player_num = std::max(user_controlled_player_num(), bench_to_player_num_);
-    const std::filesystem::path resource_dir = std::filesystem::path(bot_.game_path()) / game_handle_.module_name_ / "";
     assert(main_stage_ == nullptr);
     assert(game_handle_.max_player_ == 0 || player_num <= game_handle_.max_player_);
-    options_->SetPlayerNum(player_num);
-    options_->SetResourceDir(resource_dir.c_str());
-    options_->global_options_.public_timer_alert_ = GET_OPTION_VALUE(bot_.option(), 计时公开提示);
+    SetUpOptions_(player_num);
     if (!(main_stage_ = game_handle_.make_main_stage(reply, *options_, *this))) {
         reply() << "[错误] 开始失败：不符合游戏参数的预期";
         return EC_MATCH_UNEXPECTED_CONFIG;
     }
     state_ = State::IS_STARTED;
+    {
+        // the names are shown in almost every broadcast of the game, and we do not wait for the adapter when holding the
+        // lock of the match
+        std::vector<UserID> uids;
+        for (const auto& [uid, _] : users_) {
+            uids.emplace_back(uid);
+        }
+        UserIdentityCache::Get().PrefetchAsync(uids, gid_);
+    }
     BoardcastAtAll() << "游戏开始，您可以使用「帮助」命令（不带#号），查看可执行命令";
     for (auto& [uid, user_info] : users_) {
         for (int i = 0; i < player_num_each_user_; ++i) {
@@ -251,6 +267,209 @@ ErrCode Match::GameStart(const UserID uid, const bool is_public, MsgSenderBase&
     return EC_OK;
 }
 
+void Match::SetUpOptions_(const uint64_t player_num)
+{
+    const std::filesystem::path resource_dir = std::filesystem::path(bot_.game_path()) / game_handle_.module_name_ / "";
+    options_->SetPlayerNum(player_num);
+    options_->SetResourceDir(resource_dir.c_str());
+    options_->global_options_.public_timer_alert_ = GET_OPTION_VALUE(bot_.option(), 计时公开提示);
+}
+
+bool Match::Checkpoint(CheckpointWriter& writer) const
+{
+    std::lock_guard<std::mutex> l(mutex_);
+    if (state_ != State::IS_STARTED) {
+        return false;
+    }
+    uint64_t stage_checkpoint_size = 0;
+    const char* const stage_checkpoint = main_stage_->CheckpointC(stage_checkpoint_size);
+    if (!stage_checkpoint) {
+        MatchLog(InfoLog()) << "Checkpoint is not supported by the game";
+        return false;
+    }
+    std::vector<std::string> option_commands;
+    for (uint64_t i = 0; i < options_->Size(); ++i) {
+        option_commands.emplace_back(options_->OptionCommand(i));
+    }
+    writer.Write(game_handle_.name_, mid_, host_uid_, gid_, multiple_, bench_to_player_num_, player_num_each_user_,
+            option_commands, users_.size());
+    for (const auto& [uid, user_info] : users_) {
+        writer.Write(uid, user_info.state_, user_info.pids_, user_info.leave_when_config_changed_,
+                user_info.want_interrupt_);
+    }
+    writer.Write(players_.size());
+    for (const auto& player : players_) {
+        if (const auto* const uid = std::get_if<UserID>(&player.id_)) {
+            writer.Write(true, *uid);
+        } else {
+            writer.Write(false, std::get<ComputerID>(player.id_));
+        }
+        writer.Write(player.is_eliminated_);
+    }
+    writer.Write(is_in_deduction_, std::string_view(stage_checkpoint, stage_checkpoint_size));
+    MatchLog(InfoLog()) << "Checkpoint succeed size=" << writer.Str().size();
+    return true;
+}
+
+std::shared_ptr<Match> Match::Restore(BotCtx& bot, CheckpointReader& reader)
+{
+    std::string game_name;
+    MatchID mid;
+    UserID host_uid;
+    std::optional<GroupID> gid;
+    if (!reader.Read(game_name, mid, host_uid, gid)) {
+        ErrorLog() << "Restore match failed because the checkpoint is broken";
+        return nullptr;
+    }
+    const auto it = bot.game_handles().find(game_name);
+    if (it == bot.game_handles().end()) {
+        ErrorLog() << "Restore match failed because the game is unknown mid=" << mid << " game=" << game_name;
+        return nullptr;
+    }
+    // hold the module so that it is not unloaded before the match is restored
+    const auto module = it->second->LoadModule();
+    if (!module) {
+        ErrorLog() << "Restore match failed because the game cannot be loaded mid=" << mid << " game=" << game_name;
+        return nullptr;
+    }
+    const auto match = std::make_shared<Match>(bot, mid, *it->second, host_uid, gid);
+    if (!match->Restore_(reader)) {
+        return nullptr;
+    }
+    return match;
+}
+
+bool Match::Restore_(CheckpointReader& reader)
+{
+    std::lock_guard<std::mutex> l(mutex_);
+    std::vector<std::string> option_commands;
+    uint64_t user_num = 0;
+    if (!reader.Read(multiple_, bench_to_player_num_, player_num_each_user_, option_commands, user_num)) {
+        MatchLog(ErrorLog()) << "Restore match failed because the checkpoint is broken";
+        return false;
+    }
+    for (const auto& command : option_commands) {
+        if (!options_->SetOption(command.c_str())) {
+            MatchLog(ErrorLog()) << "Restore match failed because of the unexpected option \"" << command << "\"";
+            return false;
+        }
+    }
+    users_.clear();
+    for (uint64_t i = 0; i < user_num; ++i) {
+        UserID uid;
+        if (!reader.Read(uid)) {
+            MatchLog(ErrorLog()) << "Restore match failed because the checkpoint is broken";
+            return false;
+        }
+        auto& user_info = users_.emplace(uid, ParticipantUser(uid)).first->second;
+        if (!reader.Read(user_info.state_, user_info.pids_, user_info.leave_when_config_changed_,
+                    user_info.want_interrupt_)) {
+            MatchLog(ErrorLog()) << "Restore match failed because the checkpoint is broken";
+            return false;
+        }
+    }
+    uint64_t player_num = 0;
+    if (!reader.Read(player_num)) {
+        MatchLog(ErrorLog()) << "Restore match failed because the checkpoint is broken";
+        return false;
+    }
+    for (uint64_t i = 0; i < player_num; ++i) {
+        bool is_user = false;
+        UserID uid;
+        ComputerID cid;
+        if (!reader.Read(is_user) || !(is_user ? reader.Read(uid) : reader.Read(cid))) {
+            MatchLog(ErrorLog()) << "Restore match failed because the checkpoint is broken";
+            return false;
+        }
+        auto& player = is_user ? players_.emplace_back(uid) : players_.emplace_back(cid);
+        if (!reader.Read(player.is_eliminated_)) {
+            MatchLog(ErrorLog()) << "Restore match failed because the checkpoint is broken";
+            return false;
+        }
+    }
+    std::string stage_checkpoint;
+    if (!reader.Read(is_in_deduction_, stage_checkpoint) || !reader.IsEnd() ||
+            !std::ranges::all_of(users_, [this](const auto& pair)
+                {
+                    return std::ranges::all_of(pair.second.pids_, [&](const PlayerID pid)
+                            {
+                                return pid < players_.size() && players_[pid].id_ == VariantID(pair.first);
+                            });
+                })) {
+        MatchLog(ErrorLog()) << "Restore match failed because the checkpoint is broken";
+        return false;
+    }
+    SetUpOptions_(players_.size());
+    if (!(main_stage_ = game_handle_.make_main_stage(EmptyMsgSender::Get(), *options_, *this))) {
+        MatchLog(ErrorLog()) << "Restore match failed because the options are invalid";
+        return false;
+    }
+    state_ = State::IS_STARTED;
+    for (auto& [_, user_info] : users_) {
+        user_info.sender_.SetMatch(this);
+    }
+    boardcast_private_sender_.SetMatch(this);
+    if (group_sender_.has_value()) {
+        group_sender_->SetMatch(this);
+    }
+    // the timers of the stages are restarted with the remaining time
+    if (!main_stage_->RestoreC(stage_checkpoint.data(), stage_checkpoint.size())) {
+        MatchLog(ErrorLog()) << "Restore match failed because the stage checkpoint is broken";
+        return false;
+    }
+    if (!BindRestored_()) {
+        return false;
+    }
+    MatchLog(InfoLog()) << "Restore match succeed";
+    BoardcastAtAll() << "裁判重启完毕，游戏从中断处继续，您可以使用「帮助」命令（不带#号），查看当前阶段和可执行命令";
+    return true;
+}
+
+void Match::Suspend()
+{
+    const std::lock_guard<std::mutex> l(mutex_);
+    MatchLog(InfoLog()) << "Match is suspended";
+    StopTimer();
+    Terminate_();
+}
+
+// REQUIRE: should be protected by mutex_
+bool Match::BindRestored_()
+{
+    std::vector<UserID> bound_uids;
+    const auto unbind = [&]
+        {
+            for (const auto& uid : bound_uids) {
+                match_manager().UnbindMatch(uid);
+            }
+        };
+    for (const auto& [uid, user_info] : users_) {
+        if (user_info.state_ == ParticipantUser::State::LEFT) {
+            continue;
+        }
+        if (!match_manager().BindMatch(uid, shared_from_this())) {
+            MatchLog(ErrorLog()) << "Restore match failed because the user has joined another match uid=" << uid;
+            unbind();
+            return false;
+        }
+        bound_uids.emplace_back(uid);
+    }
+    if (gid_.has_value() && !match_manager().BindMatch(*gid_, shared_from_this())) {
+        MatchLog(ErrorLog()) << "Restore match failed because the group has another match";
+        unbind();
+        return false;
+    }
+    if (!match_manager().BindMatch(mid_, shared_from_this())) {
+        MatchLog(ErrorLog()) << "Restore match failed because the match id has been used";
+        unbind();
+        if (gid_.has_value()) {
+            match_manager().UnbindMatch(*gid_);
+        }
+        return false;
+    }
+    return true;
+}
+
 ErrCode Match::Join(const UserID uid, MsgSenderBase& reply)
 {
     std::lock_guard<std::mutex> l(mutex_);
@@ -371,10 +590,7 @@ const char* Match::PlayerName(const PlayerID& pid)
     if (const auto pval = std::get_if<ComputerID>(&id)) {
         return (str = "机器人" + std::to_string(*pval) + "号").c_str();
     }
-    if (!gid().has_value()) {
-        return GetUserName(std::get<UserID>(id).GetCStr(), nullptr);
-    }
-    return GetUserName(std::get<UserID>(id).GetCStr(), gid().has_value() ? gid()->GetCStr() : nullptr);
+    return (str = UserIdentityCache::Get().UserName(std::get<UserID>(id), gid())).c_str();
 }
 
 const char* Match::PlayerAvatar(const PlayerID& pid, const int32_t size)
@@ -384,8 +600,7 @@ const char* Match::PlayerAvatar(const PlayerID& pid, const int32_t size)
     if (const auto pval = std::get_if<ComputerID>(&id)) {
         return "";
     }
-    str = GetUserAvatar(std::get<UserID>(id).GetCStr(), size);
-    return str.c_str();
+    return (str = UserIdentityCache::Get().UserAvatar(std::get<UserID>(id), size)).c_str();
 }
 
 MsgSenderBase::MsgSenderGuard Match::BoardcastAtAll()
@@ -505,6 +720,33 @@ void Match::StopTimer()
     timer_ = nullptr; // stop timer
 }
 
+void Match::RunComputerTask(void* const p, void(* const task)(void*))
+{
+    {
+        std::lock_guard<std::mutex> l(computer_task_mutex_);
+        ++computer_task_num_;
+    }
+    std::thread([this, p, task, match_wk = weak_from_this()]
+            {
+                task(p);
+                {
+                    // |p| may be released after the notification, and so is the match if it is being destructed
+                    std::lock_guard<std::mutex> l(computer_task_mutex_);
+                    --computer_task_num_;
+                    computer_task_cv_.notify_all();
+                }
+                const auto match = match_wk.lock();
+                if (!match) {
+                    return; // match is released
+                }
+                std::lock_guard<std::mutex> l(match->mutex_);
+                if (match->state_ == State::IS_STARTED) {
+                    match->MatchLog(DebugLog()) << "Computer task finished";
+                    match->Routine_();
+                }
+            }).detach();
+}
+
 void Match::Eliminate(const PlayerID pid)
 {
     if (std::exchange(players_[pid].is_eliminated_, true) == false) {
@@ -606,21 +848,51 @@ void Match::OnGameOver_()
             sender << "\n\n游戏结果不记录：因为未连接数据库";
         } else if (multiple_ == 0) {
             sender << "\n\n游戏结果不记录：因为该游戏为试玩游戏";
-        } else if (const auto score_info =
-                    bot_.db_manager()->RecordMatch(game_handle_.name_, gid_, host_uid_, multiple_, user_game_scores,
-                        user_achievements);
-                score_info.empty()) {
-            sender << "\n\n[错误] 游戏结果写入数据库失败，请联系管理员";
-            MatchLog(ErrorLog()) << "Save database failed";
         } else {
-            assert(score_info.size() == users_.size());
-            sender << "\n\n游戏结果写入数据库成功：";
-            for (const auto& info : score_info) {
-                sender << "\n" << At(info.uid_) << "：" << show_score("零和", info.zero_sum_score_)
-                                                        << show_score("头名", info.top_score_)
-                                                        << show_score("等级", info.level_score_);
-
+            sender << "\n\n游戏结果正在写入数据库";
+            std::vector<UserID> uids;
+            if (!gid_.has_value()) {
+                for (const auto& [uid, _] : users_) {
+                    uids.emplace_back(uid);
+                }
             }
+            // The match may have been terminated when the result is written, so we cannot boardcast by the match.
+            bot_.match_recorder()->Record(
+                    MatchRecord{
+                        .game_name_ = game_handle_.name_,
+                        .gid_ = gid_,
+                        .host_uid_ = host_uid_,
+                        .multiple_ = multiple_,
+                        .game_score_infos_ = user_game_scores,
+                        .achievements_ = user_achievements,
+                    },
+                    [gid = gid_, uids = std::move(uids), user_num = users_.size()](std::vector<ScoreInfo> score_info)
+                    {
+                        const auto send_result = [&](MsgSenderBase& sender)
+                            {
+                                if (score_info.empty()) {
+                                    sender() << "[错误] 游戏结果写入数据库失败，请联系管理员";
+                                    return;
+                                }
+                                assert(score_info.size() == user_num);
+                                auto guard = sender();
+                                guard << "游戏结果写入数据库成功：";
+                                for (const auto& info : score_info) {
+                                    guard << "\n" << At(info.uid_) << "：" << show_score("零和", info.zero_sum_score_)
+                                                                           << show_score("头名", info.top_score_)
+                                                                           << show_score("等级", info.level_score_);
+                                }
+                            };
+                        if (gid.has_value()) {
+                            MsgSender sender(*gid);
+                            send_result(sender);
+                        } else {
+                            for (const auto& uid : uids) {
+                                MsgSender sender(uid);
+                                send_result(sender);
+                            }
+                        }
+                    });
         }
     }
     if (!user_achievements.empty()) {
@@ -674,7 +946,12 @@ void Match::Routine_()
     uint64_t ok_count = 0;
     for (uint64_t i = 0; !main_stage_->IsOver() && ok_count < computer_num; i = (i + 1) % computer_num) {
         const auto pid = user_controlled_num + i;
-        if (players_[pid].is_eliminated_ || StageErrCode::OK == main_stage_->HandleComputerAct(pid, false)) {
+        if (players_[pid].is_eliminated_) {
+            ++ok_count;
+            continue;
+        }
+        const LatencyScope latency_scope(computer_act_histogram_);
+        if (StageErrCode::OK == main_stage_->HandleComputerAct(pid, false)) {
             ++ok_count;
         } else {
             ok_count = 0;
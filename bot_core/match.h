@@ -10,12 +10,15 @@
 #include <set>
 #include <bitset>
 #include <variant>
+#include <condition_variable>
 
 #include "utility/msg_checker.h"
+#include "utility/checkpoint.h"
 
 #include "bot_core/match_base.h"
 #include "bot_core/msg_sender.h"
 #include "bot_core/timer.h"
+#include "bot_core/metrics.h"
 #include "bot_core/game_handle.h"
 #include "bot_core/bot_ctx.h"
 #include "bot_core/db_manager.h"
@@ -91,6 +94,7 @@ class Match : public MatchBase, public std::enable_shared_from_this<Match>
     MsgSenderBase::MsgSenderGuard Tell(const PlayerID pid) { return TellMsgSender(pid)(); }
     virtual void StartTimer(const uint64_t sec, void* p, void(*cb)(void*, uint64_t)) override;
     virtual void StopTimer() override;
+    virtual void RunComputerTask(void* p, void(*task)(void*)) override;
     virtual void Eliminate(const PlayerID pid) override;
     virtual bool IsInDeduction() const override { return is_in_deduction_; }
     virtual uint64_t MatchId() const override { return mid_; }
@@ -106,6 +110,17 @@ class Match : public MatchBase, public std::enable_shared_from_this<Match>
 
     ErrCode Terminate(const bool is_force);
 
+    // Serialize the started match, so that it can be resumed by Restore after the bot restarts. The requests handled
+    // after the checkpoint are lost. Return false if the match is not started or the game does not support checkpoints.
+    bool Checkpoint(CheckpointWriter& writer) const;
+
+    // Restore the match serialized by Checkpoint and bind it to the match manager.
+    // Return: the restored match, or nullptr if failed
+    static std::shared_ptr<Match> Restore(BotCtx& bot, CheckpointReader& reader);
+
+    // Stop the timer and unbind the checkpointed match silently before the bot is released.
+    void Suspend();
+
     const GameHandle& game_handle() const { return game_handle_; }
     std::optional<GroupID> gid() const { return gid_; }
     UserID host_uid() const { return host_uid_; }
@@ -118,6 +133,9 @@ class Match : public MatchBase, public std::enable_shared_from_this<Match>
 
    private:
     ErrCode CheckMultipleAllowed_(const UserID uid, MsgSenderBase& reply, const uint32_t multiple) const;
+    void SetUpOptions_(const uint64_t player_num);
+    bool Restore_(CheckpointReader& reader);
+    bool BindRestored_();
 
     template <typename Logger>
     Logger& MatchLog(Logger&& logger) const
@@ -170,6 +188,11 @@ class Match : public MatchBase, public std::enable_shared_from_this<Match>
     // time info
     std::shared_ptr<bool> timer_is_over_; // must before match because atom stage will call StopTimer
     std::unique_ptr<Timer> timer_;
+
+    // The computer tasks run in the background, and they are waited for before the game is released.
+    std::mutex computer_task_mutex_;
+    std::condition_variable computer_task_cv_;
+    uint64_t computer_task_num_ = 0;
     //std::chrono::time_point<std::chrono::system_clock> start_time_;
     //std::chrono::time_point<std::chrono::system_clock> end_time_;
 
@@ -198,6 +221,10 @@ class Match : public MatchBase, public std::enable_shared_from_this<Match>
 
     const Command<void(MsgSenderBase&)> help_cmd_;
 
+    // metrics, shared by the matches of the same game
+    Histogram& request_histogram_;
+    Histogram& computer_act_histogram_;
+
 #ifdef TEST_BOT
   public:
     std::mutex before_handle_timeout_mutex_;
@@ -21,6 +21,9 @@ class MatchBase
     virtual const char* PlayerAvatar(const PlayerID& pid, const int32_t size) = 0;
     virtual void StartTimer(const uint64_t sec, void* p, void(*cb)(void*, uint64_t)) = 0;
     virtual void StopTimer() = 0;
+    // Run |task| with |p| without holding the lock of the match, and then let the computers act again. It is used when
+    // computing the action of a computer takes a long time. The match may also run |task| at once in the caller's thread.
+    virtual void RunComputerTask(void* p, void(*task)(void*)) = 0;
     virtual void Eliminate(const PlayerID pid) = 0;
     virtual bool IsInDeduction() const = 0;
     virtual uint64_t MatchId() const = 0;
@@ -5,53 +5,134 @@
 #include "bot_core/match_manager.h"
 
 #include <cassert>
+#include <fstream>
+#include <sstream>
 
 #include "bot_core/msg_sender.h"
 #include "bot_core/match.h"
+#include "utility/checkpoint.h"
+#include "utility/log.h"
 
 std::pair<ErrCode, std::shared_ptr<Match>> MatchManager::NewMatch(GameHandle& game_handle, const UserID uid, const std::optional<GroupID> gid,
                                MsgSenderBase& reply)
 {
-    std::lock_guard<std::mutex> l(mutex_);
-    if (GetMatch_(uid)) {
-        reply() << "[错误] 建立失败：您已加入游戏";
-        return {EC_MATCH_USER_ALREADY_IN_MATCH, nullptr};
+    const auto user_already_in_match = [&]() -> std::pair<ErrCode, std::shared_ptr<Match>>
+        {
+            reply() << "[错误] 建立失败：您已加入游戏";
+            return {EC_MATCH_USER_ALREADY_IN_MATCH, nullptr};
+        };
+    const auto group_already_has_match = [&]() -> std::pair<ErrCode, std::shared_ptr<Match>>
+        {
+            // We has tried terminating the game outside this funciton.
+            // This case may happen when another user creates a new match after terminating.
+            reply() << "[错误] 建立失败：该房间已经开始游戏";
+            return {EC_MATCH_ALREADY_BEGIN, nullptr};
+        };
+    std::lock_guard<std::mutex> l(new_match_mutex_);
+    if (GetMatch(uid)) {
+        return user_already_in_match();
     }
-    if (gid.has_value() && GetMatch_(*gid)) {
-        // We has tried terminating the game outside this funciton.
-        // This case may happen when another user creates a new match after terminating.
-        reply() << "[错误] 建立失败：该房间已经开始游戏";
-        return {EC_MATCH_ALREADY_BEGIN, nullptr};
+    if (gid.has_value() && GetMatch(*gid)) {
+        return group_already_has_match();
     }
     const MatchID mid = NewMatchID_();
     const auto new_match = std::make_shared<Match>(bot_, mid, game_handle, uid, gid);
-    BindMatch_(mid, new_match);
-    BindMatch_(uid, new_match);
-    if (gid.has_value()) {
-        BindMatch_(*gid, new_match);
+    // the user may join another match after checking, so the binding may still fail
+    if (!BindMatch(uid, new_match)) {
+        return user_already_in_match();
     }
+    if (gid.has_value() && !BindMatch(*gid, new_match)) {
+        UnbindMatch(uid);
+        return group_already_has_match();
+    }
+    BindMatch(mid, new_match);
     return {EC_OK, new_match};
 }
 
 std::vector<std::shared_ptr<Match>> MatchManager::Matches() const
 {
-    std::lock_guard<std::mutex> l(mutex_);
     std::vector<std::shared_ptr<Match>> matches;
-    for (const auto& [_, match] : id2match<MatchID>()) {
-        matches.emplace_back(match);
-    }
+    index<MatchID>().Foreach([&](const std::shared_ptr<Match>& match) { matches.emplace_back(match); });
     return matches;
 }
 
 MatchID MatchManager::NewMatchID_()
 {
-    const auto& mid2match = id2match<MatchID>();
-    while (mid2match.find(++next_mid_) != mid2match.end())
+    while (GetMatch(++next_mid_))
         ;
     return next_mid_;
 }
 
 bool MatchManager::HasMatch() const
 {
-    return std::apply([&](const auto& ...id2match) { return (!id2match.empty() || ...); }, id2match_);
+    return std::apply([&](const auto& ...index) { return (!index.Empty() || ...); }, indexes_);
+}
+
+std::optional<std::vector<std::shared_ptr<Match>>> MatchManager::Checkpoint(const std::filesystem::path& path) const
+{
+    std::vector<std::shared_ptr<Match>> checkpointed_matches;
+    std::vector<std::string> checkpoints;
+    for (const auto& match : Matches()) {
+        if (match->state() != Match::State::IS_STARTED) {
+            continue;
+        }
+        CheckpointWriter writer;
+        if (match->Checkpoint(writer)) {
+            checkpointed_matches.emplace_back(match);
+            checkpoints.emplace_back(writer.Str());
+        } else if (match->state() == Match::State::IS_STARTED) {
+            InfoLog() << "Checkpoint matches failed because the match cannot be checkpointed mid=" << match->MatchId();
+            return std::nullopt;
+        }
+    }
+    if (checkpoints.empty()) {
+        return checkpointed_matches;
+    }
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+        f << CheckpointWriter().Write(checkpoints).Str();
+        if (!f) {
+            ErrorLog() << "Checkpoint matches failed because the file cannot be written path=" << tmp_path.string();
+            return std::nullopt;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        ErrorLog() << "Checkpoint matches failed because the file cannot be renamed path=" << path.string()
+                   << " error=" << ec.message();
+        return std::nullopt;
+    }
+    InfoLog() << "Checkpoint matches succeed num=" << checkpoints.size() << " path=" << path.string();
+    return checkpointed_matches;
+}
+
+uint64_t MatchManager::Restore(const std::filesystem::path& path)
+{
+    if (std::error_code ec; !std::filesystem::exists(path, ec)) {
+        return 0;
+    }
+    std::stringstream ss;
+    ss << std::ifstream(path, std::ios::binary).rdbuf();
+    std::filesystem::remove(path);
+    const std::string content = ss.str();
+    CheckpointReader reader(content);
+    std::vector<std::string> checkpoints;
+    if (!reader.Read(checkpoints) || !reader.IsEnd()) {
+        ErrorLog() << "Restore matches failed because the checkpoint file is broken path=" << path.string();
+        return 0;
+    }
+    std::lock_guard<std::mutex> l(new_match_mutex_);
+    uint64_t restored_num = 0;
+    for (const auto& checkpoint : checkpoints) {
+        CheckpointReader match_reader(checkpoint);
+        if (const auto match = Match::Restore(bot_, match_reader)) {
+            next_mid_ = std::max<uint64_t>(next_mid_, match->MatchId());
+            ++restored_num;
+        }
+    }
+    InfoLog() << "Restore matches finish restored_num=" << restored_num << " checkpoint_num=" << checkpoints.size();
+    return restored_num;
 }
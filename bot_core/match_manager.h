@@ -11,7 +11,11 @@
 #include <functional>
 #include <variant>
 #include <mutex>
+#include <shared_mutex>
 #include <atomic>
+#include <array>
+#include <algorithm>
+#include <filesystem>
 
 #include "bot_core/bot_core.h"
 
@@ -19,6 +23,80 @@ class Match;
 class BotCtx;
 class MsgSenderBase;
 
+// The matches indexed by one kind of id. The ids are distributed into shards by their hash values, and each shard is
+// protected by its own shared mutex, so that looking up matches does not block each other, and binding a match only
+// blocks the lookups of the ids in the same shard.
+template <typename IdType>
+class MatchIndex
+{
+  public:
+    static constexpr uint32_t k_shard_num = 16;
+
+    std::shared_ptr<Match> Get(const IdType& id) const
+    {
+        const auto& shard = Shard_(id);
+        std::shared_lock<std::shared_mutex> l(shard.mutex_);
+        const auto it = shard.id2match_.find(id);
+        return (it == shard.id2match_.end()) ? nullptr : it->second;
+    }
+
+    // Returns false if the id has been bound to a match.
+    bool Bind(const IdType& id, std::shared_ptr<Match> match)
+    {
+        auto& shard = Shard_(id);
+        std::lock_guard<std::shared_mutex> l(shard.mutex_);
+        return shard.id2match_.emplace(id, std::move(match)).second;
+    }
+
+    void Unbind(const IdType& id)
+    {
+        auto& shard = Shard_(id);
+        std::lock_guard<std::shared_mutex> l(shard.mutex_);
+        shard.id2match_.erase(id);
+    }
+
+    template <typename Fn>
+    void Foreach(const Fn& fn) const
+    {
+        for (const auto& shard : shards_) {
+            std::shared_lock<std::shared_mutex> l(shard.mutex_);
+            for (const auto& [_, match] : shard.id2match_) {
+                fn(match);
+            }
+        }
+    }
+
+    bool Empty() const
+    {
+        return std::ranges::all_of(shards_, [](const auto& shard)
+                {
+                    std::shared_lock<std::shared_mutex> l(shard.mutex_);
+                    return shard.id2match_.empty();
+                });
+    }
+
+  private:
+    struct Shard
+    {
+        mutable std::shared_mutex mutex_;
+        std::map<IdType, std::shared_ptr<Match>> id2match_;
+    };
+
+    static uint64_t Hash_(const IdType& id)
+    {
+        if constexpr (std::is_same_v<IdType, MatchID>) {
+            return id.Get();
+        } else {
+            return std::hash<std::string>{}(id.GetStr());
+        }
+    }
+
+    Shard& Shard_(const IdType& id) { return shards_[Hash_(id) % k_shard_num]; }
+    const Shard& Shard_(const IdType& id) const { return shards_[Hash_(id) % k_shard_num]; }
+
+    std::array<Shard, k_shard_num> shards_;
+};
+
 class MatchManager
 {
    public:
@@ -28,10 +106,9 @@ class MatchManager
                      MsgSenderBase& reply);
 
     template <typename IdType>
-    std::shared_ptr<Match> GetMatch(const IdType id)
+    std::shared_ptr<Match> GetMatch(const IdType id) const
     {
-        std::lock_guard<std::mutex> l(mutex_);
-        return GetMatch_(id);
+        return index<IdType>().Get(id);
     }
 
     std::vector<std::shared_ptr<Match>> Matches() const;
@@ -39,48 +116,34 @@ class MatchManager
     template <typename IdType>
     bool BindMatch(const IdType id, std::shared_ptr<Match> match)
     {
-        std::lock_guard<std::mutex> l(mutex_);
-        return BindMatch_(id, std::move(match));
+        return index<IdType>().Bind(id, std::move(match));
     }
 
     template <typename IdType>
     void UnbindMatch(const IdType id)
     {
-        std::lock_guard<std::mutex> l(mutex_);
-        UnbindMatch_(id);
+        index<IdType>().Unbind(id);
     }
 
     bool HasMatch() const;
 
-   private:
-    void DeleteMatch_(const MatchID id);
+    // Write the started matches into |path|, so that they can be resumed by Restore after the bot restarts.
+    // Return: the checkpointed matches, or std::nullopt without writing if any started match cannot be checkpointed
+    std::optional<std::vector<std::shared_ptr<Match>>> Checkpoint(const std::filesystem::path& path) const;
 
-    template <typename IdType>
-    std::shared_ptr<Match> GetMatch_(const IdType id)
-    {
-        const auto it = id2match<IdType>().find(id);
-        return (it == id2match<IdType>().end()) ? nullptr : it->second;
-    }
-
-    template <typename IdType>
-    bool BindMatch_(const IdType id, std::shared_ptr<Match> match)
-    {
-        return id2match<IdType>().emplace(id, match).second;
-    }
-
-    template <typename IdType>
-    void UnbindMatch_(const IdType id)
-    {
-        id2match<IdType>().erase(id);
-    }
+    // Restore the matches checkpointed in |path|. The file is removed before restoring, so that a match which crashes
+    // the bot is not restored again.
+    // Return: the number of restored matches
+    uint64_t Restore(const std::filesystem::path& path);
 
+   private:
+    // REQUIRE: should be protected by new_match_mutex_
     MatchID NewMatchID_();
 
     BotCtx& bot_;
-    mutable std::mutex mutex_;
-    template <typename IdType> using Id2Map = std::map<IdType, std::shared_ptr<Match>>;
-    std::tuple<Id2Map<UserID>, Id2Map<MatchID>, Id2Map<GroupID>> id2match_;
-    template <typename IdType> Id2Map<IdType>& id2match() { return std::get<Id2Map<IdType>>(id2match_); }
-    template <typename IdType> const Id2Map<IdType>& id2match() const { return std::get<Id2Map<IdType>>(id2match_); }
+    std::mutex new_match_mutex_;
+    std::tuple<MatchIndex<UserID>, MatchIndex<MatchID>, MatchIndex<GroupID>> indexes_;
+    template <typename IdType> MatchIndex<IdType>& index() { return std::get<MatchIndex<IdType>>(indexes_); }
+    template <typename IdType> const MatchIndex<IdType>& index() const { return std::get<MatchIndex<IdType>>(indexes_); }
     MatchID next_mid_;
 };
@@ -0,0 +1,329 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include "bot_core/match_recorder.h"
+
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "utility/log.h"
+
+// The journal is a text file with one entry each line, and the fields are split by tabs:
+//   R <seq> <record_id> <game_name> <gid> <host_uid> <multiple> <user_num> (<uid> <game_score>)... <achievement_num> (<uid> <achievement_name>)...
+//   C <seq>
+// An R entry is a queued record, whose gid is empty if the match is not in a group. A C entry means all the records whose
+// seq are not larger than it have been written. The C entries are not synced to the disk, because the records are
+// skipped by their ids if they are written again.
+//
+// A record failed to be written (e.g. the database is busy or the disk is full) is kept in the journal, so no more C
+// entries are appended after it, and it is recorded again with the following records when the bot restarts.
+
+static std::string Escape(const std::string_view& s)
+{
+    std::string ret;
+    for (const char c : s) {
+        if (c == '\\') {
+            ret += "\\\\";
+        } else if (c == '\t') {
+            ret += "\\t";
+        } else if (c == '\n') {
+            ret += "\\n";
+        } else {
+            ret += c;
+        }
+    }
+    return ret;
+}
+
+static std::vector<std::string> SplitAndUnescape(const std::string& line)
+{
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < line.size(); ++i) {
+        if (line[i] == '\t') {
+            fields.emplace_back();
+        } else if (line[i] == '\\' && i + 1 < line.size()) {
+            const char c = line[++i];
+            fields.back() += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+        } else {
+            fields.back() += line[i];
+        }
+    }
+    return fields;
+}
+
+static std::optional<std::pair<uint64_t, MatchRecord>> ParseRecord(const std::vector<std::string>& fields)
+{
+    try {
+        if (fields.size() < 8) {
+            return std::nullopt;
+        }
+        std::pair<uint64_t, MatchRecord> ret;
+        auto& [seq, record] = ret;
+        seq = std::stoull(fields[1]);
+        record.record_id_ = fields[2];
+        record.game_name_ = fields[3];
+        if (!fields[4].empty()) {
+            record.gid_ = fields[4];
+        }
+        record.host_uid_ = fields[5];
+        record.multiple_ = std::stoull(fields[6]);
+        size_t i = 7;
+        const uint64_t user_num = std::stoull(fields[i++]);
+        for (uint64_t j = 0; j < user_num && i + 1 < fields.size(); ++j, i += 2) {
+            record.game_score_infos_.emplace_back(fields[i], std::stoll(fields[i + 1]));
+        }
+        if (record.game_score_infos_.size() != user_num || i >= fields.size()) {
+            return std::nullopt;
+        }
+        const uint64_t achievement_num = std::stoull(fields[i++]);
+        for (uint64_t j = 0; j < achievement_num && i + 1 < fields.size(); ++j, i += 2) {
+            record.achievements_.emplace_back(fields[i], fields[i + 1]);
+        }
+        if (record.achievements_.size() != achievement_num) {
+            return std::nullopt;
+        }
+        return ret;
+    } catch (const std::exception& e) {
+        return std::nullopt;
+    }
+}
+
+static bool SyncFile(FILE* const f)
+{
+    if (fflush(f) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+MatchRecorder::MatchRecorder(DBManagerBase& db_manager, std::filesystem::path journal_path)
+    : db_manager_(db_manager)
+    , journal_path_(std::move(journal_path))
+    , record_id_prefix_(NewRecordIdPrefix_())
+    , journal_(nullptr)
+    , next_seq_(1)
+    , is_recording_(false)
+    , has_failed_records_(false)
+    , stop_(false)
+{
+    if (!journal_path_.empty()) {
+        // Rewrite the journal with the unwritten records, and replace the old one, so that the records are not lost even
+        // if the bot crashes now. The records keep their ids, so they are not duplicated if they have been written.
+        const auto tmp_path = std::filesystem::path(journal_path_) += ".tmp";
+        auto records = LoadJournal_(journal_path_);
+        OpenJournal_(tmp_path, "wb");
+        for (auto& record : records) {
+            InfoLog() << "Recover match record from journal game=" << record.game_name_
+                      << " user_num=" << record.game_score_infos_.size() << " record_id=" << record.record_id_;
+            const uint64_t seq = next_seq_++;
+            AppendJournal_(seq, record);
+            tasks_.emplace_back(seq, std::move(record), nullptr);
+        }
+        CloseJournal_();
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, journal_path_, ec);
+        if (ec) {
+            ErrorLog() << "Replace match record journal failed path=" << journal_path_ << " error=" << ec.message();
+        }
+        OpenJournal_(journal_path_, "ab");
+    }
+    thread_ = std::thread([this] { Routine_(); });
+}
+
+MatchRecorder::~MatchRecorder()
+{
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    CloseJournal_();
+}
+
+void MatchRecorder::Record(MatchRecord record, Callback callback)
+{
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        const uint64_t seq = next_seq_++;
+        if (journal_) {
+            record.record_id_ = record_id_prefix_ + std::to_string(seq);
+            AppendJournal_(seq, record);
+            if (!SyncFile(journal_)) {
+                ErrorLog() << "Sync match record journal failed path=" << journal_path_;
+            }
+        }
+        tasks_.emplace_back(seq, std::move(record), std::move(callback));
+    }
+    cv_.notify_one();
+}
+
+void MatchRecorder::WaitIdle()
+{
+    std::unique_lock<std::mutex> l(mutex_);
+    idle_cv_.wait(l, [this] { return tasks_.empty() && !is_recording_; });
+}
+
+uint64_t MatchRecorder::PendingNum() const
+{
+    std::lock_guard<std::mutex> l(mutex_);
+    return tasks_.size();
+}
+
+std::vector<MatchRecord> MatchRecorder::LoadJournal_(const std::filesystem::path& journal_path)
+{
+    std::map<uint64_t, MatchRecord> records;
+    std::ifstream f(journal_path);
+    for (std::string line; std::getline(f, line); ) {
+        const auto fields = SplitAndUnescape(line);
+        if (fields[0] == "R") {
+            if (auto ret = ParseRecord(fields)) {
+                records.emplace(std::move(*ret));
+            } else {
+                // the last line may be incomplete if the bot crashed when writing it
+                ErrorLog() << "Invalid match record in journal: " << line;
+            }
+        } else if (uint64_t seq = 0; fields[0] == "C" && fields.size() == 2 &&
+                std::from_chars(fields[1].data(), fields[1].data() + fields[1].size(), seq).ec == std::errc()) {
+            records.erase(records.begin(), records.upper_bound(seq));
+        }
+    }
+    std::vector<MatchRecord> ret;
+    for (auto& [_, record] : records) {
+        ret.emplace_back(std::move(record));
+    }
+    return ret;
+}
+
+std::string MatchRecorder::NewRecordIdPrefix_()
+{
+    std::random_device rd;
+    const uint64_t nonce = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^
+        static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%016llx-", static_cast<unsigned long long>(nonce));
+    return buf;
+}
+
+bool MatchRecorder::OpenJournal_(const std::filesystem::path& path, const char* const mode)
+{
+    journal_ = fopen(path.string().c_str(), mode);
+    if (!journal_) {
+        ErrorLog() << "Open match record journal failed path=" << path;
+        return false;
+    }
+    return true;
+}
+
+void MatchRecorder::CloseJournal_()
+{
+    if (!journal_) {
+        return;
+    }
+    if (!SyncFile(journal_)) {
+        ErrorLog() << "Sync match record journal failed path=" << journal_path_;
+    }
+    fclose(journal_);
+    journal_ = nullptr;
+}
+
+void MatchRecorder::AppendJournal_(const uint64_t seq, const MatchRecord& record)
+{
+    if (!journal_) {
+        return;
+    }
+    std::ostringstream ss;
+    ss << "R\t" << seq << "\t" << Escape(record.record_id_) << "\t" << Escape(record.game_name_) << "\t"
+       << (record.gid_.has_value() ? Escape(record.gid_->GetStr()) : "") << "\t"
+       << Escape(record.host_uid_.GetStr()) << "\t" << record.multiple_ << "\t"
+       << record.game_score_infos_.size();
+    for (const auto& [uid, game_score] : record.game_score_infos_) {
+        ss << "\t" << Escape(uid.GetStr()) << "\t" << game_score;
+    }
+    ss << "\t" << record.achievements_.size();
+    for (const auto& [uid, achievement_name] : record.achievements_) {
+        ss << "\t" << Escape(uid.GetStr()) << "\t" << Escape(achievement_name);
+    }
+    ss << "\n";
+    const std::string line = ss.str();
+    fwrite(line.data(), 1, line.size(), journal_);
+}
+
+void MatchRecorder::CommitJournal_(const uint64_t seq)
+{
+    if (!journal_) {
+        return;
+    }
+    if (tasks_.empty() && seq + 1 == next_seq_) {
+        // all records have been written, so the journal can be cleared
+        fclose(journal_);
+        OpenJournal_(journal_path_, "wb");
+    } else {
+        fprintf(journal_, "C\t%llu\n", static_cast<unsigned long long>(seq));
+        fflush(journal_);
+    }
+}
+
+void MatchRecorder::Routine_()
+{
+    std::unique_lock<std::mutex> l(mutex_);
+    while (true) {
+        cv_.wait(l, [this] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+            break; // is stopped and all records have been written
+        }
+        std::vector<Task> batch;
+        while (!tasks_.empty() && batch.size() < k_max_batch_size) {
+            batch.emplace_back(std::move(tasks_.front()));
+            tasks_.pop_front();
+        }
+        is_recording_ = true;
+        l.unlock();
+
+        std::vector<MatchRecord> records;
+        for (auto& task : batch) {
+            records.emplace_back(std::move(task.record_));
+        }
+        auto score_infos = db_manager_.RecordMatches(records);
+        score_infos.resize(batch.size());
+        InfoLog() << "Record matches finished size=" << batch.size();
+        size_t committed_num = 0; // the records before the first failed one
+        for (size_t i = 0; i < batch.size(); ++i) {
+            // the score infos of a record without users are always empty
+            if (score_infos[i].empty() && !records[i].game_score_infos_.empty()) {
+                ErrorLog() << "Record match failed, keep it in the journal game=" << records[i].game_name_
+                           << " record_id=" << records[i].record_id_;
+            } else if (committed_num == i) {
+                ++committed_num;
+            }
+            if (batch[i].callback_) {
+                batch[i].callback_(std::move(score_infos[i]));
+            }
+        }
+
+        l.lock();
+        is_recording_ = false;
+        if (!has_failed_records_ && committed_num > 0) {
+            CommitJournal_(batch[committed_num - 1].seq_);
+        }
+        has_failed_records_ = has_failed_records_ || committed_num < batch.size();
+        if (tasks_.empty()) {
+            idle_cv_.notify_all();
+        }
+    }
+}
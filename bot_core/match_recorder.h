@@ -0,0 +1,93 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "bot_core/db_manager.h"
+
+// Records the results of matches on a dedicated thread, so that a match does not wait for the database when it is over.
+// The records queued at the same time are written in one transaction.
+//
+// Each record is appended to the journal file and synced to the disk before it is queued, and the journal is cleared when
+// all the queued records are written. The records left in the journal are recorded again when the recorder is
+// constructed, so the results are not lost if the bot crashes before they are written.
+//
+// Each record has a unique id, which is written to the database in the same transaction as the record. The records
+// whose ids have been written are skipped when they are recorded again, so the results are not duplicated if the bot
+// crashes after the records are written but before the journal is cleared. The records failed to be written are also
+// left in the journal and recorded again when the bot restarts.
+class MatchRecorder
+{
+  public:
+    // Called on the recorder thread with the score infos, which is empty if the record failed.
+    using Callback = std::function<void(std::vector<ScoreInfo>)>;
+
+    static constexpr uint64_t k_max_batch_size = 64;
+
+    // |journal_path| can be empty, then the records are only kept in memory.
+    MatchRecorder(DBManagerBase& db_manager, std::filesystem::path journal_path);
+
+    MatchRecorder(const MatchRecorder&) = delete;
+    MatchRecorder(MatchRecorder&&) = delete;
+
+    // The queued records are written before the recorder is destructed.
+    ~MatchRecorder();
+
+    // The record is in the journal when it returns, so the match can tell the players that the result is being written.
+    void Record(MatchRecord record, Callback callback);
+
+    // Block until all the queued records are written and their callbacks are called.
+    void WaitIdle();
+
+    uint64_t PendingNum() const;
+
+  private:
+    struct Task
+    {
+        uint64_t seq_;
+        MatchRecord record_;
+        Callback callback_;
+    };
+
+    static std::vector<MatchRecord> LoadJournal_(const std::filesystem::path& journal_path);
+
+    static std::string NewRecordIdPrefix_();
+
+    // REQUIRE: should be protected by mutex_
+    bool OpenJournal_(const std::filesystem::path& path, const char* const mode);
+
+    // REQUIRE: should be protected by mutex_
+    void CloseJournal_();
+
+    // REQUIRE: should be protected by mutex_
+    void AppendJournal_(const uint64_t seq, const MatchRecord& record);
+
+    // REQUIRE: should be protected by mutex_
+    void CommitJournal_(const uint64_t seq);
+
+    void Routine_();
+
+    DBManagerBase& db_manager_;
+    const std::filesystem::path journal_path_;
+    const std::string record_id_prefix_; // unique for each recorder
+    FILE* journal_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable idle_cv_;
+    std::deque<Task> tasks_;
+    uint64_t next_seq_;
+    bool is_recording_;
+    bool has_failed_records_; // the failed records are left in the journal until the bot restarts
+    bool stop_;
+    std::thread thread_; /* make sure thread_ is inited last */
+};
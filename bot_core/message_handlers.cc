@@ -15,7 +15,9 @@
 #include "bot_core/db_manager.h"
 #include "bot_core/match.h"
 #include "bot_core/image.h"
+#include "bot_core/metrics.h"
 #include "bot_core/options.h"
+#include "bot_core/user_identity_cache.h"
 
 // para func can appear only once
 #define RETURN_IF_FAILED(func)                                 \
@@ -53,6 +55,8 @@ struct ShowCommandOption
 
 extern const std::vector<MetaCommandGroup> meta_cmds;
 extern const std::vector<MetaCommandGroup> admin_cmds;
+extern const MetaCommandIndex meta_cmd_index;
+extern const MetaCommandIndex admin_cmd_index;
 
 static ErrCode help_internal(BotCtx& bot, MsgSenderBase& reply, const std::vector<MetaCommandGroup>& cmd_groups,
         const ShowCommandOption& option, const std::string& type_name)
@@ -82,37 +86,38 @@ static ErrCode help(BotCtx& bot, const UserID uid, const std::optional<GroupID>
             IS_ADMIN ? "管理" : "元");
 }
 
-ErrCode HandleRequest(BotCtx& bot, const UserID uid, const std::optional<GroupID>& gid, MsgReader& reader,
-                      MsgSenderBase& reply, const std::vector<MetaCommandGroup>& cmd_groups)
+static MetaCommandIndex make_command_index(const std::vector<MetaCommandGroup>& cmd_groups)
 {
-    reader.Reset();
+    MetaCommandIndex cmd_index;
     for (const MetaCommandGroup& cmd_group : cmd_groups) {
         for (const MetaCommand& cmd : cmd_group.desc_) {
-            const std::optional<ErrCode> errcode = cmd.CallIfValid(reader, bot, uid, gid, reply);
-            if (errcode.has_value()) {
-                return *errcode;
-            }
+            cmd_index.Add(cmd);
         }
     }
-    return EC_REQUEST_NOT_FOUND;
+    return cmd_index;
+}
+
+ErrCode HandleRequest(BotCtx& bot, const UserID uid, const std::optional<GroupID>& gid, MsgReader& reader,
+                      MsgSenderBase& reply, const MetaCommandIndex& cmd_index)
+{
+    const std::optional<ErrCode> errcode = cmd_index.CallIfValid(reader, bot, uid, gid, reply);
+    return errcode.has_value() ? *errcode : EC_REQUEST_NOT_FOUND;
 }
 
-ErrCode HandleMetaRequest(BotCtx& bot, const UserID uid, const std::optional<GroupID>& gid, const std::string& msg,
+ErrCode HandleMetaRequest(BotCtx& bot, const UserID uid, const std::optional<GroupID>& gid, MsgReader& reader,
                           MsgSenderBase& reply)
 {
-    MsgReader reader(msg);
-    const auto ret = HandleRequest(bot, uid, gid, reader, reply, meta_cmds);
+    const auto ret = HandleRequest(bot, uid, gid, reader, reply, meta_cmd_index);
     if (ret == EC_REQUEST_NOT_FOUND) {
         reply() << "[错误] 未预料的元指令，您可以通过「#帮助」查看所有支持的元指令";
     }
     return ret;
 }
 
-ErrCode HandleAdminRequest(BotCtx& bot, const UserID uid, const std::optional<GroupID>& gid, const std::string& msg,
+ErrCode HandleAdminRequest(BotCtx& bot, const UserID uid, const std::optional<GroupID>& gid, MsgReader& reader,
                            MsgSenderBase& reply)
 {
-    MsgReader reader(msg);
-    const auto ret = HandleRequest(bot, uid, gid, reader, reply, admin_cmds);
+    const auto ret = HandleRequest(bot, uid, gid, reader, reply, admin_cmd_index);
     if (ret == EC_REQUEST_NOT_FOUND) {
         reply() << "[错误] 未预料的管理指令，您可以通过「%帮助」查看所有支持的管理指令";
     }
@@ -170,6 +175,12 @@ static ErrCode new_game(BotCtx& bot, const UserID uid, const std::optional<Group
         reply() << "[错误] 创建失败：未知的游戏名，请通过「#游戏列表」查看游戏名称";
         return EC_REQUEST_UNKNOWN_GAME;
     }
+    // hold the module so that it is not unloaded before the match is created
+    const auto module = it->second->LoadModule();
+    if (!module) {
+        reply() << "[错误] 创建失败：游戏模块载入失败，请联系管理员";
+        return EC_REQUEST_GAME_LOAD_FAILED;
+    }
     if (gid.has_value()) {
         const auto running_match = bot.match_manager().GetMatch(*gid);
         ErrCode rc = EC_OK;
@@ -405,7 +416,7 @@ static ErrCode show_profile(BotCtx& bot, const UserID uid, const std::optional<G
         return EC_DB_NOT_CONNECTED;
     }
     const auto profile = bot.db_manager()->GetUserProfile(uid,
-            k_time_range_begin_datetimes[time_range.ToUInt()], k_time_range_end_datetimes[time_range.ToUInt()]);  // TODO: pass sender
+            TimeRangeBeginDatetime(time_range), TimeRangeEndDatetime(time_range));  // TODO: pass sender
 
     const auto colored_text = [](const auto score, std::string text)
         {
@@ -422,8 +433,8 @@ static ErrCode show_profile(BotCtx& bot, const UserID uid, const std::optional<G
             return s;
         };
 
-    std::string html = std::string("## ") + GetUserAvatar(uid.GetCStr(), 40) + HTML_ESCAPE_SPACE HTML_ESCAPE_SPACE +
-        GetUserName(uid.GetCStr(), gid.has_value() ? gid->GetCStr() : nullptr) + "\n";
+    std::string html = std::string("## ") + UserIdentityCache::Get().UserAvatar(uid, 40) +
+        HTML_ESCAPE_SPACE HTML_ESCAPE_SPACE + UserIdentityCache::Get().UserName(uid, gid) + "\n";
 
     html += "\n- **注册时间**：" + (profile.birth_time_.empty() ? "无" : profile.birth_time_) + "\n";
 
@@ -606,17 +617,27 @@ static ErrCode clear_profile(BotCtx& bot, const UserID uid, const std::optional<
         reply() << "[错误] 重来失败：清除战绩，需最近三局比赛均取得正零和分的收益";
         return EC_USER_SUICIDE_FAILED;
     }
-    reply() << GetUserName(uid.GetCStr(), gid.has_value() ? gid->GetCStr() : nullptr) << "，凋零！";
+    reply() << UserIdentityCache::Get().UserName(uid, gid) << "，凋零！";
     return EC_OK;
 }
 
+template <typename V>
+static void prefetch_users(const V& vec, const std::optional<GroupID> gid, const std::vector<int32_t>& avatar_sizes)
+{
+    std::vector<UserID> uids;
+    for (const auto& [uid, _] : vec) {
+        uids.emplace_back(uid);
+    }
+    UserIdentityCache::Get().Prefetch(uids, gid, avatar_sizes);
+}
+
 template <typename V>
 static std::string print_score(const V& vec, const std::optional<GroupID> gid, const std::string_view& unit = "分")
 {
+    prefetch_users(vec, gid, {});
     std::string s;
     for (uint64_t i = 0; i < vec.size(); ++i) {
-        s += "\n" + std::to_string(i + 1) + "位：" +
-                GetUserName(vec[i].first.GetCStr(), gid.has_value() ? gid->GetCStr() : nullptr) +
+        s += "\n" + std::to_string(i + 1) + "位：" + UserIdentityCache::Get().UserName(vec[i].first, gid) +
                 "【" + std::to_string(vec[i].second) + " " + unit.data() + "】";
     }
     return s;
@@ -634,13 +655,13 @@ static std::string print_score_in_table(const std::string_view& score_name, cons
     table.Get(1, 0).SetContent("**排名**");
     table.Get(1, 1).SetContent("**用户**");
     table.Get(1, 2).SetContent(std::string("**") + score_name.data() + "**");
+    prefetch_users(vec, gid, {30});
     for (uint64_t i = 0; i < vec.size(); ++i) {
-        const auto uid_cstr = vec[i].first.GetCStr();
+        const auto& uid = vec[i].first;
         table.Get(2 + i, 0).SetContent(std::to_string(i + 1) + " 位");
         table.Get(2 + i, 1).SetContent(
-                "<p align=\"left\">" HTML_ESCAPE_SPACE HTML_ESCAPE_SPACE + GetUserAvatar(uid_cstr, 30) +
-                HTML_ESCAPE_SPACE HTML_ESCAPE_SPACE + GetUserName(uid_cstr, gid.has_value() ? gid->GetCStr() : nullptr) +
-                "</p>");
+                "<p align=\"left\">" HTML_ESCAPE_SPACE HTML_ESCAPE_SPACE + UserIdentityCache::Get().UserAvatar(uid, 30) +
+                HTML_ESCAPE_SPACE HTML_ESCAPE_SPACE + UserIdentityCache::Get().UserName(uid, gid) + "</p>");
         table.Get(2 + i, 2).SetContent(std::to_string(vec[i].second) + " " + unit.data());
     }
     return table.ToString();
@@ -655,7 +676,7 @@ static ErrCode show_rank(BotCtx& bot, const UserID uid, const std::optional<Grou
     std::string s;
     for (const auto time_range : TimeRange::Members()) {
         const auto info = bot.db_manager()->GetRank(
-                k_time_range_begin_datetimes[time_range.ToUInt()], k_time_range_end_datetimes[time_range.ToUInt()]);
+                TimeRangeBeginDatetime(time_range), TimeRangeEndDatetime(time_range));
         s += "\n<h2 align=\"center\">" HTML_COLOR_FONT_HEADER(blue);
         s += time_range.ToString();
         s += HTML_FONT_TAIL "赛季排行</h2>\n";
@@ -678,7 +699,7 @@ static ErrCode show_rank_time_range(BotCtx& bot, const UserID uid, const std::op
         return EC_DB_NOT_CONNECTED;
     }
     const auto info = bot.db_manager()->GetRank(
-            k_time_range_begin_datetimes[time_range.ToUInt()], k_time_range_end_datetimes[time_range.ToUInt()]);
+            TimeRangeBeginDatetime(time_range), TimeRangeEndDatetime(time_range));
     reply() << "## 零和得分排行（" << time_range << "赛季）：\n" << print_score(info.zero_sum_score_rank_, gid);
     reply() << "## 头名得分排行（" << time_range << "赛季）：\n" << print_score(info.top_score_rank_, gid);
     reply() << "## 游戏局数排行（" << time_range << "赛季）：\n" << print_score(info.match_count_rank_, gid, "场");
@@ -699,7 +720,7 @@ static ErrCode show_game_rank(BotCtx& bot, const UserID uid, const std::optional
     std::string s;
     for (const auto time_range : TimeRange::Members()) {
         const auto info = bot.db_manager()->GetLevelScoreRank(game_name,
-                k_time_range_begin_datetimes[time_range.ToUInt()], k_time_range_end_datetimes[time_range.ToUInt()]);
+                TimeRangeBeginDatetime(time_range), TimeRangeEndDatetime(time_range));
         s += "\n<h2 align=\"center\">" HTML_COLOR_FONT_HEADER(blue);
         s += time_range.ToString();
         s += HTML_FONT_TAIL "赛季";
@@ -728,8 +749,8 @@ static ErrCode show_game_rank_range_time(BotCtx& bot, const UserID uid, const st
         reply() << "[错误] 查看失败：未知的游戏名，请通过「#游戏列表」查看游戏名称";
         return EC_REQUEST_UNKNOWN_GAME;
     }
-    const auto info = bot.db_manager()->GetLevelScoreRank(game_name, k_time_range_begin_datetimes[time_range.ToUInt()],
-            k_time_range_end_datetimes[time_range.ToUInt()]);
+    const auto info = bot.db_manager()->GetLevelScoreRank(game_name, TimeRangeBeginDatetime(time_range),
+            TimeRangeEndDatetime(time_range));
     reply() << "## 等级得分排行（" << time_range << "赛季）：\n" << print_score(info.level_score_rank_, gid);
     reply() << "## 加权等级得分排行（" << time_range << "赛季）：\n" << print_score(info.weight_level_score_rank_, gid);
     reply() << "## 游戏局数排行（" << time_range << "赛季）：\n" << print_score(info.match_count_rank_, gid, "场");
@@ -748,11 +769,19 @@ static ErrCode show_honors(BotCtx& bot, const UserID uid, const std::optional<Gr
     table.Get(0, 1).SetContent("**用户**");
     table.Get(0, 2).SetContent("**荣誉**");
     table.Get(0, 3).SetContent("**获得时间**");
-    for (const auto& info : bot.db_manager()->GetHonors()) {
+    const auto honors = bot.db_manager()->GetHonors();
+    {
+        std::vector<UserID> uids;
+        for (const auto& info : honors) {
+            uids.emplace_back(info.uid_);
+        }
+        UserIdentityCache::Get().Prefetch(uids, gid, {25});
+    }
+    for (const auto& info : honors) {
         table.AppendRow();
         table.GetLastRow(0).SetContent(std::to_string(info.id_));
-        table.GetLastRow(1).SetContent(GetUserAvatar(info.uid_.GetCStr(), 25) + HTML_ESCAPE_SPACE HTML_ESCAPE_SPACE +
-                GetUserName(info.uid_.GetCStr(), gid.has_value() ? gid->GetCStr() : nullptr));
+        table.GetLastRow(1).SetContent(UserIdentityCache::Get().UserAvatar(info.uid_, 25) +
+                HTML_ESCAPE_SPACE HTML_ESCAPE_SPACE + UserIdentityCache::Get().UserName(info.uid_, gid));
         table.GetLastRow(2).SetContent(info.description_);
         table.GetLastRow(3).SetContent(info.time_);
     }
@@ -901,6 +930,43 @@ static ErrCode read_all_options(BotCtx& bot, const UserID uid, const std::option
     return EC_OK;
 }
 
+static ErrCode show_request_stat(BotCtx& bot, const UserID uid, const std::optional<GroupID> gid, MsgSenderBase& reply)
+{
+    const auto stat = bot.request_dispatcher().GetStat();
+    const auto avg_us = [&](const std::chrono::microseconds total)
+        {
+            return stat.handled_num_ == 0 ? 0 : total.count() / stat.handled_num_;
+        };
+    reply() << "等待中的请求数：" << stat.pending_num_
+            << "\n处理中的请求数：" << stat.running_num_
+            << "\n已处理的请求数：" << stat.handled_num_
+            << "\n平均等待时间：" << avg_us(stat.total_wait_time_) << "us（最长 " << stat.max_wait_time_.count() << "us）"
+            << "\n平均处理时间：" << avg_us(stat.total_handle_time_) << "us（最长 " << stat.max_handle_time_.count() << "us）";
+    return EC_OK;
+}
+
+static ErrCode show_user_identity_cache_stat(BotCtx& bot, const UserID uid, const std::optional<GroupID> gid,
+        MsgSenderBase& reply)
+{
+    const auto stat = UserIdentityCache::Get().GetStat();
+    reply() << "缓存的用户信息数：" << stat.entry_num_
+            << "\n命中次数（避免的适配器调用）：" << stat.hit_num_
+            << "\n未命中次数（实际的适配器调用）：" << stat.miss_num_;
+    return EC_OK;
+}
+
+static ErrCode show_metrics(BotCtx& bot, const UserID uid, const std::optional<GroupID> gid, MsgSenderBase& reply,
+        const std::string& prefix)
+{
+    const auto snapshot = Metrics::Get().Snapshot(prefix);
+    if (snapshot.empty()) {
+        reply() << "没有以「" << prefix << "」开头的性能指标";
+    } else {
+        reply() << snapshot.substr(0, snapshot.size() - 1); // remove the last line break
+    }
+    return EC_OK;
+}
+
 static ErrCode add_honor(BotCtx& bot, const UserID uid, const std::optional<GroupID> gid, MsgSenderBase& reply,
         const std::string& honor_uid, const std::string honor_desc)
 {
@@ -952,6 +1018,10 @@ const std::vector<MetaCommandGroup> admin_cmds = {
                         OptionalDefaultChecker<BoolChecker>(false, "文字", "图片")),
             make_command("设置配置项（可通过「%配置列表」查看所有支持的配置）", set_option, VoidChecker("%配置"),
                         RepeatableChecker<AnyArg>("配置参数", "配置参数")),
+            make_command("查看异步请求的排队情况和延迟", show_request_stat, VoidChecker("%请求队列")),
+            make_command("查看用户名称和头像缓存的命中情况", show_user_identity_cache_stat, VoidChecker("%用户缓存")),
+            make_command("查看各项性能指标（请求和电脑行动的延迟、渲染、数据库、计时器延迟和队列长度）", show_metrics,
+                        VoidChecker("%性能"), OptionalDefaultChecker<AnyArg>("", "指标名前缀", "db.")),
         }
     },
     {
@@ -963,3 +1033,6 @@ const std::vector<MetaCommandGroup> admin_cmds = {
         }
     },
 };
+
+const MetaCommandIndex meta_cmd_index = make_command_index(meta_cmds);
+const MetaCommandIndex admin_cmd_index = make_command_index(admin_cmds);
@@ -0,0 +1,277 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+// A monotonic counter. Adding is a relaxed atomic operation, so it can be left on in hot paths.
+class alignas(64) Counter
+{
+  public:
+    Counter() : value_(0) {}
+
+    void Add(const uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> value_;
+};
+
+// A latency histogram with log-linear buckets like HdrHistogram: the values below 16 have their own buckets, and each
+// power of two above is split into 16 buckets, so the relative error of a percentile is less than 1/16. Recording is
+// lock-free and costs a few relaxed atomic operations.
+class Histogram
+{
+  public:
+    static constexpr const uint32_t k_sub_bucket_bits_ = 4;
+    static constexpr const uint32_t k_sub_bucket_num_ = 1 << k_sub_bucket_bits_;
+    static constexpr const uint32_t k_bucket_num_ = k_sub_bucket_num_ * (64 - k_sub_bucket_bits_ + 1);
+
+    struct Summary
+    {
+        uint64_t count_ = 0;
+        uint64_t sum_ = 0;
+        uint64_t max_ = 0;
+        uint64_t p50_ = 0;
+        uint64_t p90_ = 0;
+        uint64_t p99_ = 0;
+    };
+
+    Histogram() : buckets_{}, count_(0), sum_(0), max_(0) {}
+
+    void Record(const uint64_t value)
+    {
+        buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        for (uint64_t max = max_.load(std::memory_order_relaxed);
+                value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed); ) {
+        }
+    }
+
+    void Record(const std::chrono::steady_clock::duration duration)
+    {
+        Record(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+    }
+
+    // The buckets are read one by one without lock, so a summary taken during recording may be slightly inconsistent.
+    Summary GetSummary() const
+    {
+        std::array<uint64_t, k_bucket_num_> counts;
+        uint64_t count = 0;
+        for (uint32_t i = 0; i < k_bucket_num_; ++i) {
+            count += (counts[i] = buckets_[i].load(std::memory_order_relaxed));
+        }
+        Summary summary{.count_ = count, .sum_ = sum_.load(std::memory_order_relaxed),
+                        .max_ = max_.load(std::memory_order_relaxed)};
+        const auto percentile = [&](const double ratio)
+            {
+                const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(count * ratio + 0.5));
+                uint64_t accumulated = 0;
+                for (uint32_t i = 0; i < k_bucket_num_; ++i) {
+                    if ((accumulated += counts[i]) >= rank) {
+                        return std::min(BucketUpperBound(i), summary.max_);
+                    }
+                }
+                return summary.max_;
+            };
+        if (count > 0) {
+            summary.p50_ = percentile(0.5);
+            summary.p90_ = percentile(0.9);
+            summary.p99_ = percentile(0.99);
+        }
+        return summary;
+    }
+
+    static uint32_t BucketIndex(const uint64_t value)
+    {
+        if (value < k_sub_bucket_num_) {
+            return value;
+        }
+        const uint32_t shift = std::bit_width(value) - k_sub_bucket_bits_ - 1;
+        return k_sub_bucket_num_ * (shift + 1) + (value >> shift) - k_sub_bucket_num_;
+    }
+
+    static uint64_t BucketUpperBound(const uint32_t index)
+    {
+        if (index < k_sub_bucket_num_) {
+            return index;
+        }
+        const uint32_t shift = index / k_sub_bucket_num_ - 1;
+        const uint64_t sub_bucket = index % k_sub_bucket_num_ + k_sub_bucket_num_;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, k_bucket_num_> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+// Records the time from construction to destruction into a histogram in microseconds.
+class LatencyScope
+{
+  public:
+    explicit LatencyScope(Histogram& histogram) : histogram_(histogram), begin_(std::chrono::steady_clock::now()) {}
+
+    LatencyScope(const LatencyScope&) = delete;
+    LatencyScope(LatencyScope&&) = delete;
+
+    ~LatencyScope() { histogram_.Record(std::chrono::steady_clock::now() - begin_); }
+
+  private:
+    Histogram& histogram_;
+    const std::chrono::steady_clock::time_point begin_;
+};
+
+// The bot-wide registry of metrics. Counters and histograms are created at their first lookup and never removed, so the
+// references can be kept by the callers to avoid looking up again. Gauges are read only when a snapshot is taken, which
+// suits the values already maintained elsewhere such as queue depths.
+class Metrics
+{
+  public:
+    using Gauge = std::function<int64_t()>;
+
+    // Unregisters the gauge when destructed.
+    class GaugeGuard
+    {
+      public:
+        GaugeGuard(Metrics& metrics, std::string name, const uint64_t id)
+            : metrics_(&metrics), name_(std::move(name)), id_(id)
+        {
+        }
+
+        GaugeGuard(const GaugeGuard&) = delete;
+
+        GaugeGuard(GaugeGuard&& other) : metrics_(other.metrics_), name_(std::move(other.name_)), id_(other.id_)
+        {
+            other.metrics_ = nullptr;
+        }
+
+        ~GaugeGuard()
+        {
+            if (metrics_) {
+                metrics_->UnregisterGauge_(name_, id_);
+            }
+        }
+
+      private:
+        Metrics* metrics_;
+        std::string name_;
+        uint64_t id_;
+    };
+
+    static Metrics& Get()
+    {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    Metrics() : next_gauge_id_(0) {}
+
+    Metrics(const Metrics&) = delete;
+    Metrics(Metrics&&) = delete;
+
+    Counter& GetCounter(const std::string& name) { return GetOrCreate_(counters_, name); }
+
+    Histogram& GetHistogram(const std::string& name) { return GetOrCreate_(histograms_, name); }
+
+    // A gauge with the same name as an existing one replaces it until the guard of the new one is destructed.
+    [[nodiscard]] GaugeGuard RegisterGauge(std::string name, Gauge gauge)
+    {
+        std::lock_guard<std::mutex> l(gauge_mutex_);
+        const uint64_t id = ++next_gauge_id_;
+        gauges_[name] = {id, std::move(gauge)};
+        return GaugeGuard(*this, std::move(name), id);
+    }
+
+    // One metric a line, sorted by the kind and the name:
+    //   counter <name> <value>
+    //   gauge <name> <value>
+    //   histogram <name> count=<n> avg_us=<us> p50_us=<us> p90_us=<us> p99_us=<us> max_us=<us>
+    // Only the metrics whose names begin with |prefix| are printed.
+    std::string Snapshot(const std::string_view prefix = "") const
+    {
+        std::stringstream ss;
+        std::unique_lock<std::mutex> l(mutex_);
+        for (const auto& [name, counter] : counters_) {
+            if (name.starts_with(prefix)) {
+                ss << "counter " << name << " " << counter->Get() << "\n";
+            }
+        }
+        l.unlock();
+        {
+            // The gauges are called with lock so that they are not unregistered meanwhile. They may take the locks of
+            // the components they observe, which may in turn look up metrics, so |mutex_| must not be held here.
+            std::lock_guard<std::mutex> gauge_l(gauge_mutex_);
+            for (const auto& [name, gauge] : gauges_) {
+                if (name.starts_with(prefix)) {
+                    ss << "gauge " << name << " " << gauge.second() << "\n";
+                }
+            }
+        }
+        l.lock();
+        for (const auto& [name, histogram] : histograms_) {
+            if (!name.starts_with(prefix)) {
+                continue;
+            }
+            const auto summary = histogram->GetSummary();
+            ss << "histogram " << name << " count=" << summary.count_
+               << " avg_us=" << (summary.count_ == 0 ? 0 : summary.sum_ / summary.count_)
+               << " p50_us=" << summary.p50_ << " p90_us=" << summary.p90_ << " p99_us=" << summary.p99_
+               << " max_us=" << summary.max_ << "\n";
+        }
+        return ss.str();
+    }
+
+  private:
+    template <typename T>
+    T& GetOrCreate_(std::map<std::string, std::unique_ptr<T>>& metrics, const std::string& name)
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        auto& metric = metrics[name];
+        if (!metric) {
+            metric = std::make_unique<T>();
+        }
+        return *metric;
+    }
+
+    void UnregisterGauge_(const std::string& name, const uint64_t id)
+    {
+        std::lock_guard<std::mutex> l(gauge_mutex_);
+        if (const auto it = gauges_.find(name); it != gauges_.end() && it->second.first == id) {
+            gauges_.erase(it);
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Counter>> counters_;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+    mutable std::mutex gauge_mutex_;
+    std::map<std::string, std::pair<uint64_t, Gauge>> gauges_;
+    uint64_t next_gauge_id_;
+};
+
+#define METRICS_CONCAT_INNER_(a, b) a##b
+#define METRICS_CONCAT_(a, b) METRICS_CONCAT_INNER_(a, b)
+
+// Records the latency of the enclosing scope into the histogram |name| of the bot-wide registry. The histogram is looked
+// up only once for each call site, so |name| should be a constant.
+#define METRICS_LATENCY_SCOPE(name) \
+    static Histogram& METRICS_CONCAT_(metrics_histogram_, __LINE__) = Metrics::Get().GetHistogram(name); \
+    const LatencyScope METRICS_CONCAT_(metrics_latency_scope_, __LINE__)(METRICS_CONCAT_(metrics_histogram_, __LINE__))
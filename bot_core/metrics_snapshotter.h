@@ -0,0 +1,114 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "utility/log.h"
+#include "bot_core/metrics.h"
+#include "bot_core/timer.h"
+
+// Write the snapshot of the bot-wide metrics into a text file periodically, so that a local scraper can read it without
+// sending commands to the bot. The first line is "time <unix seconds>" and the others are the lines of
+// Metrics::Snapshot. The file is replaced atomically, so a reader never sees a partial snapshot. The snapshotter is
+// stopped when destructed.
+class MetricsSnapshotter
+{
+  public:
+    // Returns the interval between two snapshots. The interval is read again after each snapshot so that it can be
+    // changed at runtime. Zero means pausing.
+    using IntervalGetter = std::function<TimerWheel::Duration()>;
+
+    // How long to wait before reading the interval again when the snapshotter is paused.
+    static constexpr TimerWheel::Duration k_paused_check_interval = std::chrono::seconds(10);
+
+    MetricsSnapshotter(std::filesystem::path path, IntervalGetter interval, TimerWheel& wheel = TimerWheel::Get())
+        : state_(std::make_shared<State>(std::move(path), std::move(interval), wheel))
+    {
+        std::lock_guard<std::mutex> l(state_->mutex_);
+        ScheduleNext_(state_);
+    }
+
+    MetricsSnapshotter(const MetricsSnapshotter&) = delete;
+    MetricsSnapshotter(MetricsSnapshotter&&) = delete;
+
+    ~MetricsSnapshotter()
+    {
+        std::lock_guard<std::mutex> l(state_->mutex_);
+        state_->is_over_ = true;
+        state_->wheel_.Cancel(state_->timer_id_);
+    }
+
+  private:
+    // The state is shared with the wheel so that it outlives the snapshotter if the snapshotter is released during
+    // expiring.
+    struct State
+    {
+        State(std::filesystem::path path, IntervalGetter interval, TimerWheel& wheel)
+            : path_(std::move(path)), interval_(std::move(interval)), wheel_(wheel), timer_id_(0), is_over_(false)
+        {
+        }
+        std::mutex mutex_;
+        const std::filesystem::path path_;
+        const IntervalGetter interval_;
+        TimerWheel& wheel_;
+        uint64_t timer_id_;
+        bool is_over_;
+    };
+
+    // REQUIRE: should be protected by state->mutex_
+    static void ScheduleNext_(const std::shared_ptr<State>& state)
+    {
+        const auto interval = state->interval_();
+        const bool is_paused = interval.count() <= 0;
+        state->timer_id_ = state->wheel_.Schedule(is_paused ? k_paused_check_interval : interval,
+                [state, is_paused] { OnExpire_(state, is_paused); });
+    }
+
+    static void OnExpire_(const std::shared_ptr<State>& state, const bool is_paused)
+    {
+        std::lock_guard<std::mutex> l(state->mutex_);
+        if (state->is_over_) {
+            return;
+        }
+        if (!is_paused) {
+            // Gauges may take other locks, so the snapshot is not taken on the wheel thread.
+            state->wheel_.Post([state] { Write_(state); });
+        }
+        ScheduleNext_(state);
+    }
+
+    static void Write_(const std::shared_ptr<State>& state)
+    {
+        std::lock_guard<std::mutex> l(state->mutex_);
+        if (state->is_over_) {
+            return;
+        }
+        auto tmp_path = state->path_;
+        tmp_path += ".tmp";
+        {
+            std::ofstream f(tmp_path, std::ios::trunc);
+            f << "time " << std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count() << "\n"
+              << Metrics::Get().Snapshot();
+            if (!f) {
+                ErrorLog() << "Write metrics snapshot failed path=" << tmp_path;
+                return;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, state->path_, ec);
+        if (ec) {
+            ErrorLog() << "Replace metrics snapshot failed path=" << state->path_ << " error=" << ec.message();
+        }
+    }
+
+    const std::shared_ptr<State> state_;
+};
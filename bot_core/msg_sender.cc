@@ -6,6 +6,7 @@
 
 #include "msg_sender.h"
 #include "bot_core/match.h"
+#include "bot_core/user_identity_cache.h"
 
 bool DownloadUserAvatar(const char* const uid, const std::filesystem::path::value_type* const dest_filename);
 
@@ -20,19 +21,100 @@ std::string GetUserAvatar(const char* const uid, const int32_t size)
         std::to_string(size) + "px; border-radius:50%; vertical-align: middle;\"/>";
 }
 
-void MsgSender::SavePlayer(const PlayerID& pid, const bool is_at)
+UserIdentityCache& UserIdentityCache::Get()
 {
-    if (!match_) {
-        SaveText_("[" + std::to_string(pid) + "号玩家]");
+    static UserIdentityCache cache(k_default_capacity, k_default_ttl,
+            [](const UserID& uid, const std::optional<GroupID>& gid)
+            {
+                const char* const name = GetUserName(uid.GetCStr(), gid.has_value() ? gid->GetCStr() : nullptr);
+                return name ? std::string(name) : uid.GetStr();
+            },
+            [](const UserID& uid, const int32_t size) { return GetUserAvatar(uid.GetCStr(), size); });
+    return cache;
+}
+
+void MsgBuffer::AppendText(const char* const data, const uint64_t len)
+{
+    if (len == 0) {
         return;
     }
-    SaveText_("[" + std::to_string(pid) + "号：");
-    const auto& id = match_->ConvertPid(pid);
+    Reserve_();
+    if (segments_.empty() || segments_.back().type_ != SegmentType::TEXT) {
+        segments_.emplace_back(SegmentType::TEXT, arena_.size(), 0);
+    }
+    // the last text segment is always at the end of the arena, so it can be extended in place
+    arena_.append(data, len);
+    segments_.back().size_ += len;
+}
+
+void MsgBuffer::AppendUser(const UserID& uid, const bool is_at)
+{
+    Reserve_();
+    const std::string_view uid_sv = uid.GetStr();
+    segments_.emplace_back(is_at ? SegmentType::AT_USER : SegmentType::USER, arena_.size(), uid_sv.size());
+    arena_.append(uid_sv);
+    arena_.push_back('\0');
+}
+
+void MsgBuffer::AppendPlayer(const Match* const match, const PlayerID& pid, const bool is_at)
+{
+    const auto append_text = [this](const std::string& str) { AppendText(str.data(), str.size()); };
+    if (!match) {
+        append_text("[" + std::to_string(pid) + "号玩家]");
+        return;
+    }
+    append_text("[" + std::to_string(pid) + "号：");
+    const auto& id = match->ConvertPid(pid);
     if (const auto pval = std::get_if<ComputerID>(&id)) {
-        SaveText_("机器人" + std::to_string(*pval) + "号");
+        append_text("机器人" + std::to_string(*pval) + "号");
     } else {
-        SaveUser(std::get<UserID>(id), is_at);
+        AppendUser(std::get<UserID>(id), is_at);
+    }
+    append_text("]");
+}
+
+void MsgBuffer::AppendImage(const std::filesystem::path::value_type* const path)
+{
+    segments_.emplace_back(SegmentType::IMAGE, images_.size(), 1);
+    images_.emplace_back(path);
+}
+
+void MsgBuffer::Post(void* const messager, const std::optional<GroupID>& gid) const
+{
+    thread_local std::string text; // the text run being merged, which is reused to avoid allocation
+    text.clear();
+    const auto post_text = [&]
+        {
+            if (!text.empty()) {
+                MessagerPostText(messager, text.data(), text.size());
+                text.clear();
+            }
+        };
+    for (const auto& segment : segments_) {
+        switch (segment.type_) {
+        case SegmentType::TEXT:
+            text.append(arena_.data() + segment.begin_, segment.size_);
+            break;
+        case SegmentType::USER:
+            text += UserIdentityCache::Get().UserName(
+                    UserID(std::string_view(arena_.data() + segment.begin_, segment.size_)), gid);
+            break;
+        case SegmentType::AT_USER:
+            post_text();
+            MessagerPostUser(messager, arena_.data() + segment.begin_, true);
+            break;
+        case SegmentType::IMAGE:
+            post_text();
+            MessagerPostImage(messager, images_[segment.begin_].c_str());
+            break;
+        }
     }
-    SaveText_("]");
+    post_text();
 }
 
+void MsgBuffer::Clear()
+{
+    arena_.clear();
+    segments_.clear();
+    images_.clear();
+}
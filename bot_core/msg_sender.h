@@ -5,6 +5,8 @@
 #pragma once
 
 #include <memory>
+#include <optional>
+#include <string>
 #include <variant>
 #include <vector>
 #include <functional>
@@ -37,6 +39,7 @@ template <typename IdType> struct At { IdType id_; };
 template <typename IdType> struct Name { IdType id_; };
 struct Image { std::filesystem::path path_; };
 struct Markdown { std::string_view data_; uint32_t width_ = 600; };
+struct Png { std::string_view data_; }; // the encoded image, which is saved by the bot
 
 template <typename T> concept CanToString = requires(T&& t) { std::to_string(std::forward<T>(t)); };
 
@@ -75,6 +78,7 @@ class MsgSenderBase
         inline MsgSenderGuard& operator<<(const Name<PlayerID>&);
         inline MsgSenderGuard& operator<<(const Image&);
         inline MsgSenderGuard& operator<<(const Markdown&);
+        inline MsgSenderGuard& operator<<(const Png&);
 
       private:
         MsgSenderBase* sender_;
@@ -94,11 +98,14 @@ class MsgSenderBase
     virtual void SaveImage(const std::filesystem::path::value_type* const path) = 0;
     virtual void SaveMarkdown(const char* const markdown, const uint32_t width)
     {
-        std::stringstream ss;
-        ss << std::this_thread::get_id();
-        const std::string tmp_image_name = ss.str();
-        MarkdownToImage(markdown, tmp_image_name, width);
-        SaveImage(ImageAbsPath(tmp_image_name).c_str());
+        SaveImage(MarkdownImageCache::Get().Render(markdown, width).c_str());
+    }
+    // The store of the bot is used because the message senders of the bot are made by the bot.
+    virtual void SavePng(const char* const data, const uint64_t len)
+    {
+        if (const auto path = ImageStore::Get().Save(std::string_view(data, len)); !path.empty()) {
+            SaveImage(path.c_str());
+        }
     }
     virtual void Flush() = 0;
 };
@@ -117,6 +124,7 @@ class EmptyMsgSender : public MsgSenderBase
     virtual void SaveUser(const UserID& uid, const bool is_at) override {}
     virtual void SavePlayer(const PlayerID& pid, const bool is_at) override {}
     virtual void SaveImage(const std::filesystem::path::value_type* const path) override {};
+    virtual void SavePng(const char* const data, const uint64_t len) override {}
     virtual void Flush() override {}
     virtual void SetMatch(const Match* const match) override {}
 
@@ -125,13 +133,61 @@ class EmptyMsgSender : public MsgSenderBase
     ~EmptyMsgSender() {}
 };
 
+// The message being built. The adjacent texts are merged into one segment, and the texts and the user IDs are stored in
+// one preallocated arena. When posting, the names of the users who are not at are got from UserIdentityCache and merged
+// into the adjacent texts, so a message costs one messager call for each text run between the at users and the images,
+// and a message without them costs only one. A message can be built once and posted to many messagers.
+class MsgBuffer
+{
+  public:
+    static constexpr const uint64_t k_initial_arena_size = 1024;
+
+    void AppendText(const char* const data, const uint64_t len);
+    void AppendUser(const UserID& uid, const bool is_at);
+    // |match| is used to convert |pid| to user ID, and can be null
+    void AppendPlayer(const Match* const match, const PlayerID& pid, const bool is_at);
+    void AppendImage(const std::filesystem::path::value_type* const path);
+
+    // Post all the segments to |messager| without flushing it. |gid| is the group which |messager| posts to, and is used
+    // to get the group nicknames.
+    void Post(void* const messager, const std::optional<GroupID>& gid) const;
+
+    // The capacity of the arena is kept to be reused by the next message.
+    void Clear();
+
+    bool Empty() const { return segments_.empty(); }
+    uint64_t SegmentNum() const { return segments_.size(); }
+
+  private:
+    enum class SegmentType { TEXT, USER, AT_USER, IMAGE };
+
+    // The arena is allocated when the first segment is appended, because many senders never send anything.
+    void Reserve_()
+    {
+        if (arena_.empty()) {
+            arena_.reserve(k_initial_arena_size);
+        }
+    }
+
+    struct Segment
+    {
+        SegmentType type_;
+        uint64_t begin_; // the offset in |arena_| for texts and users, or the index of |images_| for images
+        uint64_t size_;
+    };
+
+    std::string arena_; // the user IDs are null-terminated
+    std::vector<Segment> segments_;
+    std::vector<std::filesystem::path> images_;
+};
+
 class MsgSender : public MsgSenderBase
 {
   public:
     MsgSender(const UserID& uid) : sender_(Open_(uid)), match_(nullptr) {}
-    MsgSender(const GroupID& gid) : sender_(Open_(gid)), match_(nullptr) {}
+    MsgSender(const GroupID& gid) : sender_(Open_(gid)), gid_(gid), match_(nullptr) {}
     MsgSender(const MsgSender&) = delete;
-    MsgSender(MsgSender&& o) : sender_(o.sender_), match_(o.match_)
+    MsgSender(MsgSender&& o) : sender_(o.sender_), gid_(std::move(o.gid_)), match_(o.match_), buffer_(std::move(o.buffer_))
     {
         o.sender_ = nullptr;
         o.match_ = nullptr;
@@ -141,19 +197,29 @@ class MsgSender : public MsgSenderBase
     virtual MsgSenderGuard operator()() override { return MsgSenderGuard(*this); }
 
   protected:
-    virtual void SaveText(const char* const data, const uint64_t len) override { MessagerPostText(sender_, data, len); }
-    virtual void SaveUser(const UserID& uid, const bool is_at) override { MessagerPostUser(sender_, uid.GetCStr(), is_at); }
-    virtual void SavePlayer(const PlayerID& pid, const bool is_at) override;
-    virtual void SaveImage(const std::filesystem::path::value_type* const path) override { MessagerPostImage(sender_, path); }
-    virtual void Flush() override { MessagerFlush(sender_); }
-    void SaveText_(const std::string_view& sv) { SaveText(sv.data(), sv.size()); }
+    virtual void SaveText(const char* const data, const uint64_t len) override { buffer_.AppendText(data, len); }
+    virtual void SaveUser(const UserID& uid, const bool is_at) override { buffer_.AppendUser(uid, is_at); }
+    virtual void SavePlayer(const PlayerID& pid, const bool is_at) override { buffer_.AppendPlayer(match_, pid, is_at); }
+    virtual void SaveImage(const std::filesystem::path::value_type* const path) override { buffer_.AppendImage(path); }
+    virtual void Flush() override
+    {
+        Flush_(buffer_);
+        buffer_.Clear();
+    }
     friend class MsgSenderBatch;
 
   private:
     static void* Open_(const UserID& uid) { return OpenMessager(uid.GetCStr(), true); }
     static void* Open_(const GroupID& gid) { return OpenMessager(gid.GetCStr(), false); }
+    void Flush_(const MsgBuffer& buffer)
+    {
+        buffer.Post(sender_, gid_);
+        MessagerFlush(sender_);
+    }
     void* sender_;
+    std::optional<GroupID> gid_;
     const Match* match_;
+    MsgBuffer buffer_;
 };
 
 MsgSenderBase::MsgSenderGuard::~MsgSenderGuard()
@@ -199,48 +265,47 @@ MsgSenderBase::MsgSenderGuard& MsgSenderBase::MsgSenderGuard::operator<<(const M
     return *this;
 }
 
+MsgSenderBase::MsgSenderGuard& MsgSenderBase::MsgSenderGuard::operator<<(const Png& png_msg)
+{
+    sender_->SavePng(png_msg.data_.data(), png_msg.data_.size());
+    return *this;
+}
+
 MsgSenderBase::MsgSenderGuard& MsgSenderBase::MsgSenderGuard::operator<<(const std::string_view& sv)
 {
     sender_->SaveText(sv.data(), sv.size());
     return *this;
 }
 
+// The message is built only once, and then posted to each sender when flushing.
 class MsgSenderBatch : public MsgSenderBase
 {
   public:
     template <typename Fn>
-    MsgSenderBatch(Fn&& fn) : fn_(std::forward<Fn>(fn)) {}
+    MsgSenderBatch(Fn&& fn) : fn_(std::forward<Fn>(fn)), match_(nullptr) {}
 
-    virtual void SaveText(const char* const data, const uint64_t len) override
-    {
-        fn_([&](MsgSender& sender) { sender.SaveText(data, len); });
-    }
+    virtual void SaveText(const char* const data, const uint64_t len) override { buffer_.AppendText(data, len); }
 
-    virtual void SaveUser(const UserID& uid, const bool is_at) override
-    {
-        fn_([&](MsgSender& sender) { sender.SaveUser(uid.GetCStr(), is_at); });
-    }
+    virtual void SaveUser(const UserID& uid, const bool is_at) override { buffer_.AppendUser(uid, is_at); }
 
-    virtual void SavePlayer(const PlayerID& pid, const bool is_at) override
-    {
-        fn_([&](MsgSender& sender) { sender.SavePlayer(pid, is_at); });
-    }
+    virtual void SavePlayer(const PlayerID& pid, const bool is_at) override { buffer_.AppendPlayer(match_, pid, is_at); }
 
-    virtual void SaveImage(const std::filesystem::path::value_type* const path) override
-    {
-        fn_([&](MsgSender& sender) { sender.SaveImage(path); });
-    }
+    virtual void SaveImage(const std::filesystem::path::value_type* const path) override { buffer_.AppendImage(path); }
 
     virtual void Flush() override
     {
-        fn_([&](MsgSender& sender) { sender.Flush(); });
+        fn_([&](MsgSender& sender) { sender.Flush_(buffer_); });
+        buffer_.Clear();
     }
 
     virtual void SetMatch(const Match* const match) override
     {
+        match_ = match;
         fn_([&](MsgSender& sender) { sender.SetMatch(match); });
     }
 
   private:
     const std::function<void(const std::function<void(MsgSender&)>&)> fn_;
+    const Match* match_;
+    MsgBuffer buffer_;
 };
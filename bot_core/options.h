@@ -5,6 +5,7 @@
 #ifdef EXTEND_OPTION
 
 EXTEND_OPTION("计时器提示方式，私信提醒，或者群里公开 at 提醒", 计时公开提示, (BoolChecker("开启", "关闭")), false)
+EXTEND_OPTION("性能指标快照文件的写入间隔（秒），0 表示不写入", 性能快照间隔, (ArithChecker<uint32_t>(0, 3600, "秒数")), 60)
 
 #elif !defined(BOT_CORE_OPTIONS_H)
 #define BOT_CORE_OPTIONS_H
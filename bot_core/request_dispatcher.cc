@@ -0,0 +1,100 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include "bot_core/request_dispatcher.h"
+
+#include "utility/log.h"
+
+RequestDispatcher::RequestDispatcher(const uint32_t thread_num) : stop_(false)
+{
+    for (uint32_t i = 0; i < thread_num; ++i) {
+        threads_.emplace_back([this] { Routine_(); });
+    }
+}
+
+RequestDispatcher::~RequestDispatcher()
+{
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void RequestDispatcher::Dispatch(const Lane lane, const MatchID mid, Task task)
+{
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        const LaneKey key{lane, lane == Lane::MATCH ? mid.Get() : 0};
+        auto& lane_queue = lanes_[key];
+        if (!lane_queue) {
+            lane_queue = std::make_unique<LaneQueue>(key);
+            ready_lanes_.emplace_back(lane_queue.get());
+        }
+        lane_queue->requests_.emplace_back(std::move(task), std::chrono::steady_clock::now());
+        ++stat_.pending_num_;
+    }
+    cv_.notify_one();
+}
+
+void RequestDispatcher::WaitIdle()
+{
+    std::unique_lock<std::mutex> l(mutex_);
+    idle_cv_.wait(l, [this] { return stat_.pending_num_ == 0 && stat_.running_num_ == 0; });
+}
+
+RequestDispatcher::Stat RequestDispatcher::GetStat() const
+{
+    std::lock_guard<std::mutex> l(mutex_);
+    return stat_;
+}
+
+void RequestDispatcher::Routine_()
+{
+    std::unique_lock<std::mutex> l(mutex_);
+    while (true) {
+        cv_.wait(l, [this] { return stop_ || !ready_lanes_.empty(); });
+        if (ready_lanes_.empty()) {
+            // is stopped, and the requests in the lanes being handled will be handled by their own threads
+            break;
+        }
+        LaneQueue* const lane_queue = ready_lanes_.front();
+        ready_lanes_.pop_front();
+        Request request = std::move(lane_queue->requests_.front());
+        lane_queue->requests_.pop_front();
+        --stat_.pending_num_;
+        ++stat_.running_num_;
+        l.unlock();
+
+        const auto begin_time = std::chrono::steady_clock::now();
+        try {
+            request.task_();
+        } catch (const std::exception& e) {
+            ErrorLog() << "Handle request failed: " << e.what();
+        }
+        const auto end_time = std::chrono::steady_clock::now();
+
+        l.lock();
+        const auto wait_time = std::chrono::duration_cast<std::chrono::microseconds>(begin_time - request.dispatch_time_);
+        const auto handle_time = std::chrono::duration_cast<std::chrono::microseconds>(end_time - begin_time);
+        --stat_.running_num_;
+        ++stat_.handled_num_;
+        stat_.total_wait_time_ += wait_time;
+        stat_.max_wait_time_ = std::max(stat_.max_wait_time_, wait_time);
+        stat_.total_handle_time_ += handle_time;
+        stat_.max_handle_time_ = std::max(stat_.max_handle_time_, handle_time);
+        if (lane_queue->requests_.empty()) {
+            lanes_.erase(lane_queue->key_);
+        } else {
+            // queue at the back so that the lanes take turns
+            ready_lanes_.emplace_back(lane_queue);
+        }
+        if (stat_.pending_num_ == 0 && stat_.running_num_ == 0) {
+            idle_cv_.notify_all();
+        }
+    }
+}
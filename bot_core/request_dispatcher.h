@@ -0,0 +1,86 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bot_core/id.h"
+
+// Handles requests on a pool of worker threads. Each request is dispatched to a lane, and the requests in the same lane
+// are handled one by one in the dispatching order, while the requests in different lanes are handled in parallel. Each
+// match has its own lane, so a slow match does not block the others.
+class RequestDispatcher
+{
+  public:
+    enum class Lane { META, ADMIN, MATCH };
+
+    struct Stat
+    {
+        uint64_t pending_num_ = 0; // the requests waiting in the queues
+        uint64_t running_num_ = 0;
+        uint64_t handled_num_ = 0;
+        std::chrono::microseconds total_wait_time_{0}; // the time from being dispatched to being handled
+        std::chrono::microseconds max_wait_time_{0};
+        std::chrono::microseconds total_handle_time_{0};
+        std::chrono::microseconds max_handle_time_{0};
+    };
+
+    using Task = std::function<void()>;
+
+    static uint32_t DefaultThreadNum() { return std::max(2U, std::thread::hardware_concurrency()); }
+
+    RequestDispatcher(const uint32_t thread_num);
+
+    RequestDispatcher(const RequestDispatcher&) = delete;
+    RequestDispatcher(RequestDispatcher&&) = delete;
+
+    // The dispatched requests are handled before the dispatcher is destructed.
+    ~RequestDispatcher();
+
+    // |mid| is only used by the lane of match.
+    void Dispatch(const Lane lane, const MatchID mid, Task task);
+
+    // Block until all the dispatched requests are handled.
+    void WaitIdle();
+
+    Stat GetStat() const;
+
+  private:
+    using LaneKey = std::pair<Lane, uint64_t>;
+
+    struct Request
+    {
+        Task task_;
+        std::chrono::steady_clock::time_point dispatch_time_;
+    };
+
+    // A lane exists only when it has requests waiting or being handled, and it is in |ready_lanes_| when it has requests
+    // waiting and none being handled.
+    struct LaneQueue
+    {
+        LaneKey key_;
+        std::deque<Request> requests_;
+    };
+
+    void Routine_();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable idle_cv_;
+    std::map<LaneKey, std::unique_ptr<LaneQueue>> lanes_;
+    std::deque<LaneQueue*> ready_lanes_;
+    Stat stat_;
+    bool stop_;
+    std::vector<std::thread> threads_; /* make sure threads_ is inited last */
+};
@@ -30,12 +30,6 @@ ENUM_END(Achievement)
 
 static_assert(TEST_BOT);
 
-std::condition_variable Timer::cv_;
-bool Timer::skip_timer_ = false;
-std::condition_variable Timer::remaining_thread_cv_;
-uint64_t Timer::remaining_thread_count_ = 0;
-std::mutex Timer::mutex_;
-
 static std::ostream& operator<<(std::ostream& os, const ErrCode e) { return os << errcode2str(e); }
 
 constexpr const char* const k_this_qq = "114514";
@@ -119,14 +113,20 @@ void* OpenMessager(const char* const id, const bool is_uid)
     return new Messager(id, is_uid);
 }
 
+static std::atomic<uint64_t> messager_call_num_ = 0;
+static std::mutex messager_last_msgs_mutex_;
+static std::map<std::string, std::string> messager_last_msgs_;
+
 void MessagerPostText(void* const p, const char* const data, const uint64_t len)
 {
+    ++messager_call_num_;
     Messager* const messager = static_cast<Messager*>(p);
     messager->ss_ << std::string_view(data, len);
 }
 
 void MessagerPostUser(void* const p, const char* const uid, const bool is_at)
 {
+    ++messager_call_num_;
     Messager* const messager = static_cast<Messager*>(p);
     if (is_at) {
         messager->ss_ << "@" << uid;
@@ -139,19 +139,31 @@ void MessagerPostUser(void* const p, const char* const uid, const bool is_at)
 
 void MessagerPostImage(void* p, const std::filesystem::path::value_type* path)
 {
+    ++messager_call_num_;
     Messager* const messager = static_cast<Messager*>(p);
     std::basic_string<std::filesystem::path::value_type> path_str(path);
     messager->ss_ << "[image=" << std::string(path_str.begin(), path_str.end()) << "]";
 }
 
+static std::atomic<bool> messager_muted_ = false;
+
 void MessagerFlush(void* p)
 {
+    ++messager_call_num_;
     Messager* const messager = static_cast<Messager*>(p);
+    if (messager_muted_) {
+        messager->ss_.str("");
+        return;
+    }
     if (messager->is_uid_) {
         std::cout << "[BOT -> USER_" << messager->id_ << "]" << std::endl << messager->ss_.str() << std::endl;
     } else {
         std::cout << "[BOT -> GROUP_" << messager->id_ << "]" << std::endl << messager->ss_.str() << std::endl;
     }
+    {
+        std::lock_guard<std::mutex> l(messager_last_msgs_mutex_);
+        messager_last_msgs_[messager->id_] = messager->ss_.str();
+    }
     messager->ss_.str("");
 }
 
@@ -201,6 +213,7 @@ class GameOption : public GameOptionBase
     virtual const char* ColoredInfo(const uint64_t index) const { return "这是配置介绍"; };
     virtual const char* Status() const { return "这是配置状态"; };
     virtual bool SetOption(const char* const msg) { return true; };
+    virtual const char* OptionCommand(const uint64_t index) const { return ""; };
     virtual bool ToValid(MsgSenderBase& reply) { return true; }
     virtual uint64_t BestPlayerNum() const { return 2; }
     uint64_t timeout_sec_;
@@ -229,11 +242,15 @@ class SubStage : public SubGameStage<>
                 , MakeStageCommand("电脑失败次数", &SubStage::ToComputerFailed_, VoidChecker("电脑失败"),
                     BasicChecker<PlayerID>(), ArithChecker<uint64_t>(0, UINT64_MAX))
                 , MakeStageCommand("淘汰", &SubStage::Eliminate_, VoidChecker("淘汰"))
+                , MakeStageCommand("电脑在后台计算后再行动", &SubStage::ToComputeInBackground_, VoidChecker("后台计算"))
           )
         , computer_act_count_(0)
         , to_reset_timer_(false)
         , to_reset_ready_(0)
         , is_over_(false)
+        , to_compute_in_background_(false)
+        , background_task_started_(false)
+        , background_task_finished_(false)
     {}
 
     virtual void OnStageBegin() override
@@ -262,6 +279,13 @@ class SubStage : public SubGameStage<>
             reply() << "电脑行动失败，剩余次数" << (--to_computer_failed_[pid]);
             return StageErrCode::FAILED;
         }
+        if (to_compute_in_background_ && !background_task_finished_) {
+            if (!background_task_started_) {
+                background_task_started_ = true;
+                match().RunComputerTask(this, &SubStage::BackgroundTask_);
+            }
+            return StageErrCode::OK;
+        }
         return StageErrCode::READY;
     }
 
@@ -278,6 +302,18 @@ class SubStage : public SubGameStage<>
         }
     }
 
+  protected:
+    virtual bool OnCheckpoint(CheckpointWriter& writer) const override
+    {
+        writer.Write(computer_act_count_, to_reset_timer_, to_reset_ready_, to_computer_failed_, is_over_);
+        return true;
+    }
+
+    virtual bool OnRestore(CheckpointReader& reader) override
+    {
+        return reader.Read(computer_act_count_, to_reset_timer_, to_reset_ready_, to_computer_failed_, is_over_);
+    }
+
   private:
     AtomReqErrCode Ready_(const PlayerID pid, const bool is_public, MsgSenderBase& reply)
     {
@@ -342,11 +378,26 @@ class SubStage : public SubGameStage<>
         return StageErrCode::OK;
     }
 
+    AtomReqErrCode ToComputeInBackground_(const PlayerID pid, const bool is_public, MsgSenderBase& reply)
+    {
+        to_compute_in_background_ = true;
+        return StageErrCode::READY;
+    }
+
+    static void BackgroundTask_(void* const p)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        static_cast<SubStage*>(p)->background_task_finished_ = true;
+    }
+
     uint64_t computer_act_count_;
     bool to_reset_timer_;
     uint32_t to_reset_ready_;
     std::map<PlayerID, uint32_t> to_computer_failed_;
     bool is_over_;
+    bool to_compute_in_background_;
+    bool background_task_started_;
+    std::atomic<bool> background_task_finished_;
 };
 
 class MainStage : public MainGameStage<SubStage>
@@ -379,6 +430,23 @@ class MainStage : public MainGameStage<SubStage>
 
     virtual int64_t PlayerScore(const PlayerID pid) const override { return scores_[pid]; };
 
+  protected:
+    virtual bool OnCheckpoint(CheckpointWriter& writer) const override
+    {
+        writer.Write(to_checkout_, scores_, achievement_pids_);
+        return true;
+    }
+
+    virtual bool OnRestore(CheckpointReader& reader) override
+    {
+        return reader.Read(to_checkout_, scores_, achievement_pids_);
+    }
+
+    virtual VariantSubStage OnRestoreSubStage(const uint64_t index) override
+    {
+        return std::make_unique<SubStage>(*this);
+    }
+
   private:
     CompReqErrCode ToCheckout_(const PlayerID pid, const bool is_public, MsgSenderBase& reply, const uint32_t count)
     {
@@ -452,7 +520,7 @@ class TestBot : public testing::Test
   public:
     virtual void SetUp() override
     {
-        Timer::skip_timer_ = false;
+        TimerWheel::Get().SetSkip(false);
         const BotOption option {
             .this_uid_ = k_this_qq,
             .game_path_ = "/game_path/",
@@ -473,7 +541,12 @@ class TestBot : public testing::Test
         BOT_API::Release(bot_);
     }
 
-    MockDBManager& db_manager() { return static_cast<MockDBManager&>(*static_cast<BotCtx*>(bot_)->db_manager()); }
+    MockDBManager& db_manager()
+    {
+        // the match results are recorded asynchronously
+        static_cast<BotCtx*>(bot_)->match_recorder()->WaitIdle();
+        return static_cast<MockDBManager&>(*static_cast<BotCtx*>(bot_)->db_manager());
+    }
 
   protected:
     template <class MyMainStage = MainStage>
@@ -506,15 +579,12 @@ class TestBot : public testing::Test
 
     static void SkipTimer()
     {
-        std::unique_lock<std::mutex> l(Timer::mutex_);
-        Timer::skip_timer_ = true;
-        Timer::cv_.notify_all();
+        TimerWheel::Get().SetSkip(true);
     }
 
     static void WaitTimerThreadFinish()
     {
-        std::unique_lock<std::mutex> l(Timer::mutex_);
-        Timer::remaining_thread_cv_.wait(l, [] { return Timer::remaining_thread_count_ == 0; });
+        TimerWheel::Get().WaitIdle();
     }
 
     void WaitBeforeHandleTimeout(UserID uid)
@@ -526,7 +596,7 @@ class TestBot : public testing::Test
 
     static void BlockTimer()
     {
-        Timer::skip_timer_ = false;
+        TimerWheel::Get().SetSkip(false);
     }
 
     void NotifySubStage()
@@ -1160,6 +1230,20 @@ TEST_F(TestBot, set_computer_no_limit)
   ASSERT_PRI_MSG(EC_GAME_REQUEST_CHECKOUT, "1", "电脑行动次数 11");
 }
 
+TEST_F(TestBot, computer_act_after_background_task)
+{
+  AddGame("测试游戏", 2);
+  ASSERT_PRI_MSG(EC_OK, "1", "#新游戏 测试游戏");
+  ASSERT_PRI_MSG(EC_OK, "1", "#替补至 2");
+  ASSERT_PRI_MSG(EC_OK, "1", "#开始");
+  ASSERT_PRI_MSG(EC_GAME_REQUEST_OK, "1", "重新准备 1");
+  ASSERT_PRI_MSG(EC_GAME_REQUEST_CONTINUE, "1", "后台计算"); // the computer acts again and starts the task
+  ASSERT_PRI_MSG(EC_GAME_REQUEST_OK, "1", "准备"); // the request is not blocked by the task
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  // the game is over after the computer acts with the result of the task
+  ASSERT_PRI_MSG(EC_OK, "1", "#新游戏 测试游戏");
+}
+
 TEST_F(TestBot, set_computer_not_host)
 {
   AddGame("测试游戏", 5);
@@ -1596,6 +1680,205 @@ TEST_F(TestBot, get_achievement)
   ASSERT_EQ("普通成就", db_manager().user_achievements_[UserID("1")][0]);
 }
 
+// Checkpoint
+
+TEST_F(TestBot, restore_match_from_checkpoint)
+{
+  AddGame("测试游戏", 2);
+  ASSERT_PRI_MSG(EC_OK, k_admin_qq, "%默认倍率 测试游戏 1");
+  ASSERT_PUB_MSG(EC_OK, "1", "1", "#新游戏 测试游戏");
+  ASSERT_PUB_MSG(EC_OK, "1", "2", "#加入");
+  ASSERT_PUB_MSG(EC_OK, "1", "1", "#开始");
+  ASSERT_PUB_MSG(EC_GAME_REQUEST_OK, "1", "1", "准备切换 1");
+  ASSERT_PUB_MSG(EC_GAME_REQUEST_OK, "1", "2", "分数 2");
+  ASSERT_PUB_MSG(EC_GAME_REQUEST_OK, "1", "1", "准备");
+  auto& bot = *static_cast<BotCtx*>(bot_);
+  CheckpointWriter writer;
+  ASSERT_TRUE(bot.match_manager().GetMatch(UserID("1"))->Checkpoint(writer));
+  bot.match_manager().GetMatch(UserID("1"))->Suspend();
+  ASSERT_EQ(nullptr, bot.match_manager().GetMatch(GroupID("1")));
+  CheckpointReader reader(writer.Str());
+  const auto match = Match::Restore(bot, reader);
+  ASSERT_NE(nullptr, match);
+  ASSERT_EQ(match, bot.match_manager().GetMatch(UserID("2")));
+  ASSERT_EQ(match, bot.match_manager().GetMatch(GroupID("1")));
+  ASSERT_PUB_MSG(EC_GAME_REQUEST_CHECKOUT, "1", "2", "准备"); // the ready state of user 1 is restored
+  ASSERT_PUB_MSG(EC_GAME_REQUEST_OK, "1", "1", "准备");
+  ASSERT_PUB_MSG(EC_GAME_REQUEST_CHECKOUT, "1", "2", "准备");
+  ASSERT_EQ(2, db_manager().match_profiles_.size());
+  ASSERT_TRUE(std::ranges::any_of(db_manager().match_profiles_,
+              [](const MatchProfile& profile) { return profile.game_score_ == 2; })); // the score is restored
+}
+
+TEST_F(TestBot, restore_match_from_broken_checkpoint)
+{
+  AddGame("测试游戏", 2);
+  ASSERT_PUB_MSG(EC_OK, "1", "1", "#新游戏 测试游戏");
+  ASSERT_PUB_MSG(EC_OK, "1", "2", "#加入");
+  ASSERT_PUB_MSG(EC_OK, "1", "1", "#开始");
+  auto& bot = *static_cast<BotCtx*>(bot_);
+  CheckpointWriter writer;
+  ASSERT_TRUE(bot.match_manager().GetMatch(UserID("1"))->Checkpoint(writer));
+  const std::string checkpoint = writer.Str();
+  CheckpointReader truncated_reader(std::string_view(checkpoint).substr(0, checkpoint.size() - 1));
+  ASSERT_EQ(nullptr, Match::Restore(bot, truncated_reader));
+  // the users are still in the running match
+  CheckpointReader reader(checkpoint);
+  ASSERT_EQ(nullptr, Match::Restore(bot, reader));
+  ASSERT_PUB_MSG(EC_GAME_REQUEST_OK, "1", "1", "准备");
+}
+
+TEST_F(TestBot, checkpoint_not_supported_game)
+{
+  AddGame<AtomMainStage>("测试游戏", 2);
+  ASSERT_PUB_MSG(EC_OK, "1", "1", "#新游戏 测试游戏");
+  ASSERT_PUB_MSG(EC_OK, "1", "2", "#加入");
+  ASSERT_PUB_MSG(EC_OK, "1", "1", "#开始");
+  auto& bot = *static_cast<BotCtx*>(bot_);
+  CheckpointWriter writer;
+  ASSERT_FALSE(bot.match_manager().GetMatch(UserID("1"))->Checkpoint(writer));
+  bot.checkpoint_path() = std::filesystem::temp_directory_path() / "test_bot_not_supported.checkpoint";
+  ASSERT_FALSE(BOT_API::ReleaseIfNoProcessingGames(bot_));
+  ASSERT_FALSE(std::filesystem::exists(bot.checkpoint_path()));
+}
+
+TEST_F(TestBot, release_with_checkpoint_and_restore)
+{
+  const auto checkpoint_path = std::filesystem::temp_directory_path() / "test_bot_release.checkpoint";
+  std::filesystem::remove(checkpoint_path);
+  AddGame("测试游戏", 2);
+  ASSERT_PUB_MSG(EC_OK, "1", "1", "#新游戏 测试游戏");
+  ASSERT_PUB_MSG(EC_OK, "1", "2", "#加入");
+  ASSERT_PUB_MSG(EC_OK, "1", "1", "#开始");
+  ASSERT_PUB_MSG(EC_GAME_REQUEST_OK, "1", "1", "准备");
+  ASSERT_PUB_MSG(EC_OK, "2", "3", "#新游戏 测试游戏"); // not started match is terminated
+  static_cast<BotCtx*>(bot_)->checkpoint_path() = checkpoint_path;
+  ASSERT_TRUE(BOT_API::ReleaseIfNoProcessingGames(bot_));
+  bot_ = nullptr;
+  ASSERT_TRUE(std::filesystem::exists(checkpoint_path));
+
+  SetUp();
+  AddGame("测试游戏", 2);
+  ASSERT_EQ(1, static_cast<BotCtx*>(bot_)->match_manager().Restore(checkpoint_path));
+  ASSERT_FALSE(std::filesystem::exists(checkpoint_path));
+  ASSERT_PUB_MSG(EC_OK, "2", "3", "#新游戏 测试游戏");
+  ASSERT_PUB_MSG(EC_GAME_REQUEST_CHECKOUT, "1", "2", "准备");
+}
+
+// Async Request
+
+TEST_F(TestBot, handle_requests_async)
+{
+  AddGame("测试游戏", 2);
+  ASSERT_EQ(EC_OK, BOT_API::HandlePublicRequestAsync(bot_, "1", "1", "#新游戏 测试游戏"));
+  ASSERT_EQ(EC_OK, BOT_API::HandlePublicRequestAsync(bot_, "1", "2", "#加入"));
+  // the requests are only ordered for the same user, so the other user must have joined before the game starts
+  static_cast<BotCtx*>(bot_)->request_dispatcher().WaitIdle();
+  ASSERT_EQ(EC_OK, BOT_API::HandlePublicRequestAsync(bot_, "1", "1", "#开始"));
+  ASSERT_EQ(EC_OK, BOT_API::HandlePrivateRequestAsync(bot_, "1", "%请求队列"));
+  static_cast<BotCtx*>(bot_)->request_dispatcher().WaitIdle();
+  const auto match = static_cast<BotCtx*>(bot_)->match_manager().GetMatch(UserID("2"));
+  ASSERT_NE(nullptr, match);
+  ASSERT_EQ(Match::State::IS_STARTED, match->state());
+  ASSERT_EQ(4, static_cast<BotCtx*>(bot_)->request_dispatcher().GetStat().handled_num_);
+}
+
+TEST_F(TestBot, show_metrics)
+{
+  AddGame("测试游戏", 2);
+  ASSERT_PRI_MSG(EC_OK, "1", "#新游戏 测试游戏");
+  ASSERT_PRI_MSG(EC_OK, "2", "#加入 1");
+  ASSERT_PRI_MSG(EC_OK, "1", "#开始");
+  const auto request_num = Metrics::Get().GetHistogram("request.game.测试游戏").GetSummary().count_;
+  ASSERT_PRI_MSG(EC_GAME_REQUEST_OK, "1", "准备");
+  ASSERT_EQ(request_num + 1, Metrics::Get().GetHistogram("request.game.测试游戏").GetSummary().count_);
+  ASSERT_PRI_MSG(EC_REQUEST_NOT_ADMIN, "1", "%性能");
+  ASSERT_PRI_MSG(EC_OK, k_admin_qq, "%性能");
+  ASSERT_PRI_MSG(EC_OK, k_admin_qq, "%性能 request.");
+}
+
+TEST_F(TestBot, msg_sender_merges_adjacent_texts)
+{
+  MsgSender sender(UserID("1"));
+  messager_call_num_ = 0;
+  sender() << "a" << 1 << 'c' << At<UserID>("2") << "d" << Name<UserID>("3") << "e" << "f";
+  ASSERT_EQ(4, messager_call_num_); // 2 texts, 1 at and 1 flush, the name is merged into the text
+  ASSERT_EQ("a1c@2d3ef", messager_last_msgs_["1"]);
+  messager_call_num_ = 0;
+  sender() << "g" << Name<UserID>("3") << "h";
+  ASSERT_EQ(2, messager_call_num_); // 1 text and 1 flush
+  ASSERT_EQ("g3h", messager_last_msgs_["1"]);
+}
+
+TEST_F(TestBot, msg_sender_merges_group_nicknames)
+{
+  MsgSender sender(GroupID("10"));
+  messager_call_num_ = 0;
+  sender() << "a" << Name<UserID>("3") << "b";
+  ASSERT_EQ(2, messager_call_num_); // 1 text and 1 flush
+  ASSERT_EQ("a3(gid=10)b", messager_last_msgs_["10"]);
+}
+
+TEST_F(TestBot, msg_sender_batch_builds_message_once)
+{
+  std::vector<MsgSender> senders;
+  senders.emplace_back(UserID("1"));
+  senders.emplace_back(UserID("2"));
+  MsgSenderBatch batch([&](const std::function<void(MsgSender&)>& fn)
+          {
+            for (auto& sender : senders) {
+              fn(sender);
+            }
+          });
+  messager_call_num_ = 0;
+  batch() << "hello " << At<UserID>("3") << " " << "world " << At<PlayerID>(0);
+  ASSERT_EQ(8, messager_call_num_); // 3 segments and 1 flush for each sender
+  ASSERT_EQ("hello @3 world [0号玩家]", messager_last_msgs_["1"]);
+  ASSERT_EQ("hello @3 world [0号玩家]", messager_last_msgs_["2"]);
+}
+
+// Benchmark
+
+TEST_F(TestBot, benchmark_handle_public_request_concurrently)
+{
+  static constexpr uint32_t k_thread_num = 8;
+  static constexpr uint32_t k_request_num_each_thread = 20000;
+  AddGame("测试游戏", 2);
+  for (uint32_t i = 0; i < k_thread_num; ++i) {
+    const auto gid = std::to_string(100 + i);
+    ASSERT_PUB_MSG(EC_OK, gid.c_str(), ("host_" + gid).c_str(), "#新游戏 测试游戏");
+    ASSERT_PUB_MSG(EC_OK, gid.c_str(), ("member_" + gid).c_str(), "#加入");
+  }
+
+  messager_muted_ = true;
+  std::atomic<uint32_t> succ_num = 0;
+  std::vector<std::thread> threads;
+  const auto begin = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < k_thread_num; ++i) {
+    threads.emplace_back([&, gid = std::to_string(100 + i)]
+            {
+              const auto member_uid = "member_" + gid;
+              const auto idle_uid = "idle_" + gid;
+              for (uint32_t j = 0; j < k_request_num_each_thread; ++j) {
+                // half of the requests find the match of the user, and the others find nothing
+                succ_num += j % 2 ?
+                    BOT_API::HandlePublicRequest(bot_, gid.c_str(), member_uid.c_str(), "配置") == EC_MATCH_NOT_HOST :
+                    BOT_API::HandlePublicRequest(bot_, gid.c_str(), idle_uid.c_str(), "配置") == EC_MATCH_USER_NOT_IN_MATCH;
+              }
+            });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const auto cost = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin);
+  messager_muted_ = false;
+
+  ASSERT_EQ(k_thread_num * k_request_num_each_thread, succ_num);
+  std::cout << "[BENCHMARK] threads=" << k_thread_num
+            << " requests=" << k_thread_num * k_request_num_each_thread
+            << " requests_per_sec=" << k_thread_num * k_request_num_each_thread / cost.count() << std::endl;
+}
+
 int main(int argc, char** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,245 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include <atomic>
+#include <future>
+
+#include <gtest/gtest.h>
+
+#include "bot_core/cached_db_manager.h"
+
+// Counts the queries, and the results change with |version_| so that we can tell whether a result is stale.
+class CountingDBManager : public DBManagerBase
+{
+  public:
+    virtual std::vector<ScoreInfo> RecordMatch(const std::string& game_name, const std::optional<GroupID> gid,
+            const UserID& host_uid, const uint64_t multiple,
+            const std::vector<std::pair<UserID, int64_t>>& game_score_infos,
+            const std::vector<std::pair<UserID, std::string>>& achievements) override
+    {
+        ++version_;
+        return {};
+    }
+
+    virtual UserProfile GetUserProfile(const UserID& uid, const std::string_view& time_range_begin,
+            const std::string_view& time_range_end) override
+    {
+        ++query_num_;
+        return UserProfile{.uid_ = uid, .match_count_ = version_};
+    }
+
+    virtual bool Suicide(const UserID& uid, const uint32_t required_match_num) override
+    {
+        if (required_match_num > 0) {
+            return false;
+        }
+        ++version_;
+        return true;
+    }
+
+    virtual RankInfo GetRank(const std::string_view& time_range_begin, const std::string_view& time_range_end) override
+    {
+        ++query_num_;
+        if (before_rank_return_) {
+            before_rank_return_();
+        }
+        return RankInfo{.match_count_rank_ = {{UserID("a"), version_}}};
+    }
+
+    virtual GameRankInfo GetLevelScoreRank(const std::string& game_name, const std::string_view& time_range_begin,
+            const std::string_view& time_range_end) override
+    {
+        ++query_num_;
+        return GameRankInfo{.match_count_rank_ = {{UserID("a"), version_}}};
+    }
+
+    virtual AchievementStatisticInfo GetAchievementStatistic(const UserID& uid, const std::string& game_name,
+            const std::string& achievement_name) override
+    {
+        return {};
+    }
+
+    virtual std::vector<HonorInfo> GetHonors() override { return {}; }
+
+    virtual bool AddHonor(const UserID& uid, const std::string_view& description) override
+    {
+        ++version_;
+        return true;
+    }
+
+    virtual bool DeleteHonor(const int32_t id) override
+    {
+        ++version_;
+        return true;
+    }
+
+    std::atomic<int64_t> version_ = 0;
+    std::atomic<uint64_t> query_num_ = 0;
+    std::function<void()> before_rank_return_;
+};
+
+class TestCachedDBManager : public testing::Test
+{
+  protected:
+    TestCachedDBManager() : counting_db_(new CountingDBManager()), db_(std::unique_ptr<DBManagerBase>(counting_db_), 2) {}
+
+    void RecordMatch_(const std::string& game_name, const std::vector<UserID>& uids)
+    {
+        std::vector<std::pair<UserID, int64_t>> game_score_infos;
+        for (const auto& uid : uids) {
+            game_score_infos.emplace_back(uid, 0);
+        }
+        db_.RecordMatch(game_name, std::nullopt, uids.front(), 1, game_score_infos, {});
+    }
+
+    int64_t MatchCount_(const UserID& uid, const std::string_view begin = "")
+    {
+        return db_.GetUserProfile(uid, begin, "").match_count_;
+    }
+
+    int64_t RankVersion_(const std::string_view begin = "")
+    {
+        return db_.GetRank(begin, "").match_count_rank_.front().second;
+    }
+
+    int64_t GameRankVersion_(const std::string& game_name)
+    {
+        return db_.GetLevelScoreRank(game_name, "", "").match_count_rank_.front().second;
+    }
+
+    CountingDBManager* const counting_db_;
+    CachedDBManager db_;
+};
+
+TEST_F(TestCachedDBManager, query_once_for_same_key)
+{
+    ASSERT_EQ(0, RankVersion_());
+    ASSERT_EQ(0, RankVersion_());
+    ASSERT_EQ(0, GameRankVersion_("猜拳游戏"));
+    ASSERT_EQ(0, GameRankVersion_("猜拳游戏"));
+    ASSERT_EQ(0, MatchCount_("a"));
+    ASSERT_EQ(0, MatchCount_("a"));
+    ASSERT_EQ(3, counting_db_->query_num_);
+    ASSERT_EQ(3, db_.GetStat().hit_num_);
+    ASSERT_EQ(3, db_.GetStat().miss_num_);
+}
+
+TEST_F(TestCachedDBManager, key_by_time_range)
+{
+    RankVersion_("2024-01-01 00:00:00");
+    RankVersion_("2024-02-01 00:00:00");
+    MatchCount_("a", "2024-01-01 00:00:00");
+    MatchCount_("a", "2024-02-01 00:00:00");
+    ASSERT_EQ(4, counting_db_->query_num_);
+}
+
+TEST_F(TestCachedDBManager, record_match_invalidates_affected_results)
+{
+    RankVersion_();
+    GameRankVersion_("猜拳游戏");
+    GameRankVersion_("五子棋");
+    MatchCount_("a");
+    MatchCount_("b");
+    ASSERT_EQ(5, counting_db_->query_num_);
+    RecordMatch_("猜拳游戏", {"a"});
+    ASSERT_EQ(1, RankVersion_());
+    ASSERT_EQ(1, GameRankVersion_("猜拳游戏"));
+    ASSERT_EQ(1, MatchCount_("a"));
+    ASSERT_EQ(8, counting_db_->query_num_);
+    // not affected
+    ASSERT_EQ(0, GameRankVersion_("五子棋"));
+    ASSERT_EQ(0, MatchCount_("b"));
+    ASSERT_EQ(8, counting_db_->query_num_);
+}
+
+TEST_F(TestCachedDBManager, record_matches_invalidates_affected_results)
+{
+    MatchCount_("a");
+    MatchCount_("b");
+    db_.RecordMatches({MatchRecord{.game_name_ = "猜拳游戏", .host_uid_ = "a", .game_score_infos_ = {{"a", 0}}},
+                       MatchRecord{.game_name_ = "猜拳游戏", .host_uid_ = "b", .game_score_infos_ = {{"b", 0}}}});
+    ASSERT_EQ(2, MatchCount_("a"));
+    ASSERT_EQ(2, MatchCount_("b"));
+}
+
+TEST_F(TestCachedDBManager, suicide_invalidates_ranks_and_profile)
+{
+    RankVersion_();
+    GameRankVersion_("猜拳游戏");
+    MatchCount_("a");
+    MatchCount_("b");
+    ASSERT_FALSE(db_.Suicide("a", 3)); // nothing changed
+    ASSERT_EQ(0, RankVersion_());
+    ASSERT_TRUE(db_.Suicide("a", 0));
+    ASSERT_EQ(1, RankVersion_());
+    ASSERT_EQ(1, GameRankVersion_("猜拳游戏"));
+    ASSERT_EQ(1, MatchCount_("a"));
+    ASSERT_EQ(0, MatchCount_("b"));
+}
+
+TEST_F(TestCachedDBManager, honors_invalidate_profiles)
+{
+    MatchCount_("a");
+    MatchCount_("b");
+    db_.AddHonor("a", "冠军");
+    ASSERT_EQ(1, MatchCount_("a"));
+    ASSERT_EQ(0, MatchCount_("b"));
+    db_.DeleteHonor(1);
+    ASSERT_EQ(2, MatchCount_("a"));
+    ASSERT_EQ(2, MatchCount_("b"));
+}
+
+TEST_F(TestCachedDBManager, evict_least_recently_used_user)
+{
+    MatchCount_("a");
+    MatchCount_("b");
+    MatchCount_("a"); // b is the least recently used
+    MatchCount_("c");
+    ASSERT_EQ(2, db_.GetStat().user_num_);
+    ASSERT_EQ(3, counting_db_->query_num_);
+    MatchCount_("a");
+    ASSERT_EQ(3, counting_db_->query_num_);
+    MatchCount_("b");
+    ASSERT_EQ(4, counting_db_->query_num_);
+}
+
+TEST_F(TestCachedDBManager, not_cache_result_queried_during_write)
+{
+    std::promise<void> querying;
+    std::promise<void> written;
+    std::atomic<bool> is_first_query = true;
+    counting_db_->before_rank_return_ = [&]
+        {
+            if (is_first_query.exchange(false)) {
+                querying.set_value();
+                written.get_future().wait();
+            }
+        };
+    // the rank is queried before the match is recorded, so it is stale after the recording
+    auto stale_rank = std::async(std::launch::async, [&] { return RankVersion_(); });
+    querying.get_future().wait();
+    RecordMatch_("猜拳游戏", {"a"});
+    --counting_db_->version_; // let the query return the result before the recording
+    written.set_value();
+    ASSERT_EQ(0, stale_rank.get());
+    ++counting_db_->version_;
+    ASSERT_EQ(1, RankVersion_());
+}
+
+TEST_F(TestCachedDBManager, clear)
+{
+    RankVersion_();
+    MatchCount_("a");
+    db_.Clear();
+    ASSERT_EQ(0, db_.GetStat().user_num_);
+    ASSERT_EQ(0, db_.GetStat().rank_num_);
+    RankVersion_();
+    MatchCount_("a");
+    ASSERT_EQ(4, counting_db_->query_num_);
+}
+
+TEST(TestCachedDBManagerWrap, wrap_null)
+{
+    ASSERT_EQ(nullptr, CachedDBManager::Wrap(nullptr));
+}
@@ -6,6 +6,10 @@
 #include <string_view>
 #include <map>
 #include <filesystem>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
 
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
@@ -27,6 +31,8 @@ class TestDB : public testing::Test
     virtual void SetUp() override
     {
         std::filesystem::remove(std::filesystem::path(k_db_path));
+        std::filesystem::remove(std::filesystem::path(k_db_path) += "-wal");
+        std::filesystem::remove(std::filesystem::path(k_db_path) += "-shm");
     }
 
   protected:
@@ -194,6 +200,274 @@ TEST_F(TestDB, get_achievement_statisic)
     ASSERT_EQ(0, result.achieved_user_num_);
 }
 
+TEST_F(TestDB, time_range_datetime_same_as_sqlite)
+{
+    sqlite::database db(k_db_path);
+    std::string datetime;
+    db << "SELECT datetime('now','start of month');" >> datetime;
+    ASSERT_EQ(datetime, TimeRangeBeginDatetime(TimeRange::月));
+    db << "SELECT datetime('now','start of month', '+1 month');" >> datetime;
+    ASSERT_EQ(datetime, TimeRangeEndDatetime(TimeRange::月));
+    db << "SELECT datetime('now','start of year');" >> datetime;
+    ASSERT_EQ(datetime, TimeRangeBeginDatetime(TimeRange::年));
+    db << "SELECT datetime('now','start of year', '+1 year');" >> datetime;
+    ASSERT_EQ(datetime, TimeRangeEndDatetime(TimeRange::年));
+    ASSERT_EQ("", TimeRangeBeginDatetime(TimeRange::总));
+    ASSERT_EQ("", TimeRangeEndDatetime(TimeRange::总));
+}
+
+TEST_F(TestDB, get_rank_in_time_range)
+{
+    ASSERT_TRUE(UseDB_());
+    RecordMatch("g1", std::nullopt, "1", 1, std::vector<ScoreInfo>{ScoreInfo(UserID("1"), 10, 20, 30)});
+    RecordMatch("g1", std::nullopt, "1", 1, std::vector<ScoreInfo>{ScoreInfo(UserID("2"), 5, 5, 5)});
+
+    const auto rank = db_manager_->GetRank("", "");
+    ASSERT_EQ(2, rank.zero_sum_score_rank_.size());
+    ASSERT_EQ("1", rank.zero_sum_score_rank_[0].first.GetStr());
+    ASSERT_EQ(20, rank.zero_sum_score_rank_[0].second);
+    ASSERT_EQ(2, db_manager_->GetLevelScoreRank("g1", "", "").match_count_rank_.size());
+
+    ASSERT_TRUE(db_manager_->GetRank("9999-01-01 00:00:00", "").zero_sum_score_rank_.empty());
+    ASSERT_TRUE(db_manager_->GetRank("", "2000-01-01 00:00:00").zero_sum_score_rank_.empty());
+    ASSERT_TRUE(db_manager_->GetLevelScoreRank("g1", "9999-01-01 00:00:00", "").match_count_rank_.empty());
+    ASSERT_EQ(0, db_manager_->GetUserProfile(UserID("1"), "9999-01-01 00:00:00", "").match_count_);
+    ASSERT_EQ(1, db_manager_->GetUserProfile(UserID("1"), "2000-01-01 00:00:00", "9999-01-01 00:00:00").match_count_);
+}
+
+TEST_F(TestDB, record_matches_in_one_transaction)
+{
+    ASSERT_TRUE(UseDB_());
+    std::vector<MatchRecord> records;
+    for (uint32_t i = 0; i < 3; ++i) {
+        records.emplace_back(MatchRecord{
+                .game_name_ = "g1",
+                .host_uid_ = "1",
+                .multiple_ = 1,
+                .game_score_infos_ = {{"1", 10}, {"2", -10}},
+                .achievements_ = {{"1", "普通成就"}},
+            });
+    }
+    records.emplace_back(MatchRecord{.game_name_ = "g1", .host_uid_ = "1", .multiple_ = 1}); // no users
+    const auto score_infos = db_manager_->RecordMatches(records);
+    ASSERT_EQ(4, score_infos.size());
+    for (uint32_t i = 0; i < 3; ++i) {
+        ASSERT_EQ(2, score_infos[i].size());
+        ASSERT_EQ("1", score_infos[i][0].uid_.GetStr());
+        ASSERT_GT(score_infos[i][0].zero_sum_score_, 0);
+    }
+    ASSERT_TRUE(score_infos[3].empty());
+    // the level score is calculated with the matches recorded before in the same transaction
+    ASSERT_NE(score_infos[0][0].level_score_, score_infos[2][0].level_score_);
+    ASSERT_USER_PROFILE(UserID("2"),
+            score_infos[0][1].zero_sum_score_ + score_infos[1][1].zero_sum_score_ + score_infos[2][1].zero_sum_score_,
+            score_infos[0][1].top_score_ + score_infos[1][1].top_score_ + score_infos[2][1].top_score_, 3, 3, 0);
+    ASSERT_EQ(3, db_manager_->GetUserProfile(UserID("1"), "", "").recent_achievements_.size());
+}
+
+TEST_F(TestDB, close_db_after_recording_matches)
+{
+    ASSERT_TRUE(UseDB_());
+    const auto score_infos = db_manager_->RecordMatches({MatchRecord{
+            .game_name_ = "g1",
+            .host_uid_ = "1",
+            .multiple_ = 1,
+            .game_score_infos_ = {{"1", 10}, {"2", -10}},
+        }});
+    ASSERT_EQ(1, score_infos.size());
+    db_manager_.reset(); // the cached statements should not be executed again when the connections are closed
+
+    sqlite::database db(k_db_path);
+    uint64_t match_num = 0;
+    db << "SELECT COUNT(*) FROM match;" >> match_num;
+    ASSERT_EQ(1, match_num);
+    uint64_t user_with_match_num = 0;
+    db << "SELECT COUNT(*) FROM user_with_match;" >> user_with_match_num;
+    ASSERT_EQ(2, user_with_match_num);
+}
+
+TEST_F(TestDB, record_matches_skip_recorded_ids)
+{
+    ASSERT_TRUE(UseDB_());
+    const auto record = [](std::string record_id)
+        {
+            return MatchRecord{
+                    .game_name_ = "g1",
+                    .host_uid_ = "1",
+                    .multiple_ = 1,
+                    .game_score_infos_ = {{"1", 10}, {"2", -10}},
+                    .record_id_ = std::move(record_id),
+                };
+        };
+    const auto score_infos = db_manager_->RecordMatches({record("a-1")});
+    ASSERT_EQ(1, score_infos.size());
+    ASSERT_EQ(2, score_infos[0].size());
+    // replayed after a crash
+    const auto replayed_score_infos = db_manager_->RecordMatches({record("a-1"), record("a-2"), record("")});
+    ASSERT_EQ(3, replayed_score_infos.size());
+    ASSERT_EQ(2, replayed_score_infos[0].size());
+    for (uint32_t i = 0; i < 2; ++i) {
+        ASSERT_EQ(score_infos[0][i].uid_, replayed_score_infos[0][i].uid_);
+        ASSERT_EQ(score_infos[0][i].zero_sum_score_, replayed_score_infos[0][i].zero_sum_score_);
+        ASSERT_EQ(score_infos[0][i].top_score_, replayed_score_infos[0][i].top_score_);
+    }
+    ASSERT_EQ(3, db_manager_->GetUserProfile(UserID("1"), "", "").match_count_);
+}
+
+template <typename Score>
+static std::map<std::string, Score> RankToMap(const std::vector<std::pair<UserID, Score>>& rank)
+{
+    std::map<std::string, Score> ret;
+    for (const auto& [uid, score] : rank) {
+        ret.emplace(uid.GetStr(), score);
+    }
+    return ret;
+}
+
+#define ASSERT_RANK_EQ(rank_1, rank_2) \
+[&]() { \
+    const auto map_1 = RankToMap(rank_1); \
+    const auto map_2 = RankToMap(rank_2); \
+    ASSERT_EQ(map_1.size(), map_2.size()); \
+    for (const auto& [uid, score] : map_1) { \
+        ASSERT_EQ(1, map_2.count(uid)) << uid; \
+        ASSERT_NEAR(score, map_2.at(uid), 1e-6) << uid; \
+    } \
+}()
+
+static const char* const k_wide_time_range_begin = "2000-01-01 00:00:00";
+static const char* const k_wide_time_range_end = "9999-01-01 00:00:00";
+
+TEST_F(TestDB, rank_from_score_summary_same_as_from_matches)
+{
+    ASSERT_TRUE(UseDB_());
+    for (uint32_t i = 0; i < 30; ++i) {
+        db_manager_->RecordMatch("g" + std::to_string(i % 2), std::nullopt, "1", 1,
+                {{std::to_string(i % 5), 10}, {std::to_string((i + 1) % 5), 0}, {std::to_string((i + 3) % 5), -10}}, {});
+        if (i == 20) {
+            db_manager_->Suicide(UserID("2"), 0); // the old scores of user 2 should not be ranked
+        }
+    }
+    // the wide time range is not a bucket of the summary, so the ranks are aggregated from the matches
+    const auto summary_rank = db_manager_->GetRank("", "");
+    const auto match_rank = db_manager_->GetRank(k_wide_time_range_begin, k_wide_time_range_end);
+    ASSERT_EQ(5, summary_rank.zero_sum_score_rank_.size());
+    ASSERT_RANK_EQ(match_rank.zero_sum_score_rank_, summary_rank.zero_sum_score_rank_);
+    ASSERT_RANK_EQ(match_rank.top_score_rank_, summary_rank.top_score_rank_);
+    ASSERT_RANK_EQ(match_rank.match_count_rank_, summary_rank.match_count_rank_);
+    ASSERT_GT(RankToMap(summary_rank.match_count_rank_)["1"], RankToMap(summary_rank.match_count_rank_)["2"]);
+
+    const auto summary_game_rank = db_manager_->GetLevelScoreRank("g1", "", "");
+    const auto match_game_rank = db_manager_->GetLevelScoreRank("g1", k_wide_time_range_begin, k_wide_time_range_end);
+    ASSERT_EQ(5, summary_game_rank.level_score_rank_.size());
+    ASSERT_RANK_EQ(match_game_rank.level_score_rank_, summary_game_rank.level_score_rank_);
+    ASSERT_RANK_EQ(match_game_rank.weight_level_score_rank_, summary_game_rank.weight_level_score_rank_);
+    ASSERT_RANK_EQ(match_game_rank.match_count_rank_, summary_game_rank.match_count_rank_);
+}
+
+TEST_F(TestDB, rebuild_score_summary)
+{
+    ASSERT_TRUE(UseDB_());
+    db_manager_->RecordMatch("g1", std::nullopt, "1", 1, {{"1", 10}, {"2", -10}}, {});
+    db_manager_->RecordMatch("g1", std::nullopt, "1", 1, {{"1", 10}, {"2", -10}}, {});
+    {
+        sqlite::database db(k_db_path);
+        db << "BEGIN;";
+        db << "UPDATE user_with_match SET zero_sum_score = 100 WHERE user_id = '1';";
+        RebuildScoreSummary(db);
+        db << "COMMIT;";
+    }
+    const auto rank = db_manager_->GetRank("", "");
+    ASSERT_EQ("1", rank.zero_sum_score_rank_[0].first.GetStr());
+    ASSERT_EQ(200, rank.zero_sum_score_rank_[0].second);
+}
+
+TEST_F(TestDB, build_score_summary_when_open_db_without_it)
+{
+    ASSERT_TRUE(UseDB_());
+    db_manager_->RecordMatch("g1", std::nullopt, "1", 1, {{"1", 10}, {"2", -10}}, {});
+    db_manager_.reset();
+    sqlite::database(k_db_path) << "DROP TABLE user_score_summary;";
+
+    ASSERT_TRUE(UseDB_());
+    const auto rank = db_manager_->GetRank("", "");
+    ASSERT_EQ(2, rank.match_count_rank_.size());
+    ASSERT_EQ(1, rank.match_count_rank_[0].second);
+    ASSERT_EQ(1, db_manager_->GetLevelScoreRank("g1", "", "").match_count_rank_[0].second);
+}
+
+TEST_F(TestDB, read_while_writing)
+{
+    static constexpr uint32_t k_match_num = 100;
+    ASSERT_TRUE(UseDB_());
+    std::atomic<bool> is_over = false;
+    std::atomic<bool> is_consistent = true;
+    std::vector<std::thread> readers;
+    for (uint32_t i = 0; i < 4; ++i) {
+        readers.emplace_back([&]
+                {
+                    int64_t last_match_count = 0;
+                    while (!is_over) {
+                        const auto profile = db_manager_->GetUserProfile(UserID("1"), "", "");
+                        // both players are recorded in one transaction, so the reader should always see both of them
+                        const auto profile_2 = db_manager_->GetUserProfile(UserID("2"), "", "");
+                        is_consistent = is_consistent && profile.match_count_ >= last_match_count &&
+                            profile_2.match_count_ >= profile.match_count_;
+                        last_match_count = profile.match_count_;
+                    }
+                });
+    }
+    for (uint32_t i = 0; i < k_match_num; ++i) {
+        ASSERT_EQ(2, db_manager_->RecordMatch("g1", std::nullopt, "1", 1, {{"1", 10}, {"2", -10}}, {}).size());
+    }
+    is_over = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    ASSERT_TRUE(is_consistent);
+    ASSERT_USER_PROFILE(UserID("1"), db_manager_->GetUserProfile(UserID("1"), "", "").total_zero_sum_score_,
+            db_manager_->GetUserProfile(UserID("1"), "", "").total_top_score_, k_match_num, 10, 0);
+}
+
+TEST_F(TestDB, benchmark_per_call_latency)
+{
+    static constexpr uint32_t k_user_num = 20;
+    static constexpr uint32_t k_prepared_match_num = 300;
+    static constexpr uint32_t k_call_num = 200;
+    ASSERT_TRUE(UseDB_());
+
+    uint32_t match_num = 0;
+    const auto record_match = [&]
+        {
+            std::vector<std::pair<UserID, int64_t>> game_scores;
+            for (uint32_t i = 0; i < 4; ++i) {
+                game_scores.emplace_back(std::to_string((match_num + i) % k_user_num), i * 10);
+            }
+            ++match_num;
+            return db_manager_->RecordMatch("g" + std::to_string(match_num % 3), std::nullopt, "1", 1, game_scores, {});
+        };
+    for (uint32_t i = 0; i < k_prepared_match_num; ++i) {
+        record_match();
+    }
+
+    const auto benchmark = [](const char* const name, const auto& fn)
+        {
+            const auto begin = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < k_call_num; ++i) {
+                fn(i);
+            }
+            const auto cost = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin);
+            std::cout << "[BENCHMARK] " << name << "_avg_us=" << cost.count() / k_call_num << std::endl;
+        };
+    benchmark("record_match", [&](const uint32_t i) { record_match(); });
+    benchmark("get_user_profile",
+            [&](const uint32_t i) { db_manager_->GetUserProfile(std::to_string(i % k_user_num), "", ""); });
+    benchmark("get_rank", [&](const uint32_t i) { db_manager_->GetRank("", ""); });
+    benchmark("get_level_score_rank", [&](const uint32_t i) { db_manager_->GetLevelScoreRank("g1", "", ""); });
+    benchmark("get_achievement_statistic",
+            [&](const uint32_t i) { db_manager_->GetAchievementStatistic(std::to_string(i % k_user_num), "g1", "a"); });
+}
+
 int main(int argc, char** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,138 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include <atomic>
+
+#include <gtest/gtest.h>
+
+#include "bot_core/game_handle.h"
+
+class GameOptionBase
+{
+};
+
+class MainStageBase
+{
+};
+
+class TestGameHandle : public testing::Test
+{
+  protected:
+    static constexpr std::chrono::milliseconds k_idle_timeout{200};
+
+    std::unique_ptr<GameHandle::Module> LoadModule()
+    {
+        if (!loadable_) {
+            return nullptr;
+        }
+        ++loaded_num_;
+        return std::make_unique<GameHandle::Module>(
+                []() -> GameOptionBase* { return new GameOptionBase(); },
+                [](const GameOptionBase* const options) { delete options; },
+                [](MsgSenderBase&, const GameOptionBase&, MatchBase&) -> MainStageBase* { return new MainStageBase(); },
+                [](const MainStageBase* const main_stage) { delete main_stage; },
+                [this] { --loaded_num_; });
+    }
+
+    std::unique_ptr<GameHandle> MakeGameHandle(std::shared_ptr<const GameHandle::Module> module, const bool can_reload)
+    {
+        auto game_handle = std::make_unique<GameHandle>("游戏", "game", 2, "规则", std::vector<GameHandle::Achievement>{},
+                1, "开发者", "描述", std::move(module),
+                can_reload ? GameHandle::ModuleLoader([this] { return LoadModule(); }) : nullptr);
+        game_handle->SetModuleIdleTimeout(k_idle_timeout);
+        return game_handle;
+    }
+
+    static void WaitUnloaded(const GameHandle& game_handle)
+    {
+        for (int i = 0; i < 100 && game_handle.IsModuleLoaded(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+
+    std::atomic<int32_t> loaded_num_ = 0;
+    bool loadable_ = true;
+};
+
+TEST_F(TestGameHandle, load_module_when_making_game_options)
+{
+    const auto game_handle = MakeGameHandle(nullptr, true);
+    ASSERT_FALSE(game_handle->IsModuleLoaded());
+    ASSERT_EQ(0, loaded_num_);
+    const auto options = game_handle->make_game_options();
+    ASSERT_NE(nullptr, options);
+    ASSERT_TRUE(game_handle->IsModuleLoaded());
+    ASSERT_EQ(1, loaded_num_);
+    ASSERT_EQ(1, game_handle->ModuleLoadCount());
+}
+
+TEST_F(TestGameHandle, load_module_once)
+{
+    const auto game_handle = MakeGameHandle(nullptr, true);
+    const auto options_1 = game_handle->make_game_options();
+    const auto options_2 = game_handle->make_game_options();
+    ASSERT_EQ(1, loaded_num_);
+    ASSERT_EQ(1, game_handle->ModuleLoadCount());
+}
+
+TEST_F(TestGameHandle, load_module_failed)
+{
+    loadable_ = false;
+    const auto game_handle = MakeGameHandle(nullptr, true);
+    ASSERT_EQ(nullptr, game_handle->LoadModule());
+    ASSERT_FALSE(game_handle->IsModuleLoaded());
+}
+
+TEST_F(TestGameHandle, unload_idle_module_and_reload)
+{
+    const auto game_handle = MakeGameHandle(nullptr, true);
+    game_handle->make_game_options();
+    WaitUnloaded(*game_handle);
+    ASSERT_FALSE(game_handle->IsModuleLoaded());
+    ASSERT_EQ(0, loaded_num_);
+    const auto options = game_handle->make_game_options();
+    ASSERT_EQ(1, loaded_num_);
+    ASSERT_EQ(2, game_handle->ModuleLoadCount());
+}
+
+TEST_F(TestGameHandle, do_not_unload_module_in_use)
+{
+    const auto game_handle = MakeGameHandle(nullptr, true);
+    auto options = game_handle->make_game_options();
+    std::this_thread::sleep_for(k_idle_timeout * 3);
+    ASSERT_FALSE(game_handle->UnloadModuleIfIdle());
+    ASSERT_TRUE(game_handle->IsModuleLoaded());
+    options = nullptr;
+    WaitUnloaded(*game_handle);
+    ASSERT_FALSE(game_handle->IsModuleLoaded());
+}
+
+TEST_F(TestGameHandle, unload_module_loaded_at_startup)
+{
+    const auto game_handle = MakeGameHandle(LoadModule(), true);
+    ASSERT_TRUE(game_handle->IsModuleLoaded());
+    // the idle timeout is set after the handle is constructed, so unload it manually
+    std::this_thread::sleep_for(k_idle_timeout);
+    ASSERT_TRUE(game_handle->UnloadModuleIfIdle());
+    ASSERT_EQ(0, loaded_num_);
+}
+
+TEST_F(TestGameHandle, never_unload_module_which_cannot_be_reloaded)
+{
+    const auto game_handle = MakeGameHandle(LoadModule(), false);
+    game_handle->make_game_options();
+    std::this_thread::sleep_for(k_idle_timeout * 2);
+    ASSERT_FALSE(game_handle->UnloadModuleIfIdle());
+    ASSERT_TRUE(game_handle->IsModuleLoaded());
+}
+
+TEST_F(TestGameHandle, delete_objects_after_game_handle_destructed)
+{
+    auto game_handle = MakeGameHandle(nullptr, true);
+    auto options = game_handle->make_game_options();
+    game_handle = nullptr;
+    ASSERT_EQ(1, loaded_num_);
+    options = nullptr;
+    ASSERT_EQ(0, loaded_num_);
+}
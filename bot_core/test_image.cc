@@ -0,0 +1,191 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include <chrono>
+#include <atomic>
+#include <iterator>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "bot_core/image.h"
+
+// The fake image is the PNG signature followed by the width and the markdown.
+
+static const std::string k_png_signature = "\x89PNG\r\n\x1a\n";
+
+static std::string FakePng(const uint32_t width, const std::string_view markdown)
+{
+    return k_png_signature + std::to_string(width) + ":" + std::string(markdown);
+}
+
+static std::string ReadFile(const std::filesystem::path& path)
+{
+    std::ifstream f(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), {});
+}
+
+class TestImageCache : public testing::Test
+{
+  protected:
+    TestImageCache() : dir_(std::filesystem::temp_directory_path() / "lgtbot_test_image_cache"), render_num_(0)
+    {
+        std::filesystem::remove_all(dir_);
+    }
+
+    ~TestImageCache() { std::filesystem::remove_all(dir_); }
+
+    MarkdownImageCache::Renderer Renderer()
+    {
+        return [this](const std::string& markdown, const std::filesystem::path& path, const uint32_t width)
+            {
+                ++render_num_;
+                std::ofstream(path, std::ios::binary) << FakePng(width, markdown);
+                return 0;
+            };
+    }
+
+    const std::filesystem::path dir_;
+    std::atomic<uint32_t> render_num_;
+};
+
+TEST_F(TestImageCache, hit_same_markdown_and_width)
+{
+    MarkdownImageCache cache(dir_, 1024, Renderer());
+    const auto path = cache.Render("# title", 500);
+    ASSERT_EQ(FakePng(500, "# title"), ReadFile(path));
+    ASSERT_EQ(path, cache.Render("# title", 500));
+    ASSERT_EQ(1, render_num_);
+    const auto stat = cache.GetStat();
+    ASSERT_EQ(1, stat.hit_num_);
+    ASSERT_EQ(1, stat.miss_num_);
+    ASSERT_EQ(1, stat.image_num_);
+    ASSERT_EQ(FakePng(500, "# title").size() + std::string("# title").size(), stat.total_bytes_);
+}
+
+TEST_F(TestImageCache, miss_different_markdown_or_width)
+{
+    MarkdownImageCache cache(dir_, 1024, Renderer());
+    const auto path_1 = cache.Render("# title", 500);
+    const auto path_2 = cache.Render("# title", 600);
+    const auto path_3 = cache.Render("# another title", 500);
+    ASSERT_NE(path_1, path_2);
+    ASSERT_NE(path_1, path_3);
+    ASSERT_EQ(FakePng(600, "# title"), ReadFile(path_2));
+    ASSERT_EQ(3, render_num_);
+    ASSERT_EQ(3, cache.GetStat().miss_num_);
+}
+
+TEST_F(TestImageCache, evict_least_recently_used)
+{
+    const uint64_t image_size = FakePng(500, "#1").size() + std::string("#1").size();
+    MarkdownImageCache cache(dir_, image_size * 2, Renderer(), std::chrono::seconds(0));
+    const auto path_1 = cache.Render("#1", 500);
+    const auto path_2 = cache.Render("#2", 500);
+    cache.Render("#1", 500); // #2 becomes the least recently used
+    const auto path_3 = cache.Render("#3", 500);
+    ASSERT_TRUE(std::filesystem::exists(path_1));
+    ASSERT_FALSE(std::filesystem::exists(path_2));
+    ASSERT_TRUE(std::filesystem::exists(path_3));
+    ASSERT_EQ(2, cache.GetStat().image_num_);
+    ASSERT_EQ(image_size * 2, cache.GetStat().total_bytes_);
+}
+
+TEST_F(TestImageCache, remove_evicted_image_after_grace_period)
+{
+    const uint64_t image_size = FakePng(500, "#1").size() + std::string("#1").size();
+    MarkdownImageCache cache(dir_, image_size, Renderer(), std::chrono::milliseconds(100));
+    const auto path_1 = cache.Render("#1", 500);
+    const auto path_2 = cache.Render("#2", 500);
+    ASSERT_EQ(1, cache.GetStat().image_num_);
+    ASSERT_EQ(FakePng(500, "#1"), ReadFile(path_1)); // may be sending by the adapter
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    cache.Render("#3", 500);
+    ASSERT_FALSE(std::filesystem::exists(path_1));
+    ASSERT_FALSE(std::filesystem::exists(path_2));
+}
+
+TEST_F(TestImageCache, keep_image_rendered_again_during_grace_period)
+{
+    const uint64_t image_size = FakePng(500, "#1").size() + std::string("#1").size();
+    MarkdownImageCache cache(dir_, image_size, Renderer(), std::chrono::milliseconds(100));
+    const auto path_1 = cache.Render("#1", 500);
+    cache.Render("#2", 500);
+    ASSERT_EQ(path_1, cache.Render("#1", 500));
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    cache.Render("#1", 500);
+    ASSERT_EQ(FakePng(500, "#1"), ReadFile(path_1));
+    ASSERT_EQ(3, render_num_);
+}
+
+TEST_F(TestImageCache, rerender_if_source_mismatched)
+{
+    MarkdownImageCache cache(dir_, 1024, Renderer());
+    const auto path = cache.Render("# title", 500);
+    // pretend that another markdown has the same hash
+    std::ofstream(std::filesystem::path(path).replace_extension(".md"), std::ios::trunc) << "# another title";
+    ASSERT_EQ(path, cache.Render("# title", 500));
+    ASSERT_EQ(FakePng(500, "# title"), ReadFile(path));
+    ASSERT_EQ(2, render_num_);
+    ASSERT_EQ(0, cache.GetStat().hit_num_);
+}
+
+TEST_F(TestImageCache, rerender_removed_image)
+{
+    MarkdownImageCache cache(dir_, 1024, Renderer());
+    std::filesystem::remove(cache.Render("# title", 500));
+    ASSERT_EQ(FakePng(500, "# title"), ReadFile(cache.Render("# title", 500)));
+    ASSERT_EQ(2, render_num_);
+    ASSERT_EQ(1, cache.GetStat().image_num_);
+}
+
+TEST_F(TestImageCache, load_images_on_disk)
+{
+    {
+        MarkdownImageCache cache(dir_, 1024, Renderer());
+        cache.Render("# title", 500);
+    }
+    MarkdownImageCache cache(dir_, 1024, Renderer());
+    ASSERT_EQ(1, cache.GetStat().image_num_);
+    cache.Render("# title", 500);
+    ASSERT_EQ(1, render_num_);
+    ASSERT_EQ(1, cache.GetStat().hit_num_);
+}
+
+TEST_F(TestImageCache, not_load_images_without_source)
+{
+    std::filesystem::path path;
+    {
+        MarkdownImageCache cache(dir_, 1024, Renderer());
+        path = cache.Render("# title", 500);
+    }
+    std::filesystem::remove(std::filesystem::path(path).replace_extension(".md"));
+    MarkdownImageCache cache(dir_, 1024, Renderer());
+    ASSERT_EQ(0, cache.GetStat().image_num_);
+    ASSERT_FALSE(std::filesystem::exists(path));
+}
+
+TEST_F(TestImageCache, store_names_by_content)
+{
+    ImageStore store(dir_, 2);
+    const auto path_a = store.Save(FakePng(1, "a"));
+    ASSERT_TRUE(std::filesystem::exists(path_a));
+    ASSERT_EQ(path_a, store.Save(FakePng(1, "a")));
+    const auto path_b = store.Save(FakePng(1, "b"));
+    ASSERT_NE(path_a, path_b);
+    store.Save(FakePng(1, "c"));
+    ASSERT_FALSE(std::filesystem::exists(path_a));
+    ASSERT_TRUE(std::filesystem::exists(path_b));
+}
+
+TEST_F(TestImageCache, store_keep_images_until_cleared)
+{
+    const auto path = ImageStore(dir_, 2).Save(FakePng(1, "a"));
+    ImageStore store(dir_, 2);
+    ASSERT_TRUE(std::filesystem::exists(path)); // the images saved by other stores are not removed
+    store.Clear();
+    ASSERT_FALSE(std::filesystem::exists(path));
+    ASSERT_EQ(path, store.Save(FakePng(1, "a")));
+    ASSERT_TRUE(std::filesystem::exists(path));
+}
@@ -0,0 +1,262 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include <fstream>
+#include <future>
+
+#include <gtest/gtest.h>
+
+#include "bot_core/match_recorder.h"
+
+class MockDBManager : public DBManagerBase
+{
+  public:
+    virtual std::vector<ScoreInfo> RecordMatch(const std::string& game_name, const std::optional<GroupID> gid,
+            const UserID& host_uid, const uint64_t multiple,
+            const std::vector<std::pair<UserID, int64_t>>& game_score_infos,
+            const std::vector<std::pair<UserID, std::string>>& achievements) override
+    {
+        if (game_name == "fail") {
+            return {};
+        }
+        std::vector<ScoreInfo> score_infos;
+        for (const auto& [uid, game_score] : game_score_infos) {
+            score_infos.emplace_back(ScoreInfo{.uid_ = uid, .game_score_ = game_score});
+        }
+        records_.emplace_back(MatchRecord{game_name, gid, host_uid, multiple, game_score_infos, achievements});
+        return score_infos;
+    }
+
+    virtual std::vector<std::vector<ScoreInfo>> RecordMatches(const std::vector<MatchRecord>& records) override
+    {
+        if (blocker_.valid()) {
+            blocker_.wait();
+        }
+        if (fail_num_ > 0) {
+            --fail_num_;
+            return {}; // the transaction failed
+        }
+        batch_sizes_.emplace_back(records.size());
+        for (const auto& record : records) {
+            record_ids_.emplace_back(record.record_id_);
+        }
+        return DBManagerBase::RecordMatches(records);
+    }
+
+    virtual UserProfile GetUserProfile(const UserID& uid, const std::string_view& time_range_begin,
+            const std::string_view& time_range_end) override { return {}; }
+    virtual bool Suicide(const UserID& uid, const uint32_t required_match_num) override { return true; }
+    virtual RankInfo GetRank(const std::string_view& time_range_begin, const std::string_view& time_range_end) override
+    {
+        return {};
+    }
+    virtual GameRankInfo GetLevelScoreRank(const std::string& game_name, const std::string_view& time_range_begin,
+            const std::string_view& time_range_end) override { return {}; }
+    virtual AchievementStatisticInfo GetAchievementStatistic(const UserID& uid, const std::string& game_name,
+            const std::string& achievement_name) override { return {}; }
+    virtual std::vector<HonorInfo> GetHonors() override { return {}; }
+    virtual bool AddHonor(const UserID& uid, const std::string_view& description) override { return true; }
+    virtual bool DeleteHonor(const int32_t id) override { return true; }
+
+    std::shared_future<void> blocker_;
+    uint32_t fail_num_ = 0;
+    std::vector<uint64_t> batch_sizes_;
+    std::vector<MatchRecord> records_;
+    std::vector<std::string> record_ids_;
+};
+
+static MatchRecord MakeRecord(const std::string& game_name, const std::optional<GroupID> gid = std::nullopt)
+{
+    return MatchRecord{
+        .game_name_ = game_name,
+        .gid_ = gid,
+        .host_uid_ = "1",
+        .multiple_ = 1,
+        .game_score_infos_ = {{"1", 10}, {"2", -10}},
+        .achievements_ = {{"1", "普通成就"}},
+    };
+}
+
+class TestMatchRecorder : public testing::Test
+{
+  protected:
+    TestMatchRecorder() : journal_path_(std::filesystem::temp_directory_path() / "lgtbot_test_match_recorder.journal")
+    {
+        std::filesystem::remove(journal_path_);
+    }
+
+    ~TestMatchRecorder() { std::filesystem::remove(journal_path_); }
+
+    const std::filesystem::path journal_path_;
+    MockDBManager db_manager_;
+};
+
+TEST_F(TestMatchRecorder, record_and_callback)
+{
+    MatchRecorder recorder(db_manager_, {});
+    std::vector<ScoreInfo> score_infos;
+    recorder.Record(MakeRecord("game", GroupID("100")), [&](std::vector<ScoreInfo> ret) { score_infos = std::move(ret); });
+    recorder.WaitIdle();
+    ASSERT_EQ(2, score_infos.size());
+    ASSERT_EQ(UserID("1"), score_infos[0].uid_);
+    ASSERT_EQ(10, score_infos[0].game_score_);
+    ASSERT_EQ(1, db_manager_.records_.size());
+    ASSERT_EQ(GroupID("100"), db_manager_.records_[0].gid_);
+    ASSERT_EQ(0, recorder.PendingNum());
+}
+
+TEST_F(TestMatchRecorder, callback_with_empty_score_infos_when_failed)
+{
+    MatchRecorder recorder(db_manager_, {});
+    std::optional<std::vector<ScoreInfo>> score_infos;
+    recorder.Record(MakeRecord("fail"), [&](std::vector<ScoreInfo> ret) { score_infos = std::move(ret); });
+    recorder.WaitIdle();
+    ASSERT_TRUE(score_infos.has_value());
+    ASSERT_TRUE(score_infos->empty());
+}
+
+TEST_F(TestMatchRecorder, batch_records_queued_while_recording)
+{
+    std::promise<void> unblock;
+    db_manager_.blocker_ = unblock.get_future().share();
+    MatchRecorder recorder(db_manager_, {});
+    uint64_t callback_num = 0;
+    for (uint64_t i = 0; i < MatchRecorder::k_max_batch_size + 1; ++i) {
+        recorder.Record(MakeRecord(std::to_string(i)), [&](std::vector<ScoreInfo>) { ++callback_num; });
+    }
+    unblock.set_value();
+    recorder.WaitIdle();
+    ASSERT_EQ(MatchRecorder::k_max_batch_size + 1, callback_num);
+    ASSERT_GE(db_manager_.batch_sizes_.size(), 2);
+    ASSERT_LT(db_manager_.batch_sizes_.size(), MatchRecorder::k_max_batch_size + 1);
+    for (uint64_t i = 0; i < db_manager_.records_.size(); ++i) {
+        ASSERT_EQ(std::to_string(i), db_manager_.records_[i].game_name_); // keep the order
+    }
+}
+
+TEST_F(TestMatchRecorder, write_queued_records_when_destructed)
+{
+    std::promise<void> unblock;
+    db_manager_.blocker_ = unblock.get_future().share();
+    {
+        MatchRecorder recorder(db_manager_, {});
+        for (uint64_t i = 0; i < 10; ++i) {
+            recorder.Record(MakeRecord("game"), nullptr);
+        }
+        unblock.set_value();
+    }
+    ASSERT_EQ(10, db_manager_.records_.size());
+}
+
+TEST_F(TestMatchRecorder, clear_journal_when_all_records_written)
+{
+    MatchRecorder recorder(db_manager_, journal_path_);
+    recorder.Record(MakeRecord("game"), nullptr);
+    recorder.WaitIdle();
+    ASSERT_EQ(0, std::filesystem::file_size(journal_path_));
+}
+
+TEST_F(TestMatchRecorder, recover_records_from_journal)
+{
+    std::promise<void> unblock;
+    db_manager_.blocker_ = unblock.get_future().share();
+    {
+        // the records are not written because the bot "crashes" before the database is unblocked
+        MatchRecorder recorder(db_manager_, journal_path_);
+        recorder.Record(MakeRecord("game\twith\\special\ncharacters", GroupID("100")), nullptr);
+        recorder.Record(MakeRecord("private game"), nullptr);
+        std::filesystem::copy_file(journal_path_, std::filesystem::path(journal_path_) += ".bak");
+        unblock.set_value();
+    }
+    std::filesystem::rename(std::filesystem::path(journal_path_) += ".bak", journal_path_);
+    std::ofstream(journal_path_, std::ios::app) << "R\t3\tincomplete"; // the line being written when crashing
+
+    MockDBManager recovered_db_manager;
+    MatchRecorder recorder(recovered_db_manager, journal_path_);
+    recorder.WaitIdle();
+    ASSERT_EQ(2, recovered_db_manager.records_.size());
+    const auto& record = recovered_db_manager.records_[0];
+    ASSERT_EQ("game\twith\\special\ncharacters", record.game_name_);
+    ASSERT_EQ(GroupID("100"), record.gid_);
+    ASSERT_EQ(UserID("1"), record.host_uid_);
+    ASSERT_EQ(1, record.multiple_);
+    ASSERT_EQ((std::vector<std::pair<UserID, int64_t>>{{"1", 10}, {"2", -10}}), record.game_score_infos_);
+    ASSERT_EQ((std::vector<std::pair<UserID, std::string>>{{"1", "普通成就"}}), record.achievements_);
+    ASSERT_EQ("private game", recovered_db_manager.records_[1].game_name_);
+    ASSERT_FALSE(recovered_db_manager.records_[1].gid_.has_value());
+    ASSERT_EQ(0, std::filesystem::file_size(journal_path_));
+    // the database skips the records which have been written by their ids
+    ASSERT_EQ(db_manager_.record_ids_, recovered_db_manager.record_ids_);
+}
+
+TEST_F(TestMatchRecorder, keep_failed_records_in_journal)
+{
+    db_manager_.fail_num_ = 1;
+    {
+        MatchRecorder recorder(db_manager_, journal_path_);
+        std::optional<std::vector<ScoreInfo>> score_infos;
+        recorder.Record(MakeRecord("failed game"), [&](std::vector<ScoreInfo> ret) { score_infos = std::move(ret); });
+        recorder.WaitIdle();
+        ASSERT_TRUE(score_infos.has_value());
+        ASSERT_TRUE(score_infos->empty());
+        recorder.Record(MakeRecord("game"), nullptr);
+        recorder.WaitIdle();
+        ASSERT_EQ(1, db_manager_.records_.size());
+        ASSERT_NE(0, std::filesystem::file_size(journal_path_)); // not cleared because of the failed record
+    }
+
+    MockDBManager recovered_db_manager;
+    MatchRecorder recorder(recovered_db_manager, journal_path_);
+    recorder.WaitIdle();
+    ASSERT_EQ(2, recovered_db_manager.records_.size());
+    ASSERT_EQ("failed game", recovered_db_manager.records_[0].game_name_);
+    ASSERT_EQ("game", recovered_db_manager.records_[1].game_name_); // skipped by its id in the real database
+    ASSERT_EQ(0, std::filesystem::file_size(journal_path_));
+}
+
+TEST_F(TestMatchRecorder, unique_record_ids)
+{
+    {
+        MatchRecorder recorder(db_manager_, journal_path_);
+        recorder.Record(MakeRecord("game"), nullptr);
+        recorder.Record(MakeRecord("game"), nullptr);
+    }
+    MatchRecorder recorder(db_manager_, journal_path_);
+    recorder.Record(MakeRecord("game"), nullptr);
+    recorder.WaitIdle();
+    ASSERT_EQ(3, db_manager_.record_ids_.size());
+    ASSERT_FALSE(db_manager_.record_ids_[0].empty());
+    ASSERT_NE(db_manager_.record_ids_[0], db_manager_.record_ids_[1]);
+    ASSERT_NE(db_manager_.record_ids_[0], db_manager_.record_ids_[2]); // the seq restarts but the prefix changes
+}
+
+TEST_F(TestMatchRecorder, no_record_id_without_journal)
+{
+    MatchRecorder recorder(db_manager_, {});
+    recorder.Record(MakeRecord("game"), nullptr);
+    recorder.WaitIdle();
+    ASSERT_EQ(std::vector<std::string>{""}, db_manager_.record_ids_);
+}
+
+TEST_F(TestMatchRecorder, ignore_broken_commit_entry)
+{
+    std::ofstream(journal_path_) << "R\t1\tx-1\tgame_1\t\t1\t1\t2\t1\t10\t2\t-10\t0\n"
+                                    "C\tbroken\n";
+    MatchRecorder recorder(db_manager_, journal_path_);
+    recorder.WaitIdle();
+    ASSERT_EQ(std::vector<std::string>{"x-1"}, db_manager_.record_ids_);
+}
+
+TEST_F(TestMatchRecorder, skip_committed_records_in_journal)
+{
+    std::ofstream(journal_path_) << "R\t1\tx-1\tgame_1\t\t1\t1\t2\t1\t10\t2\t-10\t0\n"
+                                    "R\t2\tx-2\tgame_2\t\t1\t1\t2\t1\t10\t2\t-10\t0\n"
+                                    "C\t1\n"
+                                    "R\t3\tx-3\tgame_3\t\t1\t1\t2\t1\t10\t2\t-10\t0\n";
+    MatchRecorder recorder(db_manager_, journal_path_);
+    recorder.WaitIdle();
+    ASSERT_EQ(2, db_manager_.records_.size());
+    ASSERT_EQ("game_2", db_manager_.records_[0].game_name_);
+    ASSERT_EQ("game_3", db_manager_.records_[1].game_name_);
+}
@@ -0,0 +1,193 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "bot_core/metrics.h"
+#include "bot_core/metrics_snapshotter.h"
+
+using namespace std::chrono_literals;
+
+TEST(TestMetrics, bucket_index_is_monotonic)
+{
+    uint32_t last_index = 0;
+    for (uint64_t value = 0; value < (1 << 20); ++value) {
+        const auto index = Histogram::BucketIndex(value);
+        ASSERT_LE(last_index, index);
+        ASSERT_LE(value, Histogram::BucketUpperBound(index));
+        last_index = index;
+    }
+    ASSERT_GT(Histogram::k_bucket_num_, Histogram::BucketIndex(UINT64_MAX));
+}
+
+TEST(TestMetrics, histogram_percentiles)
+{
+    Histogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.Record(value);
+    }
+    const auto summary = histogram.GetSummary();
+    ASSERT_EQ(1000, summary.count_);
+    ASSERT_EQ(500500, summary.sum_);
+    ASSERT_EQ(1000, summary.max_);
+    // the relative error is less than 1/16
+    ASSERT_NEAR(500, summary.p50_, 500 / 16);
+    ASSERT_NEAR(900, summary.p90_, 900 / 16);
+    ASSERT_NEAR(990, summary.p99_, 990 / 16);
+}
+
+TEST(TestMetrics, empty_histogram)
+{
+    const auto summary = Histogram().GetSummary();
+    ASSERT_EQ(0, summary.count_);
+    ASSERT_EQ(0, summary.p99_);
+}
+
+TEST(TestMetrics, record_concurrently)
+{
+    Counter counter;
+    Histogram histogram;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i]
+                {
+                    for (int j = 0; j < 10000; ++j) {
+                        counter.Add();
+                        histogram.Record(i * 10000 + j);
+                    }
+                });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(40000, counter.Get());
+    ASSERT_EQ(40000, histogram.GetSummary().count_);
+    ASSERT_EQ(39999, histogram.GetSummary().max_);
+}
+
+TEST(TestMetrics, latency_scope)
+{
+    Histogram histogram;
+    {
+        const LatencyScope scope(histogram);
+        std::this_thread::sleep_for(10ms);
+    }
+    ASSERT_EQ(1, histogram.GetSummary().count_);
+    ASSERT_LE(10000, histogram.GetSummary().max_);
+}
+
+TEST(TestMetrics, same_name_same_metric)
+{
+    Metrics metrics;
+    metrics.GetCounter("a").Add(2);
+    metrics.GetCounter("a").Add(3);
+    ASSERT_EQ(5, metrics.GetCounter("a").Get());
+    ASSERT_EQ(&metrics.GetHistogram("b"), &metrics.GetHistogram("b"));
+}
+
+TEST(TestMetrics, snapshot)
+{
+    Metrics metrics;
+    metrics.GetCounter("request.num").Add(3);
+    metrics.GetHistogram("request.game.猜拳").Record(100);
+    metrics.GetHistogram("db.get_rank").Record(20);
+    const auto guard = metrics.RegisterGauge("queue.pending", [] { return 7; });
+    ASSERT_EQ("counter request.num 3\n"
+              "gauge queue.pending 7\n"
+              "histogram db.get_rank count=1 avg_us=20 p50_us=20 p90_us=20 p99_us=20 max_us=20\n"
+              "histogram request.game.猜拳 count=1 avg_us=100 p50_us=100 p90_us=100 p99_us=100 max_us=100\n",
+              metrics.Snapshot());
+    ASSERT_EQ("counter request.num 3\n"
+              "histogram request.game.猜拳 count=1 avg_us=100 p50_us=100 p90_us=100 p99_us=100 max_us=100\n",
+              metrics.Snapshot("request."));
+}
+
+TEST(TestMetrics, gauge_is_unregistered_by_guard)
+{
+    Metrics metrics;
+    {
+        const auto guard = metrics.RegisterGauge("queue.pending", [] { return 1; });
+        ASSERT_EQ("gauge queue.pending 1\n", metrics.Snapshot());
+    }
+    ASSERT_EQ("", metrics.Snapshot());
+}
+
+TEST(TestMetrics, replaced_gauge_is_not_unregistered_by_old_guard)
+{
+    Metrics metrics;
+    std::optional<Metrics::GaugeGuard> old_guard = metrics.RegisterGauge("queue.pending", [] { return 1; });
+    const auto new_guard = metrics.RegisterGauge("queue.pending", [] { return 2; });
+    old_guard.reset();
+    ASSERT_EQ("gauge queue.pending 2\n", metrics.Snapshot());
+}
+
+TEST(TestMetrics, latency_scope_macro)
+{
+    for (int i = 0; i < 3; ++i) {
+        METRICS_LATENCY_SCOPE("test.latency_scope_macro");
+    }
+    ASSERT_EQ(3, Metrics::Get().GetHistogram("test.latency_scope_macro").GetSummary().count_);
+}
+
+class TestMetricsSnapshotter : public testing::Test
+{
+  protected:
+    TestMetricsSnapshotter()
+        : wheel_(2, 10ms, 8), path_(std::filesystem::temp_directory_path() / "lgtbot_test_metrics.txt")
+    {
+        std::filesystem::remove(path_);
+    }
+
+    ~TestMetricsSnapshotter() { std::filesystem::remove(path_); }
+
+    bool WaitFile_()
+    {
+        for (int i = 0; i < 200 && !std::filesystem::exists(path_); ++i) {
+            std::this_thread::sleep_for(10ms);
+        }
+        return std::filesystem::exists(path_);
+    }
+
+    TimerWheel wheel_;
+    const std::filesystem::path path_;
+};
+
+TEST_F(TestMetricsSnapshotter, write_snapshot)
+{
+    Metrics::Get().GetCounter("test.snapshotter").Add();
+    const MetricsSnapshotter snapshotter(path_, [] { return 20ms; }, wheel_);
+    ASSERT_TRUE(WaitFile_());
+    std::ifstream f(path_);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    const auto content = ss.str();
+    ASSERT_TRUE(content.starts_with("time ")) << content;
+    ASSERT_NE(std::string::npos, content.find("\ncounter test.snapshotter 1\n")) << content;
+}
+
+TEST_F(TestMetricsSnapshotter, paused_snapshotter_writes_nothing)
+{
+    {
+        const MetricsSnapshotter snapshotter(path_, [] { return 0ms; }, wheel_);
+        std::this_thread::sleep_for(100ms);
+    }
+    ASSERT_FALSE(std::filesystem::exists(path_));
+    ASSERT_EQ(0, wheel_.PendingNum());
+}
+
+TEST_F(TestMetricsSnapshotter, stop_when_destructed)
+{
+    {
+        const MetricsSnapshotter snapshotter(path_, [] { return 20ms; }, wheel_);
+        ASSERT_TRUE(WaitFile_());
+    }
+    ASSERT_EQ(0, wheel_.PendingNum());
+    std::filesystem::remove(path_);
+    std::this_thread::sleep_for(100ms);
+    ASSERT_FALSE(std::filesystem::exists(path_));
+}
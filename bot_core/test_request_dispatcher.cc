@@ -0,0 +1,105 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include <atomic>
+#include <future>
+
+#include <gtest/gtest.h>
+
+#include "bot_core/request_dispatcher.h"
+
+using Lane = RequestDispatcher::Lane;
+
+TEST(TestRequestDispatcher, handle_requests_in_same_lane_in_order)
+{
+    RequestDispatcher dispatcher(4);
+    std::vector<uint32_t> order;
+    std::atomic<uint32_t> running_num = 0;
+    std::atomic<bool> overlapped = false;
+    for (uint32_t i = 0; i < 100; ++i) {
+        dispatcher.Dispatch(Lane::MATCH, 1, [&, i]
+                {
+                    overlapped = overlapped || running_num++ > 0;
+                    order.emplace_back(i);
+                    --running_num;
+                });
+    }
+    dispatcher.WaitIdle();
+    ASSERT_FALSE(overlapped);
+    ASSERT_EQ(100, order.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        ASSERT_EQ(i, order[i]);
+    }
+}
+
+TEST(TestRequestDispatcher, handle_requests_in_different_lanes_in_parallel)
+{
+    RequestDispatcher dispatcher(3);
+    std::promise<void> unblock;
+    const auto blocker = unblock.get_future().share();
+    dispatcher.Dispatch(Lane::MATCH, 1, [&] { blocker.wait(); });
+    dispatcher.Dispatch(Lane::MATCH, 2, [&] { blocker.wait(); });
+
+    // the match lanes are blocked, but the meta lane and the admin lane are not
+    std::promise<void> meta_handled;
+    std::promise<void> admin_handled;
+    dispatcher.Dispatch(Lane::META, {}, [&] { meta_handled.set_value(); });
+    dispatcher.Dispatch(Lane::ADMIN, {}, [&] { admin_handled.set_value(); });
+    ASSERT_EQ(std::future_status::ready, meta_handled.get_future().wait_for(std::chrono::seconds(10)));
+    ASSERT_EQ(std::future_status::ready, admin_handled.get_future().wait_for(std::chrono::seconds(10)));
+
+    const auto stat = dispatcher.GetStat();
+    ASSERT_EQ(2, stat.running_num_);
+    ASSERT_EQ(2, stat.handled_num_);
+    unblock.set_value();
+    dispatcher.WaitIdle();
+}
+
+TEST(TestRequestDispatcher, report_pending_num_and_latency)
+{
+    RequestDispatcher dispatcher(1);
+    std::promise<void> unblock;
+    const auto blocker = unblock.get_future().share();
+    dispatcher.Dispatch(Lane::MATCH, 1, [&] { blocker.wait(); });
+    for (uint32_t i = 0; i < 5; ++i) {
+        dispatcher.Dispatch(Lane::MATCH, 2, [] { std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+    }
+    while (dispatcher.GetStat().running_num_ == 0) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(5, dispatcher.GetStat().pending_num_);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    unblock.set_value();
+    dispatcher.WaitIdle();
+
+    const auto stat = dispatcher.GetStat();
+    ASSERT_EQ(0, stat.pending_num_);
+    ASSERT_EQ(0, stat.running_num_);
+    ASSERT_EQ(6, stat.handled_num_);
+    ASSERT_GE(stat.max_wait_time_, std::chrono::milliseconds(10));
+    ASSERT_GE(stat.max_handle_time_, std::chrono::milliseconds(10));
+    ASSERT_GE(stat.total_handle_time_, std::chrono::milliseconds(15));
+}
+
+TEST(TestRequestDispatcher, handle_dispatched_requests_when_destructed)
+{
+    std::atomic<uint32_t> handled_num = 0;
+    {
+        RequestDispatcher dispatcher(2);
+        for (uint32_t i = 0; i < 100; ++i) {
+            dispatcher.Dispatch(Lane::MATCH, i % 3, [&] { ++handled_num; });
+        }
+    }
+    ASSERT_EQ(100, handled_num);
+}
+
+TEST(TestRequestDispatcher, exception_does_not_stop_lane)
+{
+    RequestDispatcher dispatcher(1);
+    bool handled = false;
+    dispatcher.Dispatch(Lane::META, {}, [] { throw std::runtime_error("bad request"); });
+    dispatcher.Dispatch(Lane::META, {}, [&] { handled = true; });
+    dispatcher.WaitIdle();
+    ASSERT_TRUE(handled);
+}
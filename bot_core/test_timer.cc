@@ -0,0 +1,189 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include <fstream>
+#include <future>
+#include <numeric>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "bot_core/timer.h"
+
+using namespace std::chrono_literals;
+
+static uint64_t ThreadCount()
+{
+#ifdef __linux__
+    std::ifstream f("/proc/self/status");
+    for (std::string line; std::getline(f, line); ) {
+        if (line.starts_with("Threads:")) {
+            return std::stoull(line.substr(8));
+        }
+    }
+#endif
+    return 0;
+}
+
+class TestTimer : public testing::Test
+{
+  protected:
+    TestTimer() : wheel_(2, 10ms, 8) {}
+
+    TimerWheel wheel_;
+};
+
+TEST_F(TestTimer, expire_in_order)
+{
+    std::mutex mutex;
+    std::vector<int> order;
+    std::promise<void> done;
+    const auto record = [&](const int i)
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            order.emplace_back(i);
+            if (order.size() == 3) {
+                done.set_value();
+            }
+        };
+    wheel_.Schedule(60ms, [&] { record(3); });
+    wheel_.Schedule(20ms, [&] { record(1); });
+    wheel_.Schedule(40ms, [&] { record(2); });
+    ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(2s));
+    ASSERT_EQ((std::vector<int>{1, 2, 3}), order);
+    ASSERT_EQ(0, wheel_.PendingNum());
+}
+
+TEST_F(TestTimer, expire_after_several_rounds)
+{
+    // 8 slots with 10ms tick, so the timer should wait for more than one round
+    const auto begin = std::chrono::steady_clock::now();
+    std::promise<std::chrono::steady_clock::time_point> expired;
+    wheel_.Schedule(250ms, [&] { expired.set_value(std::chrono::steady_clock::now()); });
+    auto fut = expired.get_future();
+    ASSERT_EQ(std::future_status::ready, fut.wait_for(2s));
+    ASSERT_LE(240ms, fut.get() - begin);
+}
+
+TEST_F(TestTimer, cancel)
+{
+    std::atomic<bool> expired = false;
+    const auto id = wheel_.Schedule(30ms, [&] { expired = true; });
+    ASSERT_EQ(1, wheel_.PendingNum());
+    ASSERT_TRUE(wheel_.Cancel(id));
+    ASSERT_FALSE(wheel_.Cancel(id));
+    ASSERT_EQ(0, wheel_.PendingNum());
+    std::this_thread::sleep_for(100ms);
+    ASSERT_FALSE(expired);
+}
+
+TEST_F(TestTimer, post_to_workers)
+{
+    std::promise<std::thread::id> promise;
+    wheel_.Post([&] { promise.set_value(std::this_thread::get_id()); });
+    auto fut = promise.get_future();
+    ASSERT_EQ(std::future_status::ready, fut.wait_for(2s));
+    ASSERT_NE(std::this_thread::get_id(), fut.get());
+}
+
+TEST_F(TestTimer, timer_run_tasks_one_by_one)
+{
+    std::mutex mutex;
+    std::vector<int> order;
+    std::promise<void> done;
+    Timer::TaskSet tasks;
+    tasks.emplace_back(0, [&] { std::lock_guard<std::mutex> l(mutex); order.emplace_back(1); });
+    tasks.emplace_back(1, [&] { std::lock_guard<std::mutex> l(mutex); order.emplace_back(2); done.set_value(); });
+    Timer timer(std::move(tasks), wheel_);
+    ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(3s));
+    ASSERT_EQ((std::vector<int>{1, 2}), order);
+}
+
+TEST_F(TestTimer, release_timer_stop_tasks)
+{
+    std::atomic<bool> expired = false;
+    {
+        Timer::TaskSet tasks;
+        tasks.emplace_back(1, [&] { expired = true; });
+        Timer timer(std::move(tasks), wheel_);
+        ASSERT_EQ(1, wheel_.PendingNum());
+    }
+    ASSERT_EQ(0, wheel_.PendingNum());
+    std::this_thread::sleep_for(1200ms);
+    ASSERT_FALSE(expired);
+}
+
+TEST_F(TestTimer, release_timer_in_handle)
+{
+    std::promise<void> done;
+    std::unique_ptr<Timer> timer;
+    std::mutex mutex;
+    Timer::TaskSet tasks;
+    tasks.emplace_back(0, [&]
+            {
+                std::lock_guard<std::mutex> l(mutex);
+                timer = nullptr;
+                done.set_value();
+            });
+    tasks.emplace_back(1, [] {});
+    {
+        std::lock_guard<std::mutex> l(mutex);
+        timer = std::make_unique<Timer>(std::move(tasks), wheel_);
+    }
+    ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(2s));
+    ASSERT_EQ(0, wheel_.PendingNum());
+}
+
+// Each match holds a timer with alerts like Match::StartTimer. Switching stage means stopping the old timer and starting
+// a new one.
+TEST_F(TestTimer, benchmark_1k_matches)
+{
+    static constexpr uint64_t k_match_num = 1000;
+    static constexpr uint64_t k_switch_round = 10;
+    const auto make_tasks = []
+        {
+            Timer::TaskSet tasks;
+            tasks.emplace_back(20, [] {});
+            tasks.emplace_back(20, [] {});
+            tasks.emplace_back(10, [] {});
+            tasks.emplace_back(10, [] {});
+            return tasks;
+        };
+
+    TimerWheel& wheel = TimerWheel::Get();
+    const uint64_t thread_count_before = ThreadCount();
+
+    std::vector<std::unique_ptr<Timer>> timers(k_match_num);
+    for (auto& timer : timers) {
+        timer = std::make_unique<Timer>(make_tasks(), wheel);
+    }
+    const uint64_t thread_count_after = ThreadCount();
+
+    std::vector<double> latencies_us;
+    latencies_us.reserve(k_match_num * k_switch_round);
+    for (uint64_t round = 0; round < k_switch_round; ++round) {
+        for (auto& timer : timers) {
+            const auto begin = std::chrono::steady_clock::now();
+            timer = nullptr;
+            timer = std::make_unique<Timer>(make_tasks(), wheel);
+            latencies_us.emplace_back(
+                    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+        }
+    }
+    std::ranges::sort(latencies_us);
+    const double avg_us = std::accumulate(latencies_us.begin(), latencies_us.end(), 0.0) / latencies_us.size();
+
+    std::cout << "[BENCHMARK] matches=" << k_match_num
+              << " threads_before=" << thread_count_before
+              << " threads_after=" << thread_count_after
+              << " wheel_threads=" << (wheel.WorkerNum() + 1)
+              << " switch_avg_us=" << avg_us
+              << " switch_p50_us=" << latencies_us[latencies_us.size() / 2]
+              << " switch_p99_us=" << latencies_us[latencies_us.size() * 99 / 100] << std::endl;
+
+    ASSERT_EQ(k_match_num, wheel.PendingNum());
+    ASSERT_EQ(thread_count_before, thread_count_after);
+    timers.clear();
+    ASSERT_EQ(0, wheel.PendingNum());
+}
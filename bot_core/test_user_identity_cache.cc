@@ -0,0 +1,151 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "bot_core/user_identity_cache.h"
+
+class TestUserIdentityCache : public testing::Test
+{
+  protected:
+    std::unique_ptr<UserIdentityCache> MakeCache(const uint64_t capacity = 100,
+            const std::chrono::milliseconds ttl = std::chrono::seconds(100),
+            const std::chrono::milliseconds fetch_time = std::chrono::milliseconds(0))
+    {
+        return std::make_unique<UserIdentityCache>(capacity, ttl,
+                [this, fetch_time](const UserID& uid, const std::optional<GroupID>& gid)
+                {
+                    ++fetch_num_;
+                    std::this_thread::sleep_for(fetch_time);
+                    return uid.GetStr() + (gid.has_value() ? "@" + gid->GetStr() : "") + "#" + version_;
+                },
+                [this, fetch_time](const UserID& uid, const int32_t size)
+                {
+                    ++fetch_num_;
+                    std::this_thread::sleep_for(fetch_time);
+                    return uid.GetStr() + ":" + std::to_string(size) + "#" + version_;
+                });
+    }
+
+    std::atomic<uint64_t> fetch_num_ = 0;
+    std::string version_ = "1";
+};
+
+TEST_F(TestUserIdentityCache, fetch_once_for_same_key)
+{
+    auto cache = MakeCache();
+    ASSERT_EQ("a#1", cache->UserName("a", std::nullopt));
+    version_ = "2";
+    ASSERT_EQ("a#1", cache->UserName("a", std::nullopt));
+    ASSERT_EQ(1, fetch_num_);
+    const auto stat = cache->GetStat();
+    ASSERT_EQ(1, stat.hit_num_);
+    ASSERT_EQ(1, stat.miss_num_);
+    ASSERT_EQ(1, stat.entry_num_);
+}
+
+TEST_F(TestUserIdentityCache, key_by_uid_gid_and_size)
+{
+    auto cache = MakeCache();
+    ASSERT_EQ("a#1", cache->UserName("a", std::nullopt));
+    ASSERT_EQ("a@g#1", cache->UserName("a", GroupID("g")));
+    ASSERT_EQ("b@g#1", cache->UserName("b", GroupID("g")));
+    ASSERT_EQ("a:30#1", cache->UserAvatar("a", 30));
+    ASSERT_EQ("a:40#1", cache->UserAvatar("a", 40));
+    ASSERT_EQ(5, fetch_num_);
+    ASSERT_EQ("a@g#1", cache->UserName("a", GroupID("g")));
+    ASSERT_EQ("a:30#1", cache->UserAvatar("a", 30));
+    ASSERT_EQ(5, fetch_num_);
+}
+
+TEST_F(TestUserIdentityCache, refetch_when_expired)
+{
+    auto cache = MakeCache(100, std::chrono::milliseconds(20));
+    ASSERT_EQ("a#1", cache->UserName("a", std::nullopt));
+    version_ = "2";
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    ASSERT_EQ("a#2", cache->UserName("a", std::nullopt));
+    ASSERT_EQ(2, fetch_num_);
+}
+
+TEST_F(TestUserIdentityCache, evict_least_recently_used)
+{
+    auto cache = MakeCache(2);
+    cache->UserName("a", std::nullopt);
+    cache->UserName("b", std::nullopt);
+    cache->UserName("a", std::nullopt); // b is the least recently used
+    cache->UserName("c", std::nullopt);
+    ASSERT_EQ(2, cache->GetStat().entry_num_);
+    ASSERT_EQ(3, fetch_num_);
+    cache->UserName("a", std::nullopt);
+    ASSERT_EQ(3, fetch_num_);
+    cache->UserName("b", std::nullopt);
+    ASSERT_EQ(4, fetch_num_);
+}
+
+TEST_F(TestUserIdentityCache, prefetch_concurrently)
+{
+    auto cache = MakeCache(100, std::chrono::seconds(100), std::chrono::milliseconds(50));
+    cache->UserName("a", GroupID("g"));
+    const std::vector<UserID> uids{"a", "b", "c", "d", "b"};
+    const auto begin = std::chrono::steady_clock::now();
+    cache->Prefetch(uids, GroupID("g"), {30});
+    const auto cost = std::chrono::steady_clock::now() - begin;
+    ASSERT_EQ(1 + 3 + 4, fetch_num_); // the name of a is cached and b is duplicated
+    ASSERT_LT(cost, std::chrono::milliseconds(50 * 7));
+    for (const auto& uid : uids) {
+        cache->UserName(uid, GroupID("g"));
+        cache->UserAvatar(uid, 30);
+    }
+    ASSERT_EQ(1 + 3 + 4, fetch_num_);
+}
+
+TEST_F(TestUserIdentityCache, prefetch_async)
+{
+    auto cache = MakeCache(100, std::chrono::seconds(100), std::chrono::milliseconds(50));
+    const std::vector<UserID> uids{"a", "b", "c"};
+    const auto begin = std::chrono::steady_clock::now();
+    cache->PrefetchAsync(uids, std::nullopt);
+    ASSERT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(50));
+    cache->Prefetch(uids, std::nullopt); // the names being prefetched are not fetched again
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (const auto& uid : uids) {
+        cache->UserName(uid, std::nullopt);
+    }
+    ASSERT_EQ(3, fetch_num_);
+}
+
+TEST_F(TestUserIdentityCache, drop_prefetches_when_destructed)
+{
+    auto cache = MakeCache(100, std::chrono::seconds(100), std::chrono::milliseconds(50));
+    std::vector<UserID> uids;
+    for (uint32_t i = 0; i < UserIdentityCache::k_max_prefetch_thread_num * 4; ++i) {
+        uids.emplace_back(std::to_string(i));
+    }
+    cache->PrefetchAsync(uids, std::nullopt);
+    const auto begin = std::chrono::steady_clock::now();
+    cache.reset();
+    ASSERT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(50 * 4));
+    ASSERT_LT(fetch_num_, uids.size());
+}
+
+TEST_F(TestUserIdentityCache, count_for_each_request)
+{
+    auto cache = MakeCache();
+    cache->UserName("a", std::nullopt);
+    {
+        UserIdentityCache::RequestStatScope scope;
+        cache->UserName("a", std::nullopt);
+        cache->UserName("a", std::nullopt);
+        cache->UserName("b", std::nullopt);
+        ASSERT_EQ(2, UserIdentityCache::RequestStatScope::Get().hit_num_);
+        ASSERT_EQ(1, UserIdentityCache::RequestStatScope::Get().miss_num_);
+    }
+    UserIdentityCache::RequestStatScope scope;
+    ASSERT_EQ(0, UserIdentityCache::RequestStatScope::Get().hit_num_);
+    ASSERT_EQ(0, UserIdentityCache::RequestStatScope::Get().miss_num_);
+}
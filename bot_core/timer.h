@@ -6,83 +6,316 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <list>
+#include <mutex>
 #include <thread>
-#include <iostream> //
+#include <unordered_map>
+#include <vector>
 
-class Timer
+#include "bot_core/metrics.h"
+
+// A bot-wide hashed timing wheel. One thread advances the wheel and a small fixed pool of workers runs the expired
+// handles, so the number of threads does not grow with the number of running matches.
+class TimerWheel
 {
-   public:
-    using TaskSet = std::list<std::pair<uint64_t, std::function<void()>>>;
-    Timer(TaskSet&& tasks) : is_over_(false)
+  public:
+    using Task = std::function<void()>;
+    using Duration = std::chrono::milliseconds;
+
+    static constexpr uint64_t k_default_worker_num = 4;
+    static constexpr uint64_t k_default_slot_num = 512;
+    static constexpr Duration k_default_tick = Duration(100);
+
+    static TimerWheel& Get()
+    {
+        static TimerWheel wheel;
+        return wheel;
+    }
+
+    TimerWheel(const uint64_t worker_num = k_default_worker_num, const Duration tick = k_default_tick,
+               const uint64_t slot_num = k_default_slot_num)
+        : tick_(tick)
+        , slots_(slot_num)
+        , cursor_(0)
+        , next_id_(0)
+        , is_firing_(false)
+        , running_task_num_(0)
+        , skip_(false)
+        , stop_(false)
+        , lag_histogram_(Metrics::Get().GetHistogram("timer.lag"))
+    {
+        for (uint64_t i = 0; i < worker_num; ++i) {
+            workers_.emplace_back([this] { WorkerRoutine_(); });
+        }
+        ticker_ = std::thread([this] { TickerRoutine_(); }); /* make sure ticker_ is inited last */
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) = delete;
+
+    ~TimerWheel()
+    {
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            stop_ = true;
+        }
+        tick_cv_.notify_all();
+        task_cv_.notify_all();
+        ticker_.join();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    // Run |task| on the wheel thread after |delay|. The task should be short because it blocks the wheel, long work
+    // should be handed to Post. Returns an id which can be passed to Cancel.
+    uint64_t Schedule(const Duration delay, Task task)
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        const uint64_t ticks = std::max<uint64_t>(1, (delay.count() + tick_.count() - 1) / tick_.count());
+        const uint64_t slot = (cursor_ + ticks) % slots_.size();
+        const uint64_t id = ++next_id_;
+        auto& entries = slots_[slot];
+        entries.emplace_back(id, (ticks - 1) / slots_.size(), std::move(task));
+        index_.emplace(id, std::make_pair(slot, std::prev(entries.end())));
+        if (skip_) {
+            tick_cv_.notify_all();
+        }
+        return id;
+    }
+
+    // Returns false if the task has already expired or been canceled.
+    bool Cancel(const uint64_t id)
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        const auto it = index_.find(id);
+        if (it == index_.end()) {
+            return false;
+        }
+        slots_[it->second.first].erase(it->second.second);
+        index_.erase(it);
+        NotifyIfIdle_();
+        return true;
+    }
+
+    // Run |task| on the worker pool as soon as possible.
+    void Post(Task task)
     {
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            tasks_.emplace_back(std::move(task));
+        }
+        task_cv_.notify_one();
+    }
+
+    uint64_t PendingNum() const
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        return index_.size();
+    }
+
+    uint64_t WorkerNum() const { return workers_.size(); }
+
 #ifdef TEST_BOT
-        ++remaining_thread_count_;
+    // Let all pending and future timers expire immediately until SetSkip(false) is called.
+    void SetSkip(const bool skip)
+    {
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            skip_ = skip;
+        }
+        tick_cv_.notify_all();
+    }
+
+    // Block until no timer is pending and no handle is running.
+    void WaitIdle()
+    {
+        std::unique_lock<std::mutex> l(mutex_);
+        idle_cv_.wait(l, [this] { return IsIdle_(); });
+    }
 #endif
-        thread_ = std::thread([this, t = std::move(tasks)]()
+
+  private:
+    struct Entry
+    {
+        Entry(const uint64_t id, const uint64_t rounds, Task task) : id_(id), rounds_(rounds), task_(std::move(task)) {}
+        uint64_t id_;
+        uint64_t rounds_; // the number of whole turns to wait before the entry expires
+        Task task_;
+    };
+
+    bool IsIdle_() const { return index_.empty() && !is_firing_ && tasks_.empty() && running_task_num_ == 0; }
+
+    // REQUIRE: should be protected by mutex_
+    void NotifyIfIdle_()
+    {
+        if (IsIdle_()) {
+            idle_cv_.notify_all();
+        }
+    }
+
+    // REQUIRE: should be protected by mutex_
+    void CollectExpired_(std::vector<Task>& expired)
+    {
+        const auto collect = [&](std::list<Entry>& entries, const bool force)
             {
-                std::unique_lock<std::mutex> lock(mutex_);
-                for (const auto& [sec, handle] : t) {
-                    cv_.wait_for(lock, std::chrono::seconds(sec), [this]()
-                            {
-#ifdef TEST_BOT
-                                return is_over_.load() || skip_timer_;
-#else
-                                return is_over_.load();
-#endif
-                            });
-                    if (!is_over_) {
-                        // We need call handle async, because handle may release timer which will cause deadlock
-#ifdef TEST_BOT
-                        ++remaining_thread_count_;
-#endif
-                        std::thread([handle]
-                                {
-                                    handle();
-#ifdef TEST_BOT
-                                    std::lock_guard<std::mutex> l(Timer::mutex_);
-                                    --remaining_thread_count_;
-                                    remaining_thread_cv_.notify_all();
-#endif
-                                }).detach();
+                for (auto it = entries.begin(); it != entries.end(); ) {
+                    if (force || it->rounds_ == 0) {
+                        expired.emplace_back(std::move(it->task_));
+                        index_.erase(it->id_);
+                        it = entries.erase(it);
                     } else {
-                        break;
+                        --(it->rounds_);
+                        ++it;
                     }
                 }
-#ifdef TEST_BOT
-                --remaining_thread_count_;
-                remaining_thread_cv_.notify_all();
-#endif
-            }); /* make sure thread_ is inited last */
+            };
+        if (skip_) {
+            for (auto& entries : slots_) {
+                collect(entries, true);
+            }
+        } else {
+            cursor_ = (cursor_ + 1) % slots_.size();
+            collect(slots_[cursor_], false);
+        }
+    }
+
+    void TickerRoutine_()
+    {
+        auto next_tick = std::chrono::steady_clock::now() + tick_;
+        std::vector<Task> expired;
+        std::unique_lock<std::mutex> l(mutex_);
+        while (!stop_) {
+            tick_cv_.wait_until(l, next_tick, [&] { return stop_ || (skip_ && !index_.empty()); });
+            if (stop_) {
+                break;
+            }
+            if (skip_) {
+                CollectExpired_(expired);
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (next_tick <= now) {
+                lag_histogram_.Record(now - next_tick);
+            }
+            // catch up if the wheel thread has been delayed
+            for (; next_tick <= now; next_tick += tick_) {
+                CollectExpired_(expired);
+            }
+            if (expired.empty()) {
+                continue;
+            }
+            // Expired tasks may schedule new timers or cancel other timers, so they must be run without lock.
+            is_firing_ = true;
+            l.unlock();
+            for (auto& task : expired) {
+                task();
+            }
+            expired.clear();
+            l.lock();
+            is_firing_ = false;
+            NotifyIfIdle_();
+        }
+    }
+
+    void WorkerRoutine_()
+    {
+        std::unique_lock<std::mutex> l(mutex_);
+        while (true) {
+            task_cv_.wait(l, [this] { return stop_ || !tasks_.empty(); });
+            if (stop_) {
+                break;
+            }
+            auto task = std::move(tasks_.front());
+            tasks_.pop_front();
+            ++running_task_num_;
+            l.unlock();
+            task();
+            l.lock();
+            --running_task_num_;
+            NotifyIfIdle_();
+        }
+    }
+
+    const Duration tick_;
+    std::vector<std::list<Entry>> slots_;
+    uint64_t cursor_;
+    uint64_t next_id_;
+    std::unordered_map<uint64_t, std::pair<uint64_t, std::list<Entry>::iterator>> index_;
+    bool is_firing_;
+
+    std::deque<Task> tasks_;
+    uint64_t running_task_num_;
+
+    bool skip_;
+    bool stop_;
+    mutable std::mutex mutex_;
+    std::condition_variable tick_cv_;
+    std::condition_variable task_cv_;
+    std::condition_variable idle_cv_;
+    Histogram& lag_histogram_; // how late the ticks are processed
+    std::vector<std::thread> workers_;
+    std::thread ticker_;
+};
+
+// Run the tasks one by one. Each task waits for its seconds after the previous one is triggered. The timer is stopped
+// when destructed.
+class Timer
+{
+   public:
+    using TaskSet = std::list<std::pair<uint64_t, std::function<void()>>>;
+
+    Timer(TaskSet&& tasks, TimerWheel& wheel = TimerWheel::Get())
+        : state_(std::make_shared<State>(std::move(tasks), wheel))
+    {
+        std::lock_guard<std::mutex> l(state_->mutex_);
+        ScheduleNext_(state_);
     }
+
     Timer(const Timer&) = delete;
     Timer(Timer&&) = delete;
+
     ~Timer()
     {
-        if (thread_.joinable()) {
-            {
-                std::unique_lock<std::mutex> lock(mutex_);
-                is_over_.store(true);
-            }
-            cv_.notify_all();
-            thread_.join();
+        std::lock_guard<std::mutex> l(state_->mutex_);
+        state_->is_over_ = true;
+        state_->wheel_.Cancel(state_->timer_id_);
+    }
+
+  private:
+    // The state is shared with the wheel so that it outlives the timer if the timer is released during expiring.
+    struct State
+    {
+        State(TaskSet&& tasks, TimerWheel& wheel) : tasks_(std::move(tasks)), wheel_(wheel), timer_id_(0), is_over_(false) {}
+        std::mutex mutex_;
+        TaskSet tasks_;
+        TimerWheel& wheel_;
+        uint64_t timer_id_;
+        bool is_over_;
+    };
+
+    // REQUIRE: should be protected by state->mutex_
+    static void ScheduleNext_(const std::shared_ptr<State>& state)
+    {
+        if (state->tasks_.empty()) {
+            return;
         }
+        state->timer_id_ = state->wheel_.Schedule(std::chrono::seconds(state->tasks_.front().first),
+                [state] { OnExpire_(state); });
     }
 
-#ifdef TEST_BOT
-    static std::condition_variable cv_;
-    static bool skip_timer_;
-    static std::condition_variable remaining_thread_cv_;
-    static uint64_t remaining_thread_count_;
-    static std::mutex mutex_;
+    static void OnExpire_(const std::shared_ptr<State>& state)
+    {
+        std::lock_guard<std::mutex> l(state->mutex_);
+        if (state->is_over_) {
+            return;
+        }
+        // We need call handle async, because handle may release timer which will cause deadlock
+        state->wheel_.Post(std::move(state->tasks_.front().second));
+        state->tasks_.pop_front();
+        ScheduleNext_(state);
+    }
 
-  private:
-#else
-  private:
-    std::condition_variable cv_;
-    std::mutex mutex_;
-#endif
-    std::atomic<bool> is_over_;
-    std::thread thread_;
+    const std::shared_ptr<State> state_;
 };
@@ -0,0 +1,312 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "bot_core/id.h"
+#include "utility/log.h"
+
+// Caches the user names and avatars got from the adapter, which may cost a network round trip for each call. The
+// entries expire after a TTL so that the changed names are shown in time, and the least recently used entries are
+// evicted when the cache is full.
+class UserIdentityCache
+{
+  public:
+    using NameFetcher = std::function<std::string(const UserID&, const std::optional<GroupID>&)>;
+    using AvatarFetcher = std::function<std::string(const UserID&, int32_t)>;
+
+    static constexpr uint64_t k_default_capacity = 4096;
+    static constexpr std::chrono::seconds k_default_ttl{300};
+    static constexpr uint32_t k_max_prefetch_thread_num = 8;
+
+    struct Stat
+    {
+        uint64_t hit_num_ = 0; // the adapter calls avoided
+        uint64_t miss_num_ = 0; // the adapter calls made
+        uint64_t entry_num_ = 0;
+    };
+
+    // Resets the counters of the current thread when constructed, and logs them when destructed, so that we know how
+    // many adapter calls are avoided for each request.
+    class RequestStatScope
+    {
+      public:
+        RequestStatScope() { RequestStat_() = Stat(); }
+        RequestStatScope(const RequestStatScope&) = delete;
+        ~RequestStatScope()
+        {
+            const auto& stat = RequestStat_();
+            if (stat.hit_num_ > 0 || stat.miss_num_ > 0) {
+                DebugLog() << "User identity cache of the request hit_num=" << stat.hit_num_
+                           << " miss_num=" << stat.miss_num_;
+            }
+        }
+
+        static const Stat& Get() { return RequestStat_(); }
+    };
+
+    // Defined in msg_sender.cc, which fetches from the adapter.
+    static UserIdentityCache& Get();
+
+    UserIdentityCache(const uint64_t capacity, const std::chrono::milliseconds ttl, NameFetcher name_fetcher,
+            AvatarFetcher avatar_fetcher)
+        : capacity_(capacity), ttl_(ttl), name_fetcher_(std::move(name_fetcher))
+        , avatar_fetcher_(std::move(avatar_fetcher)), hit_num_(0), miss_num_(0), prefetch_stop_(false)
+    {
+    }
+
+    UserIdentityCache(const UserIdentityCache&) = delete;
+    UserIdentityCache(UserIdentityCache&&) = delete;
+
+    // The prefetches not started yet are dropped.
+    ~UserIdentityCache()
+    {
+        {
+            std::lock_guard<std::mutex> l(prefetch_mutex_);
+            prefetch_stop_ = true;
+        }
+        prefetch_cv_.notify_all();
+        for (auto& worker : prefetch_workers_) {
+            worker.join();
+        }
+    }
+
+    // |gid| is null means to get the nickname of the user, otherwise, getting the group nickname of the user
+    std::string UserName(const UserID& uid, const std::optional<GroupID>& gid)
+    {
+        return Lookup_(NameKey_(uid, gid), [&] { return name_fetcher_(uid, gid); });
+    }
+
+    std::string UserAvatar(const UserID& uid, const int32_t size)
+    {
+        return Lookup_(AvatarKey_(uid, size), [&] { return avatar_fetcher_(uid, size); });
+    }
+
+    // Fetch the missing names and the avatars of |avatar_sizes| for |uids| concurrently by the shared prefetch workers,
+    // and wait until they are fetched, so that the following lookups (e.g. the rows of a rank table) hit the cache
+    // instead of waiting for the adapter one by one.
+    void Prefetch(const std::vector<UserID>& uids, const std::optional<GroupID>& gid,
+            const std::vector<int32_t>& avatar_sizes = {})
+    {
+        if (const auto pending_fetches = Prefetch_(uids, gid, avatar_sizes)) {
+            std::unique_lock<std::mutex> l(pending_fetches->mutex_);
+            pending_fetches->cv_.wait(l, [&] { return pending_fetches->num_ == 0; });
+        }
+    }
+
+    // The same as Prefetch but returns at once, so it can be called when holding a lock (e.g. the lock of a match).
+    void PrefetchAsync(const std::vector<UserID>& uids, const std::optional<GroupID>& gid,
+            const std::vector<int32_t>& avatar_sizes = {})
+    {
+        Prefetch_(uids, gid, avatar_sizes);
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        lru_.clear();
+        index_.clear();
+    }
+
+    Stat GetStat() const
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        return Stat{.hit_num_ = hit_num_, .miss_num_ = miss_num_, .entry_num_ = index_.size()};
+    }
+
+  private:
+    struct Entry
+    {
+        std::string key_;
+        std::string value_;
+        std::chrono::steady_clock::time_point expire_time_;
+    };
+
+    using Index = std::unordered_map<std::string, std::list<Entry>::iterator>;
+
+    // The fetches of a prefetch which have not finished.
+    struct PendingFetches
+    {
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        uint64_t num_;
+    };
+
+    // The fields are separated by '\0', which never appears in the IDs. The size is 0 for the names.
+    static std::string Key_(const UserID& uid, const std::string_view gid, const int32_t size)
+    {
+        std::string key = uid.GetStr();
+        key += '\0';
+        key += gid;
+        key += '\0';
+        key += std::to_string(size);
+        return key;
+    }
+
+    static std::string NameKey_(const UserID& uid, const std::optional<GroupID>& gid)
+    {
+        return Key_(uid, gid.has_value() ? std::string_view(gid->GetStr()) : std::string_view(), 0);
+    }
+
+    static std::string AvatarKey_(const UserID& uid, const int32_t size) { return Key_(uid, {}, size); }
+
+    static Stat& RequestStat_()
+    {
+        thread_local Stat stat;
+        return stat;
+    }
+
+    // Returns the pending fetches, or null if there is nothing to fetch. The keys being prefetched are not fetched again.
+    std::shared_ptr<PendingFetches> Prefetch_(const std::vector<UserID>& uids, const std::optional<GroupID>& gid,
+            const std::vector<int32_t>& avatar_sizes)
+    {
+        std::vector<std::pair<std::string, std::function<std::string()>>> fetches;
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            const auto now = std::chrono::steady_clock::now();
+            const auto is_missing = [&](const std::string& key)
+                {
+                    return !Find_(key, now) && prefetching_keys_.emplace(key).second;
+                };
+            for (const auto& uid : uids) {
+                if (auto key = NameKey_(uid, gid); is_missing(key)) {
+                    fetches.emplace_back(std::move(key), [this, uid, gid] { return name_fetcher_(uid, gid); });
+                }
+                for (const int32_t size : avatar_sizes) {
+                    if (auto key = AvatarKey_(uid, size); is_missing(key)) {
+                        fetches.emplace_back(std::move(key), [this, uid, size] { return avatar_fetcher_(uid, size); });
+                    }
+                }
+            }
+            miss_num_ += fetches.size();
+        }
+        RequestStat_().miss_num_ += fetches.size();
+        if (fetches.empty()) {
+            return nullptr;
+        }
+        auto pending_fetches = std::make_shared<PendingFetches>();
+        pending_fetches->num_ = fetches.size();
+        {
+            std::lock_guard<std::mutex> l(prefetch_mutex_);
+            for (auto& [key, fetch] : fetches) {
+                prefetch_tasks_.emplace_back([this, key = std::move(key), fetch = std::move(fetch), pending_fetches]
+                        {
+                            Insert_(key, fetch());
+                            {
+                                std::lock_guard<std::mutex> l(mutex_);
+                                prefetching_keys_.erase(key);
+                            }
+                            {
+                                std::lock_guard<std::mutex> l(pending_fetches->mutex_);
+                                --pending_fetches->num_;
+                            }
+                            pending_fetches->cv_.notify_all();
+                        });
+            }
+            // the workers are started lazily because most of the time there is nothing to prefetch
+            while (prefetch_workers_.size() < std::min<uint64_t>(k_max_prefetch_thread_num, prefetch_tasks_.size())) {
+                prefetch_workers_.emplace_back([this] { PrefetchRoutine_(); });
+            }
+        }
+        prefetch_cv_.notify_all();
+        return pending_fetches;
+    }
+
+    void PrefetchRoutine_()
+    {
+        std::unique_lock<std::mutex> l(prefetch_mutex_);
+        while (true) {
+            prefetch_cv_.wait(l, [this] { return prefetch_stop_ || !prefetch_tasks_.empty(); });
+            if (prefetch_stop_) {
+                return;
+            }
+            auto task = std::move(prefetch_tasks_.front());
+            prefetch_tasks_.pop_front();
+            l.unlock();
+            task();
+            l.lock();
+        }
+    }
+
+    template <typename Fetch>
+    std::string Lookup_(const std::string& key, Fetch&& fetch)
+    {
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            if (const auto value = Find_(key, std::chrono::steady_clock::now())) {
+                ++hit_num_;
+                ++RequestStat_().hit_num_;
+                return *value;
+            }
+            ++miss_num_;
+            ++RequestStat_().miss_num_;
+        }
+        // fetch without the lock because the adapter may be slow
+        std::string value = fetch();
+        Insert_(key, value);
+        return value;
+    }
+
+    // REQUIRE: should be protected by mutex_
+    std::optional<std::string> Find_(const std::string& key, const std::chrono::steady_clock::time_point now)
+    {
+        const auto it = index_.find(key);
+        if (it == index_.end()) {
+            return std::nullopt;
+        }
+        if (it->second->expire_time_ <= now) {
+            lru_.erase(it->second);
+            index_.erase(it);
+            return std::nullopt;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->value_;
+    }
+
+    void Insert_(const std::string& key, std::string value)
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        if (const auto it = index_.find(key); it != index_.end()) {
+            lru_.erase(it->second); // fetched by another thread concurrently
+            index_.erase(it);
+        }
+        lru_.emplace_front(key, std::move(value), std::chrono::steady_clock::now() + ttl_);
+        index_.emplace(key, lru_.begin());
+        while (index_.size() > capacity_) {
+            index_.erase(lru_.back().key_);
+            lru_.pop_back();
+        }
+    }
+
+    const uint64_t capacity_;
+    const std::chrono::milliseconds ttl_;
+    const NameFetcher name_fetcher_;
+    const AvatarFetcher avatar_fetcher_;
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // the most recently used entry is at the front
+    Index index_;
+    uint64_t hit_num_;
+    uint64_t miss_num_;
+    std::unordered_set<std::string> prefetching_keys_;
+
+    std::mutex prefetch_mutex_;
+    std::condition_variable prefetch_cv_;
+    std::deque<std::function<void()>> prefetch_tasks_;
+    std::vector<std::thread> prefetch_workers_;
+    bool prefetch_stop_;
+};
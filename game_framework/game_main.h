@@ -81,6 +81,8 @@ class GameOptionBase
     virtual const char* Info(const uint64_t index) const = 0;
     virtual const char* ColoredInfo(const uint64_t index) const = 0;
     virtual const char* Status() const = 0;
+    // The command which sets the option to its current value, so that the options can be rebuilt on another instance.
+    virtual const char* OptionCommand(const uint64_t index) const = 0;
 
     GlobalGameOption global_options_;
 
@@ -114,6 +116,10 @@ class MainStageBase : virtual public StageBase
   public:
     virtual int64_t PlayerScore(const PlayerID pid) const = 0;
     virtual const char* const* VerdictateAchievements(const PlayerID pid) const = 0;
+    // Return the serialized state of the stages, or nullptr if the game does not support checkpoints.
+    virtual const char* CheckpointC(uint64_t& size) const = 0;
+    // Restore the state serialized by CheckpointC, which replaces HandleStageBegin. Return false if the state is broken.
+    virtual bool RestoreC(const char* const checkpoint, const uint64_t size) = 0;
 };
 
 #endif
@@ -36,6 +36,13 @@ class GameOption : public GameOptionBase, public MyGameOption
     virtual const char* Info(const uint64_t index) const override { return MyGameOption::Info(index); }
     virtual const char* ColoredInfo(const uint64_t index) const override { return MyGameOption::ColoredInfo(index); }
 
+    virtual const char* OptionCommand(const uint64_t index) const override
+    {
+        thread_local static std::string command;
+        command = MyGameOption::OptionCommand(index);
+        return command.c_str();
+    }
+
     virtual const char* Status() const override
     {
         thread_local static std::string info;
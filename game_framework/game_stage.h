@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <optional>
@@ -13,6 +14,7 @@
 
 #include "utility/msg_checker.h"
 #include "utility/log.h"
+#include "utility/checkpoint.h"
 #include "bot_core/match_base.h"
 
 #include "game_framework/util.h"
@@ -85,6 +87,23 @@ class Masker
 
     bool IsReady() const { return unset_count_ == 0 && any_user_ready_; }
 
+    void Checkpoint(CheckpointWriter& writer) const { writer.Write(recorder_, any_user_ready_); }
+
+    bool Restore(CheckpointReader& reader)
+    {
+        std::vector<State> recorder;
+        if (!reader.Read(recorder, any_user_ready_) || recorder.size() != recorder_.size() ||
+                !std::ranges::all_of(recorder, [](const State state)
+                    {
+                        return state == State::SET || state == State::UNSET || state == State::PINNED;
+                    })) {
+            return false;
+        }
+        recorder_ = std::move(recorder);
+        unset_count_ = std::ranges::count(recorder_, State::UNSET);
+        return true;
+    }
+
   private:
     std::string ToString_(const size_t index)
     {
@@ -124,6 +143,9 @@ class Masker
 template <typename RetType>
 using GameCommand = Command<RetType(const uint64_t, const bool, MsgSenderBase&)>;
 
+template <typename RetType>
+using GameCommandIndex = CommandIndex<RetType(const uint64_t, const bool, MsgSenderBase&)>;
+
 enum class CheckoutReason { BY_REQUEST, BY_TIMEOUT, BY_LEAVE, SKIP };
 
 template <typename SubStage, typename RetType>
@@ -151,7 +173,8 @@ class StageBaseWrapper : virtual public StageBase
         , match_(match)
         , global_info_(global_info)
         , name_(std::forward<String>(name))
-        , commands_{std::forward<Commands>(commands)...}
+        , commands_(std::vector<GameCommand<std::conditional_t<IS_ATOM, AtomReqErrCode, CompReqErrCode>>>{
+                    std::forward<Commands>(commands)...})
     {}
 
     virtual ~StageBaseWrapper() {}
@@ -226,6 +249,8 @@ class StageBaseWrapper : virtual public StageBase
                                        MsgSenderBase& reply) = 0;
     virtual StageErrCode HandleLeave(const PlayerID pid) = 0;
     virtual StageErrCode HandleComputerAct(const uint64_t pid, const bool ready_as_user) = 0;
+    virtual bool HandleCheckpoint(CheckpointWriter& writer) const = 0;
+    virtual bool HandleRestore(CheckpointReader& reader) = 0;
     virtual std::string StageInfo() const = 0;
     virtual std::string CommandInfo(const bool text_mode) const
     {
@@ -241,6 +266,13 @@ class StageBaseWrapper : virtual public StageBase
     }
 
   protected:
+    // Serialize the game-specific state of the stage (e.g., the board, the scores and the random engines) so that the
+    // match can be resumed after the bot restarts. Return false if the stage does not support checkpoints.
+    virtual bool OnCheckpoint(CheckpointWriter& writer) const { return false; }
+    // Restore the state serialized by OnCheckpoint. The stage is constructed but not began, so the messages which
+    // should be sent at the beginning are not sent again. Return false if the state is broken.
+    virtual bool OnRestore(CheckpointReader& reader) { return false; }
+
     template <typename Stage, typename RetType, typename... Args, typename... Checkers>
     GameCommand<RetType> MakeStageCommand(const char* const description, RetType (Stage::*cb)(Args...),
             Checkers&&... checkers)
@@ -259,7 +291,7 @@ class StageBaseWrapper : virtual public StageBase
     const GameOptionBase& option_;
     MatchBase& match_;
     GlobalInfo& global_info_;
-    std::vector<GameCommand<std::conditional_t<IS_ATOM, AtomReqErrCode, CompReqErrCode>>> commands_;
+    const GameCommandIndex<std::conditional_t<IS_ATOM, AtomReqErrCode, CompReqErrCode>> commands_;
 };
 
 template <bool IS_ATOM, typename MainStage>
@@ -327,6 +359,26 @@ class MainStageBaseWrapper : public MainStageBase, public StageBaseWrapper<IS_AT
         return achieved_list.data();
     }
 
+    virtual const char* CheckpointC(uint64_t& size) const override
+    {
+        thread_local static std::string checkpoint;
+        CheckpointWriter writer;
+        writer.Write(global_info_.masker_, global_info_.is_in_deduction_);
+        if (!this->HandleCheckpoint(writer)) {
+            return nullptr;
+        }
+        checkpoint = writer.Str();
+        size = checkpoint.size();
+        return checkpoint.c_str();
+    }
+
+    virtual bool RestoreC(const char* const checkpoint, const uint64_t size) override
+    {
+        CheckpointReader reader(std::string_view(checkpoint, size));
+        return reader.Read(global_info_.masker_, global_info_.is_in_deduction_) && this->HandleRestore(reader) &&
+            reader.IsEnd();
+    }
+
   private:
     GlobalInfo global_info_;
 };
@@ -368,12 +420,10 @@ class GameStage<GameOption, Achievement, MainStage, SubStages...>
     virtual StageErrCode HandleRequest(MsgReader& reader, const uint64_t pid, const bool is_public,
                                                   MsgSenderBase& reply) override
     {
-        for (const auto& cmd : Base::commands_) {
-            if (const auto rc = cmd.CallIfValid(reader, pid, is_public, reply); rc.has_value()) {
-                StageLog_(InfoLog()) << "handle request pid=" << pid << " is_public="
-                    << Bool2Str(is_public) << " rc=" << *rc;
-                return *rc;
-            }
+        if (const auto rc = Base::commands_.CallIfValid(reader, pid, is_public, reply); rc.has_value()) {
+            StageLog_(InfoLog()) << "handle request pid=" << pid << " is_public="
+                << Bool2Str(is_public) << " rc=" << *rc;
+            return *rc;
         }
         return PassToSubStage_(
                 [&](auto&& sub_stage) { return sub_stage->HandleRequest(reader, pid, is_public, reply); },
@@ -409,6 +459,32 @@ class GameStage<GameOption, Achievement, MainStage, SubStages...>
                 CheckoutReason::BY_REQUEST); // game logic not care abort computer
     }
 
+    // The stage name and the index of the substage are written as the path to the current atom stage.
+    virtual bool HandleCheckpoint(CheckpointWriter& writer) const override
+    {
+        writer.Write(Base::name_);
+        if (!this->OnCheckpoint(writer)) {
+            StageLog_(InfoLog()) << "HandleCheckpoint not supported";
+            return false;
+        }
+        writer.Write(static_cast<uint64_t>(sub_stage_.index()));
+        return std::visit([&](auto&& sub_stage) { return sub_stage->HandleCheckpoint(writer); }, sub_stage_);
+    }
+
+    virtual bool HandleRestore(CheckpointReader& reader) override
+    {
+        std::string name;
+        uint64_t index = 0;
+        if (!reader.Read(name) || name != Base::name_ || !this->OnRestore(reader) || !reader.Read(index) ||
+                index >= sizeof...(SubStages)) {
+            StageLog_(ErrorLog()) << "HandleRestore failed name=\"" << name << "\" index=" << index;
+            return false;
+        }
+        sub_stage_ = OnRestoreSubStage(index);
+        return sub_stage_.index() == index &&
+            std::visit([&](auto&& sub_stage) { return sub_stage && sub_stage->HandleRestore(reader); }, sub_stage_);
+    }
+
     virtual std::string CommandInfo(const bool text_mode) const override
     {
         return std::visit([&](auto&& sub_stage) { return Base::CommandInfo(text_mode) + sub_stage->CommandInfo(text_mode); }, sub_stage_);
@@ -465,6 +541,9 @@ class GameStage<GameOption, Achievement, MainStage, SubStages...>
     }
 
     virtual VariantSubStage OnStageBegin() = 0;
+    // Construct the |index|-th type of substage to be restored, after the state of this stage has been restored by
+    // OnRestore. The state of the substage is restored by its own OnRestore.
+    virtual VariantSubStage OnRestoreSubStage(const uint64_t index) { return {}; }
     // CompStage cannot checkout by itself so return type is void
     virtual void OnPlayerLeave(const PlayerID pid) {}
     virtual CompReqErrCode OnComputerAct(const PlayerID pid, MsgSenderBase& reply) { return StageErrCode::OK; }
@@ -516,6 +595,7 @@ class GameStage<GameOption, Achievement, MainStage>
     virtual StageErrCode HandleTimeout() override final
     {
         StageLog_(InfoLog()) << "HandleTimeout begin";
+        finish_time_.reset(); // the timer may be started again in OnTimeout
         return Handle_(OnTimeout());
     }
 
@@ -529,12 +609,10 @@ class GameStage<GameOption, Achievement, MainStage>
     virtual StageErrCode HandleRequest(MsgReader& reader, const uint64_t pid, const bool is_public,
                                                   MsgSenderBase& reply) override final
     {
-        for (const auto& cmd : Base::commands_) {
-            if (const auto rc = cmd.CallIfValid(reader, pid, is_public, reply); rc.has_value()) {
-                StageLog_(InfoLog()) << "HandleRequest matched pid=" << pid << " is_public="
-                    << Bool2Str(is_public) << " rc=" << *rc;
-                return Handle_(pid, true, *rc);
-            }
+        if (const auto rc = Base::commands_.CallIfValid(reader, pid, is_public, reply); rc.has_value()) {
+            StageLog_(InfoLog()) << "HandleRequest matched pid=" << pid << " is_public="
+                << Bool2Str(is_public) << " rc=" << *rc;
+            return Handle_(pid, true, *rc);
         }
         return StageErrCode::NOT_FOUND;
     }
@@ -546,6 +624,39 @@ class GameStage<GameOption, Achievement, MainStage>
         return Handle_(pid, ready_as_user, OnComputerAct(pid, Base::TellMsgSender(pid)));
     }
 
+    // The timer is written as the remaining seconds, so it is restarted with the remaining time when restored.
+    virtual bool HandleCheckpoint(CheckpointWriter& writer) const override
+    {
+        writer.Write(Base::name_);
+        if (!this->OnCheckpoint(writer)) {
+            StageLog_(InfoLog()) << "HandleCheckpoint not supported";
+            return false;
+        }
+        std::optional<uint64_t> remaining_sec;
+        if (finish_time_.has_value()) {
+            // the timeout which is about to be handled should not be lost
+            remaining_sec = std::max<int64_t>(1,
+                    std::chrono::ceil<std::chrono::seconds>(*finish_time_ - std::chrono::steady_clock::now()).count());
+        }
+        writer.Write(remaining_sec);
+        return true;
+    }
+
+    virtual bool HandleRestore(CheckpointReader& reader) override
+    {
+        std::string name;
+        std::optional<uint64_t> remaining_sec;
+        if (!reader.Read(name) || name != Base::name_ || !this->OnRestore(reader) || !reader.Read(remaining_sec)) {
+            StageLog_(ErrorLog()) << "HandleRestore failed name=\"" << name << "\"";
+            return false;
+        }
+        if (remaining_sec.has_value()) {
+            StartTimer(*remaining_sec);
+        }
+        StageLog_(InfoLog()) << "HandleRestore succeed";
+        return true;
+    }
+
     virtual std::string StageInfo() const override
     {
         std::string outstr = Base::name_;
@@ -570,7 +681,9 @@ class GameStage<GameOption, Achievement, MainStage>
 
     void StartTimer(const uint64_t sec)
     {
-        finish_time_ = std::chrono::steady_clock::now() + std::chrono::seconds(sec);
+        if (sec > 0) { // the match does not start a timer for zero seconds
+            finish_time_ = std::chrono::steady_clock::now() + std::chrono::seconds(sec);
+        }
         // cannot pass substage pointer because substage may has been released when alert
         Base::match_.StartTimer(sec, this,
                 option().global_options_.public_timer_alert_ ? TimerCallbackPublic_ : TimerCallbackPrivate_);
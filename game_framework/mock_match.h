@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <optional>
 
@@ -13,8 +14,9 @@
 class MockMsgSender : public MsgSenderBase
 {
   public:
-    MockMsgSender() : is_public_(true) {}
-    MockMsgSender(const PlayerID pid, const bool is_public) : pid_(pid), is_public_(is_public) {}
+    MockMsgSender(const bool mute = false) : is_public_(true), mute_(mute) {}
+    MockMsgSender(const PlayerID pid, const bool is_public, const bool mute = false)
+        : pid_(pid), is_public_(is_public), mute_(mute) {}
     virtual MsgSenderGuard operator()() override
     {
         if (is_public_ && pid_.has_value())
@@ -53,6 +55,10 @@ class MockMsgSender : public MsgSenderBase
 
     virtual void Flush() override
     {
+        if (mute_) {
+            ss_.str("");
+            return;
+        }
         if (is_public_) {
             std::cout << "[BOT -> GROUP]";
         } else if (pid_.has_value()) {
@@ -69,6 +75,7 @@ class MockMsgSender : public MsgSenderBase
   private:
     const std::optional<PlayerID> pid_;
     const bool is_public_;
+    const bool mute_; // discard the messages, e.g., when running many games concurrently
     std::stringstream ss_;
     const Match* match_;
 };
@@ -76,7 +83,8 @@ class MockMsgSender : public MsgSenderBase
 class MockMatch : public MatchBase
 {
   public:
-    MockMatch(const uint64_t player_num) : is_eliminated_(player_num, false) {}
+    MockMatch(const uint64_t player_num, const bool mute = false)
+        : boardcast_sender_(mute), is_eliminated_(player_num, false), mute_(mute) {}
 
     virtual ~MockMatch() {}
 
@@ -84,7 +92,7 @@ class MockMatch : public MatchBase
 
     virtual MsgSenderBase& TellMsgSender(const PlayerID pid) override
     {
-        return tell_senders_.try_emplace(pid, MockMsgSender(pid, false)).first->second;
+        return tell_senders_.try_emplace(pid, pid, false, mute_).first->second;
     }
 
     virtual MockMsgSender& GroupMsgSender() override { return boardcast_sender_; }
@@ -102,13 +110,15 @@ class MockMatch : public MatchBase
 
     virtual void StopTimer() override {}
 
+    virtual void RunComputerTask(void* p, void(*task)(void*)) override { task(p); }
+
     virtual void Eliminate(const PlayerID pid) override { is_eliminated_[pid] = true; }
 
     virtual bool IsInDeduction() const override { return false; }
 
     virtual uint64_t MatchId() const override
     {
-        static uint64_t match_id = 0;
+        static std::atomic<uint64_t> match_id = 0;
         return ++match_id;
     }
 
@@ -120,5 +130,6 @@ class MockMatch : public MatchBase
     MockMsgSender boardcast_sender_;
     std::map<uint64_t, MockMsgSender> tell_senders_;
     std::vector<bool> is_eliminated_;
+    const bool mute_;
 };
 
@@ -2,7 +2,15 @@
 //
 // This source code is licensed under LGPLv2 (found in the LICENSE file).
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <thread>
 
 #include <gflags/gflags.h>
 
@@ -15,6 +23,11 @@ DEFINE_uint64(player, 0, "Player number: if set to 0, best player num will be se
 DEFINE_uint64(repeat, 1, "Repeat times: if set to 0, will run unlimitedly");
 DEFINE_string(resource_dir, "./resource_dir/", "The path of game image resources");
 DEFINE_bool(gen_image, false, "Whether generate image or not");
+DEFINE_uint64(thread, 1, "Thread number: if greater than 1, games are run concurrently and messages are not printed");
+DEFINE_string(seed, "", "Seed prefix: if set, the option 种子 of each game is set to <seed>_<game index> if the game has it");
+DEFINE_string(stat_format, "", "Statistics format: csv or json, if set, messages are not printed and the statistics are "
+        "printed after all games are over");
+DEFINE_string(stat_output, "", "The file to write statistics to: if not set, statistics are printed to stdout");
 
 MainStageBase* MakeMainStage(MsgSenderBase& reply, GameOption& options, MatchBase& match);
 
@@ -29,7 +42,7 @@ class RunGameMockMatch : public MockMatch
 
     virtual const char* PlayerAvatar(const PlayerID& pid, const int32_t size) override
     {
-        if (!FLAGS_gen_image) {
+        if (!enable_markdown_to_image) {
             return "";
         }
         const std::string avatar_filename = "avatar_" + std::to_string(pid);
@@ -41,17 +54,166 @@ class RunGameMockMatch : public MockMatch
     }
 };
 
-int Run()
+// The statistics of games, which are merged from each game when it is over.
+class RunGameStat
 {
-    RunGameMockMatch match(FLAGS_player);
+  public:
+    using Duration = std::chrono::nanoseconds;
+
+    struct Game
+    {
+        Duration cost_{0};
+        std::vector<Duration> act_costs_;
+        std::map<std::string, std::vector<Duration>> stage_costs_;
+        std::vector<int64_t> scores_;
+    };
+
+    void Merge(Game&& game)
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        ++game_num_;
+        game_costs_.emplace_back(game.cost_);
+        act_costs_.insert(act_costs_.end(), game.act_costs_.begin(), game.act_costs_.end());
+        for (auto& [stage, costs] : game.stage_costs_) {
+            auto& stage_costs = stage_costs_[stage];
+            stage_costs.insert(stage_costs.end(), costs.begin(), costs.end());
+        }
+        if (scores_.size() < game.scores_.size()) {
+            scores_.resize(game.scores_.size());
+        }
+        for (size_t pid = 0; pid < game.scores_.size(); ++pid) {
+            scores_[pid].emplace_back(game.scores_[pid]);
+        }
+    }
+
+    void Output(std::ostream& os, const std::string& format, const std::chrono::steady_clock::duration cost)
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        const double seconds = std::chrono::duration<double>(cost).count();
+        std::vector<std::pair<std::string, Summary>> rows;
+        rows.emplace_back("game_us", Summarize_(game_costs_, ToMicroseconds_));
+        rows.emplace_back("computer_act_us", Summarize_(act_costs_, ToMicroseconds_));
+        for (auto& [stage, costs] : stage_costs_) {
+            rows.emplace_back("stage_us:" + stage, Summarize_(costs, ToMicroseconds_));
+        }
+        for (size_t pid = 0; pid < scores_.size(); ++pid) {
+            rows.emplace_back("score:" + std::to_string(pid), Summarize_(scores_[pid], [](const int64_t v) { return double(v); }));
+        }
+        os << std::fixed << std::setprecision(2);
+        if (format == "json") {
+            os << "{\"game\": \"" << EscapeJson_(GameModuleName_()) << "\", \"game_num\": " << game_num_
+               << ", \"thread_num\": " << FLAGS_thread << ", \"seconds\": " << seconds
+               << ", \"games_per_sec\": " << game_num_ / seconds << ", \"stats\": [";
+            for (size_t i = 0; i < rows.size(); ++i) {
+                const auto& [name, summary] = rows[i];
+                os << (i == 0 ? "" : ", ") << "{\"name\": \"" << EscapeJson_(name) << "\", \"count\": " << summary.count_
+                   << ", \"mean\": " << summary.mean_ << ", \"min\": " << summary.min_ << ", \"p50\": " << summary.p50_
+                   << ", \"p99\": " << summary.p99_ << ", \"max\": " << summary.max_ << "}";
+            }
+            os << "]}" << std::endl;
+        } else {
+            os << "name,count,mean,min,p50,p99,max" << std::endl;
+            os << "games_per_sec,1," << game_num_ / seconds << ",,,," << std::endl;
+            for (const auto& [name, summary] : rows) {
+                os << EscapeCsv_(name) << "," << summary.count_ << "," << summary.mean_ << "," << summary.min_ << ","
+                   << summary.p50_ << "," << summary.p99_ << "," << summary.max_ << std::endl;
+            }
+        }
+    }
+
+  private:
+    struct Summary
+    {
+        uint64_t count_ = 0;
+        double mean_ = 0;
+        double min_ = 0;
+        double p50_ = 0;
+        double p99_ = 0;
+        double max_ = 0;
+    };
+
+    static double ToMicroseconds_(const Duration d) { return std::chrono::duration<double, std::micro>(d).count(); }
+
+    template <typename T, typename Convert>
+    static Summary Summarize_(std::vector<T>& values, const Convert& convert)
+    {
+        if (values.empty()) {
+            return Summary{};
+        }
+        std::sort(values.begin(), values.end());
+        double sum = 0;
+        for (const auto& value : values) {
+            sum += convert(value);
+        }
+        const auto percentile = [&](const double p) { return convert(values[size_t(p * (values.size() - 1))]); };
+        return Summary{
+            .count_ = values.size(),
+            .mean_ = sum / values.size(),
+            .min_ = convert(values.front()),
+            .p50_ = percentile(0.5),
+            .p99_ = percentile(0.99),
+            .max_ = convert(values.back()),
+        };
+    }
+
+    static std::string GameModuleName_()
+    {
+#ifdef GAME_MODULE_NAME
+        return GAME_MODULE_NAME;
+#else
+        return "[unset_module_name]";
+#endif
+    }
+
+    static std::string EscapeJson_(const std::string& str)
+    {
+        std::string result;
+        for (const char c : str) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+            }
+            result += c;
+        }
+        return result;
+    }
+
+    static std::string EscapeCsv_(const std::string& str)
+    {
+        return str.find_first_of(",\"") == std::string::npos ? str :
+            "\"" + std::regex_replace(str, std::regex("\""), "\"\"") + "\"";
+    }
 
-    enable_markdown_to_image = FLAGS_gen_image;
+    std::mutex mutex_;
+    uint64_t game_num_ = 0;
+    std::vector<Duration> game_costs_;
+    std::vector<Duration> act_costs_;
+    std::map<std::string, std::vector<Duration>> stage_costs_;
+    std::vector<std::vector<int64_t>> scores_;
+};
+
+// The stage info contains the remaining time and the round number, which are removed so that the same stages of
+// different rounds are counted together.
+static std::string StageName(const char* const stage_info)
+{
+    static const std::regex remaining_time_regex("（剩余时间：-?[0-9]+秒）");
+    static const std::regex number_regex("[0-9]+");
+    return std::regex_replace(std::regex_replace(stage_info, remaining_time_regex, ""), number_regex, "N");
+}
+
+int Run(const uint64_t game_index, const bool mute, RunGameStat* const stat)
+{
+    RunGameMockMatch match(FLAGS_player, mute);
 
     GameOption option;
     option.SetPlayerNum(FLAGS_player);
     option.SetResourceDir(std::filesystem::absolute(FLAGS_resource_dir + "/").c_str());
+    if (!FLAGS_seed.empty()) {
+        // not every game has the seed option, so the failure is ignored
+        option.SetOption(("种子 " + FLAGS_seed + "_" + std::to_string(game_index)).c_str());
+    }
 
-    MockMsgSender sender;
+    MockMsgSender sender(mute);
+    const auto game_begin = std::chrono::steady_clock::now();
     std::unique_ptr<MainStageBase> main_stage(MakeMainStage(sender, option, match));
     if (!main_stage) {
         std::cerr << "Start Game Failed!" << std::endl;
@@ -59,9 +221,25 @@ int Run()
     }
     main_stage->HandleStageBegin();
 
+    RunGameStat::Game game_stat;
     uint64_t ok_count = 0;
     for (uint64_t i = 0; !main_stage->IsOver() && ok_count < FLAGS_player; i = (i + 1) % FLAGS_player) {
-        if (match.IsEliminated(i) || StageErrCode::OK == main_stage->HandleComputerAct(i, true)) {
+        if (match.IsEliminated(i)) {
+            ++ok_count;
+            continue;
+        }
+        std::string stage_name;
+        if (stat) {
+            stage_name = StageName(main_stage->StageInfoC());
+        }
+        const auto act_begin = std::chrono::steady_clock::now();
+        const auto rc = main_stage->HandleComputerAct(i, true);
+        if (stat) {
+            const auto act_cost = std::chrono::steady_clock::now() - act_begin;
+            game_stat.act_costs_.emplace_back(act_cost);
+            game_stat.stage_costs_[stage_name].emplace_back(act_cost);
+        }
+        if (StageErrCode::OK == rc) {
             ++ok_count;
         } else {
             ok_count = 0;
@@ -70,6 +248,14 @@ int Run()
 
     assert(main_stage->IsOver());
 
+    if (stat) {
+        game_stat.cost_ = std::chrono::steady_clock::now() - game_begin;
+        for (PlayerID pid = 0; pid < FLAGS_player; ++pid) {
+            game_stat.scores_.emplace_back(main_stage->PlayerScore(pid));
+        }
+        stat->Merge(std::move(game_stat));
+    }
+
     {
         auto sender_guard = sender();
         sender_guard << "分数结果";
@@ -93,9 +279,41 @@ int main(int argc, char** argv)
     if (FLAGS_player == 0) {
         FLAGS_player = GameOption().BestPlayerNum();
     }
+    if (!FLAGS_stat_format.empty() && FLAGS_stat_format != "csv" && FLAGS_stat_format != "json") {
+        std::cerr << "Invalid stat_format: " << FLAGS_stat_format << std::endl;
+        return -1;
+    }
+    const uint64_t thread_num = std::max<uint64_t>(1, FLAGS_thread);
+    const bool mute = thread_num > 1 || !FLAGS_stat_format.empty();
+
+    enable_markdown_to_image = FLAGS_gen_image && !mute;
 
-    for (uint64_t i = 0; i < FLAGS_repeat; ++i) {
-        Run();
+    RunGameStat stat;
+    std::atomic<uint64_t> next_game_index = 0;
+    const auto run_games = [&]
+        {
+            for (uint64_t i = next_game_index++; FLAGS_repeat == 0 || i < FLAGS_repeat; i = next_game_index++) {
+                Run(i, mute, FLAGS_stat_format.empty() ? nullptr : &stat);
+            }
+        };
+    const auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint64_t i = 1; i < thread_num; ++i) {
+        threads.emplace_back(run_games);
+    }
+    run_games();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const auto cost = std::chrono::steady_clock::now() - begin;
+
+    if (!FLAGS_stat_format.empty()) {
+        if (FLAGS_stat_output.empty()) {
+            stat.Output(std::cout, FLAGS_stat_format, cost);
+        } else {
+            std::ofstream f(FLAGS_stat_output);
+            stat.Output(f, FLAGS_stat_format, cost);
+        }
     }
 
     return 0;
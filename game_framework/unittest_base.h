@@ -63,6 +63,21 @@ class TestGame : public MockMatch, public testing::Test
 
     auto& expected_scores() const { return expected_scores_; }
 
+    // Checkpoint the main stage and restore it on a new main stage, as if the bot restarts.
+    bool CheckpointAndRestore()
+    {
+        uint64_t size = 0;
+        const char* const checkpoint = main_stage_->CheckpointC(size);
+        if (!checkpoint) {
+            return false;
+        }
+        const std::string checkpoint_str(checkpoint, size);
+        std::cout << "[CHECKPOINT AND RESTORE]" << std::endl;
+        MockMsgSender sender;
+        main_stage_.reset(MakeMainStage(sender, option_, *this));
+        return main_stage_ && main_stage_->RestoreC(checkpoint_str.data(), checkpoint_str.size());
+    }
+
     virtual void StartTimer(const uint64_t /*sec*/, void* p, void(*cb)(void*, uint64_t)) override { timer_started_ = true; }
 
     virtual void StopTimer() override { timer_started_ = false; }
@@ -149,6 +164,8 @@ class TestGame : public MockMatch, public testing::Test
         ASSERT_TRUE(StartGame()) << "Start game failed"; \
     } while (0)
 
+#define ASSERT_CHECKPOINT_AND_RESTORE() ASSERT_TRUE(CheckpointAndRestore()) << "Checkpoint and restore failed"
+
 #define ASSERT_ERRCODE(expected, actual) ASSERT_TRUE((expected) == (actual)) << "ErrCode Mismatch, Actual: " << (actual)
 
 #define __ASSERT_ERRCODE_BASE(ret, statement) \
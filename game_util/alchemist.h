@@ -10,6 +10,8 @@
 #include <algorithm>
 #include <variant>
 #include <iostream>
+#include <random>
+#include <vector>
 
 #include "../utility/html.h"
 
@@ -51,23 +53,16 @@ class Board
   public:
     static constexpr const uint32_t k_size = 5;
 
-    Board(std::string image_path, const int style = false) : image_path_(std::move(image_path)), style_(style), table_(k_size + 1, k_size + 1)
-    {
-        table_.SetTableStyle(" align=\"center\" cellpadding=\"1\" cellspacing=\"1\" ");
-        table_.Get(0, 0).SetContent(Image_("coor_corner_" + std::to_string(style)));
-        for (uint32_t i = 0; i < k_size; ++i) {
-            table_.Get(0, i + 1).SetContent(Image_("coor_" + std::to_string(i + 1) + "_" + std::to_string(style)));
-            table_.Get(i + 1, 0).SetContent(Image_(std::string("coor_") + static_cast<char>('a' + i) + "_" + std::to_string(style)));
-            for (uint32_t j = 0; j < k_size; ++j) {
-                table_.Get(i + 1, j + 1).SetContent(Image_("empty_" + std::to_string(style)));
-            }
-        }
-    }
+    Board(std::string image_path, const int style = false) : image_path_(std::move(image_path)), style_(style) {}
 
-    void SetStone(const uint32_t row, const uint32_t col)
+    void SetStone(const uint32_t row, const uint32_t col) { areas_[row][col] = Stone(); }
+
+    bool IsSet(const uint32_t row, const uint32_t col) const { return areas_[row][col].has_value(); }
+
+    // Whether |SetOrClearLine| will succeed.
+    bool CanBeSet(const uint32_t row, const uint32_t col, const Card card) const
     {
-        areas_[row][col] = Stone();
-        table_.Get(row + 1, col + 1).SetContent(Image_("stone_" + std::to_string(style_)));
+        return !areas_[row][col].has_value() && IsAdjCardsOk_(row, col, card) == 0;
     }
 
     // If return -1, means the position is invalid
@@ -84,7 +79,6 @@ class Board
         const auto ret = TryClear_(row, col, cal_point ? card.Score() : 0);
         if (ret == 0) {
             areas_[row][col] = card;
-            table_.Get(row + 1, col + 1).SetContent(Image_(card.ImageName()));
         }
         return ret;
     }
@@ -96,14 +90,32 @@ class Board
             return false;
         }
         area.reset();
-        table_.Get(row + 1, col + 1).SetContent(Image_("empty_" + std::to_string(style_)));
         return true;
     }
 
-    std::string ToHtml() const { return table_.ToString(); }
+    // The table is rendered only when required, so that copying a board is cheap for the tree search.
+    std::string ToHtml() const
+    {
+        html::Table table(k_size + 1, k_size + 1);
+        table.SetTableStyle(" align=\"center\" cellpadding=\"1\" cellspacing=\"1\" ");
+        table.Get(0, 0).SetContent(Image_("coor_corner_" + std::to_string(style_)));
+        for (uint32_t i = 0; i < k_size; ++i) {
+            table.Get(0, i + 1).SetContent(Image_("coor_" + std::to_string(i + 1) + "_" + std::to_string(style_)));
+            table.Get(i + 1, 0).SetContent(Image_(std::string("coor_") + static_cast<char>('a' + i) + "_" + std::to_string(style_)));
+            for (uint32_t j = 0; j < k_size; ++j) {
+                const auto& area = areas_[i][j];
+                std::string image_name =
+                    !area.has_value()                    ? "empty_" + std::to_string(style_) :
+                    std::holds_alternative<Stone>(*area) ? "stone_" + std::to_string(style_) :
+                                                           std::get<Card>(*area).ImageName();
+                table.Get(i + 1, j + 1).SetContent(Image_(std::move(image_name)));
+            }
+        }
+        return table.ToString();
+    }
 
   private:
-    std::string Image_(std::string name) { return "![](file://" + image_path_ + "/" + std::move(name) + ".png)"; }
+    std::string Image_(std::string name) const { return "![](file://" + image_path_ + "/" + std::move(name) + ".png)"; }
 
     int IsAdjCardsOk_(const uint32_t row, const uint32_t col, const Card card) const
     {
@@ -145,7 +157,6 @@ class Board
                                 auto& area = areas_[c.first][c.second];
                                 std::visit([&score](const auto& area) { score += area.Score(); }, *area);
                                 area.reset();
-                                table_.Get(c.first + 1, c.second + 1).SetContent(Image_("empty_" + std::to_string(style_)));
                             });
                     return junction_score == 0 ? 1 : score + junction_score;
                 }
@@ -160,7 +171,78 @@ class Board
     const std::string image_path_;
     const int style_;
     std::array<std::array<std::optional<std::variant<Card, Stone>>, k_size>, k_size> areas_;
-    html::Table table_;
+};
+
+// The adapter of |Board| for mcts::Searcher, which is a single-player game to get more scores in the next rounds. The
+// order of the cards to be drawn is unknown, so they are shuffled by |Randomize|.
+class MctsState
+{
+  public:
+    using Move = std::optional<std::pair<uint32_t, uint32_t>>; // null means to pass
+
+    // |card| is the card of the current round, and null means to erase. |round_num| is the number of rounds to look
+    // ahead, including the current round.
+    MctsState(const Board& board, const std::optional<Card> card, std::vector<std::optional<Card>> remaining_cards,
+            const uint32_t round_num, const bool cal_point)
+        : board_(board)
+        , card_(card)
+        , remaining_cards_(std::move(remaining_cards))
+        , round_num_(std::min<uint32_t>(round_num, remaining_cards_.size() + 1))
+        , round_(0)
+        , cal_point_(cal_point)
+        , score_(0)
+    {
+    }
+
+    uint32_t PlayerNum() const { return 1; }
+
+    uint32_t CurrentPlayer() const { return 0; }
+
+    void LegalMoves(std::vector<Move>& moves) const
+    {
+        moves.emplace_back(std::nullopt);
+        for (uint32_t row = 0; row < Board::k_size; ++row) {
+            for (uint32_t col = 0; col < Board::k_size; ++col) {
+                if (card_.has_value() ? board_.CanBeSet(row, col, *card_) : board_.IsSet(row, col)) {
+                    moves.emplace_back(std::in_place, row, col);
+                }
+            }
+        }
+    }
+
+    void Apply(const Move& move)
+    {
+        if (move.has_value() && card_.has_value()) {
+            score_ += board_.SetOrClearLine(move->first, move->second, *card_, cal_point_);
+        } else if (move.has_value()) {
+            board_.Unset(move->first, move->second);
+        }
+        if (++round_ < round_num_) {
+            card_ = remaining_cards_[round_ - 1];
+        }
+    }
+
+    bool IsTerminal() const { return round_ >= round_num_; }
+
+    double Reward(const uint32_t player) const
+    {
+        // the score of clearing a line is much higher when the points are calculated
+        const double half_reward_score = cal_point_ ? 50 : 2;
+        return score_ / (score_ + half_reward_score);
+    }
+
+    void Randomize(std::mt19937& rng) { std::ranges::shuffle(remaining_cards_, rng); }
+
+    int Score() const { return score_; }
+
+  private:
+    Board board_;
+    std::optional<Card> card_;
+    std::vector<std::optional<Card>> remaining_cards_;
+    uint32_t round_num_;
+    uint32_t round_;
+    bool cal_point_;
+    int score_;
 };
 
 }
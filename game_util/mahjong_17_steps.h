@@ -6,10 +6,15 @@
 
 #include <map>
 #include <set>
+#include <mutex>
+#include <array>
 #include <ranges>
 #include <variant>
 #include <random>
+#include <optional>
 #include <algorithm>
+#include <numeric>
+#include <unordered_map>
 
 #include "Mahjong/Table.h"
 #include "Mahjong/Rule.h"
@@ -81,6 +86,183 @@ static std::string wind2str(const Wind wind)
     return "";
 }
 
+// The number of each base tile, which is the canonical form of a hand regardless of the order of the tiles.
+using TileCounts = std::array<uint8_t, 9 * 3 + 7>;
+
+// A lookup table of all the patterns of a suit which can be split into melds, with or without a pair, so that checking
+// a winning hand costs a few table probes instead of a search.
+class AgariTable
+{
+  public:
+    static const AgariTable& Get()
+    {
+        static const AgariTable table;
+        return table;
+    }
+
+    // Same as |is和牌| for 14 tiles.
+    bool IsAgari(const TileCounts& counts) const
+    {
+        return IsNormalAgari_(counts) || Is七对子_(counts) || Is国士无双_(counts);
+    }
+
+  private:
+    static constexpr uint32_t k_suit_key_num = 1953125; // 5 ^ 9
+    static constexpr uint8_t k_melds = 1;
+    static constexpr uint8_t k_melds_and_pair = 2;
+
+    AgariTable() : suit_patterns_(k_suit_key_num, 0)
+    {
+        std::array<uint8_t, 9> counts{0};
+        AddMelds_(counts, 0, 0);
+    }
+
+    static uint32_t SuitKey_(const uint8_t* const counts)
+    {
+        uint32_t key = 0;
+        for (uint32_t i = 0; i < 9; ++i) {
+            key = key * 5 + counts[i];
+        }
+        return key;
+    }
+
+    // The melds are added in the non-decreasing order of their indexes to avoid enumerating the same pattern
+    // repeatedly. The indexes 0~6 are sequences and 7~15 are triplets.
+    void AddMelds_(std::array<uint8_t, 9>& counts, const uint32_t meld_num, const uint32_t first_meld)
+    {
+        suit_patterns_[SuitKey_(counts.data())] |= k_melds;
+        for (uint32_t pair = 0; pair < 9; ++pair) {
+            if (counts[pair] <= 2) {
+                counts[pair] += 2;
+                suit_patterns_[SuitKey_(counts.data())] |= k_melds_and_pair;
+                counts[pair] -= 2;
+            }
+        }
+        if (meld_num == 4) {
+            return;
+        }
+        for (uint32_t meld = first_meld; meld < 16; ++meld) {
+            const bool is_sequence = meld < 7;
+            const uint32_t first = is_sequence ? meld : meld - 7;
+            if (is_sequence ? (counts[first] == 4 || counts[first + 1] == 4 || counts[first + 2] == 4) :
+                              counts[first] > 1) {
+                continue;
+            }
+            const auto update = [&](const int8_t diff)
+                {
+                    if (is_sequence) {
+                        counts[first] += diff;
+                        counts[first + 1] += diff;
+                        counts[first + 2] += diff;
+                    } else {
+                        counts[first] += diff * 3;
+                    }
+                };
+            update(1);
+            AddMelds_(counts, meld_num + 1, meld);
+            update(-1);
+        }
+    }
+
+    bool IsNormalAgari_(const TileCounts& counts) const
+    {
+        uint32_t pair_num = 0;
+        for (uint32_t suit = 0; suit < 3; ++suit) {
+            const uint8_t* const suit_counts = counts.data() + suit * 9;
+            const uint32_t tile_num = std::accumulate(suit_counts, suit_counts + 9, 0U);
+            if (tile_num % 3 == 1) {
+                return false;
+            }
+            const bool has_pair = tile_num % 3 == 2;
+            pair_num += has_pair;
+            if (!(suit_patterns_[SuitKey_(suit_counts)] & (has_pair ? k_melds_and_pair : k_melds))) {
+                return false;
+            }
+        }
+        for (uint32_t i = 9 * 3; i < counts.size(); ++i) {
+            if (counts[i] == 1 || counts[i] == 4) {
+                return false;
+            }
+            pair_num += counts[i] == 2;
+        }
+        return pair_num == 1;
+    }
+
+    static bool Is七对子_(const TileCounts& counts)
+    {
+        return std::ranges::all_of(counts, [](const uint8_t count) { return count == 0 || count == 2; }) &&
+            std::ranges::count(counts, 2) == 7;
+    }
+
+    static bool Is国士无双_(const TileCounts& counts)
+    {
+        uint32_t tile_num = 0;
+        for (uint32_t i = 0; i < counts.size(); ++i) {
+            const bool is_yaochu = i >= 9 * 3 || i % 9 == 0 || i % 9 == 8;
+            if (is_yaochu ? counts[i] == 0 : counts[i] != 0) {
+                return false;
+            }
+            tile_num += counts[i];
+        }
+        return tile_num == 14;
+    }
+
+    std::vector<uint8_t> suit_patterns_; // indexed by the suit key, with k_melds and k_melds_and_pair bits
+};
+
+// Memoizes the yaku counting results of the winning hands, which is the most costly part of the listen analysis. The
+// key should contain everything affecting the result, i.e., the hand, the winning tile, the seat wind and the doras.
+class YakuCache
+{
+  public:
+    static constexpr uint64_t k_max_entry_num = 65536;
+
+    static YakuCache& Get()
+    {
+        static YakuCache cache;
+        return cache;
+    }
+
+    template <typename Count>
+    CounterResult GetOrCount(const std::string& key, Count&& count)
+    {
+        {
+            std::lock_guard<std::mutex> l(mutex_);
+            if (const auto it = results_.find(key); it != results_.end()) {
+                ++hit_num_;
+                return it->second;
+            }
+            ++miss_num_;
+        }
+        // count without the lock because it is costly
+        CounterResult result = count();
+        std::lock_guard<std::mutex> l(mutex_);
+        if (results_.size() >= k_max_entry_num) {
+            results_.clear(); // the doras differ among matches, so the entries are rarely reused for a long time
+        }
+        results_.emplace(key, result);
+        return result;
+    }
+
+    uint64_t HitNum() const
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        return hit_num_;
+    }
+
+    uint64_t MissNum() const
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        return miss_num_;
+    }
+
+  private:
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, CounterResult> results_;
+    uint64_t hit_num_ = 0;
+    uint64_t miss_num_ = 0;
+};
+
 class Mahjong17Steps
 {
   private:
@@ -638,44 +820,76 @@ class Mahjong17Steps
         }
     }
 
+    // The key of the hand of |pid| for |YakuCache|, without the winning tile.
+    std::string HandKey_(const uint64_t pid) const
+    {
+        const auto tile_char = [](const Tile& tile) { return static_cast<char>(tile.tile * 2 + tile.red_dora); };
+        std::string key;
+        for (const auto& tile : players_[pid].hand_) {
+            key += tile_char(tile); // the tiles are sorted, so the key is canonical
+        }
+        key += static_cast<char>(option_.player_descs_[pid].wind_);
+        for (const auto& [dora, inner_dora] : doras_) {
+            key += tile_char(dora);
+            key += tile_char(inner_dora);
+        }
+        return key;
+    }
+
+    CounterResult CountYaku_(Table& table, const uint64_t pid, const BaseTile basetile) const
+    {
+        Tile correspond_tile = Tile{.tile = basetile, .red_dora = 0};
+        auto counter = yaku_counter(&table, pid, &correspond_tile, false /*枪杠*/, false /*枪暗杠*/,
+                option_.player_descs_[pid].wind_ /*自风*/, Wind::East /*场风*/);
+        if (std::ranges::any_of(counter.yakus,
+                    [](const Yaku yaku) { return yaku > Yaku::满贯 && yaku < Yaku::双倍役满; })) {
+            // convert double 役满 to single 役满 (without 大四喜)
+            for (auto& yaku : counter.yakus) {
+                if (yaku == Yaku::国士无双十三面) {
+                    yaku = Yaku::国士无双;
+                    counter.yakuman -= 1;
+                } else if (yaku == Yaku::纯正九莲宝灯) {
+                    yaku = Yaku::九莲宝灯;
+                    counter.yakuman -= 1;
+                } else if (yaku == Yaku::四暗刻单骑) {
+                    yaku = Yaku::四暗刻;
+                    counter.yakuman -= 1;
+                }
+            }
+            // remove non 役满 tiles
+            std::erase_if(counter.yakus, [](const Yaku yaku) { return yaku < Yaku::满贯; });
+        }
+        counter.calculate_score(false, false);
+        return counter;
+    }
+
     std::map<BaseTile, CounterResult> GetListenInfo_(const uint64_t pid)
     {
         std::map<BaseTile, CounterResult> ret;
-        Table table;
-        InitTable_(table, pid);
-        auto basetiles = convert_tiles_to_base_tiles(table.players[pid].hand);
-        for (uint8_t basetile = 0; basetile < 9 * 3 + 7; ++basetile) {
-            if (4 == std::count_if(table.players[pid].hand.begin(), table.players[pid].hand.end(),
-                        [&basetile](const Tile* tile) { return tile->tile == basetile; })) {
+        TileCounts counts{0};
+        for (const auto& tile : players_[pid].hand_) {
+            ++counts[tile.tile];
+        }
+        const std::string hand_key = HandKey_(pid);
+        std::optional<Table> table; // only made when the result is not cached
+        for (uint8_t basetile = 0; basetile < counts.size(); ++basetile) {
+            if (counts[basetile] == 4) {
                 continue; // all same tiles are in hand
             }
-            Tile correspond_tile = Tile{.tile = static_cast<BaseTile>(basetile), .red_dora = 0};
-            basetiles.emplace_back(correspond_tile.tile);
-            if (is和牌(basetiles)) {
-                auto counter = yaku_counter(&table, pid, &correspond_tile, false /*枪杠*/, false /*枪暗杠*/,
-                        option_.player_descs_[pid].wind_ /*自风*/, Wind::East /*场风*/);
-                if (std::ranges::any_of(counter.yakus,
-                            [](const Yaku yaku) { return yaku > Yaku::满贯 && yaku < Yaku::双倍役满; })) {
-                    // convert double 役满 to single 役满 (without 大四喜)
-                    for (auto& yaku : counter.yakus) {
-                        if (yaku == Yaku::国士无双十三面) {
-                            yaku = Yaku::国士无双;
-                            counter.yakuman -= 1;
-                        } else if (yaku == Yaku::纯正九莲宝灯) {
-                            yaku = Yaku::九莲宝灯;
-                            counter.yakuman -= 1;
-                        } else if (yaku == Yaku::四暗刻单骑) {
-                            yaku = Yaku::四暗刻;
-                            counter.yakuman -= 1;
-                        }
-                    }
-                    // remove non 役满 tiles
-                    std::erase_if(counter.yakus, [](const Yaku yaku) { return yaku < Yaku::满贯; });
-                }
-                counter.calculate_score(false, false);
-                ret.emplace(static_cast<BaseTile>(basetile), std::move(counter));
+            ++counts[basetile];
+            const bool is_agari = AgariTable::Get().IsAgari(counts);
+            --counts[basetile];
+            if (!is_agari) {
+                continue;
             }
-            basetiles.pop_back();
+            auto counter = YakuCache::Get().GetOrCount(hand_key + static_cast<char>(basetile), [&]
+                    {
+                        if (!table.has_value()) {
+                            InitTable_(table.emplace(), pid);
+                        }
+                        return CountYaku_(*table, pid, static_cast<BaseTile>(basetile));
+                    });
+            ret.emplace(static_cast<BaseTile>(basetile), std::move(counter));
         }
         return ret;
     }
@@ -0,0 +1,403 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <concepts>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace mcts {
+
+// The state of a game to be searched. Copying a state clones it, and the clone should be independent of the original.
+//
+// - |Move|: the type of a move. It is compared to merge the results of different trees.
+// - |PlayerNum()|: the number of players, and the players are numbered from 0.
+// - |CurrentPlayer()|: the player to make the next move.
+// - |LegalMoves(moves)|: append the legal moves of the current player to |moves|. There should be at least one legal
+//   move when the state is not terminal.
+// - |Apply(move)|: make a legal move.
+// - |IsTerminal()|: whether the game is over.
+// - |Reward(player)|: the reward of |player| in [0, 1]. It is also called on a non-terminal state when the playout is
+//   cut off by |Options::max_playout_depth_|, so it should be an estimation then.
+template <typename T>
+concept GameState = std::copy_constructible<T> && std::semiregular<typename T::Move> &&
+    std::equality_comparable<typename T::Move> &&
+    requires(const T& state, T& mutable_state, const typename T::Move& move, std::vector<typename T::Move>& moves,
+            const uint32_t player)
+    {
+        { state.PlayerNum() } -> std::convertible_to<uint32_t>;
+        { state.CurrentPlayer() } -> std::convertible_to<uint32_t>;
+        state.LegalMoves(moves);
+        mutable_state.Apply(move);
+        { state.IsTerminal() } -> std::convertible_to<bool>;
+        { state.Reward(player) } -> std::convertible_to<double>;
+    };
+
+// A state with hidden information (e.g. the order of the cards to be drawn) can shuffle the hidden information. Each
+// tree is built on a clone of the root state randomized once, so the root-parallel search averages over several
+// guesses of the hidden information.
+template <typename T>
+concept RandomizableGameState = GameState<T> && requires(T& state, std::mt19937& rng) { state.Randomize(rng); };
+
+enum class Parallelism
+{
+    ROOT, // each thread builds its own tree, and the results of the root moves are summed up
+    TREE, // all the threads build one shared tree, and the virtual loss spreads them over different paths
+};
+
+struct Options
+{
+    uint32_t thread_num_ = 1;
+    Parallelism parallelism_ = Parallelism::ROOT;
+    std::chrono::milliseconds time_budget_{100}; // the wall-clock time of each search, 0 means no limit
+    uint64_t max_playout_num_ = 0; // 0 means no limit, the search needs at least one limit
+    uint32_t max_playout_depth_ = std::numeric_limits<uint32_t>::max();
+    uint64_t max_node_num_ = 1 << 20; // the limit of each tree, leaves are not expanded any more when reached
+    double exploration_ = 1.4;
+    uint64_t seed_ = 0; // 0 means to use a random seed
+};
+
+template <typename Move>
+struct Result
+{
+    std::optional<Move> best_move_; // null when the root state is terminal
+    double best_move_reward_ = 0; // the average reward of the player to move
+    uint64_t playout_num_ = 0;
+    uint64_t node_num_ = 0;
+    std::chrono::microseconds cost_{0};
+};
+
+template <typename Move>
+struct Node
+{
+    enum : uint8_t { NOT_EXPANDED, EXPANDING, EXPANDED };
+
+    void Init(Move move, const uint32_t player)
+    {
+        move_ = std::move(move);
+        player_ = player;
+        children_ = nullptr;
+        child_num_ = 0;
+        expand_state_.store(NOT_EXPANDED, std::memory_order_relaxed);
+        visit_num_.store(0, std::memory_order_relaxed);
+        reward_sum_.store(0, std::memory_order_relaxed);
+    }
+
+    Move move_; // the move from the parent
+    uint32_t player_; // the player who makes |move_|
+    Node* children_; // contiguous in the pool, only readable after |expand_state_| is EXPANDED
+    uint32_t child_num_;
+    std::atomic<uint8_t> expand_state_;
+    std::atomic<uint32_t> visit_num_; // increased when passed by, which is the virtual loss before being backed up
+    std::atomic<uint64_t> reward_sum_; // in units of 1 / k_reward_scale
+};
+
+// Allocates the nodes in chunks which are kept across searches, so a searcher allocates nothing once the pool has grown
+// to the size its searches need.
+template <typename Move>
+class NodePool
+{
+  public:
+    static constexpr const uint64_t k_chunk_size = 4096;
+
+    NodePool() : chunk_idx_(0), chunk_offset_(0), size_(0), max_size_(0) {}
+
+    // Return |num| contiguous nodes, or nullptr if the pool is full.
+    Node<Move>* Allocate(const uint64_t num)
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        if (num > k_chunk_size || size_ + num > max_size_) {
+            return nullptr;
+        }
+        if (chunk_offset_ + num > k_chunk_size) {
+            ++chunk_idx_;
+            chunk_offset_ = 0;
+        }
+        if (chunk_idx_ == chunks_.size()) {
+            chunks_.emplace_back(std::make_unique<Node<Move>[]>(k_chunk_size));
+        }
+        Node<Move>* const nodes = chunks_[chunk_idx_].get() + chunk_offset_;
+        chunk_offset_ += num;
+        size_ += num;
+        return nodes;
+    }
+
+    // The allocated nodes are invalid after reset, but the memory is kept.
+    void Reset(const uint64_t max_size)
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        chunk_idx_ = 0;
+        chunk_offset_ = 0;
+        size_ = 0;
+        max_size_ = max_size;
+    }
+
+    uint64_t Size() const
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        return size_;
+    }
+
+    uint64_t Capacity() const
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        return chunks_.size() * k_chunk_size;
+    }
+
+  private:
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Node<Move>[]>> chunks_;
+    uint64_t chunk_idx_;
+    uint64_t chunk_offset_;
+    uint64_t size_;
+    uint64_t max_size_;
+};
+
+// Searches the best move of the player to move. A searcher can be reused for the following moves, which reuses the
+// node pools. It is not thread-safe, but each search runs on |Options::thread_num_| threads.
+template <GameState State>
+class Searcher
+{
+  public:
+    using Move = typename State::Move;
+
+    static constexpr const uint64_t k_reward_scale = 1 << 16;
+
+    Searcher(const Options& options)
+        : options_(options)
+        , pools_(options.parallelism_ == Parallelism::ROOT ? std::max(1U, options.thread_num_) : 1)
+    {
+        for (auto& pool : pools_) {
+            pool = std::make_unique<NodePool<Move>>();
+        }
+    }
+
+    Result<Move> Search(const State& state)
+    {
+        const auto begin_time = std::chrono::steady_clock::now();
+        const auto deadline = begin_time + options_.time_budget_;
+        const uint32_t thread_num = std::max(1U, options_.thread_num_);
+        const uint64_t seed = options_.seed_ ? options_.seed_ : std::random_device{}();
+
+        if (state.IsTerminal()) {
+            return {};
+        }
+
+        std::vector<Tree> trees;
+        trees.reserve(pools_.size());
+        for (uint32_t i = 0; i < pools_.size(); ++i) {
+            NodePool<Move>* const pool = pools_[i].get();
+            pool->Reset(std::max<uint64_t>(1, options_.max_node_num_));
+            Node<Move>* const root = pool->Allocate(1);
+            root->Init(Move{}, state.PlayerNum()); // the root has no move, so it is not backed up
+            auto& tree = trees.emplace_back(pool, root, state);
+            if constexpr (RandomizableGameState<State>) {
+                std::mt19937 rng(seed + i);
+                tree.state_.Randomize(rng);
+            }
+        }
+
+        std::atomic<uint64_t> playout_num = 0;
+        const auto work = [&](const uint32_t thread_idx)
+            {
+                Tree& tree = trees[options_.parallelism_ == Parallelism::ROOT ? thread_idx : 0];
+                Worker_(tree, std::mt19937(seed + thread_num + thread_idx), deadline, playout_num);
+            };
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < thread_num; ++i) {
+            threads.emplace_back(work, i);
+        }
+        work(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        Result<Move> result;
+        result.playout_num_ = playout_num;
+        for (const auto& tree : trees) {
+            result.node_num_ += tree.pool_->Size();
+        }
+        MergeRootMoves_(trees, result);
+        result.cost_ =
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin_time);
+        return result;
+    }
+
+    // The number of nodes the pools can hold without allocating.
+    uint64_t PoolCapacity() const
+    {
+        uint64_t capacity = 0;
+        for (const auto& pool : pools_) {
+            capacity += pool->Capacity();
+        }
+        return capacity;
+    }
+
+  private:
+    struct Tree
+    {
+        NodePool<Move>* pool_;
+        Node<Move>* root_;
+        State state_;
+    };
+
+    bool ShouldStop_(const std::chrono::steady_clock::time_point deadline, std::atomic<uint64_t>& playout_num) const
+    {
+        if (options_.max_playout_num_ > 0 && playout_num.load(std::memory_order_relaxed) >= options_.max_playout_num_) {
+            return true;
+        }
+        return options_.time_budget_.count() > 0 && std::chrono::steady_clock::now() >= deadline;
+    }
+
+    void Worker_(Tree& tree, std::mt19937 rng, const std::chrono::steady_clock::time_point deadline,
+            std::atomic<uint64_t>& playout_num)
+    {
+        std::optional<State> state;
+        std::vector<Node<Move>*> path;
+        std::vector<Move> moves;
+        std::vector<uint64_t> rewards(tree.state_.PlayerNum());
+        while (!ShouldStop_(deadline, playout_num)) {
+            state.emplace(tree.state_);
+            path.clear();
+            Node<Move>* node = tree.root_;
+            node->visit_num_.fetch_add(1, std::memory_order_relaxed);
+            path.emplace_back(node);
+
+            // selection
+            while (node->expand_state_.load(std::memory_order_acquire) == Node<Move>::EXPANDED &&
+                    node->child_num_ > 0) {
+                node = SelectChild_(*node);
+                node->visit_num_.fetch_add(1, std::memory_order_relaxed);
+                state->Apply(node->move_);
+                path.emplace_back(node);
+            }
+
+            // expansion
+            if (!state->IsTerminal() && Expand_(*node, *state, *tree.pool_, moves)) {
+                node = node->children_ + rng() % node->child_num_;
+                node->visit_num_.fetch_add(1, std::memory_order_relaxed);
+                state->Apply(node->move_);
+                path.emplace_back(node);
+            }
+
+            // playout
+            for (uint32_t depth = 0; depth < options_.max_playout_depth_ && !state->IsTerminal(); ++depth) {
+                moves.clear();
+                state->LegalMoves(moves);
+                if (moves.empty()) {
+                    break;
+                }
+                state->Apply(moves[rng() % moves.size()]);
+            }
+
+            // backup
+            for (uint32_t player = 0; player < rewards.size(); ++player) {
+                rewards[player] = std::llround(std::clamp(state->Reward(player), 0.0, 1.0) * k_reward_scale);
+            }
+            for (Node<Move>* const passed_node : path) {
+                if (passed_node->player_ < rewards.size()) {
+                    passed_node->reward_sum_.fetch_add(rewards[passed_node->player_], std::memory_order_relaxed);
+                }
+            }
+            playout_num.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Only one thread expands the node, the others playout from the node before the children are ready.
+    bool Expand_(Node<Move>& node, const State& state, NodePool<Move>& pool, std::vector<Move>& moves)
+    {
+        uint8_t expand_state = Node<Move>::NOT_EXPANDED;
+        if (!node.expand_state_.compare_exchange_strong(expand_state, Node<Move>::EXPANDING,
+                    std::memory_order_acq_rel)) {
+            return false;
+        }
+        moves.clear();
+        state.LegalMoves(moves);
+        Node<Move>* const children = moves.empty() ? nullptr : pool.Allocate(moves.size());
+        if (children == nullptr) {
+            // the pool is full, so the node stays a leaf
+            node.expand_state_.store(Node<Move>::EXPANDED, std::memory_order_release);
+            return false;
+        }
+        const uint32_t player = state.CurrentPlayer();
+        for (uint32_t i = 0; i < moves.size(); ++i) {
+            children[i].Init(std::move(moves[i]), player);
+        }
+        node.children_ = children;
+        node.child_num_ = moves.size();
+        node.expand_state_.store(Node<Move>::EXPANDED, std::memory_order_release);
+        return true;
+    }
+
+    // REQUIRE: the node has children
+    Node<Move>* SelectChild_(const Node<Move>& node) const
+    {
+        const double log_parent_visit_num = std::log(std::max(1U, node.visit_num_.load(std::memory_order_relaxed)));
+        Node<Move>* best_child = node.children_; // never returns null even if the scores are not comparable
+        double best_score = -1;
+        for (uint32_t i = 0; i < node.child_num_; ++i) {
+            Node<Move>* const child = node.children_ + i;
+            const uint32_t visit_num = child->visit_num_.load(std::memory_order_relaxed);
+            if (visit_num == 0) {
+                return child;
+            }
+            const double exploitation =
+                static_cast<double>(child->reward_sum_.load(std::memory_order_relaxed)) / k_reward_scale / visit_num;
+            const double score = exploitation + options_.exploration_ * std::sqrt(log_parent_visit_num / visit_num);
+            if (score > best_score) {
+                best_score = score;
+                best_child = child;
+            }
+        }
+        return best_child;
+    }
+
+    static void MergeRootMoves_(const std::vector<Tree>& trees, Result<Move>& result)
+    {
+        struct MoveStat
+        {
+            Move move_;
+            uint64_t visit_num_;
+            uint64_t reward_sum_;
+        };
+        std::vector<MoveStat> stats;
+        for (const auto& tree : trees) {
+            const Node<Move>& root = *tree.root_;
+            if (root.expand_state_.load(std::memory_order_acquire) != Node<Move>::EXPANDED) {
+                continue;
+            }
+            for (uint32_t i = 0; i < root.child_num_; ++i) {
+                const Node<Move>& child = root.children_[i];
+                const auto it = std::ranges::find_if(stats, [&](const MoveStat& stat) { return stat.move_ == child.move_; });
+                if (it == stats.end()) {
+                    stats.emplace_back(child.move_, child.visit_num_.load(), child.reward_sum_.load());
+                } else {
+                    it->visit_num_ += child.visit_num_.load();
+                    it->reward_sum_ += child.reward_sum_.load();
+                }
+            }
+        }
+        const auto it = std::ranges::max_element(stats, {}, &MoveStat::visit_num_);
+        if (it != stats.end()) {
+            result.best_move_ = it->move_;
+            result.best_move_reward_ =
+                it->visit_num_ == 0 ? 0 : static_cast<double>(it->reward_sum_) / k_reward_scale / it->visit_num_;
+        }
+    }
+
+    const Options options_;
+    std::vector<std::unique_ptr<NodePool<Move>>> pools_;
+};
+
+}
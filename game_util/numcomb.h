@@ -6,12 +6,14 @@
 
 #include <cassert>
 
+#include <algorithm>
 #include <vector>
 #include <optional>
 #include <array>
 #include <filesystem>
 #include <numeric>
 #include <iostream>
+#include <limits>
 #include <map>
 
 #include "../utility/html.h"
@@ -23,20 +25,20 @@ enum class Direct { TOP_LEFT = 0, VERT = 1, TOP_RIGHT = 2};
 
 struct Coordinate
 {
-    Coordinate& operator+=(const Coordinate& c)
+    constexpr Coordinate& operator+=(const Coordinate& c)
     {
         x_ += c.x_;
         y_ += c.y_;
         return *this;
     }
 
-    friend Coordinate operator+(const Coordinate& _1, const Coordinate& _2)
+    friend constexpr Coordinate operator+(const Coordinate& _1, const Coordinate& _2)
     {
         Coordinate tmp(_1);
         return tmp += _2;
     }
 
-    Coordinate operator-() const { return Coordinate{-x_, -y_}; }
+    constexpr Coordinate operator-() const { return Coordinate{-x_, -y_}; }
 
     auto operator<=>(const Coordinate&) const = default;
 
@@ -45,13 +47,18 @@ struct Coordinate
 };
 
 template <Direct direct> const Coordinate k_direct_step;
-template <> const Coordinate k_direct_step<Direct::TOP_LEFT>{1, 1};
-template <> const Coordinate k_direct_step<Direct::VERT>{0, 2};
-template <> const Coordinate k_direct_step<Direct::TOP_RIGHT>{-1, 1};
+template <> inline constexpr Coordinate k_direct_step<Direct::TOP_LEFT>{1, 1};
+template <> inline constexpr Coordinate k_direct_step<Direct::VERT>{0, 2};
+template <> inline constexpr Coordinate k_direct_step<Direct::TOP_RIGHT>{-1, 1};
+
+inline constexpr std::array<Coordinate, k_direct_max> k_direct_steps{
+    k_direct_step<Direct::TOP_LEFT>, k_direct_step<Direct::VERT>, k_direct_step<Direct::TOP_RIGHT>};
 
 class AreaCard
 {
   public:
+    static constexpr int32_t k_max_point = 9; // the points are digits, which are written in the image names
+
     AreaCard() {} // wild card
 
     AreaCard(const int32_t a, const int32_t b, const int32_t c) : points_(std::in_place, std::array<int32_t, k_direct_max>{a, b, c}) {}
@@ -69,10 +76,12 @@ class AreaCard
     }
 
     template <Direct direct>
-    std::optional<int32_t> Point() const
+    std::optional<int32_t> Point() const { return Point(direct); }
+
+    std::optional<int32_t> Point(const Direct direct) const
     {
         if (points_.has_value()) {
-            return points_->at(static_cast<uint32_t>(direct));
+            return (*points_)[static_cast<uint32_t>(direct)];
         } else {
             return std::nullopt;
         }
@@ -93,11 +102,437 @@ class AreaCard
 
     bool IsWild() const { return !points_.has_value(); }
 
+    bool operator==(const AreaCard&) const = default;
+
   private:
     static constexpr int32_t k_wild_score_sum = 30;
     std::optional<std::array<int32_t, k_direct_max>> points_;
 };
 
+// The areas and lines of a comb, precomputed as flat index tables. The area 0 is the extra area which belongs to no line,
+// and the areas 1~19 make up the hexagon, indexed column by column from the left (see |ToIndex|).
+class LineTable
+{
+  public:
+    static constexpr uint32_t k_size = 3;
+    static constexpr uint32_t k_area_num = 1 + 3 * k_size * (k_size - 1) + 1;
+    static constexpr uint32_t k_max_line_size = k_size * 2 - 1;
+    static constexpr uint32_t k_line_num = k_max_line_size * k_direct_max;
+    static constexpr uint32_t k_no_line = UINT32_MAX;
+
+    struct Line
+    {
+        Direct direct_;
+        uint32_t size_;
+        std::array<uint32_t, k_max_line_size> areas_; // in the order of |k_direct_step<direct_>|
+        Coordinate head_; // the coordinate before the first area
+        Coordinate tail_; // the coordinate after the last area
+    };
+
+    constexpr LineTable() : lines_{}, area_lines_{}, area_coordinates_{}
+    {
+        for (int32_t x = -int32_t(k_size) + 1; x < int32_t(k_size); ++x) {
+            for (int32_t y = -int32_t(k_size) * 2; y <= int32_t(k_size) * 2; ++y) {
+                if (IsValid({x, y})) {
+                    area_coordinates_[ToIndex({x, y})] = {x, y};
+                }
+            }
+        }
+        uint32_t line_num = 0;
+        for (uint32_t direct = 0; direct < k_direct_max; ++direct) {
+            const Coordinate step = k_direct_steps[direct];
+            area_lines_[0][direct] = k_no_line;
+            for (uint32_t idx = 1; idx < k_area_num; ++idx) {
+                if (IsValid(area_coordinates_[idx] + -step)) {
+                    continue; // not the first area of a line
+                }
+                Line& line = lines_[line_num];
+                line.direct_ = static_cast<Direct>(direct);
+                line.size_ = 0;
+                line.head_ = area_coordinates_[idx] + -step;
+                Coordinate coor = area_coordinates_[idx];
+                for (; IsValid(coor); coor += step) {
+                    line.areas_[line.size_++] = ToIndex(coor);
+                    area_lines_[ToIndex(coor)][direct] = line_num;
+                }
+                line.tail_ = coor;
+                ++line_num;
+            }
+        }
+    }
+
+    constexpr const Line& GetLine(const uint32_t line_id) const { return lines_[line_id]; }
+
+    // Return: the line passing the area in the direction, or |k_no_line| for the area 0
+    constexpr uint32_t AreaLine(const uint32_t idx, const Direct direct) const
+    {
+        return area_lines_[idx][static_cast<uint32_t>(direct)];
+    }
+
+    constexpr Coordinate AreaCoordinate(const uint32_t idx) const { return area_coordinates_[idx]; }
+
+    static constexpr bool IsValid(const Coordinate coordinate)
+    {
+        return Abs_(coordinate.x_) + Abs_(coordinate.y_) < k_size * 2 && Abs_(coordinate.x_) < k_size &&
+            (coordinate.x_ + coordinate.y_) % 2 == 0;
+    }
+
+    // -2 -1  0  1  2       value of coordinate.x
+    //              x
+    //           x
+    //        .     x
+    //     .     .          (. + x) is the initial count (left of coordinate.x)
+    //  .     .     .
+    //     .     .          x is to-remove count
+    //  .     .     .
+    //     .     .          . is the real count
+    //  .     .     .
+    //     .     .
+    //        .     x
+    //           x          then idx the real count + (coordinate.y offset value)
+    //              x
+    static constexpr uint32_t ToIndex(const Coordinate coordinate)
+    {
+        const int32_t level = coordinate.x_ + k_size - 1;
+        uint32_t idx = (k_size + k_size + level - 1) * level / 2;
+        if (coordinate.x_ > 1) { // x == 2
+            idx -= (coordinate.x_ - 1) * coordinate.x_; // idx -= 2
+        }
+        idx += (coordinate.y_ + k_size * 2 - Abs_(coordinate.x_)) / 2;
+        return idx;
+    }
+
+  private:
+    static constexpr int32_t Abs_(const int32_t value) { return value < 0 ? -value : value; }
+
+    std::array<Line, k_line_num> lines_;
+    std::array<std::array<uint32_t, k_direct_max>, k_area_num> area_lines_;
+    std::array<Coordinate, k_area_num> area_coordinates_;
+};
+
+inline constexpr LineTable k_line_table;
+
+// The model of a comb, which holds the cards and counts the points, without rendering anything.
+class Board
+{
+  public:
+    static constexpr uint32_t k_area_num = LineTable::k_area_num;
+
+    // Return: the points got by filling the card
+    int32_t Fill(const uint32_t idx, const AreaCard& card)
+    {
+        assert(!cards_[idx].has_value());
+        cards_[idx] = card;
+        if (idx == 0) {
+            return card.PointSum();
+        }
+        int32_t point = 0;
+        for (uint32_t direct = 0; direct < k_direct_max; ++direct) {
+            point += LinePoint(k_line_table.AreaLine(idx, static_cast<Direct>(direct)));
+        }
+        return point;
+    }
+
+    void Clear(const uint32_t idx) { cards_[idx].reset(); }
+
+    bool IsFilled(const uint32_t idx) const { return cards_[idx].has_value(); }
+
+    const std::optional<AreaCard>& Get(const uint32_t idx) const { return cards_[idx]; }
+
+    // Return: the points of a line whose areas are all filled with the same number, or 0 otherwise
+    int32_t LinePoint(const uint32_t line_id) const
+    {
+        const auto& line = k_line_table.GetLine(line_id);
+        std::optional<int32_t> point;
+        for (uint32_t i = 0; i < line.size_; ++i) {
+            const auto& card = cards_[line.areas_[i]];
+            if (!card.has_value()) {
+                return 0;
+            }
+            const auto card_point = card->Point(line.direct_);
+            if (!card_point.has_value()) { // the wild card matches any number
+                continue;
+            }
+            if (point.has_value() && *point != *card_point) {
+                return 0;
+            }
+            point = card_point;
+        }
+        if (point.has_value()) {
+            return *point * line.size_;
+        } else {
+            return 10000; // TODO: is an impossible case, we should limit number of wild card less than k_size
+        }
+    }
+
+  private:
+    std::array<std::optional<AreaCard>, k_area_num> cards_;
+};
+
+// The cards which have not been dealt, counted by kinds and by the numbers of each direction.
+class CardPool
+{
+  public:
+    CardPool() : size_(0), wild_num_(0), point_sum_(0), point_nums_{} {}
+
+    explicit CardPool(const std::vector<AreaCard>& cards) : CardPool()
+    {
+        for (const auto& card : cards) {
+            Add(card);
+        }
+    }
+
+    void Add(const AreaCard& card, const uint32_t num = 1)
+    {
+        const auto it = std::ranges::find(kinds_, card, [](const auto& kind) { return kind.first; });
+        if (it == kinds_.end()) {
+            kinds_.emplace_back(card, num);
+        } else {
+            it->second += num;
+        }
+        Count_(card, num);
+    }
+
+    // Return: false if there is no such card
+    bool Remove(const AreaCard& card)
+    {
+        const auto it = std::ranges::find(kinds_, card, [](const auto& kind) { return kind.first; });
+        if (it == kinds_.end() || it->second == 0) {
+            return false;
+        }
+        --it->second; // keep the kind so that the iterators of |Kinds| are not invalidated
+        Count_(card, -1);
+        return true;
+    }
+
+    uint32_t Size() const { return size_; }
+
+    // The kinds of cards with the numbers of them. The number may be zero.
+    const std::vector<std::pair<AreaCard, uint32_t>>& Kinds() const { return kinds_; }
+
+    // Return: the number of cards which match |point| in |direct|, including the wild cards
+    uint32_t MatchNum(const Direct direct, const int32_t point) const
+    {
+        return point_nums_[static_cast<uint32_t>(direct)][point] + wild_num_;
+    }
+
+    bool HasPoint(const Direct direct, const int32_t point) const
+    {
+        return point_nums_[static_cast<uint32_t>(direct)][point] > 0;
+    }
+
+    double AveragePointSum() const { return size_ == 0 ? 0 : static_cast<double>(point_sum_) / size_; }
+
+  private:
+    void Count_(const AreaCard& card, const int32_t num)
+    {
+        size_ += num;
+        point_sum_ += card.PointSum() * num;
+        if (card.IsWild()) {
+            wild_num_ += num;
+            return;
+        }
+        for (uint32_t direct = 0; direct < k_direct_max; ++direct) {
+            const int32_t point = *card.Point(static_cast<Direct>(direct));
+            assert(0 <= point && point <= AreaCard::k_max_point);
+            point_nums_[direct][point] += num;
+        }
+    }
+
+    std::vector<std::pair<AreaCard, uint32_t>> kinds_;
+    uint32_t size_;
+    uint32_t wild_num_;
+    int64_t point_sum_;
+    std::array<std::array<uint32_t, AreaCard::k_max_point + 1>, k_direct_max> point_nums_;
+};
+
+// Chooses the area for a card by expectimax over the cards which may be dealt next.
+//
+// The search alternates between the placement layers (take the best area) and the chance layers (average over the
+// kinds of the next card weighted by their numbers in the pool). The boards at the search depth are evaluated by the
+// expected points of each unfinished line: the probability that the missing cards of the line are dealt in the remaining
+// rounds (a hypergeometric tail over the pool) times the points of the line. The lines of a direction waiting for the
+// same number share the matching cards, otherwise the lines are too optimistic to be given up. An empty area 0 is valued
+// as the average point sum of the pool, because any card can be dumped there later.
+//
+// In the games of 20 rounds (see the benchmark), the greedy search (depth 1) takes about 12us for a placement and scores
+// 146.55 points on average. The depth 2 search takes 3.8ms on average (18ms at most) and scores 150.5 points.
+class PlacementSolver
+{
+  public:
+    struct Placement
+    {
+        uint32_t idx_; // UINT32_MAX if all areas are filled
+        double expected_point_; // the points got by this placement and the expected points in the future
+    };
+
+    // |depth| is the number of the placement layers, so depth 1 is greedy on the evaluation.
+    explicit PlacementSolver(const uint32_t depth = 2) : depth_(depth) { assert(depth_ > 0); }
+
+    // |pool| holds the cards which may be dealt, which should not contain |card|. |draw_num| is the number of cards to be
+    // dealt after |card|.
+    Placement Solve(Board board, const AreaCard& card, const CardPool& pool, const uint32_t draw_num) const
+    {
+        assert(pool.Size() < k_max_pool_size);
+        return BestPlacement_(board, card, pool, draw_num, depth_);
+    }
+
+  private:
+    static constexpr uint32_t k_max_pool_size = 128;
+
+    struct LineState
+    {
+        std::optional<int32_t> point_; // the number of the filled cards, or null if they are all wild
+        uint32_t empty_num_ = 0;
+        bool is_broken_ = false;
+    };
+
+    Placement BestPlacement_(Board& board, const AreaCard& card, const CardPool& pool, const uint32_t draw_num,
+            const uint32_t depth) const
+    {
+        Placement best{UINT32_MAX, -std::numeric_limits<double>::infinity()};
+        for (uint32_t idx = 0; idx < Board::k_area_num; ++idx) {
+            if (board.IsFilled(idx)) {
+                continue;
+            }
+            const int32_t point = board.Fill(idx, card);
+            const double future_point = point + (depth == 1 || draw_num == 0 ? Evaluate_(board, pool, draw_num) :
+                        ExpectedPoint_(board, pool, draw_num, depth - 1));
+            board.Clear(idx);
+            if (future_point > best.expected_point_) {
+                best = Placement{idx, future_point};
+            }
+        }
+        return best;
+    }
+
+    // the expected points of the next cards when |draw_num| cards are to be dealt from |pool|
+    double ExpectedPoint_(Board& board, const CardPool& pool, const uint32_t draw_num, const uint32_t depth) const
+    {
+        if (pool.Size() == 0) {
+            return 0;
+        }
+        double expected_point = 0;
+        for (const auto& [next_card, num] : pool.Kinds()) {
+            if (num == 0) {
+                continue;
+            }
+            CardPool next_pool = pool;
+            next_pool.Remove(next_card);
+            const auto placement = BestPlacement_(board, next_card, next_pool, draw_num - 1, depth);
+            expected_point += placement.idx_ == UINT32_MAX ? 0 : placement.expected_point_ * num;
+        }
+        return expected_point / pool.Size();
+    }
+
+    static double Evaluate_(const Board& board, const CardPool& pool, const uint32_t draw_num)
+    {
+        if (draw_num == 0) {
+            return 0;
+        }
+        std::array<LineState, LineTable::k_line_num> states;
+        // the missing cards of the lines waiting for each number
+        std::array<std::array<uint32_t, AreaCard::k_max_point + 1>, k_direct_max> demands{};
+        for (uint32_t line_id = 0; line_id < LineTable::k_line_num; ++line_id) {
+            auto& state = states[line_id] = GetLineState_(board, line_id);
+            if (!state.is_broken_ && state.point_.has_value()) {
+                demands[static_cast<uint32_t>(k_line_table.GetLine(line_id).direct_)][*state.point_] += state.empty_num_;
+            }
+        }
+        double value = board.IsFilled(0) ? 0 : pool.AveragePointSum();
+        for (uint32_t line_id = 0; line_id < LineTable::k_line_num; ++line_id) {
+            const auto& state = states[line_id];
+            if (state.is_broken_ || state.empty_num_ == 0 || state.empty_num_ > draw_num) {
+                continue;
+            }
+            const auto& line = k_line_table.GetLine(line_id);
+            const auto& direct_demands = demands[static_cast<uint32_t>(line.direct_)];
+            const auto line_value = [&](const int32_t point)
+                {
+                    const uint32_t other_demand = direct_demands[point] - (state.point_.has_value() ? state.empty_num_ : 0);
+                    // the other lines are only partially counted because the player decides which line to complete
+                    const uint32_t match_num = pool.MatchNum(line.direct_, point) * state.empty_num_ * 3 /
+                        (state.empty_num_ * 3 + other_demand);
+                    return point * line.size_ * DrawProbability_(pool.Size(), match_num, draw_num, state.empty_num_);
+                };
+            if (state.point_.has_value()) {
+                value += line_value(*state.point_);
+                continue;
+            }
+            double max_value = 0;
+            for (int32_t point = 0; point <= AreaCard::k_max_point; ++point) {
+                if (pool.HasPoint(line.direct_, point)) {
+                    max_value = std::max(max_value, line_value(point));
+                }
+            }
+            value += max_value;
+        }
+        return value;
+    }
+
+    static LineState GetLineState_(const Board& board, const uint32_t line_id)
+    {
+        const auto& line = k_line_table.GetLine(line_id);
+        LineState state;
+        for (uint32_t i = 0; i < line.size_; ++i) {
+            const auto& card = board.Get(line.areas_[i]);
+            if (!card.has_value()) {
+                ++state.empty_num_;
+                continue;
+            }
+            const auto point = card->Point(line.direct_);
+            if (!point.has_value()) {
+                continue;
+            }
+            if (state.point_.has_value() && *state.point_ != *point) {
+                state.is_broken_ = true;
+                return state;
+            }
+            state.point_ = point;
+        }
+        return state;
+    }
+
+    // Return: the probability that at least |need_num| of |match_num| cards are dealt when |draw_num| cards are dealt
+    // from |pool_size| cards
+    static double DrawProbability_(const uint32_t pool_size, const uint32_t match_num, uint32_t draw_num,
+            const uint32_t need_num)
+    {
+        draw_num = std::min(draw_num, pool_size);
+        if (need_num > draw_num || need_num > match_num) {
+            return 0;
+        }
+        const auto& c = Binomials_();
+        double miss_probability = 0;
+        for (uint32_t x = 0; x < need_num; ++x) {
+            if (draw_num - x <= pool_size - match_num) {
+                miss_probability += c[match_num][x] * c[pool_size - match_num][draw_num - x];
+            }
+        }
+        return 1 - miss_probability / c[pool_size][draw_num];
+    }
+
+    using BinomialTable = std::array<std::array<double, k_max_pool_size>, k_max_pool_size>;
+
+    static const BinomialTable& Binomials_()
+    {
+        static const BinomialTable table = []
+            {
+                BinomialTable table{};
+                for (uint32_t n = 0; n < k_max_pool_size; ++n) {
+                    table[n][0] = 1;
+                    for (uint32_t k = 1; k <= n; ++k) {
+                        table[n][k] = table[n - 1][k - 1] + table[n - 1][k];
+                    }
+                }
+                return table;
+            }();
+        return table;
+    }
+
+    const uint32_t depth_;
+};
+
 class Wall
 {
   public:
@@ -122,19 +557,8 @@ class Wall
     std::array<bool, k_direct_max> has_line_;
 };
 
-class Area
-{
-  public:
-    friend class Comb;
-
-    Area(html::Box& box, const Coordinate coordinate) : box_(box), coordinate_(coordinate) {}
-
-  private:
-    html::Box& box_;
-    Coordinate coordinate_;
-    std::optional<AreaCard> card_;
-};
-
+// The view of a comb, which renders the |Board| as a html table. The walls out of the hexagon are lined when the lines
+// pointing to them are finished.
 class Comb
 {
   public:
@@ -149,8 +573,9 @@ class Comb
 
         static const Coordinate zero_coor{k_zero_col - k_mid_col, k_zero_row - k_mid_row};
         html::Box& zero_box = table_.Get(k_zero_row, k_zero_col);
-        areas_.emplace_back(zero_box, zero_coor);
+        area_boxes_[0] = &zero_box;
 
+        std::map<Coordinate, uint32_t> wall_indexes;
         for (int32_t col = 0; col < table_.Column(); ++col) {
             for (int32_t row = 0; row < table_.Row(); ++row) {
                 const Coordinate coor{col - k_mid_col, row - k_mid_row};
@@ -159,22 +584,35 @@ class Comb
                     table_.MergeDown(row, col, 2);
                 }
                 html::Box& box = table_.Get(row, col);
-                if (IsValid_(coor) && is_full_box) {
-                    box.SetContent(Image_("num_" + std::to_string(areas_.size())));
-                    areas_.emplace_back(box, coor);
+                if (LineTable::IsValid(coor) && is_full_box) {
+                    const uint32_t idx = LineTable::ToIndex(coor);
+                    box.SetContent(Image_("num_" + std::to_string(idx)));
+                    area_boxes_[idx] = &box;
                 } else if (is_full_box) {
-                    const auto [it, succ] = walls_.emplace(coor, Wall(box));
-                    assert(succ);
-                    box.SetContent(Image_(it->second.ImageName()));
+                    if (coor != zero_coor) {
+                        wall_indexes.emplace(coor, walls_.size());
+                        walls_.emplace_back(box);
+                        box.SetContent(Image_(walls_.back().ImageName()));
+                    }
                 } else if (box.IsVisable()) {
                     box.SetContent(Image_("wall_half"));
                 }
             }
         }
-
-        const auto num = walls_.erase(zero_coor);
-        assert(num == 1);
         zero_box.SetContent(Image_("num_0"));
+
+        for (uint32_t line_id = 0; line_id < LineTable::k_line_num; ++line_id) {
+            const auto& line = k_line_table.GetLine(line_id);
+            const Coordinate step = k_direct_steps[static_cast<uint32_t>(line.direct_)];
+            const auto add_walls = [&](Coordinate coor, const Coordinate& step)
+                {
+                    for (auto it = wall_indexes.find(coor); it != wall_indexes.end(); it = wall_indexes.find(coor += step)) {
+                        line_walls_[line_id].emplace_back(it->second);
+                    }
+                };
+            add_walls(line.head_, -step);
+            add_walls(line.tail_, step);
+        }
     }
 
     Comb(const Comb& comb) = delete;
@@ -182,143 +620,62 @@ class Comb
 
     int32_t Fill(const uint32_t idx, const AreaCard& card)
     {
-        auto& area = areas_[idx];
-        area.card_ = card;
-        const auto img_str = Image_(card.ImageName());
-        area.box_.SetContent(img_str);
-        if (idx == 0) {
-            return card.PointSum();
-        } else {
-            return Check_(area.coordinate_);
+        const int32_t point = board_.Fill(idx, card);
+        area_boxes_[idx]->SetContent(Image_(card.ImageName()));
+        if (idx != 0) {
+            LineWalls_<Direct::VERT>(idx);
+            LineWalls_<Direct::TOP_LEFT>(idx);
+            LineWalls_<Direct::TOP_RIGHT>(idx);
         }
+        return point;
     }
 
     std::pair<uint32_t, int32_t> SeqFill(const AreaCard& card)
     {
-        const auto img_str = Image_(card.ImageName());
-        if (!areas_[0].card_.has_value()) {
-            areas_[0].box_.SetContent(img_str);
-            areas_[0].card_ = card;
-            return {0, card.PointSum()};
-        }
-        for (uint32_t i = 1; i < areas_.size(); ++i) {
-            auto& area = areas_[i];
-            if (!area.card_.has_value()) {
-                area.box_.SetContent(img_str);
-                area.card_ = card;
-                return {i, Check_(area.coordinate_)};
+        for (uint32_t i = 0; i < Board::k_area_num; ++i) {
+            if (!board_.IsFilled(i)) {
+                return {i, Fill(i, card)};
             }
         }
         return {UINT32_MAX, 0}; // unexpected case
     }
 
-    void Clear(const uint32_t idx);
+    bool IsFilled(const uint32_t idx) const { return board_.IsFilled(idx); }
 
-    bool IsFilled(const uint32_t idx) const { return areas_[idx].card_.has_value(); }
+    const Board& board() const { return board_; }
 
-    std::string ToHtml() const { return table_.ToString(); } 
+    std::string ToHtml() const { return table_.ToString(); }
 
-    // -2 -1  0  1  2       value of coordinate.x
-    //              x
-    //           x
-    //        .     x
-    //     .     .          (. + x) is the initial count (left of coordinate.x)
-    //  .     .     .
-    //     .     .          x is to-remove count
-    //  .     .     .
-    //     .     .          . is the real count
-    //  .     .     .
-    //     .     .
-    //        .     x
-    //           x          then idx the real count + (coordinate.y offset value)
-    //              x
-    static uint32_t ToIndex(const Coordinate coordinate)
-    {
-        const int32_t level = coordinate.x_ + k_size - 1;
-        uint32_t idx = (k_size + k_size + level - 1) * level / 2;
-        if (coordinate.x_ > 1) { // x == 2
-            idx -= (coordinate.x_ - 1) * coordinate.x_; // idx -= 2
-        }
-        idx += (coordinate.y_ + k_size * 2 - std::abs(coordinate.x_)) / 2;
-        return idx;
-    }
+    static uint32_t ToIndex(const Coordinate coordinate) { return LineTable::ToIndex(coordinate); }
 
   private:
-    static constexpr uint32_t k_size = 3;
+    static constexpr uint32_t k_size = LineTable::k_size;
     static constexpr uint32_t k_max_row = k_size * 4 + 2;
     static constexpr uint32_t k_max_column = k_size * 2 + 1;
 
     std::string Image_(std::string name) { return "![](file://" + image_path_ + std::move(name) + ".png)"; }
 
     template <Direct direct>
-    int32_t CheckOneDirect_(const Coordinate coordinate)
+    void LineWalls_(const uint32_t idx)
     {
-        assert(Get_(coordinate).card_.has_value());
-        auto point = Get_(coordinate).card_->Point<direct>();
-        uint32_t count = 1;
-        const auto check = [&](Coordinate& coor, const Coordinate& step)
-            {
-                for (; IsValid_(coor); coor += step) {
-                    ++count;
-                    const auto& area = Get_(coor);
-                    if (!area.card_.has_value()) { // happens when the area is empty
-                        return false;
-                    }
-                    if (!point.has_value()) { // happens when previous card are wild
-                        point = area.card_->Point<direct>();
-                        continue;
-                    }
-                    if (!area.card_->IsMatch<direct>(*point)) {
-                        return false;
-                    }
-                }
-                return true;
-            };
-
-        const auto wall_line = [&](Coordinate& coor, const Coordinate& step)
-            {
-                for (auto it = walls_.find(coor); it != walls_.end(); it = walls_.find(coor += step)) {
-                    Wall& wall = it->second;
-                    wall.SetLine<direct>();
-                    wall.box_.SetContent(Image_(wall.ImageName()));
-                }
-            };
-
-        auto head_coor = coordinate + k_direct_step<direct>;
-        auto tail_coor = coordinate + -k_direct_step<direct>;
-        if (!check(head_coor, k_direct_step<direct>) || !check(tail_coor, -k_direct_step<direct>)) {
-            return 0;
+        const uint32_t line_id = k_line_table.AreaLine(idx, direct);
+        if (board_.LinePoint(line_id) == 0) {
+            return;
         }
-
-        wall_line(head_coor, k_direct_step<direct>);
-        wall_line(tail_coor, -k_direct_step<direct>);
-
         // TODO: set around success line
-        if (point.has_value()) {
-            return *point * count;
-        } else {
-            return 10000; // TODO: is an impossible case, we should limit number of wild card less than k_size
+        for (const uint32_t wall_idx : line_walls_[line_id]) {
+            Wall& wall = walls_[wall_idx];
+            wall.SetLine<direct>();
+            wall.box_.SetContent(Image_(wall.ImageName()));
         }
     }
 
-    int32_t Check_(const Coordinate coordinate)
-    {
-        return CheckOneDirect_<Direct::VERT>(coordinate) +
-               CheckOneDirect_<Direct::TOP_LEFT>(coordinate) +
-               CheckOneDirect_<Direct::TOP_RIGHT>(coordinate);
-    }
-
-    Area& Get_(const Coordinate coordinate) { return areas_[ToIndex(coordinate)]; }
-
-    bool IsValid_(const Coordinate coordinate)
-    {
-        return std::abs(coordinate.x_) + std::abs(coordinate.y_) < k_size * 2 && std::abs(coordinate.x_) < k_size;
-    }
-
     const std::string image_path_;
-    std::vector<Area> areas_;
-    std::map<Coordinate, Wall> walls_;
+    Board board_;
     html::Table table_;
+    std::array<html::Box*, Board::k_area_num> area_boxes_;
+    std::vector<Wall> walls_;
+    std::array<std::vector<uint32_t>, LineTable::k_line_num> line_walls_;
 };
 
 
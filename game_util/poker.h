@@ -46,7 +46,7 @@ ENUM_END(PatternType)
 #define POKER_H_
 
 #include <array>
-#include <deque>
+#include <bit>
 #include <mutex>
 #include <optional>
 #include <string>
@@ -302,15 +302,289 @@ Sender& operator<<(Sender& sender, const Deck& deck)
     return sender;
 }
 
+// The pokers of each suit are stored as a bitmask, in which the bit |number| is set if the poker is owned.
+using SuitMasks = std::array<uint16_t, PokerSuit::Count()>;
+
+// The packed rank of a deck. Each poker is encoded in 6 bits as |number * 4 + suit|, which keeps the order of |Poker|,
+// and the type is put above the five pokers, so comparing two ranks is the same as comparing the two decks.
+using DeckRank = uint64_t;
+
+// A deck consists of five different pokers, so zero is never the rank of a deck.
+static constexpr DeckRank k_no_deck_rank = 0;
+
+class DeckEvaluator
+{
+  public:
+    static const DeckEvaluator& Get()
+    {
+        static const DeckEvaluator evaluator;
+        return evaluator;
+    }
+
+    static void AddPoker(SuitMasks& masks, const Poker& poker)
+    {
+        masks[static_cast<uint32_t>(poker.suit_)] |= 1 << static_cast<uint32_t>(poker.number_);
+    }
+
+    static PatternType Type(const DeckRank rank) { return PatternType(static_cast<uint32_t>(rank >> k_type_shift)); }
+
+    // Return: the best deck, or |k_no_deck_rank| if there are less than five pokers
+    DeckRank Evaluate(const SuitMasks& masks) const
+    {
+        DeckRank best_rank = k_no_deck_rank;
+
+        for (uint32_t suit = 0; suit < PokerSuit::Count(); ++suit) {
+            if (const int8_t top = straight_tops_[masks[suit]]; top >= 0) {
+                best_rank = std::max(best_rank, StraightRank_(PatternType::STRAIGHT_FLUSH, top,
+                            [suit](const uint32_t) { return suit; }));
+            }
+        }
+        if (best_rank != k_no_deck_rank) {
+            return best_rank;
+        }
+
+        best_rank = PairRank_(masks);
+        if (best_rank != k_no_deck_rank && Type(best_rank) >= PatternType::FULL_HOUSE) {
+            return best_rank;
+        }
+
+        for (uint32_t suit = 0; suit < PokerSuit::Count(); ++suit) {
+            if (uint16_t top_five = top_fives_[masks[suit]]; top_five != 0) {
+                DeckRank rank = PatternType(PatternType::FLUSH).ToUInt();
+                for (; top_five != 0; top_five &= ~(1 << HighestBit_(top_five))) {
+                    rank = PushPoker_(rank, HighestBit_(top_five), suit);
+                }
+                best_rank = std::max(best_rank, rank);
+            }
+        }
+        if (best_rank != k_no_deck_rank && Type(best_rank) >= PatternType::FLUSH) {
+            return best_rank;
+        }
+
+        if (const int8_t top = straight_tops_[masks[0] | masks[1] | masks[2] | masks[3]]; top >= 0) {
+            best_rank = std::max(best_rank, StraightRank_(PatternType::STRAIGHT, top,
+                        [&masks](const uint32_t number) { return HighestSuit_(masks, number); }));
+        }
+
+        return best_rank;
+    }
+
+    // Evaluate a batch of hands, which is used by the Monte-Carlo simulation.
+    void Evaluate(const SuitMasks* const hands, const size_t hand_num, DeckRank* const ranks) const
+    {
+        for (size_t i = 0; i < hand_num; ++i) {
+            ranks[i] = Evaluate(hands[i]);
+        }
+    }
+
+    static std::optional<Deck> ToDeck(const DeckRank rank)
+    {
+        if (rank == k_no_deck_rank) {
+            return std::nullopt;
+        }
+        std::array<Poker, 5> pokers;
+        for (uint32_t i = 0; i < pokers.size(); ++i) {
+            const uint32_t code = (rank >> (k_poker_bits * (pokers.size() - 1 - i))) & k_poker_mask;
+            pokers[i] = Poker(PokerNumber(code / PokerSuit::Count()), PokerSuit(code % PokerSuit::Count()));
+        }
+        return Deck(Type(rank), pokers);
+    }
+
+    // Estimate the equity of each hand by dealing the remaining public pokers randomly for |sample_num| times. The
+    // pokers in |hands| and |public_pokers| are not dealt. The winners of a sample share it equally, and nobody wins
+    // the sample if no hand has a deck.
+    std::vector<double> EstimateEquity(const std::vector<std::vector<Poker>>& hands,
+            const std::vector<Poker>& public_pokers, const uint32_t public_poker_num, const uint32_t sample_num,
+            std::mt19937& engine) const
+    {
+        SuitMasks used_masks{0};
+        SuitMasks public_masks{0};
+        for (const auto& poker : public_pokers) {
+            AddPoker(public_masks, poker);
+            AddPoker(used_masks, poker);
+        }
+        std::vector<SuitMasks> hand_masks(hands.size(), SuitMasks{0});
+        for (size_t i = 0; i < hands.size(); ++i) {
+            for (const auto& poker : hands[i]) {
+                AddPoker(hand_masks[i], poker);
+                AddPoker(used_masks, poker);
+            }
+        }
+        std::vector<Poker> remaining_pokers;
+        for (const auto& number : PokerNumber::Members()) {
+            for (const auto& suit : PokerSuit::Members()) {
+                if (!(used_masks[static_cast<uint32_t>(suit)] >> static_cast<uint32_t>(number) & 1)) {
+                    remaining_pokers.emplace_back(number, suit);
+                }
+            }
+        }
+        const size_t deal_num = std::min<size_t>(public_poker_num - std::min<size_t>(public_poker_num, public_pokers.size()),
+                remaining_pokers.size());
+
+        std::vector<double> equities(hands.size(), 0);
+        std::vector<SuitMasks> sample_masks(hands.size());
+        std::vector<DeckRank> ranks(hands.size());
+        for (uint32_t sample = 0; sample < sample_num; ++sample) {
+            SuitMasks dealt_masks = public_masks;
+            for (size_t i = 0; i < deal_num; ++i) {
+                std::swap(remaining_pokers[i],
+                        remaining_pokers[std::uniform_int_distribution<size_t>(i, remaining_pokers.size() - 1)(engine)]);
+                AddPoker(dealt_masks, remaining_pokers[i]);
+            }
+            for (size_t i = 0; i < hands.size(); ++i) {
+                for (uint32_t suit = 0; suit < PokerSuit::Count(); ++suit) {
+                    sample_masks[i][suit] = hand_masks[i][suit] | dealt_masks[suit];
+                }
+            }
+            Evaluate(sample_masks.data(), sample_masks.size(), ranks.data());
+            const DeckRank best_rank = *std::max_element(ranks.begin(), ranks.end());
+            if (best_rank == k_no_deck_rank) {
+                continue;
+            }
+            const auto winner_num = std::count(ranks.begin(), ranks.end(), best_rank);
+            for (size_t i = 0; i < hands.size(); ++i) {
+                if (ranks[i] == best_rank) {
+                    equities[i] += 1.0 / winner_num;
+                }
+            }
+        }
+        for (auto& equity : equities) {
+            equity /= sample_num;
+        }
+        return equities;
+    }
+
+  private:
+    static constexpr uint32_t k_poker_bits = 6;
+    static constexpr DeckRank k_poker_mask = (1 << k_poker_bits) - 1;
+    static constexpr uint32_t k_type_shift = k_poker_bits * 5;
+    static constexpr uint32_t k_mask_num = 1 << PokerNumber::Count();
+
+    DeckEvaluator()
+    {
+        for (uint32_t mask = 0; mask < k_mask_num; ++mask) {
+            // a straight is searched from the greatest number, and X can also be the smallest one (i.e. 4321X)
+            straight_tops_[mask] = -1;
+            uint32_t continuous_num = 0;
+            for (int32_t number = PokerNumber::Count() - 1; number >= 0; --number) {
+                if (!(mask >> number & 1)) {
+                    continuous_num = 0;
+                } else if (++continuous_num == 5) {
+                    straight_tops_[mask] = number + 4;
+                    break;
+                }
+            }
+            if (continuous_num == 4 && (mask >> (PokerNumber::Count() - 1) & 1)) {
+                straight_tops_[mask] = 3;
+            }
+
+            uint16_t top_five = 0;
+            for (int32_t number = PokerNumber::Count() - 1; number >= 0 && std::popcount(top_five) < 5; --number) {
+                top_five |= mask & (1 << number);
+            }
+            top_fives_[mask] = std::popcount(top_five) == 5 ? top_five : 0;
+        }
+    }
+
+    static uint32_t HighestBit_(const uint16_t mask) { return std::bit_width(mask) - 1; }
+
+    static uint32_t HighestSuit_(const SuitMasks& masks, const uint32_t number)
+    {
+        uint32_t suit = PokerSuit::Count() - 1;
+        while (!(masks[suit] >> number & 1)) {
+            --suit;
+        }
+        return suit;
+    }
+
+    static DeckRank PushPoker_(const DeckRank rank, const uint32_t number, const uint32_t suit)
+    {
+        return (rank << k_poker_bits) | (number * PokerSuit::Count() + suit);
+    }
+
+    static DeckRank StraightRank_(const PatternType type, const uint32_t top, const auto& get_suit)
+    {
+        DeckRank rank = type.ToUInt();
+        for (uint32_t i = 0; i < 5; ++i) {
+            const uint32_t number = (top + PokerNumber::Count() - i) % PokerNumber::Count();
+            rank = PushPoker_(rank, number, get_suit(number));
+        }
+        return rank;
+    }
+
+    // If pokers are AA22233334, the |at_least_masks| will be:
+    // [0]: A 4 3 2 (at least has one)
+    // [1]: A 3 2 (at least has two)
+    // [2]: 3 2 (at least has three)
+    // [3]: 3 (at least has four)
+    // Then we fill the deck with the greatest number which has the most pokers, so the deck becomes 3333A.
+    static DeckRank PairRank_(const SuitMasks& m)
+    {
+        const std::array<uint16_t, PokerSuit::Count()> at_least_masks{
+            static_cast<uint16_t>(m[0] | m[1] | m[2] | m[3]),
+            static_cast<uint16_t>((m[0] & m[1]) | (m[0] & m[2]) | (m[0] & m[3]) | (m[1] & m[2]) | (m[1] & m[3]) | (m[2] & m[3])),
+            static_cast<uint16_t>((m[0] & m[1] & m[2]) | (m[0] & m[1] & m[3]) | (m[0] & m[2] & m[3]) | (m[1] & m[2] & m[3])),
+            static_cast<uint16_t>(m[0] & m[1] & m[2] & m[3]),
+        };
+        DeckRank rank = PairPatternType_(at_least_masks).ToUInt();
+        uint16_t used_numbers = 0;
+        uint32_t poker_num = 0;
+        while (poker_num < 5) {
+            // fill big pair poker first
+            int32_t i = std::min<int32_t>(PokerSuit::Count(), 5 - poker_num) - 1;
+            while (i >= 0 && (at_least_masks[i] & ~used_numbers) == 0) {
+                --i;
+            }
+            if (i < 0) {
+                return k_no_deck_rank;
+            }
+            // fill big number poker first
+            const uint32_t number = HighestBit_(at_least_masks[i] & ~used_numbers);
+            used_numbers |= 1 << number;
+            for (int32_t suit = PokerSuit::Count() - 1; suit >= 0 && poker_num < 5; --suit) {
+                if (m[suit] >> number & 1) {
+                    rank = PushPoker_(rank, number, suit);
+                    ++poker_num;
+                }
+            }
+        }
+        return rank;
+    }
+
+    static PatternType PairPatternType_(const std::array<uint16_t, PokerSuit::Count()>& at_least_masks)
+    {
+        const uint16_t three_masks = at_least_masks[3 - 1] & ~at_least_masks[4 - 1];
+        const uint16_t two_masks = at_least_masks[2 - 1] & ~at_least_masks[3 - 1];
+        if (at_least_masks[4 - 1] != 0) {
+            return PatternType::FOUR_OF_A_KIND;
+        } else if (std::popcount(three_masks) >= 2 || (three_masks != 0 && two_masks != 0)) {
+            return PatternType::FULL_HOUSE;
+        } else if (three_masks != 0) {
+            return PatternType::THREE_OF_A_KIND;
+        } else if (std::popcount(two_masks) >= 2) {
+            return PatternType::TWO_PAIRS;
+        } else if (two_masks != 0) {
+            return PatternType::ONE_PAIR;
+        } else {
+            return PatternType::HIGH_CARD;
+        }
+    }
+
+    std::array<int8_t, k_mask_num> straight_tops_; // the greatest number of the best straight, or -1 if no straight
+    std::array<uint16_t, k_mask_num> top_fives_; // the greatest five numbers, or 0 if there are less than five
+};
+
 class Hand
 {
    public:
-    Hand() : pokers_{{false}}, need_refresh_(false) {}
+    Hand() : masks_{0}, need_refresh_(false) {}
 
     bool Add(const PokerNumber& number, const PokerSuit& suit)
     {
-        const auto old_value = std::exchange(pokers_[static_cast<uint32_t>(number)][static_cast<uint32_t>(suit)], true);
-        if (old_value == false) {
+        auto& mask = masks_[static_cast<uint32_t>(suit)];
+        const uint16_t bit = 1 << static_cast<uint32_t>(number);
+        if ((mask & bit) == 0) {
+            mask |= bit;
             need_refresh_ = true;
             return true;
         }
@@ -321,8 +595,10 @@ class Hand
 
     bool Remove(const PokerNumber& number, const PokerSuit& suit)
     {
-        const auto old_value = std::exchange(pokers_[static_cast<uint32_t>(number)][static_cast<uint32_t>(suit)], false);
-        if (old_value == true) {
+        auto& mask = masks_[static_cast<uint32_t>(suit)];
+        const uint16_t bit = 1 << static_cast<uint32_t>(number);
+        if ((mask & bit) != 0) {
+            mask &= ~bit;
             need_refresh_ = true;
             return true;
         }
@@ -333,18 +609,18 @@ class Hand
 
     bool Has(const PokerNumber& number, const PokerSuit& suit) const
     {
-        return pokers_[static_cast<uint32_t>(number)][static_cast<uint32_t>(suit)];
+        return masks_[static_cast<uint32_t>(suit)] >> static_cast<uint32_t>(number) & 1;
     }
 
     bool Has(const Poker& poker) const { return Has(poker.number_, poker.suit_); }
 
     bool Empty() const
     {
-        return std::all_of(pokers_.begin(), pokers_.end(),
-                [](const auto& array) { return std::all_of(array.begin(), array.end(),
-                    [](const bool has) { return !has; }); });
+        return std::all_of(masks_.begin(), masks_.end(), [](const uint16_t mask) { return mask == 0; });
     }
 
+    const SuitMasks& Masks() const { return masks_; }
+
     template <typename Sender>
     friend Sender& operator<<(Sender& sender, const Hand& hand)
     {
@@ -377,183 +653,15 @@ class Hand
 
     const std::optional<Deck>& BestDeck() const
     {
-        if (!need_refresh_) {
-            return best_deck_;
-        }
-        need_refresh_ = false;
-        best_deck_ = std::nullopt;
-        const auto update_deck = [this](const std::optional<Deck>& deck) {
-            if (!deck.has_value()) {
-                return;
-            } else if (!best_deck_.has_value() || *best_deck_ < *deck) {
-                best_deck_.emplace(*deck);
-            }
-        };
-
-        for (auto suit_it = PokerSuit::Members().rbegin(); suit_it != PokerSuit::Members().rend(); ++suit_it) {
-            update_deck(BestFlushPattern_<true>(*suit_it));
+        if (need_refresh_) {
+            need_refresh_ = false;
+            best_deck_ = DeckEvaluator::ToDeck(DeckEvaluator::Get().Evaluate(masks_));
         }
-        if (best_deck_.has_value()) {
-            return best_deck_;
-        }
-
-        update_deck(BestPairPattern_());
-        if (best_deck_.has_value() && best_deck_->type_ >= PatternType::FULL_HOUSE) {
-            return best_deck_;
-        }
-
-        for (auto suit_it = PokerSuit::Members().rbegin(); suit_it != PokerSuit::Members().rend(); ++suit_it) {
-            update_deck(BestFlushPattern_<false>(*suit_it));
-        }
-        if (best_deck_.has_value() && best_deck_->type_ >= PatternType::FLUSH) {
-            return best_deck_;
-        }
-
-        update_deck(BestNonFlushNonPairPattern_());
-
         return best_deck_;
     }
 
    private:
-    std::optional<Deck> BestNonFlushNonPairPattern_() const {
-        const auto get_poker = [&pokers = pokers_](const PokerNumber number) -> std::optional<Poker> {
-            for (auto suit_it = PokerSuit::Members().rbegin(); suit_it != PokerSuit::Members().rend(); ++suit_it) {
-                if (pokers[static_cast<uint32_t>(number)][static_cast<uint32_t>(*suit_it)]) {
-                    return Poker(number, *suit_it);
-                }
-            }
-            return std::nullopt;
-        };
-        const auto deck = CollectNonPairDeck_<true>(get_poker);
-        if (deck.has_value()) {
-            return Deck(PatternType::STRAIGHT, *deck);
-        } else {
-            return std::nullopt;
-        }
-    }
-
-    template <bool FIND_STRAIGHT>
-    std::optional<Deck> BestFlushPattern_(const PokerSuit suit) const
-    {
-        const auto get_poker = [&suit, &pokers = pokers_](const PokerNumber number) -> std::optional<Poker> {
-            if (pokers[static_cast<uint32_t>(number)][static_cast<uint32_t>(suit)]) {
-                return Poker(number, suit);
-            } else {
-                return std::nullopt;
-            }
-        };
-        const auto deck = CollectNonPairDeck_<FIND_STRAIGHT>(get_poker);
-        if (deck.has_value()) {
-            return Deck(PatternType::Condition(FIND_STRAIGHT, PatternType::STRAIGHT_FLUSH, PatternType::FLUSH), *deck);
-        } else {
-            return std::nullopt;
-        }
-    }
-
-    template <bool FIND_STRAIGHT>
-    static std::optional<std::array<Poker, 5>> CollectNonPairDeck_(const auto& get_poker)
-    {
-        std::vector<Poker> pokers;
-        for (auto it = PokerNumber::Members().rbegin(); it != PokerNumber::Members().rend(); ++it) {
-            const auto poker = get_poker(*it);
-            if (poker.has_value()) {
-                pokers.emplace_back(*poker);
-                if (pokers.size() == 5) {
-                    return std::array<Poker, 5>{pokers[0], pokers[1], pokers[2], pokers[3], pokers[4]};
-                }
-            } else if (FIND_STRAIGHT) {
-                pokers.clear();
-            }
-        }
-        if (const auto poker = get_poker(PokerNumber::_0); FIND_STRAIGHT && pokers.size() == 4 && poker.has_value()) {
-            return std::array<Poker, 5>{pokers[0], pokers[1], pokers[2], pokers[3], *poker};
-        } else {
-            return std::nullopt;
-        }
-    }
-
-    std::optional<Deck> BestPairPattern_() const
-    {
-        // If poker_ is AA22233334, the same_number_poker_counts will be:
-        // [0]: A 4 3 2 (at least has one)
-        // [1]: A 3 2 (at least has two)
-        // [2]: 3 2 (at least has three)
-        // [3]: 3 (at least has four)
-        // Then we go through from the back of poker_number to fill the deck.
-        // When at [3], the deck become 3333?
-        // When at [2], the deck become 3333A, which is the result deck.
-        std::array<std::deque<PokerNumber>, PokerSuit::Count()> same_number_poker_counts_accurate;
-        std::array<std::deque<PokerNumber>, PokerSuit::Count()> same_number_poker_counts;
-        for (const auto number : PokerNumber::Members()) {
-            const uint64_t count = std::count(pokers_[static_cast<uint32_t>(number)].begin(),
-                                              pokers_[static_cast<uint32_t>(number)].end(), true);
-            if (count > 0) {
-                same_number_poker_counts_accurate[count - 1].emplace_back(number);
-                for (uint64_t i = 0; i < count; ++i) {
-                    same_number_poker_counts[i].emplace_back(number);
-                }
-            }
-        }
-        std::set<PokerNumber> already_used_numbers;
-        std::vector<Poker> pokers;
-
-        const auto fill_pair_to_deck = [&](const PokerNumber& number)
-        {
-            for (auto suit_it = PokerSuit::Members().rbegin();  suit_it != PokerSuit::Members().rend(); ++suit_it) {
-                if (pokers_[static_cast<uint32_t>(number)][static_cast<uint32_t>(*suit_it)]) {
-                    pokers.emplace_back(number, *suit_it);
-                    if (pokers.size() == 5) {
-                        return;
-                    }
-                }
-            }
-        };
-
-        const auto fill_best_pair_to_deck = [&]()
-        {
-            // fill big pair poker first
-            for (int64_t i = std::min(PokerSuit::Count(), 5 - pokers.size()) - 1; i >= 0; --i) {
-                const auto& owned_numbers = same_number_poker_counts[i];
-                // fill big number poker first
-                for (auto number_it = owned_numbers.rbegin(); number_it != owned_numbers.rend(); ++number_it) {
-                    if (already_used_numbers.emplace(*number_it).second) {
-                        fill_pair_to_deck(*number_it);
-                        return true;
-                    }
-                }
-            }
-            return false;
-        };
-
-        while (fill_best_pair_to_deck() && pokers.size() < 5)
-            ;
-        if (pokers.size() < 5) {
-            return std::nullopt;
-        }
-        return Deck(PairPatternType_(same_number_poker_counts_accurate),
-                    std::array<Poker, 5>{pokers[0], pokers[1], pokers[2], pokers[3], pokers[4]});
-    }
-
-    static PatternType PairPatternType_(
-            const std::array<std::deque<PokerNumber>, PokerSuit::Count()>& same_number_poker_counts)
-    {
-        if (!same_number_poker_counts[4 - 1].empty()) {
-            return PatternType::FOUR_OF_A_KIND;
-        } else if (same_number_poker_counts[3 - 1].size() >= 2 ||
-                   (!same_number_poker_counts[3 - 1].empty() && !same_number_poker_counts[2 - 1].empty())) {
-            return PatternType::FULL_HOUSE;
-        } else if (!same_number_poker_counts[3 - 1].empty()) {
-            return PatternType::THREE_OF_A_KIND;
-        } else if (same_number_poker_counts[2 - 1].size() >= 2) {
-            return PatternType::TWO_PAIRS;
-        } else if (!same_number_poker_counts[2 - 1].empty()) {
-            return PatternType::ONE_PAIR;
-        } else {
-            return PatternType::HIGH_CARD;
-        }
-    }
-
-    std::array<std::array<bool, PokerSuit::Count()>, PokerNumber::Count()> pokers_;
+    SuitMasks masks_;
     mutable std::optional<Deck> best_deck_;
     mutable bool need_refresh_;
 };
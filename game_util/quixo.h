@@ -7,8 +7,13 @@
 #include <array>
 #include <ranges>
 #include <algorithm>
+#include <cassert>
+#include <optional>
+#include <string>
 
-#include "../utility/html.h"
+#include "utility/checkpoint.h"
+#include "utility/html.h"
+#include "game_util/tile_image.h"
 
 namespace quixo {
 
@@ -63,6 +68,7 @@ class Board
         }
     }
 
+    // The html is sent instead of the image when the markdown is not converted to images.
     std::string ToHtml() const
     {
         html::Table table(7, 7);
@@ -97,6 +103,43 @@ class Board
         return table.ToString();
     }
 
+    // The board is composited from the tiles natively, which is much faster than rendering a html table of images.
+    tile_image::Image ToImage() const
+    {
+        tile_image::TileGrid grid(tile_image::TileAtlas::Get(image_path_), 7, 7);
+        grid.SetPadding(1);
+        grid.SetSpacing(1);
+        grid.SetBackground(tile_image::Color{0xff, 0xff, 0xff}); // the page of the html renderer is white
+        const auto set_image = [&](const uint32_t row, const uint32_t col, const std::string& name)
+            {
+                grid.SetTile(row, col, name);
+            };
+        for (uint32_t i = 0; i < 5; ++i) {
+            set_image(0, 1 + i, "num_" + std::to_string(0 + i));
+            set_image(1 + i, 6, "num_" + std::to_string(4 + i));
+            set_image(6, 5 - i, "num_" + std::to_string(8 + i));
+            set_image(5 - i, 0, "num_" + std::to_string((12 + i) % 16));
+        }
+        const auto set_box_image = [&](const uint32_t x, const uint32_t y, const char* const prefix)
+            {
+                set_image(x + 1, y + 1, std::string(prefix) + static_cast<char>(areas_[x][y]));
+            };
+        for (uint32_t x = 0; x < 5; ++x) {
+            for (uint32_t y = 0; y < 5; ++y) {
+                set_box_image(x, y, "box_");
+            }
+        }
+        if (last_move_coor_.has_value()) {
+            set_box_image(last_move_coor_->x_, last_move_coor_->y_, "light_");
+        }
+        ForAllSuccLine_([&](const auto& coors, const Symbol s)
+                {
+                    std::ranges::for_each(coors, [&](const Coor& coor) { set_box_image(coor.x_, coor.y_, "light_"); });
+                });
+
+        return grid.Render();
+    }
+
     ErrCode Push(const uint32_t src, const uint32_t dst, const Type type)
     {
         assert(src < k_edge_num && dst < k_edge_num);
@@ -161,6 +204,37 @@ class Board
                 });
     }
 
+    void Checkpoint(CheckpointWriter& writer) const
+    {
+        std::optional<std::pair<uint32_t, uint32_t>> last_move;
+        if (last_move_coor_.has_value()) {
+            last_move.emplace(last_move_coor_->x_, last_move_coor_->y_);
+        }
+        writer.Write(areas_, last_move, chess_counts_);
+    }
+
+    bool Restore(CheckpointReader& reader)
+    {
+        std::optional<std::pair<uint32_t, uint32_t>> last_move;
+        if (!reader.Read(areas_, last_move, chess_counts_) ||
+                (last_move.has_value() && (last_move->first >= 5 || last_move->second >= 5))) {
+            return false;
+        }
+        if (last_move.has_value()) {
+            last_move_coor_ = Coor{last_move->first, last_move->second};
+        } else {
+            last_move_coor_.reset();
+        }
+        return std::ranges::all_of(areas_, [](const auto& arr)
+                {
+                    return std::ranges::all_of(arr, [](const Type type)
+                            {
+                                return type == Type::_ || type == Type::O1 || type == Type::O2 || type == Type::X1 ||
+                                    type == Type::X2;
+                            });
+                });
+    }
+
   private:
     template <typename Fn>
     void ForAllSuccLine_(const Fn& fn) const
@@ -7,29 +7,247 @@
 #include <array>
 #include <ranges>
 #include <algorithm>
+#include <bit>
 #include <bitset>
-#include <set>
-#include <memory>
 #include <vector>
 
 #include "utility/html.h"
+#include "game_util/tile_image.h"
 
 namespace renju {
 
 enum class AreaType { EMPTY, FORBID, WHITE, BLACK };
 enum class Result { CONTINUE_OK, CONTINUE_CRASH, CONTINUE_EXTEND, TIE_FULL_BOARD, TIE_DOUBLE_WIN, WIN_BLACK, WIN_WHITE };
 
-class Piece
+// The cells of a 15 * 15 board arranged as lines. Each row, column, diagonal (row - col is constant) and anti-diagonal
+// (row + col is constant) is a mask, in which the bit |col| stands for the cell on column |col| (the bit |row| for the
+// columns), so that the neighbours on a line are the neighbouring bits.
+class LineMasks
 {
   public:
-    Piece(const AreaType type) : type_(type), tmp_disappered_(false) {}
+    using Mask = uint16_t;
 
-    AreaType type_; // should only be BLACK or WHITE
-    std::set<std::pair<uint32_t, uint32_t>> liberties_;
-    std::set<std::pair<uint32_t, uint32_t>> areas_;
-    bool tmp_disappered_;
+    static constexpr const uint32_t k_size_ = 15;
+    static constexpr const uint32_t k_direction_num_ = 4;
+    static constexpr const uint32_t k_line_num_ = k_size_ * 2 - 1;
+
+    enum Direction : uint32_t { ROW, COLUMN, DIAGONAL, ANTI_DIAGONAL };
+
+    struct Pos
+    {
+        uint32_t line_;
+        uint32_t bit_;
+    };
+
+    LineMasks() : lines_{} {}
+
+    static Pos ToLine(const uint32_t direction, const uint32_t row, const uint32_t col)
+    {
+        switch (direction) {
+        case ROW: return {row, col};
+        case COLUMN: return {col, row};
+        case DIAGONAL: return {row + k_size_ - 1 - col, col};
+        default: return {row + col, col};
+        }
+    }
+
+    static std::pair<uint32_t, uint32_t> FromLine(const uint32_t direction, const uint32_t line, const uint32_t bit)
+    {
+        switch (direction) {
+        case ROW: return {line, bit};
+        case COLUMN: return {bit, line};
+        case DIAGONAL: return {line + bit + 1 - k_size_, bit};
+        default: return {line - bit, bit};
+        }
+    }
+
+    void Set(const uint32_t row, const uint32_t col)
+    {
+        for (uint32_t direction = 0; direction < k_direction_num_; ++direction) {
+            const auto [line, bit] = ToLine(direction, row, col);
+            lines_[direction][line] |= 1 << bit;
+        }
+    }
+
+    bool Test(const uint32_t row, const uint32_t col) const { return (lines_[ROW][row] >> col) & 1; }
+
+    Mask Line(const uint32_t direction, const uint32_t line) const { return lines_[direction][line]; }
+
+    Mask& Line(const uint32_t direction, const uint32_t line) { return lines_[direction][line]; }
+
+    // the cells of the line whose row and column are both in [min_pos, max_pos]
+    static Mask Range(const uint32_t direction, const uint32_t line, const uint32_t min_pos, const uint32_t max_pos)
+    {
+        const auto range = [](const int32_t begin, const int32_t end) -> Mask
+            {
+                return begin > end ? 0 : ((1 << (end + 1)) - 1) & ~((1 << begin) - 1);
+            };
+        const int32_t min = min_pos, max = max_pos, offset = line;
+        switch (direction) {
+        case ROW:
+        case COLUMN: return min <= offset && offset <= max ? range(min, max) : 0;
+        case DIAGONAL: return range(std::max(min, min + int32_t(k_size_) - 1 - offset), std::min(max, max + int32_t(k_size_) - 1 - offset));
+        default: return range(std::max(min, offset - max), std::min(max, offset - min));
+        }
+    }
+
+    static uint32_t LineNum(const uint32_t direction) { return direction == ROW || direction == COLUMN ? k_size_ : k_line_num_; }
+
+  private:
+    std::array<std::array<Mask, k_line_num_>, k_direction_num_> lines_;
+};
+
+// The threats of one side. |fours_| is the number of the empty points completing a five, and |open_threes_| is the
+// number of the empty points making an open four (an empty point on each side). A point is counted once for each
+// direction it works in.
+struct PatternCount
+{
+    uint32_t fours_ = 0;
+    uint32_t open_threes_ = 0;
 };
 
+// The bitboard engine of |Board|. Lines are detected by shifting and ANDing the line masks, and the pattern counts are
+// updated incrementally, by recounting only the four lines passing the new piece.
+class BitBoard
+{
+  public:
+    using Mask = LineMasks::Mask;
+
+    // only the cells in [min_pos, max_pos] of both rows and columns are available
+    void SetArea(const uint32_t min_pos, const uint32_t max_pos)
+    {
+        // the lines out of the area hold neither pieces nor empty points, so their counts stay zero
+        for (uint32_t direction = 0; direction < LineMasks::k_direction_num_; ++direction) {
+            for (uint32_t line = 0; line < LineMasks::LineNum(direction); ++line) {
+                if ((area_.Line(direction, line) = LineMasks::Range(direction, line, min_pos, max_pos)) != 0) {
+                    RecountLine_(direction, line);
+                }
+            }
+        }
+    }
+
+    // should be empty
+    void Set(const uint32_t row, const uint32_t col, const AreaType type)
+    {
+        (type == AreaType::FORBID ? forbid_ : pieces_[Index_(type)]).Set(row, col);
+        for (uint32_t direction = 0; direction < LineMasks::k_direction_num_; ++direction) {
+            RecountLine_(direction, LineMasks::ToLine(direction, row, col).line_);
+        }
+    }
+
+    // The pieces of the fives in |direction| passing (row, col). Returns 0 if there is no five.
+    Mask Fives(const uint32_t row, const uint32_t col, const AreaType type, const uint32_t direction) const
+    {
+        const auto [line, bit] = LineMasks::ToLine(direction, row, col);
+        const Mask own = pieces_[Index_(type)].Line(direction, line);
+        const Mask five_begins = own & (own >> 1) & (own >> 2) & (own >> 3) & (own >> 4);
+        const Mask fives = five_begins | (five_begins << 1) | (five_begins << 2) | (five_begins << 3) | (five_begins << 4);
+        return ((fives >> bit) & 1) ? fives : 0;
+    }
+
+    // whether setting a |type| piece at the empty (row, col) completes a five
+    bool MakesFive(const uint32_t row, const uint32_t col, const AreaType type) const
+    {
+        const uint32_t index = Index_(type);
+        for (uint32_t direction = 0; direction < LineMasks::k_direction_num_; ++direction) {
+            const auto [line, bit] = LineMasks::ToLine(direction, row, col);
+            if ((FivePoints_(pieces_[index].Line(direction, line), Empty_(direction, line)) >> bit) & 1) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the empty points completing a five for |type|, as row masks
+    std::array<Mask, LineMasks::k_size_> FivePoints(const AreaType type) const
+    {
+        const uint32_t index = Index_(type);
+        std::array<Mask, LineMasks::k_size_> rows{};
+        for (uint32_t direction = 0; direction < LineMasks::k_direction_num_; ++direction) {
+            for (uint32_t line = 0; line < LineMasks::LineNum(direction); ++line) {
+                for (Mask points = FivePoints_(pieces_[index].Line(direction, line), Empty_(direction, line));
+                        points != 0; points &= points - 1) {
+                    const auto [row, col] = LineMasks::FromLine(direction, line, std::countr_zero(points));
+                    rows[row] |= 1 << col;
+                }
+            }
+        }
+        return rows;
+    }
+
+    bool Has(const uint32_t row, const uint32_t col, const AreaType type) const
+    {
+        return type == AreaType::FORBID ? forbid_.Test(row, col) : pieces_[Index_(type)].Test(row, col);
+    }
+
+    Mask Line(const AreaType type, const uint32_t direction, const uint32_t line) const
+    {
+        return (type == AreaType::FORBID ? forbid_ : pieces_[Index_(type)]).Line(direction, line);
+    }
+
+    const PatternCount& Patterns(const AreaType type) const { return patterns_[Index_(type)]; }
+
+  private:
+    static uint32_t Index_(const AreaType type) { return type == AreaType::BLACK ? 0 : 1; }
+
+    Mask Empty_(const uint32_t direction, const uint32_t line) const
+    {
+        return area_.Line(direction, line) &
+            ~(pieces_[0].Line(direction, line) | pieces_[1].Line(direction, line) | forbid_.Line(direction, line));
+    }
+
+    // For each offset of the empty point in a window of five, the beginnings of the windows are found by ANDing the
+    // shifted masks, which share the prefix and suffix conjunctions.
+    static Mask FivePoints_(const Mask own, const Mask empty)
+    {
+        const Mask own_1 = own >> 1, own_2 = own >> 2, own_3 = own >> 3, own_4 = own >> 4;
+        const Mask prefix_01 = own & own_1, prefix_012 = prefix_01 & own_2, prefix_0123 = prefix_012 & own_3;
+        const Mask suffix_34 = own_3 & own_4, suffix_234 = own_2 & suffix_34, suffix_1234 = own_1 & suffix_234;
+        return (empty & suffix_1234) | ((own & (empty >> 1) & suffix_234) << 1) |
+            ((prefix_01 & (empty >> 2) & suffix_34) << 2) | ((prefix_012 & (empty >> 3) & own_4) << 3) |
+            ((prefix_0123 & (empty >> 4)) << 4);
+    }
+
+    // The same as |FivePoints_| but with a window of six whose both ends should be empty.
+    static Mask OpenFourPoints_(const Mask own, const Mask empty)
+    {
+        const Mask own_1 = own >> 1, own_2 = own >> 2, own_3 = own >> 3, own_4 = own >> 4;
+        const Mask ends = empty & (empty >> 5);
+        const Mask prefix_12 = ends & own_1 & own_2, prefix_123 = prefix_12 & own_3;
+        const Mask suffix_34 = ends & own_3 & own_4, suffix_234 = suffix_34 & own_2;
+        return ((suffix_234 & (empty >> 1)) << 1) | ((own_1 & (empty >> 2) & suffix_34) << 2) |
+            ((prefix_12 & (empty >> 3) & own_4) << 3) | ((prefix_123 & (empty >> 4)) << 4);
+    }
+
+    // The counts of the line are cached so that the totals are updated without counting the old masks again.
+    void RecountLine_(const uint32_t direction, const uint32_t line)
+    {
+        const Mask empty = Empty_(direction, line);
+        auto& line_patterns = line_patterns_[direction][line];
+        for (uint32_t index = 0; index < 2; ++index) {
+            const Mask own = pieces_[index].Line(direction, line);
+            const uint8_t fours = std::popcount(FivePoints_(own, empty));
+            const uint8_t open_threes = std::popcount(OpenFourPoints_(own, empty));
+            patterns_[index].fours_ += fours - line_patterns.fours_[index];
+            patterns_[index].open_threes_ += open_threes - line_patterns.open_threes_[index];
+            line_patterns.fours_[index] = fours;
+            line_patterns.open_threes_[index] = open_threes;
+        }
+    }
+
+    std::array<LineMasks, 2> pieces_; // black and white
+    LineMasks forbid_;
+    LineMasks area_;
+    std::array<PatternCount, 2> patterns_{};
+    struct LinePatterns
+    {
+        std::array<uint8_t, 2> fours_;
+        std::array<uint8_t, 2> open_threes_;
+    };
+    std::array<std::array<LinePatterns, LineMasks::k_line_num_>, LineMasks::k_direction_num_> line_patterns_{};
+};
+
+// The board of go, on which a group is a row mask array found by flooding the masks of the pieces.
 class GoBoard
 {
   public:
@@ -43,8 +261,8 @@ class GoBoard
                 if (!IsValid_(round_row, round_col)) {
                     return false;
                 }
-                const auto& round_piece = pieces_[round_row][round_col];
-                return !round_piece || (round_piece->type_ == type && round_piece->liberties_.size() > 1);
+                return IsEmpty_(round_row, round_col) ||
+                    (Is_(round_row, round_col, type) && LibertyNum_(Group_(round_row, round_col, type)) > 1);
             };
         if (check(row - 1, col) || check(row + 1, col) || check(row, col - 1) || check(row, col + 1)) {
             return true;
@@ -52,70 +270,72 @@ class GoBoard
         return false;
     }
 
-    void MakePiece_(const uint32_t row, const uint32_t col, const AreaType type)
+    // should be valid
+    void Set(const uint32_t row, const uint32_t column, const AreaType type)
     {
-        const auto& piece = pieces_[row][col] = std::make_shared<Piece>(type);
-        piece->areas_.emplace(row, col);
-        const auto check_round = [&](const uint32_t round_row, const uint32_t round_col)
-            {
-                if (!IsValid_(round_row, round_col)) {
-                    return;
-                }
-                auto& round_piece = pieces_[round_row][round_col];
-                if (round_piece == nullptr) {
-                    piece->liberties_.emplace(round_row, round_col);
-                } else if (round_piece->type_ == type) {
-                    MergePieces_(piece, round_piece);
-                }
-            };
-        check_round(row - 1, col);
-        check_round(row + 1, col);
-        check_round(row, col - 1);
-        check_round(row, col + 1);
+        pieces_[Index_(type)][row] |= 1 << column;
     }
 
-    // hold a reference to ${from}
-    void MergePieces_(const std::shared_ptr<Piece> from, const std::shared_ptr<Piece>& to)
+  private:
+    using Rows = std::array<uint16_t, k_size_>;
+
+    static constexpr const uint16_t k_full_mask_ = (1 << k_size_) - 1;
+
+    static uint32_t Index_(const AreaType type) { return type == AreaType::BLACK ? 0 : 1; }
+
+    static Rows Dilate_(const Rows& rows)
     {
-        if (from == to) {
-            return;
+        Rows result;
+        for (uint32_t row = 0; row < k_size_; ++row) {
+            result[row] = (rows[row] | (rows[row] << 1) | (rows[row] >> 1) | (row > 0 ? rows[row - 1] : 0) |
+                    (row + 1 < k_size_ ? rows[row + 1] : 0)) & k_full_mask_;
         }
-        to->liberties_.insert(from->liberties_.begin(), from->liberties_.end());
-        to->areas_.insert(from->areas_.begin(), from->areas_.end());
-        for (const auto& [row, col] : from->areas_) {
-            pieces_[row][col] = to;
-        }
-    };
+        return result;
+    }
 
-    // should be valid
-    std::vector<std::shared_ptr<Piece>> Set(const uint32_t row, const uint32_t column, const AreaType type)
+    Rows Group_(const uint32_t row, const uint32_t col, const AreaType type) const
     {
-        MakePiece_(row, column, type);
-        return {};
+        const auto& own = pieces_[Index_(type)];
+        Rows group{};
+        group[row] = 1 << col;
+        for (bool grown = true; grown; ) {
+            const Rows dilated = Dilate_(group);
+            grown = false;
+            for (uint32_t i = 0; i < k_size_; ++i) {
+                const uint16_t next = dilated[i] & own[i];
+                grown |= next != group[i];
+                group[i] = next;
+            }
+        }
+        return group;
     }
 
-  private:
-    bool Is_(const uint32_t row, const uint32_t col, const AreaType type) const
+    uint32_t LibertyNum_(const Rows& group) const
     {
-        return IsValid_(row, col) && pieces_[row][col] && pieces_[row][col]->type_ == type;
+        const Rows dilated = Dilate_(group);
+        uint32_t num = 0;
+        for (uint32_t row = 0; row < k_size_; ++row) {
+            num += std::popcount(static_cast<uint16_t>(dilated[row] & ~pieces_[0][row] & ~pieces_[1][row]));
+        }
+        return num;
     }
 
-    bool IsNot_(const uint32_t row, const uint32_t col, const AreaType type) const
+    bool Is_(const uint32_t row, const uint32_t col, const AreaType type) const
     {
-        return !IsValid_(row, col) || (pieces_[row][col] && pieces_[row][col]->type_ != type);
+        return (pieces_[Index_(type)][row] >> col) & 1;
     }
 
     bool IsEmpty_(const uint32_t row, const uint32_t col) const
     {
-        return IsValid_(row, col) && !pieces_[row][col];
+        return !(((pieces_[0][row] | pieces_[1][row]) >> col) & 1);
     }
 
     static bool IsValid_(const uint32_t row, const uint32_t col)
     {
-        return row <= k_size_ && col <= k_size_;
+        return row < k_size_ && col < k_size_;
     }
 
-    std::array<std::array<std::shared_ptr<Piece>, k_size_>, k_size_> pieces_;
+    std::array<Rows, 2> pieces_{}; // black and white
 };
 
 class Board
@@ -133,6 +353,7 @@ class Board
                 area = AreaType::EMPTY;
             }
         }
+        bitboard_.SetArea(MinPos_(), MaxPos_());
     }
 
     bool CanBeSet(const uint32_t row, const uint32_t col) const { return Is_(row, col, AreaType::EMPTY); }
@@ -143,16 +364,12 @@ class Board
         if (black_row == white_row && black_column == white_column) {
             areas_[black_row][black_column] = AreaType::FORBID;
             highlight_flag_[black_row][black_column] = true;
+            bitboard_.Set(black_row, black_column, AreaType::FORBID);
             return (empty_count_ -= 1) == 0 ? Result::TIE_FULL_BOARD : Result::CONTINUE_CRASH;
         }
-        const auto set_chess = [this](const uint32_t row, const uint32_t col, const AreaType type)
-            {
-                areas_[row][col] = type;
-                highlight_flag_[row][col] = true;
-                return HasRenju_(row, col);
-            };
-        const bool black_renju = set_chess(black_row, black_column, AreaType::BLACK);
-        const bool white_renju = set_chess(white_row, white_column, AreaType::WHITE);
+        // the pieces of different colors never share a line mask, so the settlement order does not matter
+        const bool black_renju = SetChess_(black_row, black_column, AreaType::BLACK);
+        const bool white_renju = SetChess_(white_row, white_column, AreaType::WHITE);
         return (empty_count_ -= 2) == 0   ? Result::TIE_FULL_BOARD  :
                black_renju && white_renju ? Result::TIE_DOUBLE_WIN  :
                black_renju                ? Result::WIN_BLACK       :
@@ -183,6 +400,7 @@ class Board
         return s;
     }
 
+    // The html is sent instead of the image when the markdown is not converted to images.
     std::string ToHtml() const
     {
         html::Table table(expend_level_ * 2 + 3, expend_level_ * 2 + 3);
@@ -228,17 +446,97 @@ class Board
                 table.Get(i + 1, j + 1).SetContent(Image_(std::move(image_name)));
             }
         }
-        return "<style>html,body{color:#6b421d; background:#d8bf81;}</style>\n" + table.ToString();
+        return table.ToString();
+    }
+
+    // should satisfy CanBeSet
+    tile_image::Image SetAndToImage(const uint32_t m, const uint32_t n, const AreaType type)
+    {
+        areas_[m][n] = type;
+        highlight_flag_[m][n] = true;
+        tile_image::Image image = ToImage();
+        areas_[m][n] = AreaType::EMPTY;
+        highlight_flag_[m][n] = false;
+        return image;
+    }
+
+    // The indexes are drawn by the built-in font, and the indexes of the highlighted rows and columns are red.
+    tile_image::Image ToImage() const
+    {
+        static constexpr const tile_image::Color k_text_color{0x6b, 0x42, 0x1d};
+        static constexpr const tile_image::Color k_highlight_color{0xff, 0x00, 0x00};
+        tile_image::TileGrid grid(tile_image::TileAtlas::Get(image_path_), expend_level_ * 2 + 3, expend_level_ * 2 + 3);
+        grid.SetBackground(tile_image::Color{0xd8, 0xbf, 0x81});
+        grid.SetPadding(2);
+        const auto idx2c = [this](const uint32_t idx) { return idx == MinPos_() ? '0' : idx == MaxPos_() ? '2' : '1'; };
+        const uint32_t last = expend_level_ * 2 + 2;
+        for (uint32_t i = 0; i < expend_level_ * 2 + 1; ++i) {
+            const bool highlight_row = highlight_flag_[MinPos_() + i].any();
+            const bool highlight_column =
+                std::ranges::any_of(highlight_flag_, [&](const auto& bitset) { return bitset.test(MinPos_() + i); });
+            const std::string column_index = std::to_string(MinPos_() + i);
+            const std::string row_index(1, static_cast<char>('A' + MinPos_() + i));
+            const auto column_color = highlight_column ? k_highlight_color : k_text_color;
+            const auto row_color = highlight_row ? k_highlight_color : k_text_color;
+            grid.SetText(0, i + 1, column_index, column_color);
+            grid.SetText(last, i + 1, column_index, column_color);
+            grid.SetText(i + 1, 0, row_index, row_color);
+            grid.SetText(i + 1, last, row_index, row_color);
+            for (uint32_t j = 0; j < expend_level_ * 2 + 1; ++j) {
+                std::string image_name;
+                switch (areas_[MinPos_() + i][MinPos_() + j]) {
+                case AreaType::WHITE:
+                    image_name = "c_w";
+                    break;
+                case AreaType::BLACK:
+                    image_name = "c_b";
+                    break;
+                case AreaType::FORBID:
+                    image_name = "c_c";
+                    break;
+                case AreaType::EMPTY:
+                    image_name = "b_";
+                    image_name += idx2c(MinPos_() + i);
+                    image_name += idx2c(MinPos_() + j);
+                    break;
+                }
+                if (highlight_flag_[MinPos_() + i][MinPos_() + j]) {
+                    image_name += "_l";
+                }
+                grid.SetTile(i + 1, j + 1, image_name);
+            }
+        }
+        return grid.Render();
     }
 
     void ClearHighlight() { std::ranges::for_each(highlight_flag_, [](auto& flags) { flags.reset(); }); }
 
+    // The threats of |type|, which are cheap to read because they are updated incrementally.
+    const PatternCount& Patterns(const AreaType type) const { return bitboard_.Patterns(type); }
+
+    // should satisfy CanBeSet
+    bool MakesFive(const uint32_t row, const uint32_t col, const AreaType type) const
+    {
+        return bitboard_.MakesFive(row, col, type);
+    }
+
+    void FivePoints(const AreaType type, std::vector<std::pair<uint32_t, uint32_t>>& points) const
+    {
+        const auto rows = bitboard_.FivePoints(type);
+        for (uint32_t row = 0; row < k_size_; ++row) {
+            for (auto mask = rows[row]; mask != 0; mask &= mask - 1) {
+                points.emplace_back(row, std::countr_zero(mask));
+            }
+        }
+    }
+
   private:
     bool SetChess_(const uint32_t row, const uint32_t col, const AreaType type)
     {
         areas_[row][col] = type;
         highlight_flag_[row][col] = true;
-        return HasRenju_(row, col);
+        bitboard_.Set(row, col, type);
+        return HasRenju_(row, col, type);
     }
 
     bool Is_(const uint32_t row, const uint32_t col, const AreaType type) const
@@ -246,33 +544,18 @@ class Board
         return MinPos_() <= row && row <= MaxPos_() && MinPos_() <= col && col <= MaxPos_() && areas_[row][col] == type;
     }
 
-    bool HasRenju_(const uint32_t row, const uint32_t col)
+    bool HasRenju_(const uint32_t row, const uint32_t col, const AreaType type)
     {
-        return HasRenju_(row, col, -1, 1) + HasRenju_(row, col, 1, 1) + HasRenju_(row, col, 0, 1) + HasRenju_(row, col, 1, 0) > 0;
-    }
-
-    bool HasRenju_(const uint32_t row, const uint32_t col, const int32_t direct_x, const int32_t direct_y)
-    {
-        using pair = std::pair<uint32_t, uint32_t>;
-        const auto type = areas_[row][col];
-        std::vector<pair> renjus = { pair{row, col} };
-        const auto extend_range = [&](const int32_t d)
-            {
-                for (uint32_t line_x = row + direct_x * d, line_y = col + direct_y * d;
-                        Is_(line_x, line_y, type);
-                        line_x += direct_x * d, line_y += direct_y * d) {
-                    renjus.emplace_back(line_x, line_y);
-                }
-            };
-        extend_range(1);
-        extend_range(-1);
-        if (renjus.size() >= 5) {
-            for (const auto& [m, n] : renjus) {
-                highlight_flag_[m].set(n);
+        bool has_renju = false;
+        for (uint32_t direction = 0; direction < LineMasks::k_direction_num_; ++direction) {
+            const auto line = LineMasks::ToLine(direction, row, col).line_;
+            for (auto fives = bitboard_.Fives(row, col, type, direction); fives != 0; fives &= fives - 1) {
+                const auto [five_row, five_col] = LineMasks::FromLine(direction, line, std::countr_zero(fives));
+                highlight_flag_[five_row].set(five_col);
+                has_renju = true;
             }
-            return true;
         }
-        return false;
+        return has_renju;
     }
 
     bool TryExpand_()
@@ -280,6 +563,7 @@ class Board
         if (expend_level_ < k_size_ / 2 && EdgeHas_(AreaType::BLACK) && EdgeHas_(AreaType::WHITE)) {
             ++expend_level_;
             empty_count_ += expend_level_ * 2 * 4;
+            bitboard_.SetArea(MinPos_(), MaxPos_());
             return true;
         }
         return false;
@@ -291,11 +575,10 @@ class Board
 
     bool EdgeHas_(const AreaType type) const
     {
-        return std::ranges::any_of(std::views::iota(MinPos_(), MaxPos_() + 1), [this, type](const uint32_t pos)
-                {
-                    return areas_[MinPos_()][pos] == type || areas_[pos][MinPos_()] == type ||
-                           areas_[MaxPos_()][pos] == type || areas_[pos][MaxPos_()] == type;
-                });
+        const LineMasks::Mask area_mask = LineMasks::Range(LineMasks::ROW, MinPos_(), MinPos_(), MaxPos_());
+        return ((bitboard_.Line(type, LineMasks::ROW, MinPos_()) | bitboard_.Line(type, LineMasks::ROW, MaxPos_()) |
+                 bitboard_.Line(type, LineMasks::COLUMN, MinPos_()) | bitboard_.Line(type, LineMasks::COLUMN, MaxPos_())) &
+                area_mask) != 0;
     }
 
     std::string Image_(std::string name) const { return "![](file://" + image_path_ + "/" + std::move(name) + ".bmp)"; }
@@ -305,6 +588,67 @@ class Board
     std::array<std::bitset<k_size_>, k_size_> highlight_flag_;
     uint32_t expend_level_; // [ k_size_ / 2 - expend_level_, k_size_ / 2 + expend_level_] is available
     uint32_t empty_count_;
+    BitBoard bitboard_;
+};
+
+// The adapter of |Board| for mcts::Searcher. The players set pieces in turn rather than at the same time, which ignores
+// the crashes, but is good enough to find the threats. Player 0 uses the black pieces.
+class MctsState
+{
+  public:
+    using Move = std::pair<uint32_t, uint32_t>;
+
+    MctsState(const Board& board, const uint32_t current_player)
+        : board_(board), current_player_(current_player), result_(Result::CONTINUE_OK)
+    {
+    }
+
+    uint32_t PlayerNum() const { return 2; }
+
+    uint32_t CurrentPlayer() const { return current_player_; }
+
+    // The moves are pruned by the threats: a player completes the own five, or otherwise blocks the five of the opponent.
+    void LegalMoves(std::vector<Move>& moves) const
+    {
+        const AreaType own = current_player_ == 0 ? AreaType::BLACK : AreaType::WHITE;
+        const AreaType opponent = current_player_ == 0 ? AreaType::WHITE : AreaType::BLACK;
+        if (board_.Patterns(own).fours_ > 0) {
+            return board_.FivePoints(own, moves);
+        }
+        if (board_.Patterns(opponent).fours_ > 0) {
+            return board_.FivePoints(opponent, moves);
+        }
+        for (uint32_t row = 0; row < Board::k_size_; ++row) {
+            for (uint32_t col = 0; col < Board::k_size_; ++col) {
+                if (board_.CanBeSet(row, col)) {
+                    moves.emplace_back(row, col);
+                }
+            }
+        }
+    }
+
+    void Apply(const Move& move)
+    {
+        result_ = board_.Set(move.first, move.second, current_player_ == 0 ? AreaType::BLACK : AreaType::WHITE);
+        current_player_ = 1 - current_player_;
+    }
+
+    bool IsTerminal() const
+    {
+        return result_ == Result::TIE_FULL_BOARD || result_ == Result::WIN_BLACK || result_ == Result::WIN_WHITE;
+    }
+
+    double Reward(const uint32_t player) const
+    {
+        return result_ == Result::WIN_BLACK ? player == 0 :
+               result_ == Result::WIN_WHITE ? player == 1 :
+                                              0.5;
+    }
+
+  private:
+    Board board_;
+    uint32_t current_player_;
+    Result result_;
 };
 
 }
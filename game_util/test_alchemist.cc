@@ -5,6 +5,7 @@
 #define private public
 #include "game_util/alchemist.h"
 #undef private
+#include "game_util/mcts.h"
 
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
@@ -189,3 +190,41 @@ TEST_F(TestAlchemist, slash_should_not_clear)
     ASSERT_EQ(0, board.SetOrClearLine(2, 4, Card{Color::RED, Point::FIVE}));
     ASSERT_TRUE(board.Unset(2, 2));
 }
+
+TEST_F(TestAlchemist, mcts_clear_line)
+{
+    Board board("");
+    board.SetStone(2, 2);
+    board.areas_[2][0] = Card{Color::RED, Point::FIVE};
+    board.areas_[2][1] = Card{Color::RED, Point::FIVE};
+    board.areas_[2][3] = Card{Color::RED, Point::FIVE};
+    MctsState state(board, Card{Color::RED, Point::ONE}, {}, 1, true);
+    mcts::Searcher<MctsState> searcher(
+            mcts::Options{.time_budget_ = std::chrono::milliseconds(0), .max_playout_num_ = 1000, .seed_ = 1});
+    const auto move = searcher.Search(state).best_move_;
+    ASSERT_TRUE(move.has_value());
+    ASSERT_EQ((std::pair<uint32_t, uint32_t>{2, 4}), *move);
+    state.Apply(*move);
+    ASSERT_TRUE(state.IsTerminal());
+    ASSERT_EQ((10 + 5 + 5 + 5 + 1) * 2, state.Score());
+}
+
+TEST_F(TestAlchemist, mcts_look_ahead_next_rounds)
+{
+    Board board("");
+    board.SetStone(1, 2);
+    board.SetStone(2, 2);
+    board.areas_[2][0] = Card{Color::RED, Point::FIVE};
+    board.areas_[2][1] = Card{Color::RED, Point::FIVE};
+    board.areas_[2][4] = Card{Color::RED, Point::FIVE};
+    // setting the blue card at B4 prevents the red card of the next round from clearing the line at C4
+    MctsState state(board, Card{Color::BLUE, Point::TWO}, {Card{Color::RED, Point::FIVE}}, 2, false);
+    mcts::Searcher<MctsState> searcher(
+            mcts::Options{.time_budget_ = std::chrono::milliseconds(0), .max_playout_num_ = 5000, .seed_ = 1});
+    const auto move = searcher.Search(state).best_move_;
+    ASSERT_TRUE(move.has_value());
+    ASSERT_NE((std::pair<uint32_t, uint32_t>{1, 3}), *move);
+    state.Apply(*move);
+    state.Apply(std::pair<uint32_t, uint32_t>{2, 3});
+    ASSERT_EQ(2, state.Score());
+}
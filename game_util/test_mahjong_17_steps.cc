@@ -4,6 +4,8 @@
 
 #include "game_util/mahjong_17_steps.h"
 
+#include <chrono>
+#include <iostream>
 #include <ranges>
 
 #include <gtest/gtest.h>
@@ -1072,6 +1074,123 @@ void ShowImage()
 
 }
 
+TEST(TestAgariTable, same_as_is和牌)
+{
+    std::mt19937 engine(0);
+    uint64_t agari_num = 0;
+    for (uint32_t i = 0; i < 100000; ++i) {
+        // make a winning hand with melds and a pair and then replace some tiles, so that both results are covered
+        TileCounts counts{0};
+        std::vector<BaseTile> basetiles;
+        const auto add = [&](const uint32_t tile, const uint32_t num)
+            {
+                for (uint32_t j = 0; j < num; ++j) {
+                    ++counts[tile];
+                    basetiles.emplace_back(static_cast<BaseTile>(tile));
+                }
+            };
+        while (basetiles.size() < 14) {
+            const uint32_t tile = engine() % counts.size();
+            if (i % 4 == 0) {
+                add(tile, 1); // random tiles, which may be 七对子 or 国士无双 rarely
+            } else if (basetiles.size() == 12) {
+                add(tile, 2);
+            } else if (engine() % 2 == 0 || tile >= 9 * 3 || tile % 9 > 6) {
+                add(tile, 3);
+            } else {
+                add(tile, 1);
+                add(tile + 1, 1);
+                add(tile + 2, 1);
+            }
+        }
+        if (i % 4 == 3) {
+            const uint32_t j = engine() % basetiles.size();
+            --counts[basetiles[j]];
+            basetiles[j] = static_cast<BaseTile>(engine() % counts.size());
+            ++counts[basetiles[j]];
+        }
+        if (std::ranges::any_of(counts, [](const uint8_t count) { return count > 4; })) {
+            continue;
+        }
+        const bool is_agari = is和牌(basetiles);
+        ASSERT_EQ(is_agari, AgariTable::Get().IsAgari(counts)) << i;
+        agari_num += is_agari;
+    }
+    ASSERT_GT(agari_num, 0);
+}
+
+TEST_F(TestMahjong17Steps, get_listen_info_from_yaku_cache)
+{
+    table_.players_[0].hand_ = {
+        Tile{BaseTile::_1s, 0},
+        Tile{BaseTile::_2s, 0},
+        Tile{BaseTile::_3s, 0},
+        Tile{BaseTile::_2m, 0},
+        Tile{BaseTile::_3m, 0},
+        Tile{BaseTile::_4m, 0},
+        Tile{BaseTile::_3m, 0},
+        Tile{BaseTile::_4m, 0},
+        Tile{BaseTile::_5m, 0},
+        Tile{BaseTile::_7p, 0},
+        Tile{BaseTile::_7p, 0},
+        Tile{BaseTile::_9p, 0},
+        Tile{BaseTile::_9p, 0},
+    };
+    const auto info = table_.GetListenInfo_(0);
+    const uint64_t hit_num = YakuCache::Get().HitNum();
+    const uint64_t miss_num = YakuCache::Get().MissNum();
+    const auto cached_info = table_.GetListenInfo_(0);
+    ASSERT_EQ(hit_num + info.size(), YakuCache::Get().HitNum());
+    ASSERT_EQ(miss_num, YakuCache::Get().MissNum());
+    ASSERT_EQ(info.size(), cached_info.size());
+    for (const auto& [basetile, counter] : info) {
+        ASSERT_EQ(counter.score1, cached_info.at(basetile).score1);
+        ASSERT_EQ(counter.yakus, cached_info.at(basetile).yakus);
+    }
+
+    table_.doras_.emplace_back(Tile{BaseTile::_6p, 0}, Tile{BaseTile::_8p, 0}); // the doras are part of the key
+    table_.GetListenInfo_(0);
+    ASSERT_EQ(miss_num + info.size(), YakuCache::Get().MissNum());
+}
+
+// Benchmark
+
+TEST_F(TestMahjong17Steps, benchmark_get_listen_info)
+{
+    std::mt19937 engine(0);
+    std::vector<std::decay_t<decltype(table_.players_[0].hand_)>> hands;
+    std::vector<Tile> tiles;
+    for (uint32_t i = 0; i < 9 * 3 + 7; ++i) {
+        for (uint32_t j = 0; j < 4; ++j) {
+            tiles.emplace_back(Tile{static_cast<BaseTile>(i), 0});
+        }
+    }
+    for (uint32_t i = 0; i < 100; ++i) {
+        std::shuffle(tiles.begin(), tiles.end(), engine);
+        hands.emplace_back(tiles.begin(), tiles.begin() + 13);
+    }
+    hands.push_back({ // nine gates, which waits for all tiles of the suit
+            Tile{BaseTile::_1m, 0}, Tile{BaseTile::_1m, 0}, Tile{BaseTile::_1m, 0}, Tile{BaseTile::_2m, 0},
+            Tile{BaseTile::_3m, 0}, Tile{BaseTile::_4m, 0}, Tile{BaseTile::_5m, 0}, Tile{BaseTile::_6m, 0},
+            Tile{BaseTile::_7m, 0}, Tile{BaseTile::_8m, 0}, Tile{BaseTile::_9m, 0}, Tile{BaseTile::_9m, 0},
+            Tile{BaseTile::_9m, 0}});
+    for (const uint32_t repeat : {1, 100}) {
+        const auto begin = std::chrono::steady_clock::now();
+        uint64_t listen_num = 0;
+        for (uint32_t i = 0; i < repeat; ++i) {
+            for (const auto& hand : hands) {
+                table_.players_[0].hand_ = hand;
+                listen_num += table_.GetListenInfo_(0).size();
+            }
+        }
+        const auto cost = std::chrono::steady_clock::now() - begin;
+        std::cout << "[BENCHMARK] repeat=" << repeat << " listen_num=" << listen_num << " hands_per_sec="
+                  << repeat * hands.size() * 1000000000.0 / std::chrono::duration_cast<std::chrono::nanoseconds>(cost).count()
+                  << " yaku_cache_hit=" << YakuCache::Get().HitNum() << " yaku_cache_miss=" << YakuCache::Get().MissNum()
+                  << std::endl;
+    }
+}
+
 int main(int argc, char** argv)
 {
     testing::InitGoogleTest(&argc, argv);
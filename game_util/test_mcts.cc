@@ -0,0 +1,153 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include "game_util/mcts.h"
+#include "game_util/renju.h"
+
+#include <iostream>
+
+#include <gtest/gtest.h>
+#include <gflags/gflags.h>
+
+// The players take 1 to 3 stones in turn, and the player taking the last stone wins.
+class NimState
+{
+  public:
+    using Move = uint32_t;
+
+    NimState(const uint32_t stone_num) : stone_num_(stone_num), current_player_(0) {}
+
+    uint32_t PlayerNum() const { return 2; }
+    uint32_t CurrentPlayer() const { return current_player_; }
+
+    void LegalMoves(std::vector<Move>& moves) const
+    {
+        for (uint32_t num = 1; num <= std::min(3U, stone_num_); ++num) {
+            moves.emplace_back(num);
+        }
+    }
+
+    void Apply(const Move& move)
+    {
+        stone_num_ -= move;
+        current_player_ = 1 - current_player_;
+    }
+
+    bool IsTerminal() const { return stone_num_ == 0; }
+
+    // the player who has just moved takes the last stone
+    double Reward(const uint32_t player) const { return IsTerminal() ? player != current_player_ : 0.5; }
+
+  private:
+    uint32_t stone_num_;
+    uint32_t current_player_;
+};
+
+static_assert(mcts::GameState<NimState>);
+static_assert(!mcts::RandomizableGameState<NimState>);
+static_assert(mcts::GameState<renju::MctsState>);
+
+class TestMcts : public testing::Test
+{
+  protected:
+    static mcts::Options PlayoutLimitedOptions(const uint32_t thread_num, const mcts::Parallelism parallelism)
+    {
+        return mcts::Options{
+            .thread_num_ = thread_num,
+            .parallelism_ = parallelism,
+            .time_budget_ = std::chrono::milliseconds(0),
+            .max_playout_num_ = 20000,
+            .seed_ = 1,
+        };
+    }
+};
+
+TEST_F(TestMcts, find_winning_move)
+{
+    mcts::Searcher<NimState> searcher(PlayoutLimitedOptions(1, mcts::Parallelism::ROOT));
+    const auto result = searcher.Search(NimState(10));
+    ASSERT_EQ(2, result.best_move_); // leave a multiple of 4
+    ASSERT_GT(result.best_move_reward_, 0.5);
+    ASSERT_EQ(20000, result.playout_num_);
+}
+
+TEST_F(TestMcts, find_winning_move_with_root_parallelism)
+{
+    mcts::Searcher<NimState> searcher(PlayoutLimitedOptions(4, mcts::Parallelism::ROOT));
+    const auto result = searcher.Search(NimState(10));
+    ASSERT_EQ(2, result.best_move_);
+    ASSERT_GE(result.playout_num_, 20000);
+}
+
+TEST_F(TestMcts, find_winning_move_with_tree_parallelism)
+{
+    mcts::Searcher<NimState> searcher(PlayoutLimitedOptions(4, mcts::Parallelism::TREE));
+    const auto result = searcher.Search(NimState(10));
+    ASSERT_EQ(2, result.best_move_);
+    ASSERT_GE(result.playout_num_, 20000);
+}
+
+TEST_F(TestMcts, no_move_for_terminal_state)
+{
+    mcts::Searcher<NimState> searcher(PlayoutLimitedOptions(1, mcts::Parallelism::ROOT));
+    const auto result = searcher.Search(NimState(0));
+    ASSERT_FALSE(result.best_move_.has_value());
+    ASSERT_EQ(0, result.playout_num_);
+}
+
+TEST_F(TestMcts, stop_when_time_budget_exhausted)
+{
+    mcts::Searcher<NimState> searcher(mcts::Options{.thread_num_ = 2, .time_budget_ = std::chrono::milliseconds(50)});
+    const auto result = searcher.Search(NimState(100));
+    ASSERT_TRUE(result.best_move_.has_value());
+    ASSERT_GE(result.cost_, std::chrono::milliseconds(50));
+    ASSERT_LT(result.cost_, std::chrono::seconds(5));
+}
+
+TEST_F(TestMcts, stop_expanding_when_node_pool_is_full)
+{
+    auto options = PlayoutLimitedOptions(1, mcts::Parallelism::ROOT);
+    options.max_node_num_ = 100;
+    mcts::Searcher<NimState> searcher(options);
+    const auto result = searcher.Search(NimState(100));
+    ASSERT_TRUE(result.best_move_.has_value());
+    ASSERT_LE(result.node_num_, 100);
+    ASSERT_EQ(20000, result.playout_num_);
+}
+
+TEST_F(TestMcts, reuse_node_pool)
+{
+    mcts::Searcher<NimState> searcher(PlayoutLimitedOptions(1, mcts::Parallelism::ROOT));
+    searcher.Search(NimState(100));
+    const auto capacity = searcher.PoolCapacity();
+    ASSERT_GT(capacity, 0);
+    for (uint32_t i = 0; i < 5; ++i) {
+        searcher.Search(NimState(100));
+    }
+    ASSERT_EQ(capacity, searcher.PoolCapacity());
+}
+
+// Benchmark
+
+TEST_F(TestMcts, benchmark_renju_playouts_per_second)
+{
+    renju::Board board("");
+    board.Set(7, 7, renju::AreaType::BLACK);
+    board.Set(7, 8, renju::AreaType::WHITE);
+    for (const auto parallelism : {mcts::Parallelism::ROOT, mcts::Parallelism::TREE}) {
+        for (const uint32_t thread_num : {1, 2, 4, 8}) {
+            mcts::Searcher<renju::MctsState> searcher(mcts::Options{
+                    .thread_num_ = thread_num,
+                    .parallelism_ = parallelism,
+                    .time_budget_ = std::chrono::milliseconds(300),
+                    .max_playout_depth_ = 40,
+                });
+            const auto result = searcher.Search(renju::MctsState(board, 0));
+            ASSERT_TRUE(result.best_move_.has_value());
+            std::cout << "[BENCHMARK] parallelism=" << (parallelism == mcts::Parallelism::ROOT ? "root" : "tree")
+                      << " threads=" << thread_num << " playouts=" << result.playout_num_
+                      << " playouts_per_sec=" << result.playout_num_ * 1000000.0 / result.cost_.count() << std::endl;
+        }
+    }
+}
@@ -2,6 +2,9 @@
 //
 // This source code is licensed under LGPLv2 (found in the LICENSE file).
 
+#include <chrono>
+#include <random>
+
 #include "game_util/numcomb.h"
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
@@ -123,6 +126,156 @@ TEST_F(TestComb, fill_zero)
     ASSERT_EQ(30, comb::Comb("").Fill(0, comb::AreaCard()));
 }
 
+TEST_F(TestComb, line_table)
+{
+    std::array<uint32_t, comb::LineTable::k_area_num> line_nums{};
+    std::array<uint32_t, comb::LineTable::k_max_line_size + 1> size_nums{};
+    for (uint32_t line_id = 0; line_id < comb::LineTable::k_line_num; ++line_id) {
+        const auto& line = comb::k_line_table.GetLine(line_id);
+        ++size_nums[line.size_];
+        for (uint32_t i = 0; i < line.size_; ++i) {
+            ++line_nums[line.areas_[i]];
+            ASSERT_EQ(line_id, comb::k_line_table.AreaLine(line.areas_[i], line.direct_));
+        }
+    }
+    ASSERT_EQ(0, line_nums[0]);
+    for (uint32_t idx = 1; idx < comb::LineTable::k_area_num; ++idx) {
+        ASSERT_EQ(3, line_nums[idx]) << idx;
+    }
+    ASSERT_EQ((std::array<uint32_t, 6>{0, 0, 0, 6, 6, 3}), size_nums);
+    // the vertical line in the middle
+    const auto& line = comb::k_line_table.GetLine(comb::k_line_table.AreaLine(10, comb::Direct::VERT));
+    ASSERT_EQ(5, line.size_);
+    ASSERT_EQ((std::array<uint32_t, 5>{8, 9, 10, 11, 12}), line.areas_);
+    ASSERT_EQ((comb::Coordinate{0, -6}), line.head_);
+    ASSERT_EQ((comb::Coordinate{0, 6}), line.tail_);
+}
+
+TEST_F(TestComb, board_line_point)
+{
+    comb::Board board;
+    const uint32_t line_id = comb::k_line_table.AreaLine(1, comb::Direct::VERT);
+    ASSERT_EQ(0, board.Fill(1, comb::AreaCard(8, 9, 6)));
+    ASSERT_EQ(0, board.Fill(2, comb::AreaCard()));
+    ASSERT_EQ(0, board.LinePoint(line_id));
+    ASSERT_EQ(27, board.Fill(3, comb::AreaCard(3, 9, 2)));
+    ASSERT_EQ(27, board.LinePoint(line_id));
+    board.Clear(3);
+    ASSERT_FALSE(board.IsFilled(3));
+    ASSERT_EQ(0, board.Fill(3, comb::AreaCard(3, 5, 2)));
+}
+
+TEST_F(TestComb, card_pool)
+{
+    comb::CardPool pool({comb::AreaCard(8, 9, 6), comb::AreaCard(8, 9, 6), comb::AreaCard(3, 1, 2), comb::AreaCard()});
+    ASSERT_EQ(4, pool.Size());
+    ASSERT_EQ(3, pool.Kinds().size());
+    ASSERT_EQ(3, pool.MatchNum(comb::Direct::VERT, 9));
+    ASSERT_EQ(1, pool.MatchNum(comb::Direct::VERT, 5));
+    ASSERT_TRUE(pool.HasPoint(comb::Direct::TOP_LEFT, 3));
+    ASSERT_FALSE(pool.HasPoint(comb::Direct::TOP_LEFT, 4));
+    ASSERT_DOUBLE_EQ((23 + 23 + 6 + 30) / 4.0, pool.AveragePointSum());
+    ASSERT_TRUE(pool.Remove(comb::AreaCard(3, 1, 2)));
+    ASSERT_FALSE(pool.Remove(comb::AreaCard(3, 1, 2)));
+    ASSERT_FALSE(pool.HasPoint(comb::Direct::TOP_LEFT, 3));
+    ASSERT_EQ(3, pool.Size());
+}
+
+static std::vector<comb::AreaCard> AllCards()
+{
+    std::vector<comb::AreaCard> cards;
+    for (const int32_t point_0 : {3, 4, 8}) {
+        for (const int32_t point_1 : {1, 5, 9}) {
+            for (const int32_t point_2 : {2, 6, 7}) {
+                cards.emplace_back(point_0, point_1, point_2);
+                cards.emplace_back(point_0, point_1, point_2);
+            }
+        }
+    }
+    cards.emplace_back();
+    cards.emplace_back();
+    return cards;
+}
+
+TEST_F(TestComb, solver_finish_line)
+{
+    comb::Board board;
+    comb::CardPool pool(AllCards());
+    for (const uint32_t idx : {8, 9, 10, 11}) {
+        board.Fill(idx, comb::AreaCard(8, 9, 6));
+        pool.Remove(comb::AreaCard(8, 9, 6));
+    }
+    pool.Remove(comb::AreaCard(3, 9, 2));
+    for (const uint32_t depth : {1, 2}) {
+        // it is unlikely to get another 9 in the last round
+        const auto placement = comb::PlacementSolver(depth).Solve(board, comb::AreaCard(3, 9, 2), pool, 1);
+        ASSERT_EQ(12, placement.idx_) << "depth=" << depth;
+        ASSERT_GE(placement.expected_point_, 45) << "depth=" << depth;
+    }
+}
+
+TEST_F(TestComb, solver_not_break_line)
+{
+    comb::Board board;
+    comb::CardPool pool(AllCards());
+    for (const uint32_t idx : {8, 9, 10, 11}) {
+        board.Fill(idx, comb::AreaCard(8, 9, 6));
+        pool.Remove(comb::AreaCard(8, 9, 6));
+    }
+    pool.Remove(comb::AreaCard(3, 1, 2));
+    for (const uint32_t depth : {1, 2}) {
+        const auto placement = comb::PlacementSolver(depth).Solve(board, comb::AreaCard(3, 1, 2), pool, 10);
+        ASSERT_NE(12, placement.idx_) << "depth=" << depth;
+    }
+}
+
+TEST_F(TestComb, solver_full_board)
+{
+    comb::Board board;
+    for (uint32_t idx = 0; idx < comb::Board::k_area_num; ++idx) {
+        board.Fill(idx, comb::AreaCard(8, 9, 6));
+    }
+    ASSERT_EQ(UINT32_MAX, comb::PlacementSolver().Solve(board, comb::AreaCard(8, 9, 6), comb::CardPool(), 0).idx_);
+}
+
+// Benchmark
+
+TEST_F(TestComb, benchmark_solver_expected_score)
+{
+    static constexpr uint32_t k_game_num = 20;
+    for (const uint32_t depth : {0, 1, 2}) { // depth 0 means filling sequentially
+        std::mt19937 engine(0);
+        int64_t score_sum = 0;
+        std::chrono::nanoseconds max_cost(0);
+        std::chrono::nanoseconds cost_sum(0);
+        for (uint32_t game = 0; game < k_game_num; ++game) {
+            auto cards = AllCards();
+            std::shuffle(cards.begin(), cards.end(), engine);
+            comb::CardPool pool(cards);
+            comb::Board board;
+            for (uint32_t round = 0; round < comb::Board::k_area_num; ++round) {
+                const auto& card = cards[round];
+                pool.Remove(card);
+                uint32_t idx = round;
+                if (depth > 0) {
+                    const auto begin = std::chrono::steady_clock::now();
+                    idx = comb::PlacementSolver(depth).Solve(board, card, pool, comb::Board::k_area_num - 1 - round).idx_;
+                    const auto cost = std::chrono::steady_clock::now() - begin;
+                    cost_sum += cost;
+                    max_cost = std::max(max_cost, cost);
+                }
+                score_sum += board.Fill(idx, card);
+            }
+        }
+        const uint32_t decision_num = k_game_num * comb::Board::k_area_num;
+        std::cout << "[BENCHMARK] depth=" << depth << " games=" << k_game_num
+                  << " average_score=" << static_cast<double>(score_sum) / k_game_num
+                  << " average_solve_us=" << std::chrono::duration_cast<std::chrono::microseconds>(cost_sum).count() / decision_num
+                  << " max_solve_us=" << std::chrono::duration_cast<std::chrono::microseconds>(max_cost).count()
+                  << std::endl;
+    }
+}
+
 int main(int argc, char** argv)
 {
     testing::InitGoogleTest(&argc, argv);
@@ -2,6 +2,9 @@
 //
 // This source code is licensed under LGPLv2 (found in the LICENSE file).
 
+#include <chrono>
+#include <iostream>
+
 #include "game_util/poker.h"
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
@@ -259,6 +262,128 @@ TEST_F(TestPoker, compare_flushes)
     ASSERT_TRUE(*best_deck_2 < *best_deck_1); // the greatest poker RED 0 is greater than BLUE 0, so deck 1 is greater
 }
 
+static poker::Hand RandomHand(std::mt19937& engine, const uint32_t poker_num)
+{
+    poker::Hand hand;
+    for (uint32_t i = 0; i < poker_num; ) {
+        i += hand.Add(poker::PokerNumber(engine() % poker::PokerNumber::Count()),
+                poker::PokerSuit(engine() % poker::PokerSuit::Count()));
+    }
+    return hand;
+}
+
+TEST_F(TestPoker, rank_order_is_same_as_deck_order)
+{
+    std::mt19937 engine(0);
+    const auto& evaluator = poker::DeckEvaluator::Get();
+    for (uint32_t i = 0; i < 10000; ++i) {
+        const auto hand_1 = RandomHand(engine, 5 + i % 8);
+        const auto hand_2 = RandomHand(engine, 5 + i % 8);
+        const auto rank_1 = evaluator.Evaluate(hand_1.Masks());
+        const auto rank_2 = evaluator.Evaluate(hand_2.Masks());
+        ASSERT_TRUE(hand_1.BestDeck().has_value());
+        ASSERT_TRUE(hand_2.BestDeck().has_value());
+        ASSERT_TRUE(*hand_1.BestDeck() == *poker::DeckEvaluator::ToDeck(rank_1));
+        ASSERT_EQ(hand_1.BestDeck()->type_, poker::DeckEvaluator::Type(rank_1));
+        ASSERT_EQ(*hand_1.BestDeck() <=> *hand_2.BestDeck(), rank_1 <=> rank_2);
+    }
+}
+
+TEST_F(TestPoker, no_rank_for_less_than_five_pokers)
+{
+    poker::Hand hand;
+    hand.Add(poker::PokerNumber::_0, poker::PokerSuit::GREEN);
+    hand.Add(poker::PokerNumber::_0, poker::PokerSuit::RED);
+    hand.Add(poker::PokerNumber::_0, poker::PokerSuit::PURPLE);
+    hand.Add(poker::PokerNumber::_0, poker::PokerSuit::BLUE);
+    ASSERT_EQ(poker::k_no_deck_rank, poker::DeckEvaluator::Get().Evaluate(hand.Masks()));
+    ASSERT_FALSE(poker::DeckEvaluator::ToDeck(poker::k_no_deck_rank).has_value());
+}
+
+TEST_F(TestPoker, straight_with_smallest_x)
+{
+    poker::Hand hand;
+    hand.Add(poker::PokerNumber::_0, poker::PokerSuit::GREEN);
+    hand.Add(poker::PokerNumber::_1, poker::PokerSuit::RED);
+    hand.Add(poker::PokerNumber::_2, poker::PokerSuit::GREEN);
+    hand.Add(poker::PokerNumber::_3, poker::PokerSuit::GREEN);
+    hand.Add(poker::PokerNumber::_4, poker::PokerSuit::GREEN);
+    const auto best_deck = hand.BestDeck();
+    ASSERT_TRUE(best_deck.has_value());
+    ASSERT_TRUE(best_deck->type_ == poker::PatternType::STRAIGHT) << "best_deck: " << best_deck->type_;
+    ASSERT_TRUE(best_deck->pokers_.front().number_ == poker::PokerNumber::_4);
+    ASSERT_TRUE(best_deck->pokers_.back().number_ == poker::PokerNumber::_0);
+}
+
+TEST_F(TestPoker, estimate_equity)
+{
+    std::mt19937 engine(0);
+    const std::vector<poker::Poker> public_pokers{
+        {poker::PokerNumber::_1, poker::PokerSuit::GREEN},
+        {poker::PokerNumber::_2, poker::PokerSuit::GREEN},
+        {poker::PokerNumber::_3, poker::PokerSuit::GREEN},
+    };
+    const std::vector<std::vector<poker::Poker>> hands{
+        {{poker::PokerNumber::_4, poker::PokerSuit::GREEN}, {poker::PokerNumber::_5, poker::PokerSuit::GREEN}},
+        {{poker::PokerNumber::_9, poker::PokerSuit::RED}, {poker::PokerNumber::_9, poker::PokerSuit::BLUE}},
+    };
+    const auto equities = poker::DeckEvaluator::Get().EstimateEquity(hands, public_pokers, 5, 1000, engine);
+    ASSERT_EQ(2, equities.size());
+    ASSERT_DOUBLE_EQ(1.0, equities[0]); // the straight flush always wins
+    ASSERT_DOUBLE_EQ(0.0, equities[1]);
+}
+
+TEST_F(TestPoker, estimate_equity_of_same_numbers)
+{
+    std::mt19937 engine(0);
+    const std::vector<std::vector<poker::Poker>> hands{
+        {{poker::PokerNumber::_9, poker::PokerSuit::RED}, {poker::PokerNumber::_8, poker::PokerSuit::BLUE}},
+        {{poker::PokerNumber::_9, poker::PokerSuit::BLUE}, {poker::PokerNumber::_8, poker::PokerSuit::RED}},
+    };
+    const auto equities = poker::DeckEvaluator::Get().EstimateEquity(hands, {}, 5, 10000, engine);
+    ASSERT_GT(equities[0], equities[1]); // the RED 9 is greater than the BLUE 9
+    ASSERT_NEAR(1.0, equities[0] + equities[1], 1e-9); // there is always a deck with seven pokers
+}
+
+// Benchmark
+
+TEST_F(TestPoker, benchmark_evaluate)
+{
+    std::mt19937 engine(0);
+    std::vector<poker::Hand> hands;
+    std::vector<poker::SuitMasks> masks;
+    for (uint32_t i = 0; i < 100000; ++i) {
+        hands.emplace_back(RandomHand(engine, 7));
+        masks.emplace_back(hands.back().Masks());
+    }
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t deck_num = 0;
+    for (const auto& hand : hands) {
+        deck_num += hand.BestDeck().has_value();
+    }
+    const auto best_deck_cost = std::chrono::steady_clock::now() - begin;
+
+    begin = std::chrono::steady_clock::now();
+    std::vector<poker::DeckRank> ranks(masks.size());
+    poker::DeckEvaluator::Get().Evaluate(masks.data(), masks.size(), ranks.data());
+    const auto evaluate_cost = std::chrono::steady_clock::now() - begin;
+
+    begin = std::chrono::steady_clock::now();
+    const std::vector<std::vector<poker::Poker>> equity_hands{
+        {{poker::PokerNumber::_9, poker::PokerSuit::RED}, {poker::PokerNumber::_8, poker::PokerSuit::BLUE}},
+        {{poker::PokerNumber::_0, poker::PokerSuit::BLUE}, {poker::PokerNumber::_2, poker::PokerSuit::RED}},
+        {{poker::PokerNumber::_5, poker::PokerSuit::GREEN}, {poker::PokerNumber::_5, poker::PokerSuit::RED}},
+    };
+    poker::DeckEvaluator::Get().EstimateEquity(equity_hands, {}, 5, 10000, engine);
+    const auto equity_cost = std::chrono::steady_clock::now() - begin;
+
+    std::cout << "[BENCHMARK] hands=" << hands.size() << " decks=" << deck_num
+              << " best_deck_ns=" << std::chrono::duration_cast<std::chrono::nanoseconds>(best_deck_cost).count() / hands.size()
+              << " evaluate_ns=" << std::chrono::duration_cast<std::chrono::nanoseconds>(evaluate_cost).count() / masks.size()
+              << " equity_10000_samples_us=" << std::chrono::duration_cast<std::chrono::microseconds>(equity_cost).count()
+              << std::endl;
+}
+
 int main(int argc, char** argv)
 {
   testing::InitGoogleTest(&argc, argv);
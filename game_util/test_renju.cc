@@ -3,10 +3,13 @@
 // This source code is licensed under LGPLv2 (found in the LICENSE file).
 
 #include "game_util/renju.h"
+#include "game_util/mcts.h"
 
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
 
+#include <random>
+
 using namespace renju;
 
 class TestGoBoard : public testing::Test {};
@@ -42,3 +45,147 @@ TEST_F(TestGoBoard, invalid_point_with_one_piece)
     board.Set(9, 7, AreaType::WHITE);
     ASSERT_FALSE(board.CanBeSet(8, 7, AreaType::WHITE));
 }
+
+class TestRenjuMcts : public testing::Test
+{
+  protected:
+    TestRenjuMcts() : board_("")
+    {
+        for (uint32_t col = 5; col <= 8; ++col) {
+            board_.Set(7, col, AreaType::BLACK);
+        }
+        board_.Set(6, 6, AreaType::WHITE);
+        board_.Set(6, 7, AreaType::WHITE);
+        board_.Set(8, 8, AreaType::WHITE);
+    }
+
+    static mcts::Options Options()
+    {
+        return mcts::Options{.time_budget_ = std::chrono::milliseconds(0), .max_playout_num_ = 5000, .seed_ = 1};
+    }
+
+    Board board_;
+};
+
+TEST_F(TestRenjuMcts, complete_five)
+{
+    mcts::Searcher<MctsState> searcher(Options());
+    ASSERT_EQ((std::pair<uint32_t, uint32_t>{7, 9}), searcher.Search(MctsState(board_, 0)).best_move_);
+}
+
+TEST_F(TestRenjuMcts, block_five)
+{
+    mcts::Searcher<MctsState> searcher(Options());
+    ASSERT_EQ((std::pair<uint32_t, uint32_t>{7, 9}), searcher.Search(MctsState(board_, 1)).best_move_);
+}
+
+class TestRenjuBitBoard : public testing::Test
+{
+  protected:
+    TestRenjuBitBoard() { bitboard_.SetArea(0, LineMasks::k_size_ - 1); }
+
+    BitBoard bitboard_;
+};
+
+TEST_F(TestRenjuBitBoard, five_in_each_direction)
+{
+    const std::array<std::pair<int32_t, int32_t>, 4> directions{{{0, 1}, {1, 0}, {1, 1}, {1, -1}}};
+    for (const auto& [dr, dc] : directions) {
+        BitBoard bitboard;
+        bitboard.SetArea(0, LineMasks::k_size_ - 1);
+        for (int32_t i = 0; i < 4; ++i) {
+            bitboard.Set(5 + dr * i, 5 + dc * i, AreaType::BLACK);
+        }
+        ASSERT_TRUE(bitboard.MakesFive(5 + dr * 4, 5 + dc * 4, AreaType::BLACK));
+        ASSERT_TRUE(bitboard.MakesFive(5 - dr, 5 - dc, AreaType::BLACK));
+        ASSERT_FALSE(bitboard.MakesFive(5 + dr * 4, 5 + dc * 4, AreaType::WHITE));
+        ASSERT_EQ(2, bitboard.Patterns(AreaType::BLACK).fours_);
+        bitboard.Set(5 + dr * 4, 5 + dc * 4, AreaType::BLACK);
+        uint32_t five_num = 0;
+        for (uint32_t direction = 0; direction < LineMasks::k_direction_num_; ++direction) {
+            five_num += std::popcount(bitboard.Fives(5, 5, AreaType::BLACK, direction));
+        }
+        ASSERT_EQ(5, five_num);
+    }
+}
+
+TEST_F(TestRenjuBitBoard, open_three)
+{
+    bitboard_.Set(7, 6, AreaType::BLACK);
+    bitboard_.Set(7, 7, AreaType::BLACK);
+    bitboard_.Set(7, 8, AreaType::BLACK);
+    ASSERT_EQ(0, bitboard_.Patterns(AreaType::BLACK).fours_);
+    ASSERT_EQ(2, bitboard_.Patterns(AreaType::BLACK).open_threes_);
+    bitboard_.Set(7, 4, AreaType::WHITE);
+    ASSERT_EQ(1, bitboard_.Patterns(AreaType::BLACK).open_threes_);
+    bitboard_.Set(7, 10, AreaType::FORBID);
+    ASSERT_EQ(0, bitboard_.Patterns(AreaType::BLACK).open_threes_);
+    ASSERT_EQ(0, bitboard_.Patterns(AreaType::BLACK).fours_);
+}
+
+TEST_F(TestRenjuBitBoard, broken_four)
+{
+    bitboard_.Set(3, 3, AreaType::WHITE);
+    bitboard_.Set(4, 4, AreaType::WHITE);
+    bitboard_.Set(6, 6, AreaType::WHITE);
+    bitboard_.Set(7, 7, AreaType::WHITE);
+    ASSERT_EQ(1, bitboard_.Patterns(AreaType::WHITE).fours_);
+    ASSERT_TRUE(bitboard_.MakesFive(5, 5, AreaType::WHITE));
+    ASSERT_EQ(1 << 5, bitboard_.FivePoints(AreaType::WHITE)[5]);
+}
+
+TEST_F(TestRenjuBitBoard, area_limits_patterns)
+{
+    BitBoard bitboard;
+    bitboard.SetArea(5, 9);
+    for (uint32_t col = 5; col <= 8; ++col) {
+        bitboard.Set(7, col, AreaType::BLACK);
+    }
+    ASSERT_EQ(1, bitboard.Patterns(AreaType::BLACK).fours_);
+    bitboard.SetArea(4, 10);
+    ASSERT_EQ(2, bitboard.Patterns(AreaType::BLACK).fours_);
+}
+
+TEST_F(TestRenjuBitBoard, incremental_patterns_equal_to_recount)
+{
+    std::mt19937 rng(0);
+    std::vector<std::pair<uint32_t, uint32_t>> cells;
+    for (uint32_t row = 0; row < LineMasks::k_size_; ++row) {
+        for (uint32_t col = 0; col < LineMasks::k_size_; ++col) {
+            cells.emplace_back(row, col);
+        }
+    }
+    std::ranges::shuffle(cells, rng);
+    for (uint32_t i = 0; i < 120; ++i) {
+        const auto type = i % 7 == 6 ? AreaType::FORBID : i % 2 ? AreaType::WHITE : AreaType::BLACK;
+        bitboard_.Set(cells[i].first, cells[i].second, type);
+        BitBoard recounted = bitboard_;
+        recounted.SetArea(0, LineMasks::k_size_ - 1);
+        for (const auto color : {AreaType::BLACK, AreaType::WHITE}) {
+            ASSERT_EQ(recounted.Patterns(color).fours_, bitboard_.Patterns(color).fours_);
+            ASSERT_EQ(recounted.Patterns(color).open_threes_, bitboard_.Patterns(color).open_threes_);
+        }
+    }
+}
+
+TEST_F(TestRenjuBitBoard, board_set_simultaneously)
+{
+    Board board("");
+    for (uint32_t col = 5; col <= 8; ++col) {
+        const auto result = board.Set(7, col, 6, col);
+        ASSERT_TRUE(result == Result::CONTINUE_OK || result == Result::CONTINUE_EXTEND);
+    }
+    ASSERT_EQ(Result::TIE_DOUBLE_WIN, board.Set(7, 9, 6, 9));
+}
+
+TEST_F(TestRenjuBitBoard, board_crash_blocks_five)
+{
+    Board board("");
+    for (uint32_t col = 5; col <= 8; ++col) {
+        board.Set(7, col, AreaType::BLACK);
+    }
+    ASSERT_TRUE(board.MakesFive(7, 9, AreaType::BLACK));
+    ASSERT_EQ(Result::CONTINUE_CRASH, board.Set(7, 9, 7, 9));
+    ASSERT_FALSE(board.CanBeSet(7, 9));
+    ASSERT_EQ(0, board.Patterns(AreaType::BLACK).fours_);
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include "game_util/tile_image.h"
+
+#include <chrono>
+#include <iostream>
+
+#include <gtest/gtest.h>
+#include <gflags/gflags.h>
+
+using namespace tile_image;
+
+static const std::filesystem::path k_games_dir = std::filesystem::path(__FILE__).parent_path() / ".." / "games";
+
+class TestTileImage : public testing::Test
+{
+  protected:
+    virtual void SetUp() override
+    {
+        dir_ = std::filesystem::temp_directory_path() /
+            ("test_tile_image_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    }
+
+    virtual void TearDown() override
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(dir_, ec);
+    }
+
+    static bool SameColor(const Color& a, const Color& b)
+    {
+        return a.r_ == b.r_ && a.g_ == b.g_ && a.b_ == b.b_ && a.a_ == b.a_;
+    }
+
+    std::filesystem::path dir_;
+};
+
+TEST_F(TestTileImage, png_round_trip)
+{
+    Image image(3, 2, Color{10, 20, 30});
+    image.At(2, 1) = Color{200, 100, 50, 128};
+    const std::string png = image.EncodePng();
+    ASSERT_FALSE(png.empty());
+    std::filesystem::create_directories(dir_);
+    std::ofstream(dir_ / "tile.png", std::ios::binary) << png;
+    const auto loaded = Image::Load(dir_ / "tile.png");
+    ASSERT_TRUE(loaded.has_value());
+    ASSERT_EQ(3, loaded->Width());
+    ASSERT_EQ(2, loaded->Height());
+    ASSERT_TRUE(SameColor(Color{10, 20, 30}, loaded->At(0, 0)));
+    ASSERT_TRUE(SameColor(Color{200, 100, 50, 128}, loaded->At(2, 1)));
+}
+
+TEST_F(TestTileImage, load_bmp)
+{
+    const auto image = Image::Load(k_games_dir / "renju" / "resource" / "b_00.bmp");
+    ASSERT_TRUE(image.has_value());
+    ASSERT_EQ(32, image->Width());
+    ASSERT_EQ(32, image->Height());
+    ASSERT_EQ(255, image->At(0, 0).a_);
+}
+
+TEST_F(TestTileImage, load_invalid_file)
+{
+    ASSERT_FALSE(Image::Load(dir_ / "not_exist.png").has_value());
+    ASSERT_FALSE(Image::Load(dir_ / "not_exist.bmp").has_value());
+}
+
+TEST_F(TestTileImage, blit_blends_and_clips)
+{
+    Image canvas(4, 4, Color{0, 0, 0});
+    Image tile(2, 2, Color{255, 255, 255, 255});
+    tile.At(1, 1) = Color{255, 255, 255, 0};
+    canvas.Blit(tile, -1, 3);
+    ASSERT_TRUE(SameColor(Color{255, 255, 255}, canvas.At(0, 3)));
+    ASSERT_TRUE(SameColor(Color{0, 0, 0}, canvas.At(1, 3)));
+    canvas.FillRect(2, 0, 1, 1, Color{255, 0, 0, 128});
+    ASSERT_EQ(128, canvas.At(2, 0).r_);
+    ASSERT_EQ(255, canvas.At(2, 0).a_);
+}
+
+TEST_F(TestTileImage, draw_text)
+{
+    Image image(Image::TextWidth("1-"), Image::TextHeight());
+    image.DrawText(0, 0, "1-", Color{255, 0, 0});
+    ASSERT_EQ(11, image.Width());
+    ASSERT_EQ(255, image.At(2, 0).a_); // the top of '1'
+    ASSERT_EQ(0, image.At(0, 0).a_);
+    ASSERT_EQ(255, image.At(6, 3).a_); // the middle of '-'
+}
+
+TEST_F(TestTileImage, atlas_decodes_tile_once)
+{
+    auto& atlas = TileAtlas::Get(k_games_dir / "quixo" / "resource");
+    const Image* const tile = atlas.Tile("box_0");
+    ASSERT_NE(nullptr, tile);
+    ASSERT_EQ(64, tile->Width());
+    ASSERT_EQ(tile, TileAtlas::Get(k_games_dir / "quixo" / "resource").Tile("box_0"));
+    ASSERT_EQ(nullptr, atlas.Tile("not_exist"));
+}
+
+TEST_F(TestTileImage, grid_layout)
+{
+    TileGrid grid(TileAtlas::Get(k_games_dir / "quixo" / "resource"), 2, 3);
+    grid.SetSpacing(1);
+    grid.SetPadding(1);
+    grid.SetTile(0, 0, "box_0");
+    grid.SetTile(1, 2, "box_1");
+    grid.SetText(1, 0, "A", Color{255, 0, 0});
+    const Image image = grid.Render();
+    ASSERT_EQ(64 * 2 + 3 * 2 + 4, image.Width()); // the text is narrower than the tile
+    ASSERT_EQ(64 * 2 + 2 * 2 + 3, image.Height());
+}
+
+// Benchmark
+
+TEST_F(TestTileImage, benchmark_quixo_board)
+{
+    auto& atlas = TileAtlas::Get(k_games_dir / "quixo" / "resource");
+    const auto begin = std::chrono::steady_clock::now();
+    constexpr uint32_t k_repeat = 20;
+    for (uint32_t i = 0; i < k_repeat; ++i) {
+        TileGrid grid(atlas, 7, 7);
+        grid.SetSpacing(1);
+        grid.SetPadding(1);
+        for (uint32_t row = 1; row < 6; ++row) {
+            for (uint32_t col = 1; col < 6; ++col) {
+                grid.SetTile(row, col, std::string("box_") + static_cast<char>('0' + (row * col + i) % 5));
+            }
+        }
+        ASSERT_FALSE(grid.Render().EncodePng().empty());
+    }
+    const auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+    std::cout << "[BENCHMARK] render_and_encode_us=" << cost.count() / k_repeat << std::endl;
+}
@@ -0,0 +1,392 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <png.h>
+
+// A native compositor for the boards made of fixed-size tiles. The tiles of a resource directory are decoded once into
+// a shared atlas, and a board is blitted into an RGBA buffer and encoded as PNG directly, without the HTML renderer.
+namespace tile_image {
+
+struct Color
+{
+    uint8_t r_;
+    uint8_t g_;
+    uint8_t b_;
+    uint8_t a_ = 255;
+};
+
+static_assert(sizeof(Color) == 4, "the pixels should be laid out as PNG_FORMAT_RGBA");
+
+class Image
+{
+  public:
+    // The glyphs of the built-in 5 * 7 font. Each row is 5 bits with the leftmost pixel as the highest bit.
+    static constexpr const uint32_t k_glyph_width_ = 5;
+    static constexpr const uint32_t k_glyph_height_ = 7;
+
+    Image() : width_(0), height_(0) {}
+
+    Image(const uint32_t width, const uint32_t height, const Color background = Color{0, 0, 0, 0})
+        : width_(width), height_(height), pixels_(width * height, background)
+    {
+    }
+
+    // Supports PNG and uncompressed 24-bit or 32-bit BMP. Returns std::nullopt if the file cannot be decoded.
+    static std::optional<Image> Load(const std::filesystem::path& path)
+    {
+        return path.extension() == ".bmp" ? LoadBmp_(path) : LoadPng_(path);
+    }
+
+    uint32_t Width() const { return width_; }
+
+    uint32_t Height() const { return height_; }
+
+    bool Empty() const { return pixels_.empty(); }
+
+    const Color& At(const uint32_t x, const uint32_t y) const { return pixels_[y * width_ + x]; }
+
+    Color& At(const uint32_t x, const uint32_t y) { return pixels_[y * width_ + x]; }
+
+    // Draws |src| over this image with its top-left corner at (x, y). The pixels out of this image are clipped.
+    void Blit(const Image& src, const int32_t x, const int32_t y)
+    {
+        const int32_t begin_x = std::max(0, -x), end_x = std::min<int32_t>(src.width_, width_ - x);
+        const int32_t begin_y = std::max(0, -y), end_y = std::min<int32_t>(src.height_, height_ - y);
+        for (int32_t src_y = begin_y; src_y < end_y; ++src_y) {
+            for (int32_t src_x = begin_x; src_x < end_x; ++src_x) {
+                Blend_(pixels_[(src_y + y) * width_ + src_x + x], src.pixels_[src_y * src.width_ + src_x]);
+            }
+        }
+    }
+
+    void FillRect(const int32_t x, const int32_t y, const uint32_t width, const uint32_t height, const Color color)
+    {
+        for (int32_t row = std::max(0, y); row < std::min<int32_t>(height_, y + height); ++row) {
+            for (int32_t col = std::max(0, x); col < std::min<int32_t>(width_, x + width); ++col) {
+                Blend_(pixels_[row * width_ + col], color);
+            }
+        }
+    }
+
+    // Draws |text| with the built-in font, which has digits, latin letters (drawn in upper case), '-', ':' and spaces.
+    // Other characters are drawn as spaces.
+    void DrawText(const int32_t x, const int32_t y, const std::string_view text, const Color color, const uint32_t scale = 1)
+    {
+        int32_t pen_x = x;
+        for (const char c : text) {
+            const auto& glyph = Glyph_(c);
+            for (uint32_t row = 0; row < k_glyph_height_; ++row) {
+                for (uint32_t col = 0; col < k_glyph_width_; ++col) {
+                    if ((glyph[row] >> (k_glyph_width_ - 1 - col)) & 1) {
+                        FillRect(pen_x + col * scale, y + row * scale, scale, scale, color);
+                    }
+                }
+            }
+            pen_x += (k_glyph_width_ + 1) * scale;
+        }
+    }
+
+    static uint32_t TextWidth(const std::string_view text, const uint32_t scale = 1)
+    {
+        return text.empty() ? 0 : ((k_glyph_width_ + 1) * text.size() - 1) * scale;
+    }
+
+    static uint32_t TextHeight(const uint32_t scale = 1) { return k_glyph_height_ * scale; }
+
+    // Returns an empty string if the encoding fails.
+    std::string EncodePng() const
+    {
+        png_image image = PngImage_();
+        png_alloc_size_t size = 0;
+        if (!png_image_write_to_memory(&image, nullptr, &size, 0, pixels_.data(), 0, nullptr)) {
+            return {};
+        }
+        std::string buffer(size, '\0');
+        if (!png_image_write_to_memory(&image, buffer.data(), &size, 0, pixels_.data(), 0, nullptr)) {
+            return {};
+        }
+        buffer.resize(size);
+        return buffer;
+    }
+
+  private:
+    static void Blend_(Color& dst, const Color& src)
+    {
+        if (src.a_ == 255 || dst.a_ == 0) {
+            dst = src;
+            return;
+        }
+        if (src.a_ == 0) {
+            return;
+        }
+        const uint32_t dst_weight = dst.a_ * (255 - src.a_) / 255;
+        const uint32_t alpha = src.a_ + dst_weight;
+        const auto mix = [&](const uint8_t s, const uint8_t d) -> uint8_t
+            {
+                return (s * src.a_ + d * dst_weight) / alpha;
+            };
+        dst = Color{mix(src.r_, dst.r_), mix(src.g_, dst.g_), mix(src.b_, dst.b_), static_cast<uint8_t>(alpha)};
+    }
+
+    png_image PngImage_() const
+    {
+        png_image image;
+        memset(&image, 0, sizeof(image));
+        image.version = PNG_IMAGE_VERSION;
+        image.width = width_;
+        image.height = height_;
+        image.format = PNG_FORMAT_RGBA;
+        image.flags = PNG_IMAGE_FLAG_FAST; // the boards are sent once, so the encoding speed matters more than the size
+        return image;
+    }
+
+    static std::optional<Image> LoadPng_(const std::filesystem::path& path)
+    {
+        png_image image;
+        memset(&image, 0, sizeof(image));
+        image.version = PNG_IMAGE_VERSION;
+        if (!png_image_begin_read_from_file(&image, path.string().c_str())) {
+            return std::nullopt;
+        }
+        image.format = PNG_FORMAT_RGBA;
+        Image result(image.width, image.height);
+        if (!png_image_finish_read(&image, nullptr, result.pixels_.data(), 0, nullptr)) {
+            png_image_free(&image);
+            return std::nullopt;
+        }
+        return result;
+    }
+
+    static std::optional<Image> LoadBmp_(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const auto read = [&data](const size_t offset, const size_t size)
+            {
+                uint32_t value = 0;
+                for (size_t i = 0; i < size; ++i) {
+                    value |= static_cast<uint32_t>(static_cast<uint8_t>(data[offset + i])) << (i * 8);
+                }
+                return value;
+            };
+        if (data.size() < 54 || data[0] != 'B' || data[1] != 'M') {
+            return std::nullopt;
+        }
+        const uint32_t bits_offset = read(10, 4);
+        const int32_t width = read(18, 4);
+        const int32_t signed_height = read(22, 4);
+        const uint32_t bit_count = read(28, 2);
+        const uint32_t compression = read(30, 4);
+        const uint32_t height = std::abs(signed_height);
+        if (width <= 0 || height == 0 || (bit_count != 24 && bit_count != 32) || compression != 0) {
+            return std::nullopt;
+        }
+        const uint32_t bytes_per_pixel = bit_count / 8;
+        const uint32_t stride = (width * bytes_per_pixel + 3) / 4 * 4; // rows are aligned to 4 bytes
+        if (data.size() < bits_offset + stride * height) {
+            return std::nullopt;
+        }
+        Image result(width, height);
+        for (uint32_t row = 0; row < height; ++row) {
+            // rows are stored from the bottom unless the height is negative
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(data.data()) + bits_offset +
+                    (signed_height > 0 ? height - 1 - row : row) * stride;
+            for (int32_t col = 0; col < width; ++col, src += bytes_per_pixel) {
+                result.At(col, row) = Color{src[2], src[1], src[0]}; // the fourth byte of BI_RGB is reserved
+            }
+        }
+        return result;
+    }
+
+    static const std::array<uint8_t, k_glyph_height_>& Glyph_(const char c)
+    {
+        static constexpr const std::array<std::array<uint8_t, k_glyph_height_>, 10> k_digits{{
+            {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},
+            {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},
+            {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},
+            {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},
+            {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C},
+        }};
+        static constexpr const std::array<std::array<uint8_t, k_glyph_height_>, 26> k_letters{{
+            {0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11}, {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},
+            {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C},
+            {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},
+            {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},
+            {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},
+            {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},
+            {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},
+            {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},
+            {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},
+            {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+            {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},
+            {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},
+            {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}, {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F},
+        }};
+        static constexpr const std::array<uint8_t, k_glyph_height_> k_minus{0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00};
+        static constexpr const std::array<uint8_t, k_glyph_height_> k_colon{0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00};
+        static constexpr const std::array<uint8_t, k_glyph_height_> k_space{};
+        return '0' <= c && c <= '9' ? k_digits[c - '0'] :
+               'A' <= c && c <= 'Z' ? k_letters[c - 'A'] :
+               'a' <= c && c <= 'z' ? k_letters[c - 'a'] :
+               c == '-'             ? k_minus            :
+               c == ':'             ? k_colon            :
+                                      k_space            ;
+    }
+
+    uint32_t width_;
+    uint32_t height_;
+    std::vector<Color> pixels_;
+};
+
+// The decoded tiles of a resource directory, shared by all the matches of the game. A tile is decoded at its first use
+// and never released, because the resource directories are small.
+class TileAtlas
+{
+  public:
+    static TileAtlas& Get(const std::filesystem::path& dir)
+    {
+        static std::mutex mutex;
+        static std::unordered_map<std::string, std::unique_ptr<TileAtlas>> atlases;
+        std::lock_guard<std::mutex> l(mutex);
+        auto& atlas = atlases[dir.lexically_normal().string()];
+        if (!atlas) {
+            atlas = std::make_unique<TileAtlas>(dir);
+        }
+        return *atlas;
+    }
+
+    explicit TileAtlas(std::filesystem::path dir) : dir_(std::move(dir)) {}
+
+    TileAtlas(const TileAtlas&) = delete;
+    TileAtlas(TileAtlas&&) = delete;
+
+    // Looks for |name|.png and then |name|.bmp. Returns nullptr if neither can be decoded.
+    const Image* Tile(const std::string& name)
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        const auto [it, inserted] = tiles_.try_emplace(name);
+        if (inserted) {
+            for (const char* const extension : {".png", ".bmp"}) {
+                if (auto image = Image::Load(dir_ / (name + extension)); image.has_value()) {
+                    it->second = std::move(*image);
+                    break;
+                }
+            }
+        }
+        return it->second.Empty() ? nullptr : &it->second; // the failures are also kept to avoid reading them again
+    }
+
+  private:
+    const std::filesystem::path dir_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Image> tiles_; // the addresses of the values are stable
+};
+
+// A grid of tiles which takes the place of an html::Table of images. A column is as wide as its widest cell and a row is
+// as high as its highest cell, and the content of a cell is centered.
+class TileGrid
+{
+  public:
+    TileGrid(TileAtlas& atlas, const uint32_t row_num, const uint32_t col_num)
+        : atlas_(atlas), row_num_(row_num), col_num_(col_num), cells_(row_num * col_num), padding_(0), spacing_(0)
+        , background_{0, 0, 0, 0}
+    {
+    }
+
+    void SetTile(const uint32_t row, const uint32_t col, const std::string& name) { Cell_(row, col).tile_ = atlas_.Tile(name); }
+
+    // The text is drawn over the tile, if any.
+    void SetText(const uint32_t row, const uint32_t col, std::string text, const Color color, const uint32_t scale = 2)
+    {
+        auto& cell = Cell_(row, col);
+        cell.text_ = std::move(text);
+        cell.text_color_ = color;
+        cell.text_scale_ = scale;
+    }
+
+    // the same as cellpadding and cellspacing of a html table
+    void SetPadding(const uint32_t padding) { padding_ = padding; }
+    void SetSpacing(const uint32_t spacing) { spacing_ = spacing; }
+
+    void SetBackground(const Color background) { background_ = background; }
+
+    Image Render() const
+    {
+        std::vector<uint32_t> widths(col_num_, 0);
+        std::vector<uint32_t> heights(row_num_, 0);
+        for (uint32_t row = 0; row < row_num_; ++row) {
+            for (uint32_t col = 0; col < col_num_; ++col) {
+                const auto& cell = cells_[row * col_num_ + col];
+                widths[col] = std::max({widths[col], cell.tile_ ? cell.tile_->Width() : 0,
+                        Image::TextWidth(cell.text_, cell.text_scale_)});
+                heights[row] = std::max({heights[row], cell.tile_ ? cell.tile_->Height() : 0,
+                        cell.text_.empty() ? 0 : Image::TextHeight(cell.text_scale_)});
+            }
+        }
+        const auto offsets = [this](const std::vector<uint32_t>& sizes)
+            {
+                std::vector<uint32_t> offsets(sizes.size() + 1, spacing_);
+                for (uint32_t i = 0; i < sizes.size(); ++i) {
+                    offsets[i + 1] = offsets[i] + sizes[i] + padding_ * 2 + spacing_;
+                }
+                return offsets;
+            };
+        const auto xs = offsets(widths);
+        const auto ys = offsets(heights);
+        Image image(xs.back(), ys.back(), background_);
+        for (uint32_t row = 0; row < row_num_; ++row) {
+            for (uint32_t col = 0; col < col_num_; ++col) {
+                const auto& cell = cells_[row * col_num_ + col];
+                const uint32_t center_x = xs[col] + padding_ + widths[col] / 2;
+                const uint32_t center_y = ys[row] + padding_ + heights[row] / 2;
+                if (cell.tile_) {
+                    image.Blit(*cell.tile_, center_x - cell.tile_->Width() / 2, center_y - cell.tile_->Height() / 2);
+                }
+                if (!cell.text_.empty()) {
+                    image.DrawText(center_x - Image::TextWidth(cell.text_, cell.text_scale_) / 2,
+                            center_y - Image::TextHeight(cell.text_scale_) / 2, cell.text_, cell.text_color_,
+                            cell.text_scale_);
+                }
+            }
+        }
+        return image;
+    }
+
+  private:
+    struct Cell
+    {
+        const Image* tile_ = nullptr;
+        std::string text_;
+        Color text_color_{0, 0, 0};
+        uint32_t text_scale_ = 1;
+    };
+
+    Cell& Cell_(const uint32_t row, const uint32_t col) { return cells_[row * col_num_ + col]; }
+
+    TileAtlas& atlas_;
+    const uint32_t row_num_;
+    const uint32_t col_num_;
+    std::vector<Cell> cells_;
+    uint32_t padding_;
+    uint32_t spacing_;
+    Color background_;
+};
+
+}
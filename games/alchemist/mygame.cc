@@ -3,6 +3,8 @@
 // This source code is licensed under LGPLv2 (found in the LICENSE file).
 
 #include <array>
+#include <atomic>
+#include <deque>
 #include <map>
 #include <functional>
 #include <memory>
@@ -17,6 +19,7 @@
 #include "utility/msg_checker.h"
 #include "utility/html.h"
 #include "game_util/alchemist.h"
+#include "game_util/mcts.h"
 
 const std::string k_game_name = "炼金术士";
 const uint64_t k_max_player = 0; /* 0 means no max-player limits */
@@ -26,6 +29,15 @@ const std::string k_description = "通过放置卡牌，让卡牌连成直线获
 
 static int WinScoreThreshold(const bool mode) { return mode ? 200 : 10; }
 
+// The search runs in the background, so it uses only a few threads to leave the others to the other matches.
+static mcts::Options ComputerSearchOptions()
+{
+    return mcts::Options{
+        .thread_num_ = std::clamp(std::thread::hardware_concurrency(), 1U, 2U),
+        .time_budget_ = std::chrono::milliseconds(200),
+    };
+}
+
 std::string GameOption::StatusInfo() const
 {
     std::string str = std::string("\n「") + (GET_VALUE(模式) ? "竞技" : "经典") + "」模式\n每回合" +
@@ -94,6 +106,7 @@ class MainStage : public MainGameStage<RoundStage>
     {
         for (uint64_t i = 0; i < option.PlayerNum(); ++i) {
             players_.emplace_back(option.ResourceDir(), GET_OPTION_VALUE(option, 模式));
+            computer_searches_.emplace_back();
         }
 
         const std::string& seed_str = GET_OPTION_VALUE(option, 种子);
@@ -182,7 +195,36 @@ class MainStage : public MainGameStage<RoundStage>
     }
 
 
+    // The cards of the following rounds, whose order is unknown to the players.
+    std::vector<std::optional<alchemist::Card>> RemainingCards() const
+    {
+        const size_t end = std::min<size_t>(cards_.size(), GET_OPTION_VALUE(option(), 回合数));
+        return {cards_.begin() + std::min<size_t>(round_, end), cards_.begin() + end};
+    }
+
+    uint32_t round() const { return round_; }
+
+    // The search of a computer runs without the lock of the match, and the result is taken when the computer acts again.
+    struct ComputerSearch
+    {
+        ComputerSearch() : searcher_(ComputerSearchOptions()) {}
+
+        static void Run(void* const p)
+        {
+            auto& search = *static_cast<ComputerSearch*>(p);
+            search.best_move_ = search.searcher_.Search(*search.state_).best_move_;
+            search.is_running_.store(false, std::memory_order_release);
+        }
+
+        mcts::Searcher<alchemist::MctsState> searcher_;
+        std::optional<uint32_t> round_; // the round which |best_move_| is searched for
+        std::optional<alchemist::MctsState> state_;
+        std::optional<alchemist::MctsState::Move> best_move_;
+        std::atomic<bool> is_running_ = false;
+    };
+
     std::vector<Player> players_;
+    std::deque<ComputerSearch> computer_searches_; // the searches are neither copyable nor movable
 
   private:
     VariantSubStage NewStage_();
@@ -210,6 +252,31 @@ class RoundStage : public SubGameStage<>
         StartTimer(GET_OPTION_VALUE(option(), 局时));
     }
 
+    virtual AtomReqErrCode OnComputerAct(const PlayerID pid, MsgSenderBase& reply) override
+    {
+        static constexpr const uint32_t k_lookahead_round_num = 4;
+        auto& search = main_stage().computer_searches_[pid];
+        if (search.is_running_.load(std::memory_order_acquire)) {
+            return StageErrCode::OK; // the computer will act again when the search is finished
+        }
+        if (search.round_ != main_stage().round()) {
+            search.round_ = main_stage().round();
+            search.state_.emplace(*main_stage().players_[pid].board_, card_, main_stage().RemainingCards(),
+                    k_lookahead_round_num, GET_OPTION_VALUE(option(), 模式));
+            search.is_running_.store(true, std::memory_order_relaxed);
+            match().RunComputerTask(&search, &MainStage::ComputerSearch::Run);
+            if (search.is_running_.load(std::memory_order_acquire)) {
+                return StageErrCode::OK;
+            }
+        }
+        const auto& move = search.best_move_;
+        if (!move.has_value() || !move->has_value()) {
+            return Pass_(pid, false, reply);
+        }
+        const std::string coor_str{static_cast<char>('A' + (*move)->first), static_cast<char>('1' + (*move)->second)};
+        return Set_(pid, false, reply, coor_str);
+    }
+
   private:
     CheckoutErrCode OnTimeout()
     {
@@ -42,6 +42,18 @@ GAME_TEST(2, one_finish)
     ASSERT_SCORE(0, 0);
 }
 
+GAME_TEST(2, computer_act)
+{
+    ASSERT_PUB_MSG(OK, 0, "种子 ABC");
+    ASSERT_PUB_MSG(OK, 0, "回合数 10");
+    ASSERT_TRUE(StartGame());
+    for (uint32_t i = 0; i < 10; ++i) {
+        ASSERT_PUB_MSG(OK, 0, "pass");
+        ASSERT_COMPUTER_ACT(CHECKOUT, 1);
+    }
+    ASSERT_FINISHED(true);
+}
+
 GAME_TEST(2, do_nothing)
 {
     ASSERT_PUB_MSG(OK, 0, "回合数 10");
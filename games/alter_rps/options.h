@@ -42,9 +42,9 @@ class CardChecker : public MsgArgChecker<Card>
             return std::nullopt;
         }
         const auto str = reader.NextArg();
-        const auto cut_prefix = [](const std::string& str, const std::string_view prefix)
+        const auto cut_prefix = [](const std::string_view str, const std::string_view prefix)
             {
-                return str.starts_with(prefix) ? str.substr(prefix.size()) : "";
+                return str.starts_with(prefix) ? str.substr(prefix.size()) : std::string_view();
             };
         std::optional<int> point = 0;
         if (const auto point_str = cut_prefix(str, "剪刀"); !point_str.empty() && (point = arith_checker_.Check(point_str)).has_value()) {
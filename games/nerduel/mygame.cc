@@ -5,6 +5,8 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
+#include <random>
 
 #include "game_framework/game_main.h"
 #include "game_framework/game_options.h"
@@ -142,12 +144,41 @@ class MainStage : public MainGameStage<SettingStage, GuessingStage> {
   bool JudgeOver();
   void Info_() {}
 
+  bool IsValidEquation(const std::string& str, std::string& err) const {
+    const bool standard = GET_OPTION_VALUE(option(), 游戏模式);
+    return (standard && EquationTable::Get(GET_OPTION_VALUE(option(), 等式长度)).Contains(str)) ||
+           check_equation(str, err, standard);
+  }
+
+  // The solver of the computer player |pid|, which is made when the computer acts for the first time.
+  EquationSolver& Solver(const PlayerID pid) {
+    auto& solver = solvers_[pid];
+    if (!solver.has_value()) {
+      solver.emplace(EquationTable::Get(GET_OPTION_VALUE(option(), 等式长度)));
+      for (const auto& [guess, feedback] : feedbacks_[pid]) {
+        solver->Filter(guess, feedback);
+      }
+    }
+    return *solver;
+  }
+
+  void AddFeedback(const PlayerID pid, const std::string& guess, const int a, const int b) {
+    const auto code = EquationCode::Pack(guess);
+    feedbacks_[pid].emplace_back(*code, make_feedback(a, b));
+    if (solvers_[pid].has_value()) {
+      solvers_[pid]->Filter(*code, make_feedback(a, b));
+    }
+  }
+
   bool ended_;
   MyTable table_;
   int turn_;
   std::vector<int64_t> score_;
   std::vector<std::string> target_;
   std::vector<std::string> history_;
+  std::array<std::vector<std::pair<EquationCode, Feedback>>, 2> feedbacks_;
+  std::array<std::optional<EquationSolver>, 2> solvers_;
+  std::mt19937 random_engine_{std::random_device{}()};
 };
 
 class SettingStage : public SubGameStage<> {
@@ -180,6 +211,12 @@ class SettingStage : public SubGameStage<> {
     return StageErrCode::OK;
   }
 
+  virtual AtomReqErrCode OnComputerAct(const PlayerID pid, MsgSenderBase& reply) override {
+    const auto& equations = EquationTable::Get(GET_OPTION_VALUE(option(), 等式长度)).Equations();
+    std::uniform_int_distribution<size_t> distribution(0, equations.size() - 1);
+    return Set_(pid, false, reply, equations[distribution(main_stage().random_engine_)].ToString());
+  }
+
  private:
   AtomReqErrCode Set_(const PlayerID pid, const bool is_public, MsgSenderBase& reply,
                       std::string str) {
@@ -193,7 +230,7 @@ class SettingStage : public SubGameStage<> {
       return StageErrCode::FAILED;
     }
     std::string err;
-    bool valid = check_equation(str, err, GET_OPTION_VALUE(option(), 游戏模式));
+    bool valid = main_stage().IsValidEquation(str, err);
     if (!valid) {
       reply() << "设置失败：" << err;
       return StageErrCode::FAILED;
@@ -231,6 +268,11 @@ class GuessingStage : public SubGameStage<> {
     return StageErrCode::CONTINUE;
   }
 
+  virtual AtomReqErrCode OnComputerAct(const PlayerID pid, MsgSenderBase& reply) override {
+    auto& main_stage = this->main_stage();
+    return Guess_(pid, false, reply, main_stage.Solver(pid).NextGuess(main_stage.random_engine_).ToString());
+  }
+
  private:
   AtomReqErrCode Guess_(const PlayerID pid, const bool is_public, MsgSenderBase& reply,
                         std::string str) {
@@ -244,13 +286,14 @@ class GuessingStage : public SubGameStage<> {
       return StageErrCode::FAILED;
     }
     std::string err;
-    bool valid = check_equation(str, err, GET_OPTION_VALUE(option(), 游戏模式));
+    bool valid = main_stage().IsValidEquation(str, err);
     if (!valid) {
       reply() << "猜测失败：" << err;
       return StageErrCode::FAILED;
     }
     SetReady(pid);
     auto [a, b] = get_a_b(str, main_stage().target_[pid]);
+    main_stage().AddFeedback(pid, str, a, b);
     main_stage().table_.SetEquation(str, pid, a, b);
     char tmp[128];
     sprintf(tmp, "%s %dA%dB\n", str.c_str(), a, b);
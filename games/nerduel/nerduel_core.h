@@ -1,13 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
 #include <string>
+#include <string_view>
+#include <vector>
 
 extern "C" {
 #include "tinyexpr.h"
 }
 
-std::pair<int, int> get_a_b(const std::string& guess, const std::string& target) {
+inline std::pair<int, int> get_a_b(const std::string& guess, const std::string& target) {
   if (guess.length() != target.length()) {
     return {0, 0};
   }
@@ -28,9 +37,9 @@ std::pair<int, int> get_a_b(const std::string& guess, const std::string& target)
   return {a, b};
 }
 
-double evaluate(const std::string& formula) { return te_interp(formula.c_str(), 0); }
+inline double evaluate(const std::string& formula) { return te_interp(formula.c_str(), 0); }
 
-bool check_equation(const std::string& formula, std::string& error, bool standard) {
+inline bool check_equation(const std::string& formula, std::string& error, bool standard) {
   int n = formula.length();
   int eq_pos = -1;
   for (int i = 0; i < n; i++) {
@@ -105,4 +114,235 @@ bool check_equation(const std::string& formula, std::string& error, bool standar
     return false;
   }
   return true;
-}
\ No newline at end of file
+}
+// ========== EQUATION TABLE ==========
+
+constexpr uint32_t k_min_equation_length = 5;
+constexpr uint32_t k_max_equation_length = 9;
+
+// The symbols are sorted by ASCII, and the code of a symbol is its index plus 1, so that the packed equations of the
+// same length are sorted in the same order as the strings.
+constexpr std::string_view k_equation_symbols = "*+-/0123456789=";
+
+// An equation packed with 4 bits per symbol, together with the number of each symbol (8 bits per symbol), which makes
+// the A/B feedback of two equations computable with a few bit operations.
+struct EquationCode {
+  static std::optional<EquationCode> Pack(const std::string_view str) {
+    if (str.empty() || str.length() > k_max_equation_length) {
+      return std::nullopt;
+    }
+    EquationCode code;
+    for (const char c : str) {
+      const auto index = k_equation_symbols.find(c);
+      if (index == std::string_view::npos) {
+        return std::nullopt;
+      }
+      code.symbols_ = (code.symbols_ << 4) | (index + 1);
+      code.counts_[index / 8] += uint64_t(1) << (index % 8 * 8);
+    }
+    return code;
+  }
+
+  std::string ToString() const {
+    std::string str;
+    for (uint64_t symbols = symbols_; symbols; symbols >>= 4) {
+      str += k_equation_symbols[(symbols & 0xF) - 1];
+    }
+    std::reverse(str.begin(), str.end());
+    return str;
+  }
+
+  bool operator<(const EquationCode& other) const { return symbols_ < other.symbols_; }
+  bool operator==(const EquationCode& other) const { return symbols_ == other.symbols_; }
+
+  uint64_t symbols_ = 0;
+  std::array<uint64_t, 2> counts_{0, 0};
+};
+
+// The feedback is encoded as A * 16 + B.
+using Feedback = uint32_t;
+
+inline Feedback make_feedback(const uint32_t a, const uint32_t b) { return a * 16 + b; }
+
+// Same as |get_a_b| for two equations of |length|.
+inline Feedback get_feedback(const EquationCode& guess, const EquationCode& target, const uint32_t length) {
+  // A: the number of zero nibbles of the xor value
+  const uint64_t diff = guess.symbols_ ^ target.symbols_;
+  const uint32_t a = length - std::popcount((diff | diff >> 1 | diff >> 2 | diff >> 3) & 0x1111111111111111ULL);
+  // A + B: the sum of the minimum count of each symbol
+  constexpr uint64_t k_high_bits = 0x8080808080808080ULL;
+  uint32_t common = 0;
+  for (uint32_t i = 0; i < 2; ++i) {
+    const uint64_t x = guess.counts_[i], y = target.counts_[i];
+    const uint64_t x_not_less = ((((x | k_high_bits) - y) & k_high_bits) >> 7) * 0xFF;
+    common += (((y & x_not_less) | (x & ~x_not_less)) * 0x0101010101010101ULL) >> 56;
+  }
+  return make_feedback(a, common - a);
+}
+
+// All the equations of a length which are valid in the standard mode, generated once and shared by all matches. The
+// left side is evaluated in the same order as tinyexpr, so the table is the same as the equations accepted by
+// |check_equation|.
+class EquationTable {
+ public:
+  // REQUIRE: |length| is in [k_min_equation_length, k_max_equation_length]
+  static const EquationTable& Get(const uint32_t length) {
+    static std::mutex mutex;
+    static std::array<std::unique_ptr<const EquationTable>, k_max_equation_length + 1> tables;
+    std::lock_guard<std::mutex> l(mutex);
+    auto& table = tables[length];
+    if (!table) {
+      table = std::make_unique<const EquationTable>(length);
+    }
+    return *table;
+  }
+
+  explicit EquationTable(const uint32_t length) : length_(length) {
+    char buffer[k_max_equation_length + 1] = {0};
+    // the right side has at least one digit
+    for (uint32_t left_length = 3; left_length + 2 <= length; ++left_length) {
+      GenerateLeft_(buffer, left_length, 0, 0, 0, 0, 0);
+    }
+    std::sort(equations_.begin(), equations_.end());
+  }
+
+  EquationTable(const EquationTable&) = delete;
+
+  uint32_t Length() const { return length_; }
+
+  const std::vector<EquationCode>& Equations() const { return equations_; }
+
+  bool Contains(const std::string_view str) const {
+    const auto code = EquationCode::Pack(str);
+    return str.length() == length_ && code.has_value() &&
+           std::binary_search(equations_.begin(), equations_.end(), *code);
+  }
+
+ private:
+  static double Apply_(const double x, const char op, const double y) {
+    switch (op) {
+      case '+': return x + y;
+      case '-': return x - y;
+      case '*': return x * y;
+      case '/': return x / y;
+      default: return y;  // no left operand
+    }
+  }
+
+  // Enumerate the numbers and operators from |pos| of the left side. The numbers have no leading zeros. |sum| is the
+  // value of the finished terms combined by |sum_op| with the current term, and |term| is the value of the factors of
+  // the current term combined by |term_op| with the next factor.
+  void GenerateLeft_(char* const buffer, const uint32_t left_length, const uint32_t pos, const double sum,
+                     const char sum_op, const double term, const char term_op) {
+    for (uint32_t digit_num = 1, min_value = 0, max_value = 10; pos + digit_num <= left_length;
+         ++digit_num, min_value = max_value, max_value *= 10) {
+      const uint32_t end = pos + digit_num;
+      const bool is_last = end == left_length;
+      if ((is_last && pos == 0) || (!is_last && end + 1 >= left_length)) {
+        continue;  // no operator, or no room for the next number
+      }
+      for (uint32_t value = min_value; value < max_value; ++value) {
+        for (uint32_t i = end, v = value; i > pos; --i, v /= 10) {
+          buffer[i - 1] = '0' + v % 10;
+        }
+        const double new_term = Apply_(term, term_op, value);
+        if (is_last) {
+          AddIfValid_(buffer, left_length, Apply_(sum, sum_op, new_term));
+          continue;
+        }
+        for (const char op : {'+', '-'}) {
+          buffer[end] = op;
+          GenerateLeft_(buffer, left_length, end + 1, Apply_(sum, sum_op, new_term), op, 0, 0);
+        }
+        for (const char op : {'*', '/'}) {
+          buffer[end] = op;
+          GenerateLeft_(buffer, left_length, end + 1, sum, sum_op, new_term, op);
+        }
+      }
+    }
+  }
+
+  void AddIfValid_(char* const buffer, const uint32_t left_length, const double value) {
+    if (!std::isfinite(value) || value < -1e-6) {
+      return;
+    }
+    const double right = std::round(value);
+    if (std::fabs(value - right) > 1e-6) {
+      return;
+    }
+    const uint32_t right_length = length_ - left_length - 1;
+    uint64_t right_value = right;
+    buffer[left_length] = '=';
+    for (uint32_t i = length_; i > left_length + 1; --i, right_value /= 10) {
+      buffer[i - 1] = '0' + right_value % 10;
+    }
+    if (right_value != 0 || (right_length > 1 && buffer[left_length + 1] == '0')) {
+      return;  // the number of digits of the right side does not match
+    }
+    equations_.emplace_back(*EquationCode::Pack(std::string_view(buffer, length_)));
+  }
+
+  const uint32_t length_;
+  std::vector<EquationCode> equations_;
+};
+
+// Keeps the equations consistent with the feedbacks of the previous guesses, and chooses the guess which splits them
+// into the smallest groups.
+class EquationSolver {
+ public:
+  static constexpr uint32_t k_guess_sample_num = 64;
+  static constexpr uint32_t k_target_sample_num = 1024;
+
+  explicit EquationSolver(const EquationTable& table) : table_(table), candidates_(table.Equations()) {}
+
+  void Filter(const EquationCode& guess, const Feedback feedback) {
+    const uint32_t length = table_.Length();
+    std::erase_if(candidates_, [&](const EquationCode& candidate) {
+      return get_feedback(guess, candidate, length) != feedback;
+    });
+  }
+
+  const std::vector<EquationCode>& Candidates() const { return candidates_; }
+
+  // Return: a candidate if there are only a few, otherwise the sampled guess with the minimum expected number of the
+  // remaining candidates. The target may be out of the table in the wild mode, in which case a random equation is
+  // returned when no candidates remain.
+  template <typename RandomEngine>
+  EquationCode NextGuess(RandomEngine& engine) const {
+    const auto& equations = candidates_.size() > 0 ? candidates_ : table_.Equations();
+    if (equations.size() <= 2) {
+      return equations.front();
+    }
+    std::vector<EquationCode> targets;
+    std::sample(candidates_.begin(), candidates_.end(), std::back_inserter(targets), k_target_sample_num, engine);
+    std::vector<EquationCode> guesses;
+    std::sample(candidates_.begin(), candidates_.end(), std::back_inserter(guesses), k_guess_sample_num / 2, engine);
+    std::sample(table_.Equations().begin(), table_.Equations().end(), std::back_inserter(guesses),
+                k_guess_sample_num / 2, engine);
+    const uint32_t length = table_.Length();
+    EquationCode best_guess = guesses.front();
+    uint64_t best_score = UINT64_MAX;
+    for (uint32_t i = 0; i < guesses.size(); ++i) {
+      std::array<uint32_t, 256> group_sizes{0};
+      for (const auto& target : targets) {
+        ++group_sizes[get_feedback(guesses[i], target, length)];
+      }
+      // the sum of squares is proportional to the expected group size, and the candidates are preferred because
+      // they may hit the target
+      uint64_t score = 0;
+      for (const uint32_t size : group_sizes) {
+        score += uint64_t(size) * size;
+      }
+      score = score * 2 + (i >= k_guess_sample_num / 2 || i >= candidates_.size());
+      if (score < best_score) {
+        best_score = score;
+        best_guess = guesses[i];
+      }
+    }
+    return best_guess;
+  }
+
+ private:
+  const EquationTable& table_;
+  std::vector<EquationCode> candidates_;
+};
@@ -2,7 +2,137 @@
 //
 // This source code is licensed under LGPLv2 (found in the LICENSE file).
 
+#include <chrono>
+#include <iostream>
+
 #include "game_framework/unittest_base.h"
+#include "nerduel_core.h"
+
+static std::string random_equation_string(std::mt19937& engine, const uint32_t length) {
+  std::uniform_int_distribution<size_t> distribution(0, k_equation_symbols.size() - 1);
+  std::string str;
+  for (uint32_t i = 0; i < length; ++i) {
+    str += k_equation_symbols[distribution(engine)];
+  }
+  return str;
+}
+
+GAME_TEST(2, computer_set_equations) {
+  ASSERT_TRUE(StartGame());
+  ASSERT_COMPUTER_ACT(OK, 0);
+  ASSERT_COMPUTER_ACT(CHECKOUT, 1);
+  ASSERT_PRI_MSG(FAILED, 0, "12+3=16");
+  ASSERT_PRI_MSG(OK, 0, "12+3=15");
+  ASSERT_COMPUTER_ACT(CHECKOUT, 1);
+  ASSERT_COMPUTER_ACT(OK, 0);
+}
+
+TEST(EquationTable, same_as_check_equation_for_all_strings) {
+  const auto& table = EquationTable::Get(5);
+  std::string str(5, ' ');
+  uint64_t valid_num = 0;
+  for (uint64_t i = 0; i < 759375; ++i) {  // 15 ^ 5
+    for (uint64_t j = 0, k = i; j < 5; ++j, k /= k_equation_symbols.size()) {
+      str[j] = k_equation_symbols[k % k_equation_symbols.size()];
+    }
+    std::string err;
+    const bool valid = check_equation(str, err, true);
+    ASSERT_EQ(valid, table.Contains(str)) << str;
+    valid_num += valid;
+  }
+  ASSERT_EQ(valid_num, table.Equations().size());
+}
+
+TEST(EquationTable, all_equations_are_valid) {
+  for (uint32_t length = k_min_equation_length; length <= 8; ++length) {
+    const auto& table = EquationTable::Get(length);
+    ASSERT_FALSE(table.Equations().empty());
+    for (const auto& equation : table.Equations()) {
+      std::string err;
+      ASSERT_TRUE(check_equation(equation.ToString(), err, true)) << equation.ToString() << " " << err;
+    }
+  }
+}
+
+TEST(EquationTable, contains) {
+  const auto& table = EquationTable::Get(7);
+  ASSERT_TRUE(table.Contains("12+3=15"));
+  ASSERT_TRUE(table.Contains("7/2*2=7"));
+  ASSERT_TRUE(table.Contains("0*999=0"));
+  ASSERT_FALSE(table.Contains("12+3=16"));
+  ASSERT_FALSE(table.Contains("012+3=15"));
+  ASSERT_FALSE(table.Contains("15=12+3"));
+  ASSERT_FALSE(table.Contains("-3+5=2"));
+  ASSERT_FALSE(table.Contains("1+1=2"));
+}
+
+TEST(EquationFeedback, same_as_get_a_b) {
+  std::mt19937 engine(0);
+  for (uint32_t i = 0; i < 100000; ++i) {
+    const uint32_t length = k_min_equation_length + i % (k_max_equation_length - k_min_equation_length + 1);
+    const auto guess = random_equation_string(engine, length);
+    const auto target = random_equation_string(engine, length);
+    const auto [a, b] = get_a_b(guess, target);
+    ASSERT_EQ(make_feedback(a, b), get_feedback(*EquationCode::Pack(guess), *EquationCode::Pack(target), length))
+        << guess << " " << target;
+  }
+}
+
+TEST(EquationSolver, find_target) {
+  std::mt19937 engine(0);
+  const auto& table = EquationTable::Get(7);
+  for (uint32_t i = 0; i < 20; ++i) {
+    const auto& target = table.Equations()[engine() % table.Equations().size()];
+    EquationSolver solver(table);
+    uint32_t guess_num = 0;
+    while (true) {
+      ASSERT_LT(guess_num++, 10) << target.ToString();
+      const auto guess = solver.NextGuess(engine);
+      const auto feedback = get_feedback(guess, target, 7);
+      if (feedback == make_feedback(7, 0)) {
+        break;
+      }
+      solver.Filter(guess, feedback);
+      ASSERT_FALSE(solver.Candidates().empty());
+    }
+  }
+}
+
+// Benchmark
+
+TEST(EquationSolver, benchmark_filter_candidates) {
+  std::mt19937 engine(0);
+  for (uint32_t length = k_min_equation_length; length <= k_max_equation_length; ++length) {
+    auto begin = std::chrono::steady_clock::now();
+    const auto& table = EquationTable::Get(length);
+    const auto generate_cost = std::chrono::steady_clock::now() - begin;
+
+    constexpr uint32_t k_filter_num = 100;
+    uint64_t candidate_num = 0;
+    begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < k_filter_num; ++i) {
+      EquationSolver solver(table);
+      const auto& guess = table.Equations()[engine() % table.Equations().size()];
+      const auto& target = table.Equations()[engine() % table.Equations().size()];
+      solver.Filter(guess, get_feedback(guess, target, length));
+      candidate_num += solver.Candidates().size();
+    }
+    const auto filter_cost = std::chrono::steady_clock::now() - begin;
+
+    begin = std::chrono::steady_clock::now();
+    EquationSolver(table).NextGuess(engine);
+    const auto guess_cost = std::chrono::steady_clock::now() - begin;
+
+    std::cout << "[BENCHMARK] length=" << length << " equations=" << table.Equations().size()
+              << " generate_ms=" << std::chrono::duration_cast<std::chrono::milliseconds>(generate_cost).count()
+              << " filter_ns_per_equation="
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(filter_cost).count() /
+                     double(k_filter_num * table.Equations().size())
+              << " remaining_candidates=" << candidate_num / k_filter_num
+              << " next_guess_us=" << std::chrono::duration_cast<std::chrono::microseconds>(guess_cost).count()
+              << std::endl;
+  }
+}
 
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
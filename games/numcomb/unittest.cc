@@ -66,6 +66,18 @@ GAME_TEST(2, timeout_hook)
     ASSERT_PUB_MSG(OK, 1, "2");
 }
 
+GAME_TEST(2, computer_place_by_solver)
+{
+    ASSERT_PUB_MSG(OK, 0, "种子 ABC");
+    ASSERT_TRUE(StartGame());
+    for (uint32_t i = 0; i < 20; ++i) {
+        ASSERT_PUB_MSG(OK, 0, std::to_string(i).c_str());
+        ASSERT_COMPUTER_ACT(CHECKOUT, 1);
+    }
+    ASSERT_FINISHED(true);
+    ASSERT_GT(expected_scores()->at(1), expected_scores()->at(0)); // the computer beats filling sequentially
+}
+
 int main(int argc, char** argv)
 {
     testing::InitGoogleTest(&argc, argv);
@@ -61,7 +61,7 @@ class MainStage : public MainGameStage<>
     {
         SetReady(1 - cur_pid());
         StartTimer(GET_OPTION_VALUE(option(), 局时));
-        Boardcast() << Markdown(ShowInfo_());
+        ShowInfo_(BoardcastMsgSender());
         Boardcast() << "请" << At(cur_pid()) << "行动，" << GET_OPTION_VALUE(option(), 局时)
                     << "秒未行动自动判负\n格式：移动前位置 移动后位置";
     }
@@ -89,6 +89,18 @@ class MainStage : public MainGameStage<>
         return scores_[pid];
     }
 
+  protected:
+    virtual bool OnCheckpoint(CheckpointWriter& writer) const override
+    {
+        writer.Write(first_turn_, board_, round_, scores_);
+        return true;
+    }
+
+    virtual bool OnRestore(CheckpointReader& reader) override
+    {
+        return reader.Read(first_turn_, board_, round_, scores_) && first_turn_ < 2;
+    }
+
   private:
     AtomReqErrCode Set_(const PlayerID pid, const bool is_public, MsgSenderBase& reply, const uint32_t src, const uint32_t dst)
     {
@@ -118,11 +130,22 @@ class MainStage : public MainGameStage<>
 
     AtomReqErrCode Info_(const PlayerID pid, const bool is_public, MsgSenderBase& reply)
     {
-        reply() << Markdown(ShowInfo_());
+        ShowInfo_(reply);
         return StageErrCode::OK;
     }
 
-    std::string ShowInfo_() const
+    void ShowInfo_(MsgSenderBase& reply) const
+    {
+        auto sender = reply();
+        if (!enable_markdown_to_image) {
+            sender << Markdown(InfoHtml_() + "\n\n" + board_.ToHtml()); // the board is not encoded when not sent
+            return;
+        }
+        sender << Markdown(InfoHtml_());
+        sender << Png{board_.ToImage().EncodePng()};
+    }
+
+    std::string InfoHtml_() const
     {
         std::string str = "## 第" + std::to_string(round_ / 2 + 1) + "回合\n\n";
         html::Table player_table(2, 4);
@@ -142,8 +165,6 @@ class MainStage : public MainGameStage<>
         print_player(0);
         print_player(1);
         str += player_table.ToString();
-        str += "\n\n";
-        str += board_.ToHtml();
         return str;
     }
 
@@ -151,15 +172,15 @@ class MainStage : public MainGameStage<>
     {
         const auto ret = board_.LineCount();
         if (ret[1 - static_cast<uint32_t>(cur_symbol())]) {
-            Boardcast() << Markdown(ShowInfo_());
+            ShowInfo_(BoardcastMsgSender());
             Boardcast() << At(cur_pid()) << "帮助对手达成了直线，于是，输掉了比赛";
             scores_[1 - cur_pid()] = 1;
         } else if (ret[static_cast<uint32_t>(cur_symbol())]) {
-            Boardcast() << Markdown(ShowInfo_());
+            ShowInfo_(BoardcastMsgSender());
             Boardcast() << At(cur_pid()) << "达成了直线，于是，赢得了比赛";
             scores_[cur_pid()] = 1;
         } else if ((++round_) / 2 >= GET_OPTION_VALUE(option(), 回合数)) {
-            Boardcast() << Markdown(ShowInfo_());
+            ShowInfo_(BoardcastMsgSender());
             const auto chess_counts = ChessCounts_();
             if (chess_counts[0] == chess_counts[1]) {
                 Boardcast() << "游戏达到最大回合数，双方棋子数量相同，游戏平局";
@@ -171,11 +192,11 @@ class MainStage : public MainGameStage<>
                 Boardcast() << "游戏达到最大回合数，玩家" << At(PlayerID(0)) << "棋子数量较少，于是，赢得了比赛";
             }
         } else if (!board_.CanPush(cur_type())) {
-            Boardcast() << Markdown(ShowInfo_());
+            ShowInfo_(BoardcastMsgSender());
             Boardcast() << At(cur_pid()) << "没有可取出的棋子，于是，输掉了比赛";
             scores_[1 - cur_pid()] = 1;
         } else {
-            Boardcast() << Markdown(ShowInfo_());
+            ShowInfo_(BoardcastMsgSender());
             ClearReady(cur_pid());
             StartTimer(GET_OPTION_VALUE(option(), 局时));
             Boardcast() << "请" << At(cur_pid()) << "行动，" << GET_OPTION_VALUE(option(), 局时)
@@ -214,7 +235,7 @@ class MainStage : public MainGameStage<>
         return chess_counts;
     }
 
-    const PlayerID first_turn_;
+    PlayerID first_turn_;
     quixo::Board board_;
     uint32_t round_;
     std::array<int32_t, 2> scores_;
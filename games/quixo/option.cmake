@@ -0,0 +1,6 @@
+target_link_libraries(quixo PNG::PNG)
+
+if (WITH_TEST)
+  target_link_libraries(test_game_quixo PNG::PNG)
+  target_link_libraries(run_game_quixo PNG::PNG)
+endif (WITH_TEST)
@@ -31,6 +31,37 @@ GAME_TEST(2, win_line)
     }
 }
 
+GAME_TEST(2, resume_from_checkpoint)
+{
+    bool first_hand = 0;
+    ASSERT_PUB_MSG(OK, 0, "模式 简单");
+    ASSERT_TRUE(StartGame());
+    if (const auto ret = PrivateRequest(0, "4 0"); ret == StageErrCode::FAILED) {
+        first_hand = 1;
+        ASSERT_PRI_MSG(CONTINUE, 1, "4 0");
+    } else {
+        first_hand = 0;
+        ASSERT_ERRCODE(StageErrCode::CONTINUE, ret);
+    }
+    ASSERT_PUB_MSG(CONTINUE, 1 - first_hand, "5 15");
+    ASSERT_CHECKPOINT_AND_RESTORE();
+    ASSERT_TRUE(timer_started_);
+    ASSERT_PUB_MSG(FAILED, 1 - first_hand, "5 15"); // not the turn
+    ASSERT_PUB_MSG(CONTINUE, first_hand, "4 0");
+    ASSERT_PUB_MSG(CONTINUE, 1 - first_hand, "5 15");
+    ASSERT_PUB_MSG(CONTINUE, first_hand, "4 0");
+    ASSERT_CHECKPOINT_AND_RESTORE();
+    ASSERT_PUB_MSG(CONTINUE, 1 - first_hand, "5 15");
+    ASSERT_PUB_MSG(CONTINUE, first_hand, "4 0");
+    ASSERT_PUB_MSG(CONTINUE, 1 - first_hand, "5 15");
+    ASSERT_PUB_MSG(CHECKOUT, first_hand, "4 0");
+    if (first_hand == 0) {
+        ASSERT_SCORE(1, 0);
+    } else {
+        ASSERT_SCORE(0, 1);
+    }
+}
+
 GAME_TEST(2, lose_opp_line)
 {
     bool first_hand = 0;
@@ -2,7 +2,9 @@
 //
 // This source code is licensed under LGPLv2 (found in the LICENSE file).
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <map>
 #include <functional>
 #include <memory>
@@ -15,6 +17,7 @@
 #include "utility/msg_checker.h"
 #include "utility/html.h"
 #include "game_util/renju.h"
+#include "game_util/mcts.h"
 
 const std::string k_game_name = "决胜五子";
 const uint64_t k_max_player = 2; /* 0 means no max-player limits */
@@ -24,6 +27,16 @@ const std::string k_description = "双方一起落子的五子棋游戏";
 
 using namespace renju;
 
+// The search runs in the background, so it uses only a few threads to leave the others to the other matches.
+static mcts::Options ComputerSearchOptions()
+{
+    return mcts::Options{
+        .thread_num_ = std::clamp(std::thread::hardware_concurrency(), 1U, 2U),
+        .time_budget_ = std::chrono::milliseconds(500),
+        .max_playout_depth_ = 40,
+    };
+}
+
 std::string GameOption::StatusInfo() const
 {
     return "每步时限 " + std::to_string(GET_VALUE(时限)) + " 秒，" +
@@ -74,15 +87,26 @@ class MainStage : public MainGameStage<>
             Boardcast() << "[注意] 本局为竞技模式，和棋时 pass 次数较多的玩家取得胜利";
         }
         StartTimer(GET_OPTION_VALUE(option(), 时限));
-        Boardcast() << Markdown(HtmlHead_() + board_.ToHtml());
+        ShowBoard_(BoardcastMsgSender());
         Boardcast() << "请私信裁判落子位置";
     }
 
     virtual AtomReqErrCode OnComputerAct(const PlayerID pid, MsgSenderBase& reply)
     {
-        do {
-            player_pos_[pid].emplace(rand() % Board::k_size_, rand() % Board::k_size_);
-        } while (!board_.CanBeSet(player_pos_[pid]->first, player_pos_[pid]->second));
+        auto& search = computer_searches_[pid];
+        if (search.is_running_.load(std::memory_order_acquire)) {
+            return StageErrCode::OK; // the computer will act again when the search is finished
+        }
+        if (search.round_ != round_) {
+            search.round_ = round_;
+            search.state_.emplace(board_, pid);
+            search.is_running_.store(true, std::memory_order_relaxed);
+            match().RunComputerTask(&search, &ComputerSearch::Run);
+            if (search.is_running_.load(std::memory_order_acquire)) {
+                return StageErrCode::OK;
+            }
+        }
+        player_pos_[pid] = search.best_move_;
         return StageErrCode::READY;
     }
 
@@ -150,15 +174,14 @@ class MainStage : public MainGameStage<>
             reply() << "落子成功，您在 " << static_cast<char>('A' + player_pos_[pid]->first) << player_pos_[pid]->second << " 位置落子";
             return StageErrCode::READY;
         }
-        reply() << Markdown(HtmlHead_() + board_.SetAndToHtml(player_pos_[pid]->first, player_pos_[pid]->second,
-                    pid == 0 ? AreaType::BLACK : AreaType::WHITE));
+        ShowBoard_(reply, pid);
         reply() << "选择位置成功，但是您还需要使用「落子」命令进行实际落子，落子前您可多次变更位置";
         return StageErrCode::OK;
     }
 
     AtomReqErrCode Info_(const PlayerID pid, const bool is_public, MsgSenderBase& reply)
     {
-        reply() << Markdown(HtmlHead_() + board_.ToHtml());
+        ShowBoard_(reply);
         return StageErrCode::OK;
     }
 
@@ -196,9 +219,26 @@ class MainStage : public MainGameStage<>
         return coor;
     }
 
+    // Show the board with the stone which |pid| is about to set if |pid| is given. The board is not encoded when the
+    // markdown is not converted to images.
+    void ShowBoard_(MsgSenderBase& reply, const std::optional<PlayerID> pid = std::nullopt)
+    {
+        auto sender = reply();
+        if (!enable_markdown_to_image) {
+            sender << Markdown(HtmlHead_() + (pid.has_value() ?
+                        board_.SetAndToHtml(player_pos_[*pid]->first, player_pos_[*pid]->second, Pid2Type_(*pid)) :
+                        board_.ToHtml()));
+            return;
+        }
+        sender << Markdown(HtmlHead_());
+        sender << Png{(pid.has_value() ?
+                board_.SetAndToImage(player_pos_[*pid]->first, player_pos_[*pid]->second, Pid2Type_(*pid)) :
+                board_.ToImage()).EncodePng()};
+    }
+
     std::string HtmlHead_() const
     {
-        std::string str = "## 第 " + std::to_string(round_ + 1);
+        std::string str = "<style>html,body{color:#6b421d; background:#d8bf81;}</style>\n\n## 第 " + std::to_string(round_ + 1);
         if (GET_OPTION_VALUE(option(), 回合上限) > 0) {
             str += " / " + std::to_string(GET_OPTION_VALUE(option(), 回合上限));
         }
@@ -264,7 +304,7 @@ class MainStage : public MainGameStage<>
         last_last_round_both_passed_ = last_round_both_passed_;
         last_round_both_passed_ = last_round_passed_[0] && last_round_passed_[1];
         crash_count_ += (last_round_crashed_ = (ret == Result::CONTINUE_CRASH || last_round_both_passed_)) && extended_;
-        reply() << Markdown(HtmlHead_() + board_.ToHtml());
+        ShowBoard_(reply);
         auto sender = reply();
         bool is_over = true;
         if (ret == Result::WIN_BLACK) {
@@ -342,6 +382,26 @@ class MainStage : public MainGameStage<>
     bool last_round_crashed_;
     std::array<int32_t, 2> pass_count_;
     std::optional<PlayerID> winner_;
+
+    // The search of a computer runs without the lock of the match, and the result is taken when the computer acts again.
+    struct ComputerSearch
+    {
+        ComputerSearch() : searcher_(ComputerSearchOptions()) {}
+
+        static void Run(void* const p)
+        {
+            auto& search = *static_cast<ComputerSearch*>(p);
+            search.best_move_ = search.searcher_.Search(*search.state_).best_move_;
+            search.is_running_.store(false, std::memory_order_release);
+        }
+
+        mcts::Searcher<MctsState> searcher_;
+        std::optional<uint32_t> round_; // the round which |best_move_| is searched for
+        std::optional<MctsState> state_;
+        std::optional<MctsState::Move> best_move_;
+        std::atomic<bool> is_running_ = false;
+    };
+    std::array<ComputerSearch, 2> computer_searches_;
 };
 
 MainStageBase* MakeMainStage(MsgSenderBase& reply, GameOption& options, MatchBase& match)
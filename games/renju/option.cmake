@@ -0,0 +1,6 @@
+target_link_libraries(renju PNG::PNG)
+
+if (WITH_TEST)
+  target_link_libraries(test_game_renju PNG::PNG)
+  target_link_libraries(run_game_renju PNG::PNG)
+endif (WITH_TEST)
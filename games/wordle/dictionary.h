@@ -0,0 +1,164 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wordle {
+
+// A read-only word list loaded from a word file. Each word is packed into an integer with 5 bits per letter, so that
+// the words of the same length are sorted as integers and the membership is checked by an open-addressing hash table.
+// The word lists are cached for the whole module, so all matches share them without parsing the files again.
+class WordList
+{
+  public:
+    static constexpr uint32_t k_max_length = 8;
+
+    using Word = uint64_t;
+
+    // Return: the cached word list, or nullptr if the file cannot be read
+    static std::shared_ptr<const WordList> Get(const std::string& path)
+    {
+        static std::mutex mutex;
+        static std::map<std::string, std::shared_ptr<const WordList>> word_lists;
+        std::lock_guard<std::mutex> l(mutex);
+        auto& word_list = word_lists[path];
+        if (!word_list) {
+            word_list = Load(path); // failures are not cached so that the file can be fixed without restarting
+        }
+        return word_list;
+    }
+
+    // Return: the word list, or nullptr if the file cannot be read
+    static std::shared_ptr<const WordList> Load(const std::string& path)
+    {
+        std::ifstream f(path, std::ios::binary);
+        if (!f) {
+            return nullptr;
+        }
+        std::ostringstream ss;
+        ss << f.rdbuf();
+        return std::make_shared<const WordList>(ss.str());
+    }
+
+    // The words are separated by whitespaces. The words which are too long or contain characters other than lowercase
+    // letters are ignored.
+    explicit WordList(const std::string_view text)
+    {
+        for (size_t begin = 0, end = 0; begin < text.size(); begin = end + 1) {
+            end = std::min(text.find_first_of(" \t\r\n", begin), text.size());
+            if (const auto word = Pack(text.substr(begin, end - begin)); word != 0) {
+                buckets_[end - begin].words_.emplace_back(word);
+            }
+        }
+        for (auto& bucket : buckets_) {
+            bucket.Build();
+        }
+    }
+
+    WordList(const WordList&) = delete;
+
+    bool Contains(const std::string_view word) const
+    {
+        const Word packed = Pack(word);
+        return packed != 0 && buckets_[word.size()].Contains(packed);
+    }
+
+    uint64_t Size(const uint32_t length) const { return length <= k_max_length ? buckets_[length].words_.size() : 0; }
+
+    // The packed words of |length| in lexicographical order.
+    const std::vector<Word>& Words(const uint32_t length) const { return buckets_[length].words_; }
+
+    std::string At(const uint32_t length, const uint64_t index) const { return Unpack(buckets_[length].words_[index]); }
+
+    // Return: 0 if |word| is empty, too long or contains characters other than lowercase letters
+    static Word Pack(const std::string_view word)
+    {
+        if (word.empty() || word.size() > k_max_length) {
+            return 0;
+        }
+        Word packed = 0;
+        for (const char c : word) {
+            if (c < 'a' || c > 'z') {
+                return 0;
+            }
+            packed = (packed << k_letter_bits) | (c - 'a' + 1);
+        }
+        return packed;
+    }
+
+    static std::string Unpack(Word word)
+    {
+        std::string str;
+        for (; word != 0; word >>= k_letter_bits) {
+            str += static_cast<char>('a' + (word & k_letter_mask) - 1);
+        }
+        std::reverse(str.begin(), str.end());
+        return str;
+    }
+
+    // Return: the number of positions at which the letters of the two words of the same length are the same
+    static uint32_t SameLetterNum(const Word a, const Word b, const uint32_t length)
+    {
+        uint32_t num = 0;
+        for (Word diff = a ^ b, i = 0; i < length; ++i, diff >>= k_letter_bits) {
+            num += (diff & k_letter_mask) == 0;
+        }
+        return num;
+    }
+
+  private:
+    static constexpr uint32_t k_letter_bits = 5;
+    static constexpr Word k_letter_mask = (1 << k_letter_bits) - 1;
+
+    struct Bucket
+    {
+        void Build()
+        {
+            std::sort(words_.begin(), words_.end());
+            words_.erase(std::unique(words_.begin(), words_.end()), words_.end());
+            uint64_t size = 1;
+            while (size < words_.size() * 2) {
+                size <<= 1;
+            }
+            table_.assign(size, 0); // 0 is never a packed word, so it marks an empty slot
+            for (const Word word : words_) {
+                uint64_t i = Hash(word);
+                while (table_[i] != 0) {
+                    i = (i + 1) & (table_.size() - 1);
+                }
+                table_[i] = word;
+            }
+        }
+
+        bool Contains(const Word word) const
+        {
+            for (uint64_t i = Hash(word); table_[i] != 0; i = (i + 1) & (table_.size() - 1)) {
+                if (table_[i] == word) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint64_t Hash(const Word word) const { return (word * 0x9E3779B97F4A7C15ULL >> 17) & (table_.size() - 1); }
+
+        std::vector<Word> words_;
+        std::vector<Word> table_; // at most half full
+    };
+
+    std::array<Bucket, k_max_length + 1> buckets_;
+};
+
+} // namespace wordle
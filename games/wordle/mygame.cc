@@ -17,6 +17,7 @@
 #include "game_framework/game_achievements.h"
 #include "utility/msg_checker.h"
 #include "utility/html.h"
+#include "dictionary.h"
 
 using namespace std;
 
@@ -26,21 +27,6 @@ const uint64_t k_multiple = 0; // the default score multiple for the game, 0 for
 const std::string k_developer = "睦月";
 const std::string k_description = "猜测英文单词的游戏";
 
-// Give it 2 strings, returns how many letters are the same.
-int cmpString(string a,string b)
-{
-    if(a.length() != b.length()) return -1;
-
-    int n = a.length();
-    int ret = 0;
-    for(int i = 0; i < n; i++)
-    {
-        if(a[i] == b[i])
-            ret++;
-    }
-    return ret;
-}
-
 // Give it two srtrings, it returns you the wordle result. E.g. abcd and acbe returns 2110.
 string cmpWordle(string a,string b)
 {
@@ -142,8 +128,16 @@ class MainStage : public MainGameStage<RoundStage>
      * The initial of (All words), (gameEnd) is in function -> OnStageBegin()
      */
 
-    // All words
-    set<string> wordList[10];
+    // The words to be chosen, which are shared by all matches
+    shared_ptr<const wordle::WordList> answerWords;
+
+    // The extra words which can be guessed besides |answerWords|, nullptr if there are no extra words
+    shared_ptr<const wordle::WordList> extraWords;
+
+    bool IsValidWord(const string& word) const
+    {
+        return (answerWords && answerWords->Contains(word)) || (extraWords && extraWords->Contains(word));
+    }
 
     // check if game ends.
     bool gameEnd;
@@ -521,7 +515,7 @@ class RoundStage : public SubGameStage<>
         }
 
 
-        if(main_stage().wordList[l].find(submission) == main_stage().wordList[l].end()) {
+        if(!main_stage().IsValidWord(submission)) {
             reply() << "[错误] 这不是一个有效的单词。";
             return StageErrCode::FAILED;
         }
@@ -555,45 +549,16 @@ MainStage::VariantSubStage MainStage::OnStageBegin()
     player_used_[0] = "00000000000000000000000000+";
     player_used_[1] = "00000000000000000000000000+";
 
-    // 1. Read all given words.
-    FILE *fp=fopen((string(option().ResourceDir())+("words.txt")).c_str(),"r");
-    if(fp == NULL)
+    // 1. Get the word lists, which are loaded only once by the module.
+    int hard = GET_OPTION_VALUE(option(), 高难);
+    answerWords = wordle::WordList::Get(string(option().ResourceDir()) + (hard == 1 ? "wordsGuess.txt" : "words.txt"));
+    if(answerWords == nullptr)
     {
-        Boardcast() << "[错误] 单词列表不存在。(W)";
+        Boardcast() << (hard == 1 ? "[错误] 单词列表不存在。(GH)" : "[错误] 单词列表不存在。(W)");
         gameEnd = 1;
         return make_unique<RoundStage>(*this, ++round_);
     }
 
-    int hard = GET_OPTION_VALUE(option(), 高难);
-    if(hard == 1)
-    {
-        fclose(fp);
-        fp = fopen((string(option().ResourceDir())+("wordsGuess.txt")).c_str(),"r");
-        if(fp == NULL)
-        {
-            Boardcast() << "[错误] 单词列表不存在。(GH)";
-            gameEnd = 1;
-            return make_unique<RoundStage>(*this, ++round_);
-        }
-    }
-
-    char word[50];
-    while(fscanf(fp, "%s", word) != EOF)
-    {
-        string addS = "";
-        int len = strlen(word);
-
-        if(len < 5 || len > 8) continue;
-
-        for(int i = 0; i < len; i++)
-        {
-            addS += word[i];
-        }
-
-        wordList[len].insert(addS);
-    }
-    fclose(fp);
-
 
 
     // 2. Choose random words for players
@@ -623,27 +588,22 @@ MainStage::VariantSubStage MainStage::OnStageBegin()
         int r1,r2,n2;
 
 
-        if(wordList[l].size()==0)
+        const auto& words = answerWords->Words(l);
+
+        if(words.size()==0)
             continue;
 
-        r1=rand()%wordList[l].size();
+        r1=rand()%words.size();
 
         // random select a word or player 0
-        for(auto v:wordList[l])
-        {
-            if(r1==0)
-            {
-                s1=v;
-                break;
-            }
-            r1--;
-        }
+        const wordle::WordList::Word w1 = words[r1];
+        s1 = wordle::WordList::Unpack(w1);
 
         n2 = 0;
-        for(auto v:wordList[l])
+        for(auto v:words)
         {
-            int same=cmpString(v,s1);
-            if(same != -1 && same != 0 && same != l)
+            int same=wordle::WordList::SameLetterNum(v,w1,l);
+            if(same != 0 && same != l)
             {
                 n2++;
             }
@@ -659,15 +619,15 @@ MainStage::VariantSubStage MainStage::OnStageBegin()
         // find a correct s2 for s1
         r2 = rand()%n2;
         r2++;
-        for(auto v:wordList[l])
+        for(auto v:words)
         {
-            int same=cmpString(v,s1);
+            int same=wordle::WordList::SameLetterNum(v,w1,l);
             if(same > 0 && same != l)
             {
                 r2--;
                 if(r2 == 0)
                 {
-                    s2 = v;
+                    s2 = wordle::WordList::Unpack(v);
                     break;
                 }
             }
@@ -713,30 +673,13 @@ MainStage::VariantSubStage MainStage::OnStageBegin()
     // 5. extend wordlist
     if(hard == 0)
     {
-        fp = fopen((string(option().ResourceDir())+("wordsGuess.txt")).c_str(),"r");
-        if(fp == NULL)
+        extraWords = wordle::WordList::Get(string(option().ResourceDir()) + "wordsGuess.txt");
+        if(extraWords == nullptr)
         {
             Boardcast() << "[错误] 单词列表不存在。(G)";
             gameEnd = 1;
             return make_unique<RoundStage>(*this, ++round_);
         }
-
-    //    char word[50];
-        while(fscanf(fp, "%s", word) != EOF)
-        {
-            string addS = "";
-            int len = strlen(word);
-
-            if(len < 4 || len > 8) continue;
-
-            for(int i = 0; i < len; i++)
-            {
-                addS += word[i];
-            }
-
-            wordList[len].insert(addS);
-        }
-        fclose(fp);
     }
 
 
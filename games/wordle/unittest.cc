@@ -2,7 +2,11 @@
 //
 // This source code is licensed under LGPLv2 (found in the LICENSE file).
 
+#include <chrono>
+#include <iostream>
+
 #include "game_framework/unittest_base.h"
+#include "dictionary.h"
 
 // The first parameter is player number. It is a one-player game test.
 GAME_TEST(1, player_not_enough)
@@ -10,7 +14,65 @@ GAME_TEST(1, player_not_enough)
     ASSERT_FALSE(StartGame()); // according to |GameOption::ToValid|, the mininum player number is 3
 }
 
+TEST(WordList, pack_and_check_words)
+{
+    const wordle::WordList word_list("about  ability\nzebra\r\nAbout ab1de toolongword\n");
+    ASSERT_TRUE(word_list.Contains("about"));
+    ASSERT_TRUE(word_list.Contains("ability"));
+    ASSERT_TRUE(word_list.Contains("zebra"));
+    ASSERT_FALSE(word_list.Contains("About"));
+    ASSERT_FALSE(word_list.Contains("ab1de"));
+    ASSERT_FALSE(word_list.Contains("toolongword"));
+    ASSERT_FALSE(word_list.Contains("abou"));
+    ASSERT_FALSE(word_list.Contains(""));
+    ASSERT_EQ(2, word_list.Size(5));
+    ASSERT_EQ("about", word_list.At(5, 0));
+    ASSERT_EQ("zebra", word_list.At(5, 1));
+    ASSERT_EQ(1, word_list.Size(7));
+    ASSERT_EQ(0, word_list.Size(6));
+    ASSERT_EQ(4, wordle::WordList::SameLetterNum(wordle::WordList::Pack("about"), wordle::WordList::Pack("abort"), 5));
+}
+
+GAME_TEST(2, reject_invalid_word)
+{
+    ASSERT_PUB_MSG(OK, 0, "长度 5");
+    ASSERT_TRUE(StartGame());
+    ASSERT_PRI_MSG(FAILED, 0, "abcde");
+    ASSERT_PRI_MSG(FAILED, 0, "abou");
+    ASSERT_PRI_MSG(OK, 0, "about");
+    ASSERT_PRI_MSG(CHECKOUT, 1, "aahed"); // only in the extended word list
+}
+
+GAME_TEST(2, reject_invalid_word_in_hard_mode)
+{
+    ASSERT_PUB_MSG(OK, 0, "长度 5");
+    ASSERT_PUB_MSG(OK, 0, "高难 1");
+    ASSERT_TRUE(StartGame());
+    ASSERT_PRI_MSG(FAILED, 0, "abcde");
+    ASSERT_PRI_MSG(OK, 0, "aahed");
+}
 
+// Benchmark
+
+GAME_TEST(2, benchmark_start_game)
+{
+    const std::string path = std::string(option_.ResourceDir()) + "wordsGuess.txt";
+    auto begin = std::chrono::steady_clock::now();
+    ASSERT_NE(nullptr, wordle::WordList::Load(path));
+    const auto load_cost = std::chrono::steady_clock::now() - begin;
+
+    constexpr uint32_t k_start_num = 100;
+    begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < k_start_num; ++i) {
+        ASSERT_TRUE(StartGame());
+    }
+    const auto start_cost = std::chrono::steady_clock::now() - begin;
+
+    std::cout << "[BENCHMARK] load_word_list_us="
+              << std::chrono::duration_cast<std::chrono::microseconds>(load_cost).count()
+              << " start_game_us=" << std::chrono::duration_cast<std::chrono::microseconds>(start_cost).count() / k_start_num
+              << std::endl;
+}
 
 int main(int argc, char** argv)
 {
@@ -7,11 +7,13 @@
 #include <iostream>
 #include <map>
 
+#include "bot_core/db_manager.h"
 #include "bot_core/score_calculation.h"
 
 #include "sqlite_modern_cpp.h"
 
 DEFINE_string(db_path, "", "The path of db file");
+DEFINE_bool(only_rebuild_score_summary, false, "Only rebuild the score summary for ranks without recalculating the scores");
 
 struct GameHistory
 {
@@ -104,16 +106,21 @@ int main(int argc, char** argv)
         std::map<UserID, UserHistoryInfo> user_history_infos;
         sqlite::database db(FLAGS_db_path);
         db << "BEGIN;";
-        db << "SELECT match_id, game_name, multiple from match;"
-           >> [&](const uint64_t match_id, const std::string& game_name, const uint32_t multiple)
-                {
-                    auto user_infos = LoadMatch(db, match_id, game_name, user_history_infos);
-                    if (user_infos.size() > 1) {
-                        const auto score_infos = CalScores(user_infos, multiple);
-                        UpdateMatchScore(db, match_id, score_infos);
-                        UpdateUserHistoryInfo(game_name, score_infos, user_history_infos);
-                    }
-                };
+        if (!FLAGS_only_rebuild_score_summary) {
+            db << "SELECT match_id, game_name, multiple from match;"
+               >> [&](const uint64_t match_id, const std::string& game_name, const uint32_t multiple)
+                    {
+                        auto user_infos = LoadMatch(db, match_id, game_name, user_history_infos);
+                        if (user_infos.size() > 1) {
+                            const auto score_infos = CalScores(user_infos, multiple);
+                            UpdateMatchScore(db, match_id, score_infos);
+                            UpdateUserHistoryInfo(game_name, score_infos, user_history_infos);
+                        }
+                    };
+        }
+        // the summary is summed up from the scores of matches, so it should be rebuilt after the scores are updated
+        RebuildScoreSummary(db);
+        std::cout << "Rebuild score summary finished" << std::endl;
         db << "COMMIT;";
     } catch (const sqlite::sqlite_exception& e) {
         std::cerr << "[ERROR] DB error " << e.get_code() << ": " << e.what() << ", during " << e.get_sql() << std::endl;
@@ -0,0 +1,272 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#pragma once
+
+#include <charconv>
+#include <concepts>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// The checkpoint is a sequence of tokens, each of which is written as "<size>:<bytes>". The numbers are written in
+// decimal, so the checkpoint is readable, and the strings can contain any characters.
+//
+// Supported types:
+// - arithmetic types, enums, and the ids which can be converted from and to uint64_t
+// - strings, and the ids which can be converted from and to std::string
+// - std::optional, the tuple-like types (std::pair, std::tuple, std::array) and the ranges (std::vector, std::map...)
+// - random engines, which are written by their stream operators, so that the random sequences are resumed
+// - the classes with member functions |void Checkpoint(CheckpointWriter&) const| and |bool Restore(CheckpointReader&)|
+
+class CheckpointWriter;
+class CheckpointReader;
+
+namespace checkpoint_internal {
+
+template <typename T>
+concept HasMemberHooks = requires(const T& c_value, T& value, CheckpointWriter& writer, CheckpointReader& reader)
+{
+    c_value.Checkpoint(writer);
+    { value.Restore(reader) } -> std::same_as<bool>;
+};
+
+template <typename T>
+concept IsIntegerID = !std::is_arithmetic_v<T> && !std::is_enum_v<T> && std::convertible_to<T, uint64_t> &&
+                      std::constructible_from<T, uint64_t>;
+
+template <typename T>
+concept IsStringLike = std::convertible_to<const T&, std::string> && std::constructible_from<T, std::string>;
+
+template <typename T>
+struct IsOptional : std::false_type {};
+
+template <typename T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+concept IsRandomEngine = std::uniform_random_bit_generator<T> && requires(std::ostream& os, std::istream& is, T& engine)
+{
+    os << engine;
+    is >> engine;
+};
+
+template <typename T>
+concept IsTupleLike = requires { std::tuple_size<T>::value; };
+
+// The element type which can be read into, e.g., std::pair<K, V> rather than std::pair<const K, V> for maps.
+template <typename T>
+struct ReadableElement { using type = std::ranges::range_value_t<T>; };
+
+template <typename T> requires requires { typename T::key_type; typename T::mapped_type; }
+struct ReadableElement<T> { using type = std::pair<typename T::key_type, typename T::mapped_type>; };
+
+}
+
+class CheckpointWriter
+{
+  public:
+    template <typename ...Ts>
+    CheckpointWriter& Write(const Ts& ...values)
+    {
+        (Write_(values), ...);
+        return *this;
+    }
+
+    const std::string& Str() const { return str_; }
+
+  private:
+    template <typename T>
+    void Write_(const T& value)
+    {
+        using namespace checkpoint_internal;
+        if constexpr (HasMemberHooks<T>) {
+            value.Checkpoint(*this);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            WriteToken_(value ? "1" : "0");
+        } else if constexpr (std::is_floating_point_v<T>) {
+            // std::to_chars for the floating-point types is not provided by libstdc++ 10
+            char buf[64];
+            const int size = std::snprintf(buf, sizeof(buf), "%.*Lg", std::numeric_limits<T>::max_digits10,
+                    static_cast<long double>(value));
+            WriteToken_(std::string_view(buf, size));
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            char buf[64];
+            const auto [end, ec] = std::to_chars(std::begin(buf), std::end(buf), value);
+            WriteToken_(std::string_view(buf, end));
+        } else if constexpr (std::is_enum_v<T>) {
+            Write_(static_cast<std::underlying_type_t<T>>(value));
+        } else if constexpr (IsIntegerID<T>) {
+            Write_(static_cast<uint64_t>(value));
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            WriteToken_(value);
+        } else if constexpr (IsStringLike<T>) {
+            WriteToken_(static_cast<std::string>(value));
+        } else if constexpr (IsOptional<T>::value) {
+            Write_(value.has_value());
+            if (value.has_value()) {
+                Write_(*value);
+            }
+        } else if constexpr (IsRandomEngine<T>) {
+            std::ostringstream ss;
+            ss << value;
+            WriteToken_(ss.str());
+        } else if constexpr (IsTupleLike<T>) {
+            std::apply([this](const auto& ...elements) { (Write_(elements), ...); }, value);
+        } else if constexpr (std::ranges::sized_range<const T>) {
+            Write_(static_cast<uint64_t>(std::ranges::size(value)));
+            for (const auto& element : value) {
+                Write_<std::ranges::range_value_t<T>>(element); // convert the proxies of std::vector<bool>
+            }
+        } else {
+            static_assert(!std::is_same_v<T, T>, "the type cannot be written into checkpoints");
+        }
+    }
+
+    void WriteToken_(const std::string_view token)
+    {
+        str_ += std::to_string(token.size());
+        str_ += ':';
+        str_ += token;
+    }
+
+    std::string str_;
+};
+
+class CheckpointReader
+{
+  public:
+    explicit CheckpointReader(const std::string_view str) : str_(str) {}
+
+    // Return false if the checkpoint is broken or does not match the types. The values may be partially read in this
+    // case, so they should be discarded.
+    template <typename ...Ts>
+    bool Read(Ts& ...values)
+    {
+        return (Read_(values) && ...);
+    }
+
+    bool IsEnd() const { return str_.empty(); }
+
+  private:
+    template <typename T>
+    bool Read_(T& value)
+    {
+        using namespace checkpoint_internal;
+        if constexpr (HasMemberHooks<T>) {
+            return value.Restore(*this);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            const auto token = ReadToken_();
+            if (!token.has_value() || (*token != "0" && *token != "1")) {
+                return false;
+            }
+            value = *token == "1";
+            return true;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            const auto token = ReadToken_();
+            if (!token.has_value() || token->empty()) {
+                return false;
+            }
+            const std::string str(*token); // strtold requires a null-terminated string
+            char* end = nullptr;
+            const long double result = std::strtold(str.c_str(), &end);
+            if (end != str.c_str() + str.size()) {
+                return false;
+            }
+            value = static_cast<T>(result);
+            return true;
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            const auto token = ReadToken_();
+            if (!token.has_value()) {
+                return false;
+            }
+            const auto [end, ec] = std::from_chars(token->data(), token->data() + token->size(), value);
+            return ec == std::errc() && end == token->data() + token->size();
+        } else if constexpr (std::is_enum_v<T>) {
+            std::underlying_type_t<T> underlying_value;
+            if (!Read_(underlying_value)) {
+                return false;
+            }
+            value = static_cast<T>(underlying_value);
+            return true;
+        } else if constexpr (IsIntegerID<T>) {
+            uint64_t id = 0;
+            if (!Read_(id)) {
+                return false;
+            }
+            value = T(id);
+            return true;
+        } else if constexpr (IsStringLike<T>) {
+            const auto token = ReadToken_();
+            if (!token.has_value()) {
+                return false;
+            }
+            value = T(std::string(*token));
+            return true;
+        } else if constexpr (IsOptional<T>::value) {
+            bool has_value = false;
+            if (!Read_(has_value)) {
+                return false;
+            }
+            if (!has_value) {
+                value.reset();
+                return true;
+            }
+            return Read_(value.emplace());
+        } else if constexpr (IsRandomEngine<T>) {
+            const auto token = ReadToken_();
+            if (!token.has_value()) {
+                return false;
+            }
+            std::istringstream ss{std::string(*token)};
+            ss >> value;
+            return !ss.fail();
+        } else if constexpr (IsTupleLike<T>) {
+            return std::apply([this](auto& ...elements) { return (Read_(elements) && ...); }, value);
+        } else if constexpr (std::ranges::sized_range<const T>) {
+            uint64_t size = 0;
+            if (!Read_(size) || size > str_.size()) { // each element takes at least 2 characters
+                return false;
+            }
+            value.clear();
+            for (uint64_t i = 0; i < size; ++i) {
+                typename ReadableElement<T>::type element;
+                if (!Read_(element)) {
+                    return false;
+                }
+                value.insert(value.end(), std::move(element));
+            }
+            return true;
+        } else {
+            static_assert(!std::is_same_v<T, T>, "the type cannot be read from checkpoints");
+        }
+    }
+
+    std::optional<std::string_view> ReadToken_()
+    {
+        const auto colon_pos = str_.find(':');
+        if (colon_pos == std::string_view::npos) {
+            return std::nullopt;
+        }
+        uint64_t size = 0;
+        const auto [end, ec] = std::from_chars(str_.data(), str_.data() + colon_pos, size);
+        if (ec != std::errc() || end != str_.data() + colon_pos || str_.size() - colon_pos - 1 < size) {
+            return std::nullopt;
+        }
+        const auto token = str_.substr(colon_pos + 1, size);
+        str_.remove_prefix(colon_pos + 1 + size);
+        return token;
+    }
+
+    std::string_view str_;
+};
@@ -5,6 +5,7 @@
 #ifdef ENUM_FILE
 
 #include <string>
+#include <string_view>
 #include <array>
 #include <optional>
 #include <map>
@@ -75,7 +76,7 @@ class name \
 \
     inline static const std::map<std::string, name>& ParseMap(); \
 \
-    inline static std::optional<name> Parse(const std::string& str); \
+    inline static std::optional<name> Parse(const std::string_view str); \
 \
     constexpr static name Condition(const bool cond, const name _1, const name _2) { return cond ? _1 : _2; } \
 \
@@ -195,10 +196,11 @@ inline const std::map<std::string, name>& name::ParseMap() \
 #undef ENUM_END
 
 #define ENUM_BEGIN(name) \
-inline std::optional<name> name::Parse(const std::string& str) \
+inline std::optional<name> name::Parse(const std::string_view str) \
 { \
-    const auto it = ParseMap().find(str); \
-    if (it == ParseMap().end()) { \
+    static const std::map<std::string, name, std::less<>> parser(ParseMap().begin(), ParseMap().end()); \
+    const auto it = parser.find(str); \
+    if (it == parser.end()) { \
         return std::nullopt; \
     } \
     return it->second; \
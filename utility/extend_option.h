@@ -95,6 +95,18 @@ class OPTION_CLASSNAME
         return false;
     }
 
+    // Return the command which sets the option to its current value, e.g., "局时 120".
+    std::string OptionCommand(const uint64_t index) const
+    {
+#define EXTEND_OPTION(_0, name, _1, _2) \
+        if (index == OPTION_(name)) { \
+            return #name " " + CHECKER_(name).ArgString(VALUE_(name)); \
+        }
+#include OPTION_FILENAME
+#undef EXTEND_OPTION
+        return "";
+    }
+
     constexpr uint32_t Count() const { return Option::MAX_OPTION; }
     const char* Info(const uint64_t index) const { return infos_[index].c_str(); }
     const char* ColoredInfo(const uint64_t index) const { return colored_infos_[index].c_str(); }
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <array>
 #include <functional>
 #include <iostream>
 #include <map>
@@ -11,7 +12,9 @@
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 #include <sstream>
 #include <bitset>
@@ -21,35 +24,98 @@
 
 // TODO: check callback parameters
 
+// Splits the message into arguments once, keeping views over the message instead of copying the arguments. The
+// arguments are separated by ASCII whitespaces, the ideographic space (U+3000) or the no-break space (U+00A0) in UTF-8.
+// The message should outlive the reader.
 class MsgReader final
 {
    public:
-    MsgReader(const std::string& msg)
+    MsgReader(const std::string_view msg) : arg_num_(0), next_(0) { Split_(msg); }
+
+    MsgReader(const char* const msg) : MsgReader(std::string_view(msg)) {}
+
+    MsgReader(const std::string& msg) : MsgReader(std::string_view(msg)) {}
+
+    // the views would refer to a destructed string
+    MsgReader(std::string&& msg) = delete;
+
+    MsgReader(std::vector<std::string> args) : holder_(std::move(args)), arg_num_(0), next_(0)
     {
-        std::istringstream ss(msg);
-        for (std::string arg; ss >> arg;) {
-            args_.push_back(arg);
+        for (const auto& arg : holder_) {
+            Append_(arg);
         }
-        iter_ = args_.begin();
     }
 
-    MsgReader(std::vector<std::string> args) : args_(std::move(args)), iter_(args_.begin()) {}
+    MsgReader(const MsgReader&) = delete;
+    MsgReader(MsgReader&&) = delete;
 
     ~MsgReader() {}
 
-    bool HasNext() const { return iter_ != args_.end(); }
+    bool HasNext() const { return next_ != arg_num_; }
+
+    std::string_view NextArg() { return next_ == arg_num_ ? std::string_view() : Arg_(next_++); }
+
+    void Reset() { next_ = 0; }
 
-    const std::string& NextArg()
+   private:
+    static constexpr size_t k_inline_arg_num = 16;
+
+    void Split_(const std::string_view msg)
     {
-        static const std::string k_empty;
-        return iter_ == args_.end() ? k_empty : *(iter_++);
+        size_t begin = 0;
+        for (size_t i = 0; i < msg.size(); ) {
+            if (const size_t space_size = SpaceSize_(msg.substr(i)); space_size > 0) {
+                if (begin < i) {
+                    Append_(msg.substr(begin, i - begin));
+                }
+                i += space_size;
+                begin = i;
+            } else {
+                ++i;
+            }
+        }
+        if (begin < msg.size()) {
+            Append_(msg.substr(begin));
+        }
     }
 
-    void Reset() { iter_ = args_.begin(); }
+    // Return: the size in bytes of the whitespace at the beginning of |str|, or 0 if |str| does not begin with a whitespace
+    static size_t SpaceSize_(const std::string_view str)
+    {
+        static constexpr std::string_view k_ideographic_space = "\xE3\x80\x80";
+        static constexpr std::string_view k_no_break_space = "\xC2\xA0";
+        switch (str.front()) {
+        case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+            return 1;
+        case k_ideographic_space.front():
+            return str.starts_with(k_ideographic_space) ? k_ideographic_space.size() : 0;
+        case k_no_break_space.front():
+            return str.starts_with(k_no_break_space) ? k_no_break_space.size() : 0;
+        default:
+            return 0;
+        }
+    }
 
-   private:
-    std::vector<std::string> args_;
-    std::vector<std::string>::iterator iter_;
+    void Append_(const std::string_view arg)
+    {
+        if (arg_num_ < k_inline_arg_num) {
+            inline_args_[arg_num_] = arg;
+        } else {
+            overflow_args_.emplace_back(arg);
+        }
+        ++arg_num_;
+    }
+
+    std::string_view Arg_(const size_t i) const
+    {
+        return i < k_inline_arg_num ? inline_args_[i] : overflow_args_[i - k_inline_arg_num];
+    }
+
+    const std::vector<std::string> holder_; // the arguments owned by the reader
+    std::array<std::string_view, k_inline_arg_num> inline_args_; // avoid allocation for the most messages
+    std::vector<std::string_view> overflow_args_;
+    size_t arg_num_;
+    size_t next_;
 };
 
 template <typename T>
@@ -64,6 +130,12 @@ class MsgArgChecker
     virtual std::string ColoredFormatInfo() const = 0;
     virtual std::string ExampleInfo() const = 0;
     virtual std::optional<T> Check(MsgReader& reader) const = 0;
+    // check the argument without copying it
+    virtual std::optional<T> Check(const std::string_view arg) const
+    {
+        MsgReader reader(arg);
+        return Check(reader);
+    }
     virtual std::string ArgString(const T& value) const = 0;
 };
 
@@ -88,8 +160,9 @@ class AnyArg : public MsgArgChecker<std::string>
         if (!reader.HasNext()) {
             return std::nullopt;
         }
-        return reader.NextArg();
+        return Check(reader.NextArg());
     }
+    virtual std::optional<std::string> Check(const std::string_view arg) const override { return std::string(arg); }
     virtual std::string ArgString(const std::string& value) const { return value; }
 
    private:
@@ -121,7 +194,10 @@ class BoolChecker : public MsgArgChecker<bool>
         if (!reader.HasNext()) {
             return std::nullopt;
         }
-        const std::string str = reader.NextArg();
+        return Check(reader.NextArg());
+    }
+    virtual std::optional<bool> Check(const std::string_view str) const override
+    {
         if (str == true_str_) {
             return true;
         } else if (str == false_str_) {
@@ -146,8 +222,8 @@ class AlterChecker : public MsgArgChecker<T>
 {
   public:
     template <typename String = const char* const>
-    AlterChecker(std::map<std::string, T> arg_map)
-            : arg_map_(std::move(arg_map))
+    AlterChecker(const std::map<std::string, T>& arg_map)
+            : arg_map_(arg_map.begin(), arg_map.end())
             , format_info_(FormatInfoInternal_(arg_map_))
             , colored_format_info_(HTML_COLOR_FONT_HEADER(purple) + format_info_ + HTML_FONT_TAIL)
     {}
@@ -164,8 +240,11 @@ class AlterChecker : public MsgArgChecker<T>
         if (!reader.HasNext()) {
             return std::nullopt;
         }
-        std::string s = reader.NextArg();
-        const auto it = arg_map_.find(s);
+        return Check(reader.NextArg());
+    }
+    virtual std::optional<T> Check(const std::string_view str) const
+    {
+        const auto it = arg_map_.find(str);
         return it == arg_map_.end() ? std::optional<T>() : it->second;
     }
     virtual std::string ArgString(const T& value) const
@@ -179,7 +258,7 @@ class AlterChecker : public MsgArgChecker<T>
     }
 
   private:
-    static std::string FormatInfoInternal_(const std::map<std::string, T>& arg_map)
+    static std::string FormatInfoInternal_(const std::map<std::string, T, std::less<>>& arg_map)
     {
         if (arg_map.empty()) {
             return "(错误，可选项为空)";
@@ -197,7 +276,7 @@ class AlterChecker : public MsgArgChecker<T>
         return outstr;
     }
 
-    const std::map<std::string, T> arg_map_;
+    const std::map<std::string, T, std::less<>> arg_map_;
     const std::string format_info_;
     const std::string colored_format_info_;
 };
@@ -227,7 +306,7 @@ class ArithChecker : public MsgArgChecker<T>
         }
         return Check(reader.NextArg());
     }
-    virtual std::optional<T> Check(const std::string& str) const
+    virtual std::optional<T> Check(const std::string_view str) const
     {
         T result{};
         const auto [ptr, ec] { std::from_chars(str.data(), str.data() + str.size(), result) };
@@ -279,7 +358,12 @@ class BasicChecker : public MsgArgChecker<T>
         if (!reader.HasNext()) {
             return std::nullopt;
         }
-        if (T value; std::stringstream(reader.NextArg()) >> value) {
+        return Check(reader.NextArg());
+    }
+    virtual std::optional<T> Check(const std::string_view str) const
+    {
+        ViewStreamBuf buf(str);
+        if (T value; std::istream(&buf) >> value) {
             return value;
         } else {
             return std::nullopt;
@@ -293,6 +377,17 @@ class BasicChecker : public MsgArgChecker<T>
     }
 
    private:
+    // Reads the argument in place, so that the argument is not copied into a string stream.
+    class ViewStreamBuf : public std::streambuf
+    {
+      public:
+        ViewStreamBuf(const std::string_view str)
+        {
+            char* const begin = const_cast<char*>(str.data()); // the buffer is never written
+            setg(begin, begin, begin + str.size());
+        }
+    };
+
     const std::string format_info_;
     const std::string escaped_format_info_;
     const std::string colored_format_info_;
@@ -319,6 +414,7 @@ class MsgArgChecker<void> final
     std::string EscapedFormatInfo() const { return const_arg_; };
     std::string ColoredFormatInfo() const { return const_arg_; };
     std::string ExampleInfo() const { return const_arg_; };
+    const std::string& ConstArg() const { return const_arg_; }
 
    private:
     const std::string const_arg_;
@@ -522,7 +618,7 @@ class EnumChecker : public MsgArgChecker<Enum>
         }
         return Check(reader.NextArg());
     }
-    virtual std::optional<Enum> Check(const std::string& str) const { return Enum::Parse(str); }
+    virtual std::optional<Enum> Check(const std::string_view str) const override { return Enum::Parse(str); }
     virtual std::string ArgString(const Enum& value) const { return value.ToString(); }
 
   private:
@@ -628,6 +724,7 @@ class Command<UserResult(UserArgs...)>
         virtual ~Base_() {}
         virtual CommandResult CallIfValid(MsgReader& msg_reader, UserArgs... user_args) const = 0;
         virtual std::string Info(const bool with_example = false, const bool with_html_color = false) const = 0;
+        virtual const std::string* LeadingLiteral() const = 0;
     };
 
     template <typename Callback, typename... Checkers>
@@ -709,6 +806,17 @@ class Command<UserResult(UserArgs...)>
             return outstr;
         }
 
+        virtual const std::string* LeadingLiteral() const override
+        {
+            if constexpr (sizeof...(Checkers) > 0) {
+                using FirstChecker = std::decay_t<decltype(std::get<0>(checkers_))>;
+                if constexpr (std::is_same_v<FirstChecker, VoidChecker>) {
+                    return &std::get<0>(checkers_).ConstArg();
+                }
+            }
+            return nullptr;
+        }
+
       private:
         const char* const description_;
         const Callback callback_;
@@ -730,7 +838,98 @@ class Command<UserResult(UserArgs...)>
 
     auto Info(const bool with_example, const bool with_html_color) const { return cmd_->Info(with_example, with_html_color); }
 
+    // Return: the argument which the request must begin with, or nullptr if the command begins with a typed argument
+    const std::string* LeadingLiteral() const { return cmd_->LeadingLiteral(); }
+
   private:
     std::shared_ptr<Base_> cmd_;
 };
 
+template <typename> class CommandIndex;
+
+// Indexes the commands by their leading literals once when the commands are registered, so that a request is only
+// checked against the commands with the same leading literal and the commands beginning with typed arguments. The
+// candidates are checked in the registration order, so the matched command is the same as checking all commands one
+// by one.
+template <typename UserResult, typename ...UserArgs>
+class CommandIndex<UserResult(UserArgs...)>
+{
+  public:
+    using CommandType = Command<UserResult(UserArgs...)>;
+    using CommandResult = typename std::conditional_t<std::is_void_v<UserResult>, bool, std::optional<UserResult>>;
+
+    CommandIndex() {}
+
+    CommandIndex(std::vector<CommandType> commands) : commands_(std::move(commands))
+    {
+        for (uint32_t i = 0; i < commands_.size(); ++i) {
+            Index_(i);
+        }
+    }
+
+    CommandIndex(const CommandIndex&) = default;
+    CommandIndex(CommandIndex&&) = default;
+
+    void Add(CommandType command)
+    {
+        commands_.emplace_back(std::move(command));
+        Index_(commands_.size() - 1);
+    }
+
+    CommandResult CallIfValid(MsgReader& msg_reader, UserArgs... user_args) const
+    {
+        const std::vector<uint32_t>& literal_bucket = LiteralBucket_(msg_reader);
+        auto literal_it = literal_bucket.begin();
+        auto typed_it = typed_bucket_.begin();
+        // merge the two buckets to keep the registration order
+        while (literal_it != literal_bucket.end() || typed_it != typed_bucket_.end()) {
+            const uint32_t i = typed_it == typed_bucket_.end() ||
+                    (literal_it != literal_bucket.end() && *literal_it < *typed_it) ? *(literal_it++) : *(typed_it++);
+            if (auto result = commands_[i].CallIfValid(msg_reader, user_args...); result) {
+                return result;
+            }
+        }
+        return CommandResult{};
+    }
+
+    // Return: the number of commands which will be checked for the request
+    size_t CandidateNum(MsgReader& msg_reader) const { return LiteralBucket_(msg_reader).size() + typed_bucket_.size(); }
+
+    bool empty() const { return commands_.empty(); }
+    size_t size() const { return commands_.size(); }
+    auto begin() const { return commands_.begin(); }
+    auto end() const { return commands_.end(); }
+
+  private:
+    void Index_(const uint32_t i)
+    {
+        if (const std::string* const literal = commands_[i].LeadingLiteral()) {
+            literal_buckets_[*literal].emplace_back(i);
+        } else {
+            typed_bucket_.emplace_back(i);
+        }
+    }
+
+    const std::vector<uint32_t>& LiteralBucket_(MsgReader& msg_reader) const
+    {
+        static const std::vector<uint32_t> k_empty;
+        msg_reader.Reset();
+        if (!msg_reader.HasNext()) {
+            return k_empty;
+        }
+        const auto it = literal_buckets_.find(msg_reader.NextArg());
+        msg_reader.Reset();
+        return it == literal_buckets_.end() ? k_empty : it->second;
+    }
+
+    struct LiteralHash_
+    {
+        using is_transparent = void;
+        size_t operator()(const std::string_view literal) const { return std::hash<std::string_view>()(literal); }
+    };
+
+    std::vector<CommandType> commands_;
+    std::unordered_map<std::string, std::vector<uint32_t>, LiteralHash_, std::equal_to<>> literal_buckets_;
+    std::vector<uint32_t> typed_bucket_; // the commands beginning with typed arguments, which may match any request
+};
+
@@ -0,0 +1,154 @@
+// Copyright (c) 2018-present, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under LGPLv2 (found in the LICENSE file).
+
+#include <array>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "checkpoint.h"
+
+enum class Color { RED = 'R', BLUE = 'B' };
+
+struct IntegerID
+{
+    IntegerID() : id_(UINT64_MAX) {}
+    IntegerID(const uint64_t id) : id_(id) {}
+    operator uint64_t() const { return id_; }
+    uint64_t id_;
+};
+
+struct StringID
+{
+    StringID() = default;
+    StringID(std::string id) : id_(std::move(id)) {}
+    operator std::string() const { return id_; }
+    std::string id_;
+};
+
+class Counter
+{
+  public:
+    void Checkpoint(CheckpointWriter& writer) const { writer.Write(count_); }
+    bool Restore(CheckpointReader& reader) { return reader.Read(count_) && count_ >= 0; }
+    int32_t count_ = 0;
+};
+
+template <typename T>
+T WriteAndRead(const T& value)
+{
+    CheckpointWriter writer;
+    writer.Write(value);
+    CheckpointReader reader(writer.Str());
+    T result{};
+    EXPECT_TRUE(reader.Read(result)) << writer.Str();
+    EXPECT_TRUE(reader.IsEnd()) << writer.Str();
+    return result;
+}
+
+TEST(TestCheckpoint, format)
+{
+    CheckpointWriter writer;
+    writer.Write(true, -12, std::string("a:b"), std::vector<uint32_t>{7, 8});
+    ASSERT_EQ("1:13:-123:a:b1:21:71:8", writer.Str());
+}
+
+TEST(TestCheckpoint, arithmetic)
+{
+    ASSERT_EQ(true, WriteAndRead(true));
+    ASSERT_EQ(false, WriteAndRead(false));
+    ASSERT_EQ('x', WriteAndRead('x'));
+    ASSERT_EQ(INT64_MIN, WriteAndRead(INT64_MIN));
+    ASSERT_EQ(UINT64_MAX, WriteAndRead(UINT64_MAX));
+    ASSERT_EQ(0.1, WriteAndRead(0.1));
+    ASSERT_EQ(-1.5f, WriteAndRead(-1.5f));
+    ASSERT_EQ(1.0 / 3, WriteAndRead(1.0 / 3));
+    ASSERT_EQ(-0.1f, WriteAndRead(-0.1f));
+}
+
+TEST(TestCheckpoint, enum_and_ids)
+{
+    ASSERT_EQ(Color::BLUE, WriteAndRead(Color::BLUE));
+    ASSERT_EQ(3, WriteAndRead(IntegerID(3)).id_);
+    ASSERT_EQ("玩家", WriteAndRead(StringID("玩家")).id_);
+}
+
+TEST(TestCheckpoint, strings)
+{
+    ASSERT_EQ("", WriteAndRead(std::string()));
+    ASSERT_EQ("1:2 3\n", WriteAndRead(std::string("1:2 3\n")));
+    ASSERT_EQ(std::string("a\0b", 3), WriteAndRead(std::string("a\0b", 3)));
+}
+
+TEST(TestCheckpoint, containers)
+{
+    const std::vector<std::optional<std::string>> vec{"a", std::nullopt, ""};
+    ASSERT_EQ(vec, WriteAndRead(vec));
+    const std::vector<bool> bits{true, false, true};
+    ASSERT_EQ(bits, WriteAndRead(bits));
+    const std::array<std::array<Color, 2>, 2> arr{{{Color::RED, Color::BLUE}, {Color::BLUE, Color::RED}}};
+    ASSERT_EQ(arr, WriteAndRead(arr));
+    const std::map<std::string, std::set<int>> map{{"a", {1, 2}}, {"b", {}}};
+    ASSERT_EQ(map, WriteAndRead(map));
+    const std::tuple<int, std::string, std::pair<bool, double>> tuple{1, "a", {true, 2.5}};
+    ASSERT_EQ(tuple, WriteAndRead(tuple));
+}
+
+TEST(TestCheckpoint, member_hooks)
+{
+    Counter counter;
+    counter.count_ = 5;
+    ASSERT_EQ(5, WriteAndRead(counter).count_);
+
+    CheckpointWriter writer;
+    writer.Write(-1);
+    CheckpointReader reader(writer.Str());
+    ASSERT_FALSE(reader.Read(counter));
+}
+
+TEST(TestCheckpoint, random_engine_is_resumed)
+{
+    std::mt19937 engine(42);
+    engine.discard(100);
+    auto restored_engine = WriteAndRead(engine);
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(engine(), restored_engine());
+    }
+}
+
+TEST(TestCheckpoint, read_broken_checkpoint)
+{
+    const auto can_read = [](const std::string_view str, auto value) { return CheckpointReader(str).Read(value); };
+    ASSERT_FALSE(can_read("", 0));
+    ASSERT_FALSE(can_read("1", 0));
+    ASSERT_FALSE(can_read("3:12", 0)); // truncated
+    ASSERT_FALSE(can_read("x:1", 0));
+    ASSERT_FALSE(can_read("1:a", 0));
+    ASSERT_FALSE(can_read("3:300", uint8_t(0))); // out of range
+    ASSERT_FALSE(can_read("1:2", false));
+    ASSERT_FALSE(can_read("2:-1", uint32_t(0)));
+    ASSERT_FALSE(can_read("9:999999999", std::vector<int>())); // the size is larger than the remaining
+    ASSERT_FALSE(can_read("1:21:1", std::vector<int>()));
+}
+
+TEST(TestCheckpoint, read_in_order)
+{
+    CheckpointWriter writer;
+    writer.Write(1, std::string("a")).Write(2);
+    CheckpointReader reader(writer.Str());
+    int a = 0;
+    std::string b;
+    int c = 0;
+    ASSERT_TRUE(reader.Read(a, b));
+    ASSERT_FALSE(reader.IsEnd());
+    ASSERT_TRUE(reader.Read(c));
+    ASSERT_TRUE(reader.IsEnd());
+    ASSERT_EQ(1, a);
+    ASSERT_EQ("a", b);
+    ASSERT_EQ(2, c);
+    ASSERT_FALSE(reader.Read(c));
+}
@@ -20,6 +20,10 @@ ENUM_END(MyEnum)
 #define TEST_MSG_CHECKER_CC
 
 #include <array>
+#include <atomic>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
 #include <string_view>
 #include <map>
 #include <gtest/gtest.h>
@@ -29,6 +33,22 @@ ENUM_END(MyEnum)
 #define ENUM_FILE "test_msg_checker.cc"
 #include "extend_enum.h"
 
+static std::atomic<uint64_t> g_allocation_num = 0;
+
+void* operator new(const size_t size)
+{
+    ++g_allocation_num;
+    if (void* const p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// The deletes are not inlined, otherwise the compiler sees a pointer returned by the new being passed to free.
+[[gnu::noinline]] void operator delete(void* const p) noexcept { std::free(p); }
+
+[[gnu::noinline]] void operator delete(void* const p, const size_t) noexcept { std::free(p); }
+
 class TestMsgChecker : public testing::Test
 {
 
@@ -55,6 +75,60 @@ do { \
     ASSERT_FALSE(checker.Check(reader)); \
 } while (0)
 
+TEST_F(TestMsgChecker, test_msg_reader)
+{
+    MsgReader reader(" 出牌\t红桃A\xE3\x80\x80\xE3\x80\x80黑桃10\xC2\xA0 结束\xE3\x80\x80");
+    ASSERT_EQ("出牌", reader.NextArg());
+    ASSERT_EQ("红桃A", reader.NextArg());
+    ASSERT_EQ("黑桃10", reader.NextArg());
+    ASSERT_TRUE(reader.HasNext());
+    ASSERT_EQ("结束", reader.NextArg());
+    ASSERT_FALSE(reader.HasNext());
+    ASSERT_EQ("", reader.NextArg());
+    reader.Reset();
+    ASSERT_EQ("出牌", reader.NextArg());
+}
+
+TEST_F(TestMsgChecker, test_msg_reader_empty)
+{
+    MsgReader reader(" \xE3\x80\x80\n");
+    ASSERT_FALSE(reader.HasNext());
+}
+
+TEST_F(TestMsgChecker, test_msg_reader_many_args)
+{
+    std::string msg;
+    for (int i = 0; i < 100; ++i) {
+        msg += std::to_string(i) + " ";
+    }
+    MsgReader reader(msg);
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(std::to_string(i), reader.NextArg());
+    }
+    ASSERT_FALSE(reader.HasNext());
+}
+
+TEST_F(TestMsgChecker, test_msg_reader_from_args)
+{
+    MsgReader reader(std::vector<std::string>{"a b", "", "c"});
+    ASSERT_EQ("a b", reader.NextArg());
+    ASSERT_EQ("", reader.NextArg());
+    ASSERT_EQ("c", reader.NextArg());
+    ASSERT_FALSE(reader.HasNext());
+}
+
+TEST_F(TestMsgChecker, test_check_view)
+{
+    const std::string msg = "12 是 two";
+    const std::string_view view(msg);
+    ASSERT_EQ(12, ArithChecker<int>(0, 20).Check(view.substr(0, 2)));
+    ASSERT_EQ(true, BoolChecker("是", "否").Check(view.substr(3, 3)));
+    ASSERT_EQ(MyEnum::two, EnumChecker<MyEnum>().Check(view.substr(7)));
+    ASSERT_EQ(2, AlterChecker<int>({{"one", 1}, {"two", 2}}).Check(view.substr(7)));
+    ASSERT_EQ("12 是", AnyArg().Check(view.substr(0, 6)));
+    ASSERT_FALSE(ArithChecker<int>(0, 20).Check(view));
+}
+
 TEST_F(TestMsgChecker, any_checker)
 {
     AnyArg checker;
@@ -175,6 +249,17 @@ TEST_F(TestMsgChecker, test_basic_checker)
     ASSERT_EQ("1", checker.ArgString(Obj{2}));
 }
 
+TEST_F(TestMsgChecker, test_basic_checker_without_allocation)
+{
+    BasicChecker<Obj> checker;
+    const std::string_view view = "00000000000000000012 zero"; // longer than the small string buffer
+    const uint64_t allocation_num_begin = g_allocation_num;
+    ASSERT_EQ(Obj{13}, checker.Check(view.substr(0, 20)));
+    ASSERT_EQ(Obj{2}, checker.Check(view.substr(0, 19))); // the argument is not read beyond the view
+    ASSERT_FALSE(checker.Check(view.substr(21)));
+    ASSERT_EQ(0, g_allocation_num - allocation_num_begin);
+}
+
 TEST_F(TestMsgChecker, test_void_checker)
 {
     VoidChecker checker("test");
@@ -260,6 +345,143 @@ TEST_F(TestMsgChecker, test_flags_checker)
     ASSERT_EQ("", checker.ArgString(0b000));
 }
 
+TEST_F(TestMsgChecker, test_command_index_keeps_registration_order)
+{
+    CommandIndex<int()> index;
+    index.Add(Command<int()>("literal", [] { return 1; }, VoidChecker("a"), VoidChecker("b")));
+    index.Add(Command<int()>("typed", [](const std::string&) { return 2; }, AnyArg()));
+    index.Add(Command<int()>("literal after typed", [] { return 3; }, VoidChecker("a")));
+    index.Add(Command<int()>("typed with two args", [](const int, const std::string&) { return 4; },
+                ArithChecker<int>(0, 10), AnyArg()));
+    index.Add(Command<int()>("empty", [] { return 5; }));
+    const auto call = [&](const std::string& msg) { MsgReader reader(msg); return index.CallIfValid(reader); };
+    ASSERT_EQ(1, call("a b"));
+    ASSERT_EQ(2, call("a"));
+    ASSERT_EQ(2, call("c"));
+    ASSERT_EQ(4, call("1 c"));
+    ASSERT_EQ(5, call(""));
+    ASSERT_FALSE(call("a c"));
+    ASSERT_FALSE(call("c d e"));
+}
+
+TEST_F(TestMsgChecker, test_command_index_candidate_num)
+{
+    CommandIndex<int()> index(std::vector<Command<int()>>{
+            Command<int()>("a", [] { return 1; }, VoidChecker("a")),
+            Command<int()>("a x", [](const std::string&) { return 2; }, VoidChecker("a"), AnyArg()),
+            Command<int()>("b", [] { return 3; }, VoidChecker("b")),
+            Command<int()>("typed", [](const bool) { return 4; }, BoolChecker("y", "n")),
+        });
+    ASSERT_EQ(4, index.size());
+    MsgReader reader_a("a x");
+    ASSERT_EQ(3, index.CandidateNum(reader_a));
+    ASSERT_EQ(2, index.CallIfValid(reader_a));
+    MsgReader reader_b("b");
+    ASSERT_EQ(2, index.CandidateNum(reader_b));
+    MsgReader reader_typo("c");
+    ASSERT_EQ(1, index.CandidateNum(reader_typo));
+    ASSERT_FALSE(index.CallIfValid(reader_typo));
+}
+
+// Benchmark
+
+TEST_F(TestMsgChecker, benchmark_command_index)
+{
+    constexpr int k_literal_command_num = 40;
+    constexpr int k_lookup_num = 100000;
+    std::vector<Command<int()>> commands;
+    for (int i = 0; i < k_literal_command_num; ++i) {
+        commands.emplace_back("literal", [i](const std::optional<int>) { return i; }, VoidChecker("#cmd" + std::to_string(i)),
+                OptionalChecker<ArithChecker<int>>(0, 100));
+    }
+    commands.emplace_back("typed", [](const int, const int) { return -1; }, ArithChecker<int>(0, 100), ArithChecker<int>(0, 100));
+    const CommandIndex<int()> index(commands);
+
+    for (const std::string msg : {"#cmd0 1", "#cmd39 1", "#cmd40 1", "1 2"}) {
+        MsgReader reader(msg);
+        int linear_matched_num = 0;
+        const auto linear_begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < k_lookup_num; ++i) {
+            for (const auto& command : commands) {
+                if (command.CallIfValid(reader)) {
+                    ++linear_matched_num;
+                    break;
+                }
+            }
+        }
+        const auto linear_cost = std::chrono::steady_clock::now() - linear_begin;
+
+        int index_matched_num = 0;
+        const auto index_begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < k_lookup_num; ++i) {
+            index_matched_num += index.CallIfValid(reader).has_value();
+        }
+        const auto index_cost = std::chrono::steady_clock::now() - index_begin;
+
+        ASSERT_EQ(linear_matched_num, index_matched_num);
+        std::cout << "[BENCHMARK] msg=\"" << msg << "\" linear_ns_per_lookup="
+                  << std::chrono::duration_cast<std::chrono::nanoseconds>(linear_cost).count() / k_lookup_num
+                  << " index_ns_per_lookup="
+                  << std::chrono::duration_cast<std::chrono::nanoseconds>(index_cost).count() / k_lookup_num
+                  << std::endl;
+    }
+}
+
+TEST_F(TestMsgChecker, benchmark_parse_request_without_allocation)
+{
+    // the requests recorded from the meta commands and the game commands
+    static const std::array<const char*, 12> k_corpus{
+        "#帮助", "#游戏列表 图片", "#规则 猜拳游戏", "#新游戏 五子棋", "#加入 3",
+        "#战绩\xE3\x80\x80文字", "赛况", "7 8", "结束 否", "two\xE3\x80\x80three one", "1 2 3 4 5 6 7 8 9 10 11 12", "帮助 图片",
+    };
+    CommandIndex<int()> index;
+    index.Add(Command<int()>("help", [](const bool) { return 0; }, VoidChecker("#帮助"),
+                OptionalDefaultChecker<BoolChecker>(false, "文字", "图片")));
+    index.Add(Command<int()>("game list", [](const bool) { return 1; }, VoidChecker("#游戏列表"),
+                OptionalDefaultChecker<BoolChecker>(false, "文字", "图片")));
+    index.Add(Command<int()>("join", [](const int) { return 2; }, VoidChecker("#加入"), ArithChecker<int>(0, 100)));
+    index.Add(Command<int()>("score", [](const bool) { return 3; }, VoidChecker("#战绩"), BoolChecker("文字", "图片")));
+    index.Add(Command<int()>("status", [] { return 4; }, VoidChecker("赛况")));
+    index.Add(Command<int()>("set", [](const int, const int) { return 5; }, ArithChecker<int>(0, 14),
+                ArithChecker<int>(0, 14)));
+    index.Add(Command<int()>("finish", [](const bool) { return 6; }, VoidChecker("结束"), BoolChecker("是", "否")));
+    index.Add(Command<int()>("flags", [](const MyEnum::BitSet&) { return 7; }, FlagsChecker<MyEnum>()));
+    index.Add(Command<int()>("help", [](const bool) { return 8; }, VoidChecker("帮助"), BoolChecker("文字", "图片")));
+
+    constexpr int k_round_num = 10000;
+    int matched_num = 0;
+    const uint64_t allocation_num_begin = g_allocation_num;
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < k_round_num; ++i) {
+        for (const char* const msg : k_corpus) {
+            MsgReader reader(msg);
+            matched_num += index.CallIfValid(reader).has_value();
+        }
+    }
+    const auto cost = std::chrono::steady_clock::now() - begin;
+    const uint64_t allocation_num = g_allocation_num - allocation_num_begin;
+    // the rule, new game and repeated number commands are not registered, because the string and vector arguments passed
+    // to the callbacks still need allocation
+    ASSERT_EQ(k_round_num * 9, matched_num);
+
+    uint64_t legacy_allocation_num = g_allocation_num;
+    for (int i = 0; i < k_round_num; ++i) {
+        for (const char* const msg : k_corpus) {
+            std::vector<std::string> args;
+            std::istringstream ss(msg);
+            for (std::string arg; ss >> arg;) {
+                args.push_back(arg);
+            }
+        }
+    }
+    legacy_allocation_num = g_allocation_num - legacy_allocation_num;
+
+    std::cout << "[BENCHMARK] requests=" << k_round_num * k_corpus.size()
+              << " ns_per_request=" << std::chrono::duration_cast<std::chrono::nanoseconds>(cost).count() / (k_round_num * k_corpus.size())
+              << " allocations=" << allocation_num << " legacy_tokenizer_allocations=" << legacy_allocation_num << std::endl;
+    ASSERT_EQ(0, allocation_num);
+}
+
 int main(int argc, char** argv)
 {
   testing::InitGoogleTest(&argc, argv);